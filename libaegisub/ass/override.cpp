@@ -0,0 +1,370 @@
+// Copyright (c) 2014, Thomas Goyne <plorkyeran@aegisub.org>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+
+#include "libaegisub/ass/override.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace {
+using namespace agi::ass;
+
+/// Only parameters not at the end need to be marked as optional; this is
+/// just to know which parameters to skip when there are earlier optional
+/// arguments
+enum {
+	NOT_OPTIONAL = 0xFF,
+	OPTIONAL_2 = 0x02,
+	OPTIONAL_3 = 0x04,
+	OPTIONAL_4 = 0x08
+};
+
+constexpr ParameterProto param(ParameterType type, ParameterClass classification = ParameterClass::NORMAL, int optional = NOT_OPTIONAL) {
+	return ParameterProto{optional, type, classification};
+}
+
+const auto INT = ParameterType::INT;
+const auto FLOAT = ParameterType::FLOAT;
+const auto TEXT = ParameterType::TEXT;
+const auto BOOL = ParameterType::BOOL;
+const auto BLOCK = ParameterType::BLOCK;
+
+const auto SIZE = ParameterClass::ABSOLUTE_SIZE;
+const auto POS_X = ParameterClass::ABSOLUTE_POS_X;
+const auto POS_Y = ParameterClass::ABSOLUTE_POS_Y;
+const auto TIME_START = ParameterClass::RELATIVE_TIME_START;
+const auto TIME_END = ParameterClass::RELATIVE_TIME_END;
+const auto NORMAL = ParameterClass::NORMAL;
+
+// Longer tag names must appear before shorter tag names
+const TagProto protos[] = {
+	{"\\alpha", 1, {param(TEXT, ParameterClass::ALPHA)}}, // \alpha&H<aa>&
+	{"\\bord", 1, {param(FLOAT, SIZE)}}, // \bord<depth>
+	{"\\xbord", 1, {param(FLOAT, SIZE)}}, // \xbord<depth>
+	{"\\ybord", 1, {param(FLOAT, SIZE)}}, // \ybord<depth>
+	{"\\shad", 1, {param(FLOAT, SIZE)}}, // \shad<depth>
+	{"\\xshad", 1, {param(FLOAT, SIZE)}}, // \xshad<depth>
+	{"\\yshad", 1, {param(FLOAT, SIZE)}}, // \yshad<depth>
+
+	// \fade(<a1>,<a2>,<a3>,<t1>,<t2>,<t3>,<t4>)
+	{"\\fade", 7, {param(INT), param(INT), param(INT),
+		param(INT, TIME_START), param(INT, TIME_START), param(INT, TIME_START), param(INT, TIME_START)}},
+
+	// \move(<x1>,<y1>,<x2>,<y2>[,<t1>,<t2>])
+	{"\\move", 6, {param(FLOAT, POS_X), param(FLOAT, POS_Y), param(FLOAT, POS_X), param(FLOAT, POS_Y),
+		param(INT, TIME_START), param(INT, TIME_START)}},
+
+	// If these are rearranged, keep rect clip and vector clip adjacent in this order
+	// \clip(<x1>,<y1>,<x2>,<y2>)
+	{"\\clip", 4, {param(INT, POS_X), param(INT, POS_Y), param(INT, POS_X), param(INT, POS_Y)}},
+	// \clip([<scale>,]<some drawings>)
+	{"\\clip", 2, {param(INT, NORMAL, OPTIONAL_2), param(TEXT, ParameterClass::DRAWING)}},
+	// \iclip(<x1>,<y1>,<x2>,<y2>)
+	{"\\iclip", 4, {param(INT, POS_X), param(INT, POS_Y), param(INT, POS_X), param(INT, POS_Y)}},
+	// \iclip([<scale>,]<some drawings>)
+	{"\\iclip", 2, {param(INT, NORMAL, OPTIONAL_2), param(TEXT, ParameterClass::DRAWING)}},
+
+	{"\\fscx", 1, {param(FLOAT, ParameterClass::RELATIVE_SIZE_X)}}, // \fscx<percent>
+	{"\\fscy", 1, {param(FLOAT, ParameterClass::RELATIVE_SIZE_Y)}}, // \fscy<percent>
+	{"\\pos", 2, {param(FLOAT, POS_X), param(FLOAT, POS_Y)}}, // \pos(<x>,<y>)
+	{"\\org", 2, {param(INT, POS_X), param(INT, POS_Y)}}, // \org(<x>,<y>)
+	{"\\pbo", 1, {param(INT, POS_Y)}}, // \pbo<y>
+	{"\\fad", 2, {param(INT, TIME_START), param(INT, TIME_END)}}, // \fad(<t1>,<t2>)
+	{"\\fsp", 1, {param(FLOAT, SIZE)}}, // \fsp<pixels>
+	{"\\frx", 1, {param(FLOAT)}}, // \frx<degrees>
+	{"\\fry", 1, {param(FLOAT)}}, // \fry<degrees>
+	{"\\frz", 1, {param(FLOAT)}}, // \frz<degrees>
+	{"\\fr", 1, {param(FLOAT)}}, // \fr<degrees>
+	{"\\fax", 1, {param(FLOAT)}}, // \fax<factor>
+	{"\\fay", 1, {param(FLOAT)}}, // \fay<factor>
+	{"\\1c", 1, {param(TEXT, ParameterClass::COLOR)}}, // \1c&H<bbggrr>&
+	{"\\2c", 1, {param(TEXT, ParameterClass::COLOR)}}, // \2c&H<bbggrr>&
+	{"\\3c", 1, {param(TEXT, ParameterClass::COLOR)}}, // \3c&H<bbggrr>&
+	{"\\4c", 1, {param(TEXT, ParameterClass::COLOR)}}, // \4c&H<bbggrr>&
+	{"\\1a", 1, {param(TEXT, ParameterClass::ALPHA)}}, // \1a&H<aa>&
+	{"\\2a", 1, {param(TEXT, ParameterClass::ALPHA)}}, // \2a&H<aa>&
+	{"\\3a", 1, {param(TEXT, ParameterClass::ALPHA)}}, // \3a&H<aa>&
+	{"\\4a", 1, {param(TEXT, ParameterClass::ALPHA)}}, // \4a&H<aa>&
+	{"\\fe", 1, {param(TEXT)}}, // \fe<charset>
+	{"\\ko", 1, {param(INT, ParameterClass::KARAOKE)}}, // \ko<duration>
+	{"\\kf", 1, {param(INT, ParameterClass::KARAOKE)}}, // \kf<duration>
+	{"\\be", 1, {param(INT, SIZE)}}, // \be<strength>
+	{"\\blur", 1, {param(FLOAT, SIZE)}}, // \blur<strength>
+	{"\\fn", 1, {param(TEXT)}}, // \fn<name>
+	{"\\fs+", 1, {param(FLOAT)}}, // \fs+<size>
+	{"\\fs-", 1, {param(FLOAT)}}, // \fs-<size>
+	{"\\fs", 1, {param(FLOAT, SIZE)}}, // \fs<size>
+	{"\\an", 1, {param(INT)}}, // \an<alignment>
+	{"\\c", 1, {param(TEXT, ParameterClass::COLOR)}}, // \c&H<bbggrr>&
+	{"\\b", 1, {param(INT)}}, // \b<0/1/weight>
+	{"\\i", 1, {param(BOOL)}}, // \i<0/1>
+	{"\\u", 1, {param(BOOL)}}, // \u<0/1>
+	{"\\s", 1, {param(BOOL)}}, // \s<0/1>
+	{"\\a", 1, {param(INT)}}, // \a<alignment>
+	{"\\k", 1, {param(INT, ParameterClass::KARAOKE)}}, // \k<duration>
+	{"\\K", 1, {param(INT, ParameterClass::KARAOKE)}}, // \K<duration>
+	{"\\q", 1, {param(INT)}}, // \q<0-3>
+	{"\\p", 1, {param(INT)}}, // \p<n>
+	{"\\r", 1, {param(TEXT)}}, // \r[<name>]
+
+	// \t([<t1>,<t2>,][<accel>,]<style modifiers>)
+	{"\\t", 4, {param(INT, TIME_START, OPTIONAL_3 | OPTIONAL_4), param(INT, TIME_START, OPTIONAL_3 | OPTIONAL_4),
+		param(FLOAT, NORMAL, OPTIONAL_2 | OPTIONAL_4), param(BLOCK)}}
+};
+
+/// The prototypes for each character following the slash, in table order
+struct candidate_list {
+	std::vector<TagProto const *> lists[256];
+
+	candidate_list() {
+		for (auto const& proto : protos)
+			lists[(unsigned char)proto.name[1]].push_back(&proto);
+	}
+
+	std::vector<TagProto const *> const& operator[](unsigned char c) const { return lists[c]; }
+};
+
+bool is_space(char c) {
+	return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
+
+boost::string_view trim(boost::string_view str) {
+	while (!str.empty() && is_space(str.front())) str.remove_prefix(1);
+	while (!str.empty() && is_space(str.back())) str.remove_suffix(1);
+	return str;
+}
+
+/// Call f with a nul-terminated copy of str, which is on the stack unless
+/// str is unreasonably long for a number
+template<typename Func>
+auto with_c_str(boost::string_view str, Func&& f) -> decltype(f("")) {
+	char buf[64];
+	if (str.size() < sizeof buf) {
+		memcpy(buf, str.data(), str.size());
+		buf[str.size()] = 0;
+		return f(buf);
+	}
+	return f(str.to_string().c_str());
+}
+
+void visit_tags(boost::string_view block, int depth, DialogueVisitor &visitor, int *drawing_level) {
+	Tag tag;
+	auto visit = [&](boost::string_view text) {
+		ParseTag(text, tag);
+		tag.depth = depth;
+		if (drawing_level && tag.name == "\\p")
+			*drawing_level = tag.params[0].GetInt(0);
+		visitor.VisitTag(tag);
+
+		for (size_t i = 0; i < tag.param_count; ++i) {
+			if (tag.params[i].type == ParameterType::BLOCK && !tag.params[i].omitted)
+				visit_tags(tag.params[i].value, depth + 1, visitor, nullptr);
+		}
+	};
+
+	int paren_depth = 0;
+	size_t start = 0;
+	for (size_t i = 1; i < block.size(); ++i) {
+		if (paren_depth > 0) {
+			if (block[i] == ')')
+				--paren_depth;
+		}
+		else if (block[i] == '\\') {
+			visit(block.substr(start, i - start));
+			start = i;
+		}
+		else if (block[i] == '(')
+			++paren_depth;
+	}
+
+	if (!block.empty())
+		visit(block.substr(start));
+}
+}
+
+namespace agi { namespace ass {
+int Parameter::GetInt(int def) const {
+	if (omitted) return def;
+	if (classification == ParameterClass::ALPHA) {
+		return with_c_str(value, [](const char *str) {
+			// &Hxx&, but vsfilter lets you leave everything out
+			auto digits = std::find_if(str, str + strlen(str), [](char c) { return isxdigit((unsigned char)c); });
+			return (int)std::min(std::max(strtol(digits, nullptr, 16), 0L), 255L);
+		});
+	}
+
+	// atoi without needing a nul-terminated copy
+	auto str = value;
+	while (!str.empty() && is_space(str.front())) str.remove_prefix(1);
+	bool negative = !str.empty() && str.front() == '-';
+	if (!str.empty() && (str.front() == '-' || str.front() == '+')) str.remove_prefix(1);
+	unsigned int ret = 0;
+	for (char c : str) {
+		if (c < '0' || c > '9') break;
+		ret = ret * 10 + (c - '0');
+	}
+	return negative ? -(int)ret : (int)ret;
+}
+
+double Parameter::GetDouble(double def) const {
+	if (omitted) return def;
+	return with_c_str(value, [](const char *str) { return atof(str); });
+}
+
+TagProto const *FindTag(boost::string_view text) {
+	if (text.size() < 2 || text[0] != '\\') return nullptr;
+	static const candidate_list candidates;
+	for (auto proto : candidates[(unsigned char)text[1]]) {
+		if (text.substr(1).starts_with(proto->name + 1))
+			return proto;
+	}
+	return nullptr;
+}
+
+size_t SplitParameters(boost::string_view text, boost::string_view *out, size_t max_count) {
+	size_t count = 0;
+	auto add = [&](boost::string_view param) {
+		if (count < max_count)
+			out[count] = param;
+		++count;
+	};
+
+	if (text.empty())
+		return 0;
+
+	// Without parentheses the whole thing is the only parameter
+	if (text[0] != '(') {
+		add(trim(text));
+		return count;
+	}
+
+	size_t i = 0, len = text.size();
+	int depth = 1;
+	while (i < len && depth > 0) {
+		// Skip until the next ',' or the ')' closing the parameter list
+		size_t start = ++i;
+		while (i < len && depth > 0) {
+			char c = text[i];
+			if (c == ',' && depth == 1) break;
+			if (c == '(') ++depth;
+			else if (c == ')' && --depth == 0) break;
+			++i;
+		}
+		add(trim(text.substr(start, i - start)));
+	}
+
+	// Garbage after the parentheses is kept as an extra parameter
+	if (i + 1 < len)
+		add(text.substr(i + 1));
+	return count;
+}
+
+void ParseTag(boost::string_view text, Tag &tag) {
+	tag.text = text;
+	tag.proto = FindTag(text);
+	if (!tag.proto) {
+		tag.name = text;
+		tag.param_count = 0;
+		return;
+	}
+
+	tag.name = text.substr(0, strlen(tag.proto->name));
+
+	boost::string_view values[max_parameters];
+	size_t total = SplitParameters(text.substr(tag.name.size()), values, max_parameters);
+
+	// vector (i)clip is the prototype after the rectangular one
+	if (total != 4 && (tag.name == "\\clip" || tag.name == "\\iclip"))
+		++tag.proto;
+
+	// With more parameters than any tag takes, none of them are present
+	int present = total > 0 && total <= 8 ? 1 << (total - 1) : 0;
+
+	size_t cur = 0;
+	tag.param_count = tag.proto->param_count;
+	for (size_t i = 0; i < tag.param_count; ++i) {
+		auto const& proto = tag.proto->params[i];
+		auto& param = tag.params[i];
+		param.type = proto.type;
+		param.classification = proto.classification;
+		param.omitted = !(proto.optional & present) || cur >= total;
+		param.value = param.omitted ? boost::string_view() : values[cur++];
+	}
+}
+
+void VisitDialogue(boost::string_view text, DialogueVisitor &visitor) {
+	int drawing_level = 0;
+
+	for (size_t len = text.size(), cur = 0; cur < len; ) {
+		if (text[cur] == '{') {
+			size_t end = text.find('}', cur);
+
+			// VSFilter requires that override blocks be closed, while libass
+			// does not. We match VSFilter here.
+			if (end != boost::string_view::npos) {
+				auto block = text.substr(cur + 1, end - cur - 1);
+				cur = end + 1;
+
+				if (!block.empty() && block.find('\\') == boost::string_view::npos)
+					visitor.VisitComment(block);
+				else
+					visit_tags(block, 0, visitor, &drawing_level);
+				continue;
+			}
+		}
+
+		size_t end = std::min(text.find('{', cur + 1), len);
+		auto part = text.substr(cur, end - cur);
+		cur = end;
+
+		if (drawing_level == 0)
+			visitor.VisitText(part);
+		else
+			visitor.VisitDrawing(part, drawing_level);
+	}
+}
+
+TextRewriter::TextRewriter(boost::string_view source, std::string &out)
+: source(source)
+, copied(source.data())
+, out(out)
+{
+	out.clear();
+}
+
+void TextRewriter::Replace(boost::string_view part, boost::string_view replacement) {
+	out.append(copied, part.data() - copied);
+	out.append(replacement.data(), replacement.size());
+	copied = part.data() + part.size();
+	changed = true;
+}
+
+void TextRewriter::Replace(boost::string_view part, int replacement) {
+	char buf[16];
+	Replace(part, boost::string_view(buf, snprintf(buf, sizeof buf, "%d", replacement)));
+}
+
+bool TextRewriter::Finish() {
+	if (changed)
+		out.append(copied, source.data() + source.size() - copied);
+	return changed;
+}
+} }
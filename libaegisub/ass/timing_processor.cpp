@@ -0,0 +1,136 @@
+// Copyright (c) 2014, Thomas Goyne <plorkyeran@aegisub.org>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include <libaegisub/ass/timing_processor.h>
+
+#include <libaegisub/vfr.h>
+
+#include <algorithm>
+#include <set>
+#include <unordered_map>
+
+// All comparisons other than for adjacency are done on times rounded to
+// centiseconds (Time's int conversion), as that's what is saved to the file
+
+namespace {
+using agi::ass::TimingLine;
+
+void lead_in(std::vector<TimingLine>& lines, int lead) {
+	// Ends of the lines before the current one. Lines which start before
+	// this one collide with it exactly when they end after it starts, so
+	// the closest non-colliding end is the largest one not after the start.
+	std::multiset<int> ends;
+	for (auto& line : lines) {
+		int start = line.start;
+		int new_start = start - lead;
+		auto it = ends.upper_bound(start);
+		if (it != ends.begin())
+			new_start = std::max(new_start, *--it);
+		ends.insert(line.end);
+		line.start = new_start;
+	}
+}
+
+void lead_out(std::vector<TimingLine>& lines, int lead) {
+	// Swept backwards, so these describe the lines after the current one.
+	// Lead-out never changes starts, but the original end of each line is
+	// needed for the collision checks so it's recorded before modifying it.
+	std::multiset<int> starts;
+	std::unordered_map<int, int> min_start_by_end;
+	for (auto line = lines.rbegin(); line != lines.rend(); ++line) {
+		int start = line->start;
+		int end = line->end;
+		int new_end = end + lead;
+
+		// Later lines which start after this one and don't overlap it
+		auto it = starts.lower_bound(std::max(start + 1, end));
+		if (it != starts.end())
+			new_end = std::min(new_end, *it);
+
+		// Later lines can also fail to overlap by ending at the start of
+		// this line, which is only possible for zero-length lines as they
+		// were sorted by their starts before lead-in
+		auto zero = min_start_by_end.find(start);
+		if (zero != min_start_by_end.end())
+			new_end = std::min(new_end, zero->second);
+
+		starts.insert(start);
+		auto inserted = min_start_by_end.emplace(end, start);
+		if (!inserted.second)
+			inserted.first->second = std::min(inserted.first->second, start);
+		line->end = new_end;
+	}
+}
+
+void make_adjacent(std::vector<TimingLine>& lines, int max_gap, int max_overlap, double bias) {
+	for (size_t i = 1; i < lines.size(); ++i) {
+		auto& prev = lines[i - 1];
+		auto& cur = lines[i];
+
+		// Raw millisecond values are used in this step instead of the typical centisecond.
+		// In this step, we need to distinguish between gap and overlap, as they have different thresholds.
+		// A small gap / overlap less than 1 centisecond may not be distinguishable using rounded centisecond values.
+		int dist = cur.start.GetMillisecond() - prev.end.GetMillisecond();
+		if ((dist < 0 && -dist <= max_overlap) || (dist > 0 && dist <= max_gap)) {
+			int pos = prev.end.GetMillisecond() + int(dist * bias + 0.5);
+			cur.start = pos;
+			prev.end = pos;
+		}
+	}
+}
+
+int closest_keyframe(std::vector<int> const& kf, int frame) {
+	const auto pos = std::upper_bound(kf.begin(), kf.end(), frame);
+	// Return last keyframe if this is after the last one
+	if (pos == kf.end()) return kf.back();
+	// *pos is greater than frame, and *(pos - 1) is less than or equal to frame
+	return (pos == kf.begin() || *pos - frame < frame - *(pos - 1)) ? *pos : *(pos - 1);
+}
+
+void snap_to_keyframes(std::vector<TimingLine>& lines, agi::ass::TimingSettings const& s,
+	agi::vfr::Framerate const& fps, std::vector<int> const& kf)
+{
+	for (auto& cur : lines) {
+		int start_frame = fps.FrameAtTime(cur.start, agi::vfr::START);
+		int end_frame = fps.FrameAtTime(cur.end, agi::vfr::END);
+
+		int closest = closest_keyframe(kf, start_frame);
+		int time = fps.TimeAtFrame(closest, agi::vfr::START);
+		if ((closest > start_frame && time - cur.start <= s.before_start) || (closest < start_frame && cur.start - time <= s.after_start))
+			cur.start = time;
+
+		closest = closest_keyframe(kf, end_frame) - 1;
+		time = fps.TimeAtFrame(closest, agi::vfr::END);
+		if ((closest > end_frame && time - cur.end <= s.before_end) || (closest < end_frame && cur.end - time <= s.after_end))
+			cur.end = time;
+	}
+}
+}
+
+namespace agi { namespace ass {
+void TimingPostProcess(std::vector<TimingLine>& lines, TimingSettings const& settings,
+	vfr::Framerate const& fps, std::vector<int> const& keyframes)
+{
+	if (settings.lead_in)
+		lead_in(lines, settings.lead_in);
+	if (settings.lead_out)
+		lead_out(lines, settings.lead_out);
+	if (settings.adjacent)
+		make_adjacent(lines, settings.adjacent_gap, settings.adjacent_overlap, settings.adjacent_bias);
+	if (settings.snap && !keyframes.empty())
+		snap_to_keyframes(lines, settings, fps, keyframes);
+}
+} }
@@ -17,69 +17,297 @@
 #include <libaegisub/ass/uuencode.h>
 
 #include <algorithm>
+#include <cstring>
+
+#ifdef AGI_SIMD_X86
+#include <immintrin.h>
+#endif
 
 // Despite being called uuencoding by ass_specs.doc, the format is actually
 // somewhat different from real uuencoding.  Each 3-byte chunk is split into 4
 // 6-bit pieces, then 33 is added to each piece. Lines are wrapped after 80
 // characters, and files with non-multiple-of-three lengths are padded with
 // zero.
+//
+// As there's no lookup table involved, the SIMD kernels are just the scalar
+// bit shuffling done on every 32-bit lane at once, with each lane holding
+// one group of three bytes or four characters.
 
-namespace agi { namespace ass {
+namespace {
+using agi::simd::level;
 
-std::string UUEncode(const char *begin, const char *end, bool insert_linebreaks) {
-	size_t size = std::distance(begin, end);
-	std::string ret;
-	ret.reserve((size * 4 + 2) / 3 + size / 80 * 2);
-
-	size_t written = 0;
-	for (size_t pos = 0; pos < size; pos += 3) {
-		unsigned char src[3] = { '\0', '\0', '\0' };
-		memcpy(src, begin + pos, std::min<size_t>(3u, size - pos));
-
-		unsigned char dst[4] = {
-			static_cast<unsigned char>(src[0] >> 2),
-			static_cast<unsigned char>(((src[0] & 0x3) << 4) | ((src[1] & 0xF0) >> 4)),
-			static_cast<unsigned char>(((src[1] & 0xF) << 2) | ((src[2] & 0xC0) >> 6)),
-			static_cast<unsigned char>(src[2] & 0x3F)
-		};
-
-		for (size_t i = 0; i < std::min<size_t>(size - pos + 1, 4u); ++i) {
-			ret += dst[i] + 33;
-
-			if (insert_linebreaks && ++written == 80 && pos + 3 < size) {
-				written = 0;
-				ret += "\r\n";
-			}
+/// Groups of three bytes in each 80 character line
+const size_t line_groups = 20;
+
+inline void encode_group(const unsigned char *src, char *dst) {
+	dst[0] = static_cast<char>((src[0] >> 2) + 33);
+	dst[1] = static_cast<char>((((src[0] & 0x3) << 4) | (src[1] >> 4)) + 33);
+	dst[2] = static_cast<char>((((src[1] & 0xF) << 2) | (src[2] >> 6)) + 33);
+	dst[3] = static_cast<char>((src[2] & 0x3F) + 33);
+}
+
+inline void decode_group(const unsigned char *src, char *dst) {
+	dst[0] = static_cast<char>((src[0] << 2) | (src[1] >> 4));
+	dst[1] = static_cast<char>(((src[1] & 0xF) << 4) | (src[2] >> 2));
+	dst[2] = static_cast<char>(((src[2] & 0x3) << 6) | src[3]);
+}
+
+inline bool is_skipped(char c) {
+	return !c || c == '\n' || c == '\r';
+}
+
+#ifdef AGI_SIMD_X86
+/// Split the low three bytes of each lane into four printable characters
+inline __m128i encode_lanes_sse2(__m128i x) {
+	auto bits = [&](int shift, int mask) {
+		auto shifted = shift > 0 ? _mm_slli_epi32(x, shift) : _mm_srli_epi32(x, -shift);
+		return _mm_and_si128(shifted, _mm_set1_epi32(mask));
+	};
+	auto chars = _mm_or_si128(
+		_mm_or_si128(_mm_or_si128(bits(-2, 0x3F), bits(12, 0x3000)), _mm_or_si128(bits(-4, 0x0F00), bits(10, 0x3C0000))),
+		_mm_or_si128(bits(-6, 0x030000), bits(8, 0x3F000000)));
+	return _mm_add_epi8(chars, _mm_set1_epi8(33));
+}
+
+/// Join the four characters in each lane into three bytes in the low three bytes
+inline __m128i decode_lanes_sse2(__m128i x) {
+	x = _mm_sub_epi8(x, _mm_set1_epi8(33));
+	auto bits = [&](int shift, int mask) {
+		auto shifted = shift > 0 ? _mm_slli_epi32(x, shift) : _mm_srli_epi32(x, -shift);
+		return _mm_and_si128(shifted, _mm_set1_epi32(mask));
+	};
+	return _mm_or_si128(
+		_mm_or_si128(_mm_or_si128(bits(2, 0xFC), bits(-12, 0x0F)), _mm_or_si128(bits(4, 0xF000), bits(-10, 0x3F00))),
+		_mm_or_si128(bits(6, 0xC00000), bits(-8, 0xFF0000)));
+}
+
+inline bool any_skipped_sse2(__m128i x) {
+	auto skipped = _mm_or_si128(_mm_cmpeq_epi8(x, _mm_setzero_si128()),
+		_mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(x, _mm_set1_epi8('\r'))));
+	return _mm_movemask_epi8(skipped) != 0;
+}
+
+/// Encode groups of three bytes four at a time, reading up to two bytes
+/// past the last group encoded
+void encode_sse2(const unsigned char *&src, const unsigned char *src_end, char *&dst, size_t& groups) {
+	for (; groups >= 4 && src_end - src >= 14; groups -= 4, src += 12, dst += 16) {
+		// Each 64-bit half gets two groups, which are then moved into
+		// separate 32-bit lanes
+		auto x = _mm_unpacklo_epi64(
+			_mm_loadl_epi64(reinterpret_cast<const __m128i *>(src)),
+			_mm_loadl_epi64(reinterpret_cast<const __m128i *>(src + 6)));
+		x = _mm_or_si128(
+			_mm_and_si128(x, _mm_set1_epi64x(0xFFFFFF)),
+			_mm_and_si128(_mm_slli_epi64(x, 8), _mm_set1_epi64x(0xFFFFFF00000000)));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst), encode_lanes_sse2(x));
+	}
+}
+
+/// Decode sixteen characters at a time until one which has to be skipped is
+/// reached, writing up to two bytes past the end of the decoded data
+void decode_sse2(const char *&src, const char *end, char *&dst) {
+	for (; end - src >= 16; src += 16, dst += 12) {
+		auto x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+		if (any_skipped_sse2(x)) return;
+		x = decode_lanes_sse2(x);
+		// Pack the three bytes from each 32-bit lane together
+		x = _mm_or_si128(
+			_mm_and_si128(x, _mm_set1_epi64x(0xFFFFFF)),
+			_mm_and_si128(_mm_srli_epi64(x, 8), _mm_set1_epi64x(0xFFFFFF000000)));
+		_mm_storel_epi64(reinterpret_cast<__m128i *>(dst), x);
+		_mm_storel_epi64(reinterpret_cast<__m128i *>(dst + 6), _mm_srli_si128(x, 8));
+	}
+}
+
+AGI_TARGET_AVX2 inline __m256i avx2_bits(__m256i x, int shift, int mask) {
+	auto shifted = shift > 0 ? _mm256_slli_epi32(x, shift) : _mm256_srli_epi32(x, -shift);
+	return _mm256_and_si256(shifted, _mm256_set1_epi32(mask));
+}
+
+AGI_TARGET_AVX2 inline __m256i encode_lanes_avx2(__m256i x) {
+	auto chars = _mm256_or_si256(
+		_mm256_or_si256(
+			_mm256_or_si256(avx2_bits(x, -2, 0x3F), avx2_bits(x, 12, 0x3000)),
+			_mm256_or_si256(avx2_bits(x, -4, 0x0F00), avx2_bits(x, 10, 0x3C0000))),
+		_mm256_or_si256(avx2_bits(x, -6, 0x030000), avx2_bits(x, 8, 0x3F000000)));
+	return _mm256_add_epi8(chars, _mm256_set1_epi8(33));
+}
+
+AGI_TARGET_AVX2 inline __m256i decode_lanes_avx2(__m256i x) {
+	x = _mm256_sub_epi8(x, _mm256_set1_epi8(33));
+	return _mm256_or_si256(
+		_mm256_or_si256(
+			_mm256_or_si256(avx2_bits(x, 2, 0xFC), avx2_bits(x, -12, 0x0F)),
+			_mm256_or_si256(avx2_bits(x, 4, 0xF000), avx2_bits(x, -10, 0x3F00))),
+		_mm256_or_si256(avx2_bits(x, 6, 0xC00000), avx2_bits(x, -8, 0xFF0000)));
+}
+
+/// Encode groups of three bytes eight at a time, reading up to four bytes
+/// past the last group encoded
+AGI_TARGET_AVX2 void encode_avx2(const unsigned char *&src, const unsigned char *src_end, char *&dst, size_t& groups) {
+	// Move each group of three bytes into its own 32-bit lane
+	const auto spread = _mm256_setr_epi8(
+		0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+		0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+	for (; groups >= 8 && src_end - src >= 28; groups -= 8, src += 24, dst += 32) {
+		auto x = _mm256_inserti128_si256(
+			_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src))),
+			_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 12)), 1);
+		x = _mm256_shuffle_epi8(x, spread);
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst), encode_lanes_avx2(x));
+	}
+}
+
+/// Decode 32 characters at a time until one which has to be skipped is
+/// reached, writing up to four bytes past the end of the decoded data
+AGI_TARGET_AVX2 void decode_avx2(const char *&src, const char *end, char *&dst) {
+	// Move the three bytes from each lane to the start of each 128-bit half
+	const auto pack = _mm256_setr_epi8(
+		0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+		0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+	for (; end - src >= 32; src += 32, dst += 24) {
+		auto x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src));
+		auto skipped = _mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_setzero_si256()),
+			_mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8('\n')), _mm256_cmpeq_epi8(x, _mm256_set1_epi8('\r'))));
+		if (_mm256_movemask_epi8(skipped)) return;
+
+		x = _mm256_shuffle_epi8(decode_lanes_avx2(x), pack);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst), _mm256_castsi256_si128(x));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 12), _mm256_extracti128_si256(x, 1));
+	}
+}
+#endif
+
+/// Encode whole groups of three bytes, which may read past the last group
+/// but not past src_end
+char *encode_groups(const unsigned char *src, const unsigned char *src_end, char *dst, size_t groups, level lvl) {
+#ifdef AGI_SIMD_X86
+	if (lvl == level::avx2)
+		encode_avx2(src, src_end, dst, groups);
+	if (lvl != level::none)
+		encode_sse2(src, src_end, dst, groups);
+#endif
+	for (; groups; --groups, src += 3, dst += 4)
+		encode_group(src, dst);
+	return dst;
+}
+
+/// Encoded size of len bytes
+size_t encoded_size(size_t len, bool insert_linebreaks) {
+	size_t groups = (len + 2) / 3;
+	size_t size = len / 3 * 4 + (len % 3 ? len % 3 + 1 : 0);
+	if (insert_linebreaks && groups)
+		size += (groups - 1) / line_groups * 2;
+	return size;
+}
+
+/// Encode [src, src + len), where only the data as a whole ends on a partial
+/// group and anything up to src_end may be read
+char *encode(const unsigned char *src, size_t len, const unsigned char *src_end, char *dst, bool insert_linebreaks, level lvl) {
+	const unsigned char *end = src + len;
+	size_t groups = len / 3;
+	while (groups) {
+		size_t count = insert_linebreaks ? std::min(groups, line_groups) : groups;
+		dst = encode_groups(src, src_end, dst, count, lvl);
+		src += count * 3;
+		groups -= count;
+		if (insert_linebreaks && count == line_groups && src < end) {
+			*dst++ = '\r';
+			*dst++ = '\n';
 		}
 	}
 
+	if (size_t remaining = end - src) {
+		unsigned char last[3] = { 0, 0, 0 };
+		memcpy(last, src, remaining);
+		char chars[4];
+		encode_group(last, chars);
+		memcpy(dst, chars, remaining + 1);
+		dst += remaining + 1;
+	}
+	return dst;
+}
+}
+
+namespace agi { namespace ass {
+
+std::string UUEncode(const char *begin, const char *end, bool insert_linebreaks, simd::level lvl) {
+	size_t len = std::distance(begin, end);
+	std::string ret(encoded_size(len, insert_linebreaks), '\0');
+	if (len) {
+		auto src = reinterpret_cast<const unsigned char *>(begin);
+		encode(src, len, src + len, &ret[0], insert_linebreaks, lvl);
+	}
 	return ret;
 }
 
-std::vector<char> UUDecode(const char *begin, const char *end) {
-	std::vector<char> ret;
-	size_t len = end - begin;
-	ret.reserve(len * 3 / 4);
+void UUEncode(const char *begin, const char *end, std::function<void (const char *, size_t)> const& write, bool insert_linebreaks, simd::level lvl) {
+	// Whole lines of input, so that pieces end between lines
+	const size_t chunk_size = 1024 * line_groups * 3;
 
-	for (size_t pos = 0; pos + 1 < len; ) {
-		size_t bytes = 0;
-		unsigned char src[4] = { '\0', '\0', '\0', '\0' };
-		for (size_t i = 0; i < 4 && pos < len; ++pos) {
-			char c = begin[pos];
-			if (c && c != '\n' && c != '\r') {
-				src[i++] = c - 33;
-				++bytes;
+	auto src = reinterpret_cast<const unsigned char *>(begin);
+	auto src_end = reinterpret_cast<const unsigned char *>(end);
+	std::vector<char> buffer(encoded_size(std::min<size_t>(chunk_size, src_end - src), insert_linebreaks) + 2);
+	for (size_t len; src < src_end; src += len) {
+		len = std::min<size_t>(chunk_size, src_end - src);
+		char *dst = buffer.data();
+		if (insert_linebreaks && src != reinterpret_cast<const unsigned char *>(begin)) {
+			*dst++ = '\r';
+			*dst++ = '\n';
+		}
+		dst = encode(src, len, src_end, dst, insert_linebreaks, lvl);
+		write(buffer.data(), dst - buffer.data());
+	}
+}
+
+std::vector<char> UUDecode(const char *begin, const char *end, simd::level lvl) {
+	// Room for every character being decoded plus what the kernels write
+	// past the end of the data
+	std::vector<char> ret(std::distance(begin, end) / 4 * 3 + 2 + 4);
+	char *dst = ret.data();
+
+	unsigned char group[4];
+	size_t group_size = 0;
+	for (const char *src = begin; src < end; ) {
+		// Runs of whole groups with nothing to skip are done in bulk
+		if (group_size == 0) {
+#ifdef AGI_SIMD_X86
+			if (lvl == level::avx2)
+				decode_avx2(src, end, dst);
+			if (lvl != level::none)
+				decode_sse2(src, end, dst);
+#endif
+			for (; end - src >= 4; src += 4, dst += 3) {
+				if (is_skipped(src[0]) || is_skipped(src[1]) || is_skipped(src[2]) || is_skipped(src[3]))
+					break;
+				unsigned char chars[4];
+				for (int i = 0; i < 4; ++i)
+					chars[i] = static_cast<unsigned char>(src[i] - 33);
+				decode_group(chars, dst);
 			}
+			if (src == end) break;
 		}
 
-		if (bytes > 1)
-			ret.push_back((src[0] << 2) | (src[1] >> 4));
-		if (bytes > 2)
-			ret.push_back(((src[1] & 0xF) << 4) | (src[2] >> 2));
-		if (bytes > 3)
-			ret.push_back(((src[2] & 0x3) << 6) | (src[3]));
+		char c = *src++;
+		if (is_skipped(c)) continue;
+		group[group_size++] = static_cast<unsigned char>(c - 33);
+		if (group_size == 4) {
+			decode_group(group, dst);
+			dst += 3;
+			group_size = 0;
+		}
+	}
+
+	// A partial group of n characters has n - 1 bytes of data
+	if (group_size > 1) {
+		std::fill(group + group_size, group + 4, 0);
+		char bytes[3];
+		decode_group(group, bytes);
+		memcpy(dst, bytes, group_size - 1);
+		dst += group_size - 1;
 	}
 
+	ret.resize(dst - ret.data());
 	return ret;
 }
 } }
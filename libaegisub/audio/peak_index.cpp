@@ -0,0 +1,227 @@
+// Copyright (c) 2014, Thomas Goyne <plorkyeran@aegisub.org>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include "libaegisub/audio/peak_index.h"
+
+#include "libaegisub/fs.h"
+#include "libaegisub/io.h"
+#include "libaegisub/log.h"
+#include "libaegisub/make_unique.h"
+
+#include <algorithm>
+#include <cstring>
+#include <istream>
+#include <ostream>
+
+namespace {
+const char index_magic[8] = {'A', 'G', 'I', 'P', 'E', 'A', 'K', '2'};
+
+struct index_header {
+	char magic[8];
+	int64_t num_samples;
+	int32_t sample_rate;
+	int32_t base_run;
+	int32_t fanout;
+	int32_t levels;
+	/// Length of the source identity which follows the header
+	int32_t source_size;
+	int32_t reserved;
+};
+
+agi::AudioPeak merge(const agi::AudioPeak *peaks, size_t count) {
+	agi::AudioPeak ret = peaks[0];
+	int32_t avg_min = peaks[0].avg_min, avg_max = peaks[0].avg_max;
+	for (size_t i = 1; i < count; ++i) {
+		ret.min = std::min(ret.min, peaks[i].min);
+		ret.max = std::max(ret.max, peaks[i].max);
+		avg_min += peaks[i].avg_min;
+		avg_max += peaks[i].avg_max;
+	}
+	ret.avg_min = static_cast<int16_t>(avg_min / static_cast<int32_t>(count));
+	ret.avg_max = static_cast<int16_t>(avg_max / static_cast<int32_t>(count));
+	return ret;
+}
+}
+
+namespace agi {
+AudioPeakIndex::AudioPeakIndex(int64_t num_samples)
+: num_samples(num_samples)
+{
+	// Build levels until a single entry covers the entire track
+	size_t entries = static_cast<size_t>((num_samples + BaseRun - 1) / BaseRun);
+	do {
+		levels.emplace_back(entries);
+		entries = (entries + Fanout - 1) / Fanout;
+	} while (levels.back().size() > 1);
+	filled.resize(levels.size(), 0);
+}
+
+void AudioPeakIndex::PushEntry(size_t level, AudioPeak const& peak) {
+	levels[level][filled[level]++] = peak;
+
+	// Merge into the parent once it's either full or we've hit the end
+	if (level + 1 == levels.size()) return;
+	size_t children = filled[level] % Fanout;
+	if (children == 0)
+		children = Fanout;
+	else if (filled[level] != levels[level].size())
+		return;
+	PushEntry(level + 1, merge(&levels[level][filled[level] - children], children));
+}
+
+void AudioPeakIndex::FlushPending() {
+	AudioPeak peak;
+	peak.min = pending_min;
+	peak.max = pending_max;
+	// The final run may be short, but it's averaged over a full run as
+	// entries are always merged with equal weights
+	peak.avg_min = static_cast<int16_t>(pending_neg / BaseRun);
+	peak.avg_max = static_cast<int16_t>(pending_pos / BaseRun);
+	PushEntry(0, peak);
+
+	pending_count = 0;
+	pending_min = pending_max = 0;
+	pending_neg = pending_pos = 0;
+}
+
+void AudioPeakIndex::Publish() {
+	int64_t indexed = static_cast<int64_t>(filled[0]) * BaseRun;
+	indexed_samples.store(std::min(indexed, num_samples), std::memory_order_release);
+}
+
+void AudioPeakIndex::AddSamples(const int16_t *buf, int64_t count) {
+	while (count > 0) {
+		int run = static_cast<int>(std::min<int64_t>(count, BaseRun - pending_count));
+		for (int i = 0; i < run; ++i) {
+			int16_t sample = buf[i];
+			if (sample > 0) {
+				pending_max = std::max(pending_max, sample);
+				pending_pos += sample;
+			}
+			else {
+				pending_min = std::min(pending_min, sample);
+				pending_neg += sample;
+			}
+		}
+		buf += run;
+		count -= run;
+		pending_count += run;
+		if (pending_count == BaseRun)
+			FlushPending();
+	}
+
+	if (pending_count && static_cast<int64_t>(filled[0]) * BaseRun + pending_count >= num_samples)
+		FlushPending();
+	Publish();
+}
+
+bool AudioPeakIndex::GetPeak(int64_t start, int64_t count, AudioPeak &out) const {
+	if (count < Fanout * BaseRun || start < 0) return false;
+	const int64_t indexed = indexed_samples.load(std::memory_order_acquire);
+	const int64_t end = std::min(start + count, num_samples);
+	if (end > indexed) return false;
+	if (start >= end) {
+		out = AudioPeak();
+		return true;
+	}
+
+	// Use the coarsest level which still has at least Fanout entries per
+	// range, which bounds both the rounding error and the number of entries
+	// read to a small constant
+	size_t level = 0;
+	int64_t span = BaseRun;
+	while (level + 1 < levels.size() && span * Fanout * Fanout <= count) {
+		++level;
+		span *= Fanout;
+	}
+
+	// Round the range to the nearest entry boundaries
+	size_t first = static_cast<size_t>((start + span / 2) / span);
+	size_t last = static_cast<size_t>((end + span / 2) / span);
+	first = std::min(first, levels[level].size() - 1);
+	last = std::min(last, levels[level].size());
+	if (last <= first)
+		last = std::min(first + 1, levels[level].size());
+	out = merge(&levels[level][first], last - first);
+	return true;
+}
+
+void AudioPeakIndex::Save(fs::path const& filename, int sample_rate, std::string const& source) const {
+	if (!IsComplete()) return;
+
+	index_header header;
+	memcpy(header.magic, index_magic, sizeof(index_magic));
+	header.num_samples = num_samples;
+	header.sample_rate = sample_rate;
+	header.base_run = BaseRun;
+	header.fanout = Fanout;
+	header.levels = static_cast<int32_t>(levels.size());
+	header.source_size = static_cast<int32_t>(source.size());
+	header.reserved = 0;
+
+	try {
+		io::Save file(filename, true);
+		auto& out = file.Get();
+		out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+		out.write(source.data(), source.size());
+		for (auto const& level : levels)
+			out.write(reinterpret_cast<const char *>(level.data()), level.size() * sizeof(AudioPeak));
+	}
+	catch (agi::Exception const& e) {
+		LOG_E("audio/peak_index") << "Failed to save peak index: " << e.GetMessage();
+	}
+}
+
+std::unique_ptr<AudioPeakIndex> AudioPeakIndex::Load(fs::path const& filename, int64_t num_samples, int sample_rate, std::string const& source) {
+	if (!fs::FileExists(filename)) return nullptr;
+
+	try {
+		auto in = io::Open(filename, true);
+		index_header header;
+		if (!in->read(reinterpret_cast<char *>(&header), sizeof(header)))
+			return nullptr;
+
+		auto index = agi::make_unique<AudioPeakIndex>(num_samples);
+		if (memcmp(header.magic, index_magic, sizeof(index_magic)) ||
+			header.num_samples != num_samples ||
+			header.sample_rate != sample_rate ||
+			header.base_run != BaseRun ||
+			header.fanout != Fanout ||
+			header.levels != static_cast<int32_t>(index->levels.size()) ||
+			header.source_size != static_cast<int32_t>(source.size()))
+			return nullptr;
+
+		std::string saved_source(source.size(), '\0');
+		if (!source.empty() && !in->read(&saved_source[0], saved_source.size()))
+			return nullptr;
+		if (saved_source != source)
+			return nullptr;
+
+		for (size_t i = 0; i < index->levels.size(); ++i) {
+			auto& level = index->levels[i];
+			if (!in->read(reinterpret_cast<char *>(level.data()), level.size() * sizeof(AudioPeak)))
+				return nullptr;
+			index->filled[i] = level.size();
+		}
+		index->indexed_samples = num_samples;
+		return index;
+	}
+	catch (agi::Exception const& e) {
+		LOG_D("audio/peak_index") << "Failed to load peak index: " << e.GetMessage();
+		return nullptr;
+	}
+}
+}
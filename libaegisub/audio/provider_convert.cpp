@@ -36,6 +36,11 @@ public:
 	void FillBuffer(void *buf, int64_t start, int64_t count) const override {
 		source->GetInt16MonoAudio(reinterpret_cast<int16_t*>(buf), start, count);
 	}
+
+	std::unique_ptr<AudioProvider> Duplicate() const override {
+		auto src = source->Duplicate();
+		return src ? agi::make_unique<ConvertAudioProvider>(std::move(src)) : nullptr;
+	}
 };
 
 /// Sample doubler with linear interpolation for the samples provider
@@ -48,6 +53,11 @@ public:
 		decoded_samples = decoded_samples * 2;
 	}
 
+	std::unique_ptr<AudioProvider> Duplicate() const override {
+		auto src = source->Duplicate();
+		return src ? agi::make_unique<SampleDoublingAudioProvider>(std::move(src)) : nullptr;
+	}
+
 	void FillBuffer(void *buf, int64_t start, int64_t count) const override {
 		int16_t *src, *dst = static_cast<int16_t *>(buf);
 
@@ -16,6 +16,7 @@
 
 #include "libaegisub/audio/provider.h"
 
+#include <libaegisub/audio/peak_index.h>
 #include <libaegisub/file_mapping.h>
 #include <libaegisub/format.h>
 #include <libaegisub/fs.h>
@@ -25,6 +26,7 @@
 #include <boost/filesystem/path.hpp>
 #include <boost/interprocess/detail/os_thread_functions.hpp>
 #include <ctime>
+#include <mutex>
 #include <thread>
 
 
@@ -33,6 +35,10 @@ using namespace agi;
 
 class HDAudioProvider final : public AudioProviderWrapper {
 	mutable temp_file_mapping file;
+	/// The decoder thread reads back the file to save it while the audio is in use
+	mutable std::mutex read_mutex;
+	std::unique_ptr<AudioPeakIndex> peaks;
+	fs::path save_to;
 	std::atomic<bool> cancelled = {false};
 	std::thread decoder;
 
@@ -44,6 +50,7 @@ class HDAudioProvider final : public AudioProviderWrapper {
 		}
 
 		if (count > 0) {
+			std::unique_lock<std::mutex> lock(read_mutex);
 			start *= bytes_per_sample * channels;
 			count *= bytes_per_sample * channels;
 			memcpy(buf, file.read(start, count), count);
@@ -62,19 +69,27 @@ class HDAudioProvider final : public AudioProviderWrapper {
 	}
 
 public:
-	HDAudioProvider(std::unique_ptr<AudioProvider> src, agi::fs::path const& dir)
+	HDAudioProvider(std::unique_ptr<AudioProvider> src, agi::fs::path const& dir, agi::fs::path const& save_to)
 	: AudioProviderWrapper(std::move(src))
 	, file(dir / CacheFilename(dir, this->GetHash()), num_samples* bytes_per_sample* channels)
+	, peaks(agi::make_unique<AudioPeakIndex>(num_samples))
+	, save_to(save_to)
 	{
 		decoded_samples = 0;
+
 		decoder = std::thread([&] {
 			int64_t block = 65536;
 			for (int64_t i = 0; i < num_samples; i += block) {
 				if (cancelled) break;
 				block = std::min(block, num_samples - i);
-				source->GetAudio(file.write(i * bytes_per_sample * channels, block * bytes_per_sample * channels), i, block);
+				auto data = file.write(i * bytes_per_sample * channels, block * bytes_per_sample * channels);
+				source->GetAudio(data, i, block);
+				AddToPeakIndex(*peaks, data, block);
 				decoded_samples += block;
 			}
+			// The peak index is saved along with the audio
+			if (!cancelled && !this->save_to.empty())
+				SaveDecodedAudio(*this, this->save_to, cancelled);
 		});
 	}
 
@@ -82,11 +97,13 @@ public:
 		cancelled = true;
 		decoder.join();
 	}
+
+	AudioPeakIndex const* GetPeakIndex() const override { return peaks.get(); }
 };
 }
 
 namespace agi {
-std::unique_ptr<AudioProvider> CreateHDAudioProvider(std::unique_ptr<AudioProvider> src, agi::fs::path const& dir) {
-	return agi::make_unique<HDAudioProvider>(std::move(src), dir);
+std::unique_ptr<AudioProvider> CreateHDAudioProvider(std::unique_ptr<AudioProvider> src, agi::fs::path const& dir, agi::fs::path const& save_to) {
+	return agi::make_unique<HDAudioProvider>(std::move(src), dir, save_to);
 }
 }
@@ -16,10 +16,14 @@
 
 #include "libaegisub/audio/provider.h"
 
+#include "libaegisub/audio/peak_index.h"
+#include "libaegisub/log.h"
 #include "libaegisub/make_unique.h"
 
 #include <array>
 #include <boost/container/stable_vector.hpp>
+#include <boost/filesystem/path.hpp>
+#include <mutex>
 #include <thread>
 
 namespace {
@@ -28,62 +32,162 @@ using namespace agi;
 #define CacheBits 22
 #define CacheBlockSize (1 << CacheBits)
 
+/// Most decoders to run at once. Each needs its own copy of the source, and
+/// past a few the source file's IO is the limit.
+const unsigned MaxDecoders = 4;
+
 class RAMAudioProvider final : public AudioProviderWrapper {
 #ifdef _MSC_VER
 	boost::container::stable_vector<char[CacheBlockSize]> blockcache;
 #else
 	boost::container::stable_vector<std::array<char, CacheBlockSize>> blockcache;
 #endif
+	/// Which blocks have been decoded
+	std::unique_ptr<std::atomic<bool>[]> block_decoded;
+	/// Which blocks a decoder has started on, guarded by claim_mutex
+	std::vector<bool> block_claimed;
+	std::mutex claim_mutex;
+	/// Block to decode next if it isn't already done
+	mutable std::atomic<size_t> next_block{0};
+
+	/// The peak index has to be built in order, so blocks decoded out of
+	/// order wait for the ones before them
+	std::unique_ptr<AudioPeakIndex> peaks;
+	size_t peak_blocks = 0;
+	std::mutex peak_mutex;
+
+	fs::path save_to;
+	/// Sources for the decoders after the first, which uses the original
+	std::vector<std::unique_ptr<AudioProvider>> extra_sources;
 	std::atomic<bool> cancelled = {false};
-	std::thread decoder;
+	std::vector<std::thread> decoders;
+
+	int64_t SamplesPerBlock() const { return CacheBlockSize / bytes_per_sample / channels; }
 
 	void FillBuffer(void *buf, int64_t start, int64_t count) const override;
 
+	/// Claim the next block to decode, or return false if none are left
+	bool ClaimBlock(size_t &block) {
+		std::unique_lock<std::mutex> lock(claim_mutex);
+		// Carry on from the most recently requested block and then go back
+		// to the start for anything skipped
+		size_t start = std::min<size_t>(next_block, blockcache.size());
+		for (size_t i = 0; i < blockcache.size(); ++i) {
+			block = (start + i) % blockcache.size();
+			if (block_claimed[block]) continue;
+			block_claimed[block] = true;
+			next_block = block + 1;
+			return true;
+		}
+		return false;
+	}
+
+	void Decode(AudioProvider const& src) {
+		const int64_t readsize = SamplesPerBlock();
+		size_t i;
+		while (!cancelled && ClaimBlock(i)) {
+			auto actual_read = std::min<int64_t>(readsize, num_samples - i * readsize);
+			src.GetAudio(&blockcache[i][0], i * readsize, actual_read);
+			block_decoded[i] = true;
+
+			{
+				std::unique_lock<std::mutex> lock(peak_mutex);
+				for (; peak_blocks < blockcache.size() && block_decoded[peak_blocks]; ++peak_blocks)
+					AddToPeakIndex(*peaks, &blockcache[peak_blocks][0], std::min<int64_t>(readsize, num_samples - peak_blocks * readsize));
+			}
+
+			// Whichever decoder finishes the last block saves the audio
+			if ((decoded_samples += actual_read) == num_samples && !save_to.empty())
+				SaveDecodedAudio(*this, save_to, cancelled);
+		}
+	}
+
 public:
-	RAMAudioProvider(std::unique_ptr<AudioProvider> src)
+	RAMAudioProvider(std::unique_ptr<AudioProvider> src, fs::path const& save_to)
 	: AudioProviderWrapper(std::move(src))
+	, save_to(save_to)
 	{
 		decoded_samples = 0;
 
 		try {
-			blockcache.resize((num_samples * bytes_per_sample * channels + CacheBlockSize - 1) >> CacheBits);
+			blockcache.resize((num_samples + SamplesPerBlock() - 1) / SamplesPerBlock());
 		}
 		catch (std::bad_alloc const&) {
 			throw AudioProviderError("Not enough memory available to cache in RAM");
 		}
 
-		decoder = std::thread([&] {
-			int64_t readsize = CacheBlockSize / bytes_per_sample / channels;
-			for (size_t i = 0; i < blockcache.size(); i++) {
-				if (cancelled) break;
-				auto actual_read = std::min<int64_t>(readsize, num_samples - i * readsize);
-				source->GetAudio(&blockcache[i][0], i * readsize, actual_read);
-				decoded_samples += actual_read;
+		block_decoded.reset(new std::atomic<bool>[blockcache.size()]);
+		for (size_t i = 0; i < blockcache.size(); ++i)
+			block_decoded[i] = false;
+		block_claimed.resize(blockcache.size());
+
+		peaks = agi::make_unique<AudioPeakIndex>(num_samples);
+
+		// Blocks can only be decoded in parallel if the source can be opened
+		// more than once
+		size_t threads = std::min<size_t>(blockcache.size(), std::min(MaxDecoders, std::max(1u, std::thread::hardware_concurrency())));
+		try {
+			for (size_t i = 1; i < threads; ++i) {
+				auto dup = source->Duplicate();
+				if (!dup) break;
+				extra_sources.push_back(std::move(dup));
 			}
-		});
+		}
+		catch (AudioProviderError const& e) {
+			LOG_W("audio_provider/ram") << "Decoding with one thread as the source could not be reopened: " << e.GetMessage();
+		}
+
+		decoders.emplace_back([&] { Decode(*source); });
+		for (auto& extra : extra_sources) {
+			auto src = extra.get();
+			decoders.emplace_back([=] { Decode(*src); });
+		}
 	}
 
 	~RAMAudioProvider() {
 		cancelled = true;
-		decoder.join();
+		for (auto& decoder : decoders)
+			decoder.join();
+	}
+
+	bool IsDecoded(int64_t start, int64_t count) const override {
+		start = std::max<int64_t>(start, 0);
+		count = std::min(count, num_samples - start);
+		if (count <= 0) return true;
+
+		for (int64_t i = start / SamplesPerBlock(); i <= (start + count - 1) / SamplesPerBlock(); ++i) {
+			if (!block_decoded[i]) return false;
+		}
+		return true;
+	}
+
+	void Prioritize(int64_t start) const override {
+		if (start >= 0 && start < num_samples && !block_decoded[start / SamplesPerBlock()])
+			next_block = start / SamplesPerBlock();
 	}
+
+	AudioPeakIndex const* GetPeakIndex() const override { return peaks.get(); }
 };
 
 void RAMAudioProvider::FillBuffer(void *buf, int64_t start, int64_t count) const {
 	auto charbuf = static_cast<char *>(buf);
+	const int64_t samples_per_block = SamplesPerBlock();
+	bool prioritized = false;
 	for (int64_t bytes_remaining = count * bytes_per_sample * channels; bytes_remaining; ) {
-		if (start >= decoded_samples) {
-			memset(charbuf, 0, bytes_remaining);
-			break;
-		}
-
-		const int64_t samples_per_block = CacheBlockSize / bytes_per_sample / channels;
-
 		const size_t i = start / samples_per_block;
 		const int start_offset = (start % samples_per_block) * bytes_per_sample * channels;
 		const int read_size = std::min<int>(bytes_remaining, samples_per_block * bytes_per_sample * channels - start_offset);
 
-		memcpy(charbuf, &blockcache[i][start_offset], read_size);
+		if (block_decoded[i])
+			memcpy(charbuf, &blockcache[i][start_offset], read_size);
+		else {
+			// Not decoded yet, so return silence and have it decoded next
+			memset(charbuf, 0, read_size);
+			if (!prioritized) {
+				next_block = i;
+				prioritized = true;
+			}
+		}
 		charbuf += read_size;
 		bytes_remaining -= read_size;
 		start += read_size / bytes_per_sample / channels;
@@ -92,7 +196,7 @@ void RAMAudioProvider::FillBuffer(void *buf, int64_t start, int64_t count) const
 }
 
 namespace agi {
-std::unique_ptr<AudioProvider> CreateRAMAudioProvider(std::unique_ptr<AudioProvider> src) {
-	return agi::make_unique<RAMAudioProvider>(std::move(src));
+std::unique_ptr<AudioProvider> CreateRAMAudioProvider(std::unique_ptr<AudioProvider> src, fs::path const& save_to) {
+	return agi::make_unique<RAMAudioProvider>(std::move(src), save_to);
 }
 }
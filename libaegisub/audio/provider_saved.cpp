@@ -0,0 +1,185 @@
+// Copyright (c) 2014, Thomas Goyne <plorkyeran@aegisub.org>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+
+#include "libaegisub/audio/provider.h"
+
+#include "libaegisub/audio/peak_index.h"
+#include "libaegisub/file_mapping.h"
+#include "libaegisub/fs.h"
+#include "libaegisub/io.h"
+#include "libaegisub/log.h"
+#include "libaegisub/make_unique.h"
+
+#include <boost/filesystem/path.hpp>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+namespace {
+using namespace agi;
+
+const char saved_magic[8] = {'A', 'E', 'G', 'I', 'P', 'C', 'M', '1'};
+
+/// Written after the samples, so that a file which was not finished never
+/// has a valid one
+struct saved_footer {
+	char magic[8];
+	int64_t num_samples;
+	int32_t channels;
+	int32_t sample_rate;
+	int32_t bytes_per_sample;
+	int32_t float_samples;
+};
+
+saved_footer make_footer(AudioProvider const& provider) {
+	saved_footer footer;
+	memcpy(footer.magic, saved_magic, sizeof(saved_magic));
+	footer.num_samples = provider.GetNumSamples();
+	footer.channels = provider.GetChannels();
+	footer.sample_rate = provider.GetSampleRate();
+	footer.bytes_per_sample = provider.GetBytesPerSample();
+	footer.float_samples = provider.AreSamplesFloat();
+	return footer;
+}
+
+uint64_t data_size(AudioProvider const& provider) {
+	return (uint64_t)provider.GetNumSamples() * provider.GetBytesPerSample() * provider.GetChannels();
+}
+
+fs::path peaks_filename(fs::path filename) {
+	return filename.replace_extension(".peaks");
+}
+
+/// The saved audio's name identifies its source, so it also identifies the
+/// source of the peak index saved alongside it
+std::string peaks_source(fs::path const& filename) {
+	return filename.filename().string();
+}
+
+class SavedAudioProvider final : public AudioProviderWrapper {
+	mutable std::mutex mutex;
+	mutable read_file_mapping file;
+	std::unique_ptr<AudioPeakIndex> peaks;
+	std::atomic<bool> cancelled = {false};
+	std::thread indexer;
+
+	void FillBuffer(void *buf, int64_t start, int64_t count) const override {
+		const int bps = bytes_per_sample * channels;
+		std::unique_lock<std::mutex> lock(mutex);
+		memcpy(buf, file.read(start * bps, count * bps), count * bps);
+	}
+
+public:
+	SavedAudioProvider(std::unique_ptr<AudioProvider> src, fs::path const& filename)
+	: AudioProviderWrapper(std::move(src))
+	, file(filename)
+	, peaks(AudioPeakIndex::Load(peaks_filename(filename), num_samples, sample_rate, peaks_source(filename)))
+	{
+		if (!HasSavedAudio(*source, filename))
+			throw AudioDataNotFound("Saved audio does not match the source");
+
+		// Everything the source would decode is already in the file
+		decoded_samples = num_samples;
+		source.reset();
+
+		if (peaks) return;
+
+		// The peaks were lost or never saved, so rebuild them from the file
+		peaks = agi::make_unique<AudioPeakIndex>(num_samples);
+		indexer = std::thread([=] {
+			std::vector<char> buf;
+			int64_t block = 65536;
+			for (int64_t i = 0; i < num_samples; i += block) {
+				if (cancelled) return;
+				block = std::min(block, num_samples - i);
+				buf.resize(block * bytes_per_sample * channels);
+				FillBuffer(&buf[0], i, block);
+				AddToPeakIndex(*peaks, &buf[0], block);
+			}
+			peaks->Save(peaks_filename(filename), sample_rate, peaks_source(filename));
+		});
+	}
+
+	~SavedAudioProvider() {
+		cancelled = true;
+		if (indexer.joinable())
+			indexer.join();
+	}
+
+	AudioPeakIndex const* GetPeakIndex() const override { return peaks.get(); }
+};
+}
+
+namespace agi {
+bool SaveDecodedAudio(AudioProvider const& provider, fs::path const& filename, std::atomic<bool> const& cancelled) {
+	bool complete = false;
+	try {
+		{
+			io::Save file(filename, true);
+			auto& out = file.Get();
+
+			const size_t bps = provider.GetBytesPerSample() * provider.GetChannels();
+			std::vector<char> buf;
+			int64_t block = 65536;
+			int64_t i = 0;
+			for (; i < provider.GetNumSamples() && !cancelled && out; i += block) {
+				block = std::min(block, provider.GetNumSamples() - i);
+				buf.resize(block * bps);
+				provider.GetAudio(&buf[0], i, block);
+				out.write(&buf[0], buf.size());
+			}
+
+			if (i >= provider.GetNumSamples() && !cancelled) {
+				auto footer = make_footer(provider);
+				out.write(reinterpret_cast<const char *>(&footer), sizeof(footer));
+				complete = !!out;
+			}
+		}
+
+		if (!complete) {
+			fs::Remove(filename);
+			return false;
+		}
+
+		if (auto peaks = provider.GetPeakIndex())
+			peaks->Save(peaks_filename(filename), provider.GetSampleRate(), peaks_source(filename));
+	}
+	catch (agi::Exception const& e) {
+		LOG_E("audio_provider/saved") << "Failed to save decoded audio: " << e.GetMessage();
+		return false;
+	}
+	return true;
+}
+
+bool HasSavedAudio(AudioProvider const& source, fs::path const& filename) {
+	try {
+		if (!fs::FileExists(filename) || fs::Size(filename) != data_size(source) + sizeof(saved_footer))
+			return false;
+
+		read_file_mapping file(filename);
+		auto expected = make_footer(source);
+		return !memcmp(file.read(data_size(source), sizeof(saved_footer)), &expected, sizeof(saved_footer));
+	}
+	catch (agi::Exception const&) {
+		return false;
+	}
+}
+
+std::unique_ptr<AudioProvider> CreateSavedAudioProvider(std::unique_ptr<AudioProvider> src, fs::path const& filename) {
+	return agi::make_unique<SavedAudioProvider>(std::move(src), filename);
+}
+}
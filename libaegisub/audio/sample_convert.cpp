@@ -0,0 +1,494 @@
+// Copyright (c) 2014, Thomas Goyne <plorkyeran@aegisub.org>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+
+#include "libaegisub/audio/sample_convert.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef AGI_SIMD_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+/// Sample formats which have their own conversion kernels
+enum class format {
+	u8,
+	s16,
+	s32,
+	f32,
+	f64,
+	/// Any other integer size, such as 24-bit
+	other_int
+};
+
+template<typename T>
+inline T load(const char *src) {
+	T v;
+	memcpy(&v, src, sizeof(T));
+	return v;
+}
+
+template<typename Float>
+inline int16_t from_float(Float v) {
+	Float expanded = v * 32768;
+	// Written so that NaN gives the same result as the SIMD kernels
+	return !(expanded >= -32768) ? -32768 :
+		expanded > 32767 ? 32767 :
+		static_cast<int16_t>(expanded);
+}
+
+/// Convert sample i of a run of samples to 16 bits
+template<format F>
+inline int16_t sample(const char *src, size_t i, int bytes_per_sample);
+
+template<> inline int16_t sample<format::u8>(const char *src, size_t i, int) {
+	return static_cast<int16_t>((static_cast<uint8_t>(src[i]) - 128) * 256);
+}
+template<> inline int16_t sample<format::s16>(const char *src, size_t i, int) {
+	return load<int16_t>(src + i * 2);
+}
+template<> inline int16_t sample<format::s32>(const char *src, size_t i, int) {
+	return load<int16_t>(src + i * 4 + 2);
+}
+template<> inline int16_t sample<format::f32>(const char *src, size_t i, int) {
+	return from_float(load<float>(src + i * 4));
+}
+template<> inline int16_t sample<format::f64>(const char *src, size_t i, int) {
+	return from_float(load<double>(src + i * 8));
+}
+template<> inline int16_t sample<format::other_int>(const char *src, size_t i, int bytes_per_sample) {
+	return load<int16_t>(src + (i + 1) * bytes_per_sample - 2);
+}
+
+/// Convert a run of samples without any averaging of channels
+typedef void (*convert_fn)(const char *src, int16_t *dst, size_t count, int bytes_per_sample);
+/// Average each group of channels samples
+typedef void (*downmix_fn)(const int16_t *src, int16_t *dst, size_t count, int channels);
+
+template<format F>
+void convert_scalar(const char *src, int16_t *dst, size_t count, int bytes_per_sample) {
+	for (size_t i = 0; i < count; ++i)
+		dst[i] = sample<F>(src, i, bytes_per_sample);
+}
+
+template<int Channels>
+void downmix_scalar(const int16_t *src, int16_t *dst, size_t count, int) {
+	for (size_t i = 0; i < count; ++i) {
+		int sum = 0;
+		for (int c = 0; c < Channels; ++c)
+			sum += src[i * Channels + c];
+		dst[i] = static_cast<int16_t>(sum / Channels);
+	}
+}
+
+void downmix_scalar_any(const int16_t *src, int16_t *dst, size_t count, int channels) {
+	for (size_t i = 0; i < count; ++i) {
+		int sum = 0;
+		for (int c = 0; c < channels; ++c)
+			sum += src[i * channels + c];
+		dst[i] = static_cast<int16_t>(sum / channels);
+	}
+}
+
+#ifdef AGI_SIMD_X86
+/// Divide by 2^bits, rounding towards zero like integer division
+inline __m128i div_pow2_sse2(__m128i v, int bits) {
+	__m128i bias = _mm_srli_epi32(_mm_srai_epi32(v, 31), 32 - bits);
+	return _mm_srai_epi32(_mm_add_epi32(v, bias), bits);
+}
+
+template<format F>
+void convert_sse2(const char *src, int16_t *dst, size_t count, int bytes_per_sample);
+
+template<> void convert_sse2<format::u8>(const char *src, int16_t *dst, size_t count, int) {
+	const __m128i bias = _mm_set1_epi8(-128);
+	const __m128i zero = _mm_setzero_si128();
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16) {
+		// Flipping the top bit is subtracting 128, and putting the result in
+		// the high byte multiplies it by 256
+		__m128i v = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i)), bias);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_unpacklo_epi8(zero, v));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i + 8), _mm_unpackhi_epi8(zero, v));
+	}
+	convert_scalar<format::u8>(src + i, dst + i, count - i, 1);
+}
+
+template<> void convert_sse2<format::s16>(const char *src, int16_t *dst, size_t count, int) {
+	memcpy(dst, src, count * 2);
+}
+
+template<> void convert_sse2<format::s32>(const char *src, int16_t *dst, size_t count, int) {
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m128i lo = _mm_srai_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 4)), 16);
+		__m128i hi = _mm_srai_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 4 + 16)), 16);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packs_epi32(lo, hi));
+	}
+	convert_scalar<format::s32>(src + i * 4, dst + i, count - i, 4);
+}
+
+template<> void convert_sse2<format::f32>(const char *src, int16_t *dst, size_t count, int) {
+	const __m128 scale = _mm_set1_ps(32768.f);
+	const __m128 min = _mm_set1_ps(-32768.f);
+	const __m128 max = _mm_set1_ps(32767.f);
+	auto convert = [&](const char *p) {
+		__m128 v = _mm_mul_ps(_mm_loadu_ps(reinterpret_cast<const float *>(p)), scale);
+		// max returns its second argument for NaN
+		return _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(v, min), max));
+	};
+
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m128i lo = convert(src + i * 4);
+		__m128i hi = convert(src + i * 4 + 16);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packs_epi32(lo, hi));
+	}
+	convert_scalar<format::f32>(src + i * 4, dst + i, count - i, 4);
+}
+
+template<> void convert_sse2<format::f64>(const char *src, int16_t *dst, size_t count, int) {
+	const __m128d scale = _mm_set1_pd(32768.);
+	const __m128d min = _mm_set1_pd(-32768.);
+	const __m128d max = _mm_set1_pd(32767.);
+	auto convert = [&](const char *p) {
+		__m128d v = _mm_mul_pd(_mm_loadu_pd(reinterpret_cast<const double *>(p)), scale);
+		return _mm_cvttpd_epi32(_mm_min_pd(_mm_max_pd(v, min), max));
+	};
+
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m128i lo = _mm_unpacklo_epi64(convert(src + i * 8), convert(src + i * 8 + 16));
+		__m128i hi = _mm_unpacklo_epi64(convert(src + i * 8 + 32), convert(src + i * 8 + 48));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packs_epi32(lo, hi));
+	}
+	convert_scalar<format::f64>(src + i * 8, dst + i, count - i, 8);
+}
+
+template<> void convert_sse2<format::other_int>(const char *src, int16_t *dst, size_t count, int bytes_per_sample) {
+	// Odd sizes need byte shuffles which SSE2 doesn't have
+	convert_scalar<format::other_int>(src, dst, count, bytes_per_sample);
+}
+
+void downmix2_sse2(const int16_t *src, int16_t *dst, size_t count, int) {
+	const __m128i ones = _mm_set1_epi16(1);
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		// madd with ones sums each pair of channels
+		__m128i lo = _mm_madd_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 2)), ones);
+		__m128i hi = _mm_madd_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 2 + 8)), ones);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i),
+			_mm_packs_epi32(div_pow2_sse2(lo, 1), div_pow2_sse2(hi, 1)));
+	}
+	downmix_scalar<2>(src + i * 2, dst + i, count - i, 2);
+}
+
+/// Sums of four samples from the pair sums of two samples each in a and b
+inline __m128i sum_pairs_sse2(__m128i a, __m128i b) {
+	__m128 even = _mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b), _MM_SHUFFLE(2, 0, 2, 0));
+	__m128 odd = _mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b), _MM_SHUFFLE(3, 1, 3, 1));
+	return _mm_add_epi32(_mm_castps_si128(even), _mm_castps_si128(odd));
+}
+
+void downmix4_sse2(const int16_t *src, int16_t *dst, size_t count, int) {
+	const __m128i ones = _mm_set1_epi16(1);
+	auto sum4 = [&](const int16_t *p) {
+		__m128i a = _mm_madd_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p)), ones);
+		__m128i b = _mm_madd_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 8)), ones);
+		return div_pow2_sse2(sum_pairs_sse2(a, b), 2);
+	};
+
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packs_epi32(sum4(src + i * 4), sum4(src + i * 4 + 16)));
+	downmix_scalar<4>(src + i * 4, dst + i, count - i, 4);
+}
+
+void downmix8_sse2(const int16_t *src, int16_t *dst, size_t count, int) {
+	const __m128i ones = _mm_set1_epi16(1);
+	auto sum4 = [&](const int16_t *p) {
+		// Each vector is one sample, so transpose the four pair sums of four
+		// samples while adding them up
+		__m128i a = _mm_madd_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p)), ones);
+		__m128i b = _mm_madd_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 8)), ones);
+		__m128i c = _mm_madd_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 16)), ones);
+		__m128i d = _mm_madd_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 24)), ones);
+		__m128i ab = _mm_add_epi32(_mm_unpacklo_epi32(a, b), _mm_unpackhi_epi32(a, b));
+		__m128i cd = _mm_add_epi32(_mm_unpacklo_epi32(c, d), _mm_unpackhi_epi32(c, d));
+		__m128i sum = _mm_add_epi32(_mm_unpacklo_epi64(ab, cd), _mm_unpackhi_epi64(ab, cd));
+		return div_pow2_sse2(sum, 3);
+	};
+
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packs_epi32(sum4(src + i * 8), sum4(src + i * 8 + 32)));
+	downmix_scalar<8>(src + i * 8, dst + i, count - i, 8);
+}
+
+AGI_TARGET_AVX2
+inline __m256i div_pow2_avx2(__m256i v, int bits) {
+	__m256i bias = _mm256_srli_epi32(_mm256_srai_epi32(v, 31), 32 - bits);
+	return _mm256_srai_epi32(_mm256_add_epi32(v, bias), bits);
+}
+
+/// Pack two vectors of eight 32-bit values to sixteen 16-bit values in order
+AGI_TARGET_AVX2
+inline __m256i packs_ordered_avx2(__m256i lo, __m256i hi) {
+	// packs works within each 128-bit lane, interleaving the halves
+	return _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+template<format F>
+void convert_avx2(const char *src, int16_t *dst, size_t count, int bytes_per_sample);
+
+template<> AGI_TARGET_AVX2
+void convert_avx2<format::u8>(const char *src, int16_t *dst, size_t count, int) {
+	const __m128i bias = _mm_set1_epi8(-128);
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16) {
+		__m128i v = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i)), bias);
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_slli_epi16(_mm256_cvtepi8_epi16(v), 8));
+	}
+	convert_scalar<format::u8>(src + i, dst + i, count - i, 1);
+}
+
+template<> AGI_TARGET_AVX2
+void convert_avx2<format::s16>(const char *src, int16_t *dst, size_t count, int) {
+	memcpy(dst, src, count * 2);
+}
+
+template<> AGI_TARGET_AVX2
+void convert_avx2<format::s32>(const char *src, int16_t *dst, size_t count, int) {
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16) {
+		__m256i lo = _mm256_srai_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i * 4)), 16);
+		__m256i hi = _mm256_srai_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i * 4 + 32)), 16);
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), packs_ordered_avx2(lo, hi));
+	}
+	convert_scalar<format::s32>(src + i * 4, dst + i, count - i, 4);
+}
+
+template<> AGI_TARGET_AVX2
+void convert_avx2<format::f32>(const char *src, int16_t *dst, size_t count, int) {
+	const __m256 scale = _mm256_set1_ps(32768.f);
+	const __m256 min = _mm256_set1_ps(-32768.f);
+	const __m256 max = _mm256_set1_ps(32767.f);
+
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16) {
+		__m256 lo = _mm256_mul_ps(_mm256_loadu_ps(reinterpret_cast<const float *>(src + i * 4)), scale);
+		__m256 hi = _mm256_mul_ps(_mm256_loadu_ps(reinterpret_cast<const float *>(src + i * 4 + 32)), scale);
+		__m256i lo_i = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(lo, min), max));
+		__m256i hi_i = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(hi, min), max));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), packs_ordered_avx2(lo_i, hi_i));
+	}
+	convert_scalar<format::f32>(src + i * 4, dst + i, count - i, 4);
+}
+
+template<> AGI_TARGET_AVX2
+void convert_avx2<format::f64>(const char *src, int16_t *dst, size_t count, int) {
+	const __m256d scale = _mm256_set1_pd(32768.);
+	const __m256d min = _mm256_set1_pd(-32768.);
+	const __m256d max = _mm256_set1_pd(32767.);
+
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256d lo = _mm256_mul_pd(_mm256_loadu_pd(reinterpret_cast<const double *>(src + i * 8)), scale);
+		__m256d hi = _mm256_mul_pd(_mm256_loadu_pd(reinterpret_cast<const double *>(src + i * 8 + 32)), scale);
+		__m128i lo_i = _mm256_cvttpd_epi32(_mm256_min_pd(_mm256_max_pd(lo, min), max));
+		__m128i hi_i = _mm256_cvttpd_epi32(_mm256_min_pd(_mm256_max_pd(hi, min), max));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packs_epi32(lo_i, hi_i));
+	}
+	convert_scalar<format::f64>(src + i * 8, dst + i, count - i, 8);
+}
+
+template<> AGI_TARGET_AVX2
+void convert_avx2<format::other_int>(const char *src, int16_t *dst, size_t count, int bytes_per_sample) {
+	if (bytes_per_sample != 3) {
+		convert_scalar<format::other_int>(src, dst, count, bytes_per_sample);
+		return;
+	}
+
+	// Gather the top two bytes of each of four 24-bit samples in each lane
+	const __m256i shuffle = _mm256_setr_epi8(
+		1, 2, 4, 5, 7, 8, 10, 11, -1, -1, -1, -1, -1, -1, -1, -1,
+		1, 2, 4, 5, 7, 8, 10, 11, -1, -1, -1, -1, -1, -1, -1, -1);
+	size_t i = 0;
+	// Each load reads 16 bytes for 12 bytes of samples, so stop early enough
+	// to not read past the end
+	for (; i + 10 <= count; i += 8) {
+		__m256i v = _mm256_inserti128_si256(
+			_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 3))),
+			_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 3 + 12)), 1);
+		v = _mm256_permute4x64_epi64(_mm256_shuffle_epi8(v, shuffle), _MM_SHUFFLE(3, 1, 2, 0));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm256_castsi256_si128(v));
+	}
+	convert_scalar<format::other_int>(src + i * 3, dst + i, count - i, 3);
+}
+
+AGI_TARGET_AVX2
+void downmix2_avx2(const int16_t *src, int16_t *dst, size_t count, int) {
+	const __m256i ones = _mm256_set1_epi16(1);
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16) {
+		__m256i lo = _mm256_madd_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i * 2)), ones);
+		__m256i hi = _mm256_madd_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i * 2 + 16)), ones);
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i),
+			packs_ordered_avx2(div_pow2_avx2(lo, 1), div_pow2_avx2(hi, 1)));
+	}
+	downmix_scalar<2>(src + i * 2, dst + i, count - i, 2);
+}
+
+/// Sums of each pair of 16-bit values
+AGI_TARGET_AVX2
+inline __m256i pair_sums_avx2(const int16_t *src) {
+	return _mm256_madd_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(src)), _mm256_set1_epi16(1));
+}
+
+AGI_TARGET_AVX2
+void downmix4_avx2(const int16_t *src, int16_t *dst, size_t count, int) {
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16) {
+		// hadd works within each 128-bit lane, so this gives samples
+		// 0, 1, 4, 5, 2, 3, 6, 7 of each group of eight
+		__m256i lo = _mm256_hadd_epi32(pair_sums_avx2(src + i * 4), pair_sums_avx2(src + i * 4 + 16));
+		__m256i hi = _mm256_hadd_epi32(pair_sums_avx2(src + i * 4 + 32), pair_sums_avx2(src + i * 4 + 48));
+		lo = _mm256_permute4x64_epi64(div_pow2_avx2(lo, 2), _MM_SHUFFLE(3, 1, 2, 0));
+		hi = _mm256_permute4x64_epi64(div_pow2_avx2(hi, 2), _MM_SHUFFLE(3, 1, 2, 0));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), packs_ordered_avx2(lo, hi));
+	}
+	downmix_scalar<4>(src + i * 4, dst + i, count - i, 4);
+}
+
+/// Averages of eight samples of eight channels each
+AGI_TARGET_AVX2
+inline __m256i average8_avx2(const int16_t *src) {
+	__m256i ab = _mm256_hadd_epi32(pair_sums_avx2(src), pair_sums_avx2(src + 16));
+	__m256i cd = _mm256_hadd_epi32(pair_sums_avx2(src + 32), pair_sums_avx2(src + 48));
+	// hadd works within each 128-bit lane, so the sums come out as samples
+	// 0, 2, 4, 6, 1, 3, 5, 7
+	const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+	__m256i sum = _mm256_permutevar8x32_epi32(_mm256_hadd_epi32(ab, cd), order);
+	return div_pow2_avx2(sum, 3);
+}
+
+AGI_TARGET_AVX2
+void downmix8_avx2(const int16_t *src, int16_t *dst, size_t count, int) {
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16)
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), packs_ordered_avx2(average8_avx2(src + i * 8), average8_avx2(src + i * 8 + 64)));
+	downmix_scalar<8>(src + i * 8, dst + i, count - i, 8);
+}
+#endif
+
+template<format F>
+convert_fn select_convert(agi::simd::level level) {
+#ifdef AGI_SIMD_X86
+	if (level == agi::simd::level::avx2)
+		return convert_avx2<F>;
+	if (level == agi::simd::level::sse2)
+		return convert_sse2<F>;
+#endif
+	return convert_scalar<F>;
+}
+
+convert_fn select_convert(format fmt, agi::simd::level level) {
+	switch (fmt) {
+		case format::u8:  return select_convert<format::u8>(level);
+		case format::s16: return select_convert<format::s16>(level);
+		case format::s32: return select_convert<format::s32>(level);
+		case format::f32: return select_convert<format::f32>(level);
+		case format::f64: return select_convert<format::f64>(level);
+		default:          return select_convert<format::other_int>(level);
+	}
+}
+
+downmix_fn select_downmix(int channels, agi::simd::level level) {
+#ifdef AGI_SIMD_X86
+	if (level == agi::simd::level::avx2) {
+		if (channels == 2) return downmix2_avx2;
+		if (channels == 4) return downmix4_avx2;
+		if (channels == 8) return downmix8_avx2;
+	}
+	else if (level == agi::simd::level::sse2) {
+		if (channels == 2) return downmix2_sse2;
+		if (channels == 4) return downmix4_sse2;
+		if (channels == 8) return downmix8_sse2;
+	}
+#endif
+	switch (channels) {
+		case 2: return downmix_scalar<2>;
+		case 3: return downmix_scalar<3>;
+		case 4: return downmix_scalar<4>;
+		case 5: return downmix_scalar<5>;
+		case 6: return downmix_scalar<6>;
+		case 7: return downmix_scalar<7>;
+		case 8: return downmix_scalar<8>;
+		default: return downmix_scalar_any;
+	}
+}
+}
+
+namespace agi {
+void ConvertSamplesToInt16Mono(const void *src, int16_t *dst, int64_t count,
+	int bytes_per_sample, bool float_samples, int channels,
+	simd::level level)
+{
+	format fmt = format::other_int;
+	if (float_samples)
+		fmt = bytes_per_sample == 8 ? format::f64 : format::f32;
+	else if (bytes_per_sample == 1)
+		fmt = format::u8;
+	else if (bytes_per_sample == 2)
+		fmt = format::s16;
+	else if (bytes_per_sample == 4)
+		fmt = format::s32;
+
+	auto convert = select_convert(fmt, level);
+	auto src_bytes = static_cast<const char *>(src);
+	if (channels == 1) {
+		convert(src_bytes, dst, count, bytes_per_sample);
+		return;
+	}
+
+	// Convert to 16 bits in chunks small enough to stay in the L1 cache and
+	// then average the channels
+	const size_t buffer_size = 4096;
+	int16_t buffer[buffer_size];
+	auto downmix = select_downmix(channels, level);
+	const int64_t chunk = std::max<int64_t>(1, buffer_size / channels);
+	if (static_cast<size_t>(channels) > buffer_size) {
+		// Not a real thing, but a bad file could claim to have this many
+		for (int64_t i = 0; i < count; ++i) {
+			int sum = 0;
+			for (int c = 0; c < channels; ++c) {
+				convert(src_bytes + ((size_t)i * channels + c) * bytes_per_sample, buffer, 1, bytes_per_sample);
+				sum += buffer[0];
+			}
+			dst[i] = static_cast<int16_t>(sum / channels);
+		}
+		return;
+	}
+
+	for (int64_t i = 0; i < count; i += chunk) {
+		auto n = std::min(chunk, count - i);
+		convert(src_bytes + (size_t)i * channels * bytes_per_sample, buffer, n * channels, bytes_per_sample);
+		downmix(buffer, dst + i, n, channels);
+	}
+}
+}
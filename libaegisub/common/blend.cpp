@@ -0,0 +1,160 @@
+// Copyright (c) 2014, Thomas Goyne <plorkyeran@aegisub.org>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include "libaegisub/blend.h"
+
+#ifdef AGI_SIMD_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+/// floor(x / 255) for 0 <= x <= 255 * 255
+inline unsigned int div255(unsigned int x) {
+	return (x + 1 + (x >> 8)) >> 8;
+}
+
+struct blend_params {
+	unsigned int opacity;
+	unsigned int b, g, r;
+
+	blend_params(uint32_t color)
+	: opacity(255 - (color & 0xFF))
+	, b((color >> 8) & 0xFF)
+	, g((color >> 16) & 0xFF)
+	, r(color >> 24)
+	{
+	}
+};
+
+inline void blend_pixel(uint8_t *dst, uint8_t coverage, blend_params const& p) {
+	unsigned int k = div255(coverage * p.opacity);
+	unsigned int ck = 255 - k;
+	dst[0] = static_cast<uint8_t>(div255(k * p.b + ck * dst[0]));
+	dst[1] = static_cast<uint8_t>(div255(k * p.g + ck * dst[1]));
+	dst[2] = static_cast<uint8_t>(div255(k * p.r + ck * dst[2]));
+	dst[3] = 0;
+}
+
+void blend_row_scalar(uint8_t *dst, const uint8_t *mask, int width, blend_params const& p) {
+	for (int x = 0; x < width; ++x)
+		blend_pixel(dst + x * 4, mask[x], p);
+}
+
+#ifdef AGI_SIMD_X86
+inline __m128i div255_epu16(__m128i x) {
+	x = _mm_add_epi16(x, _mm_add_epi16(_mm_set1_epi16(1), _mm_srli_epi16(x, 8)));
+	return _mm_srli_epi16(x, 8);
+}
+
+/// Blend two pixels, widened to 16 bits per channel, with k replicated
+/// across each pixel's four channels
+inline __m128i blend2_sse2(__m128i pixels, __m128i k, __m128i color) {
+	__m128i ck = _mm_sub_epi16(_mm_set1_epi16(255), k);
+	return div255_epu16(_mm_add_epi16(_mm_mullo_epi16(k, color), _mm_mullo_epi16(ck, pixels)));
+}
+
+void blend_row_sse2(uint8_t *dst, const uint8_t *mask, int width, blend_params const& p) {
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i opacity = _mm_set1_epi16(static_cast<short>(p.opacity));
+	const __m128i color = _mm_setr_epi16(p.b, p.g, p.r, 0, p.b, p.g, p.r, 0);
+	const __m128i rgb_mask = _mm_set1_epi32(0x00FFFFFF);
+
+	int x = 0;
+	for (; x + 8 <= width; x += 8) {
+		__m128i m = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(mask + x)), zero);
+		__m128i k = div255_epu16(_mm_mullo_epi16(m, opacity));
+		__m128i k03 = _mm_unpacklo_epi16(k, k);
+		__m128i k47 = _mm_unpackhi_epi16(k, k);
+
+		auto px = reinterpret_cast<__m128i *>(dst + x * 4);
+		__m128i lo = _mm_loadu_si128(px);
+		__m128i hi = _mm_loadu_si128(px + 1);
+
+		__m128i p01 = blend2_sse2(_mm_unpacklo_epi8(lo, zero), _mm_unpacklo_epi32(k03, k03), color);
+		__m128i p23 = blend2_sse2(_mm_unpackhi_epi8(lo, zero), _mm_unpackhi_epi32(k03, k03), color);
+		__m128i p45 = blend2_sse2(_mm_unpacklo_epi8(hi, zero), _mm_unpacklo_epi32(k47, k47), color);
+		__m128i p67 = blend2_sse2(_mm_unpackhi_epi8(hi, zero), _mm_unpackhi_epi32(k47, k47), color);
+
+		_mm_storeu_si128(px, _mm_and_si128(_mm_packus_epi16(p01, p23), rgb_mask));
+		_mm_storeu_si128(px + 1, _mm_and_si128(_mm_packus_epi16(p45, p67), rgb_mask));
+	}
+
+	blend_row_scalar(dst + x * 4, mask + x, width - x, p);
+}
+
+AGI_TARGET_AVX2
+inline __m256i div255_epu16(__m256i x) {
+	x = _mm256_add_epi16(x, _mm256_add_epi16(_mm256_set1_epi16(1), _mm256_srli_epi16(x, 8)));
+	return _mm256_srli_epi16(x, 8);
+}
+
+/// Blend four pixels, widened to 16 bits per channel
+AGI_TARGET_AVX2
+inline __m256i blend4_avx2(const uint8_t *dst, __m128i k_bytes, __m256i color) {
+	__m256i pixels = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(dst)));
+	__m256i k = _mm256_cvtepu8_epi16(k_bytes);
+	__m256i ck = _mm256_sub_epi16(_mm256_set1_epi16(255), k);
+	return div255_epu16(_mm256_add_epi16(_mm256_mullo_epi16(k, color), _mm256_mullo_epi16(ck, pixels)));
+}
+
+AGI_TARGET_AVX2
+void blend_row_avx2(uint8_t *dst, const uint8_t *mask, int width, blend_params const& p) {
+	const __m128i opacity = _mm_set1_epi16(static_cast<short>(p.opacity));
+	const __m256i color = _mm256_setr_epi16(
+		p.b, p.g, p.r, 0, p.b, p.g, p.r, 0,
+		p.b, p.g, p.r, 0, p.b, p.g, p.r, 0);
+	const __m256i rgb_mask = _mm256_set1_epi32(0x00FFFFFF);
+	const __m128i spread03 = _mm_setr_epi8(0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3);
+	const __m128i spread47 = _mm_setr_epi8(4, 4, 4, 4, 5, 5, 5, 5, 6, 6, 6, 6, 7, 7, 7, 7);
+
+	int x = 0;
+	for (; x + 8 <= width; x += 8) {
+		__m128i m = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(mask + x)));
+		__m128i k = div255_epu16(_mm_mullo_epi16(m, opacity));
+		// k is at most 255, so narrow it back to bytes to replicate it per channel
+		__m128i k_bytes = _mm_packus_epi16(k, k);
+
+		uint8_t *px = dst + x * 4;
+		__m256i p03 = blend4_avx2(px, _mm_shuffle_epi8(k_bytes, spread03), color);
+		__m256i p47 = blend4_avx2(px + 16, _mm_shuffle_epi8(k_bytes, spread47), color);
+
+		// packus works within each 128-bit lane, leaving the pixels in the order 0, 1, 4, 5, 2, 3, 6, 7
+		__m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(p03, p47), _MM_SHUFFLE(3, 1, 2, 0));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(px), _mm256_and_si256(packed, rgb_mask));
+	}
+
+	blend_row_sse2(dst + x * 4, mask + x, width - x, p);
+}
+#endif
+}
+
+namespace agi {
+void BlendMask(uint8_t *dst, ptrdiff_t dst_stride, const uint8_t *mask, ptrdiff_t mask_stride,
+	int width, int height, uint32_t color, simd::level level)
+{
+	auto blend_row = blend_row_scalar;
+#ifdef AGI_SIMD_X86
+	if (level == simd::level::avx2)
+		blend_row = blend_row_avx2;
+	else if (level == simd::level::sse2)
+		blend_row = blend_row_sse2;
+#endif
+
+	blend_params params(color);
+	for (int y = 0; y < height; ++y)
+		blend_row(dst + y * dst_stride, mask + y * mask_stride, width, params);
+}
+}
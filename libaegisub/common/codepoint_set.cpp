@@ -0,0 +1,95 @@
+// Copyright (c) 2014, Thomas Goyne <plorkyeran@aegisub.org>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+
+#include "libaegisub/codepoint_set.h"
+
+#include <algorithm>
+#include <unicode/utf8.h>
+
+namespace agi {
+void CodepointSet::insert(int32_t c) {
+	if (c < 0) return;
+	size_t word = static_cast<size_t>(c) / 64;
+	if (word >= bits.size())
+		bits.resize(word + 1);
+	bits[word] |= uint64_t(1) << (c % 64);
+}
+
+void CodepointSet::insert_text(const char *begin, const char *end) {
+	auto size = static_cast<int32_t>(end - begin);
+	for (int32_t i = 0; i < size; ) {
+		if (begin[i] == '\\' && i + 1 < size) {
+			char next = begin[++i];
+			if (next == 'N' || next == 'n') {
+				++i;
+				continue;
+			}
+			if (next == 'h') {
+				++i;
+				insert(0xA0);
+				continue;
+			}
+
+			insert('\\');
+			continue;
+		}
+
+		UChar32 c;
+		U8_NEXT(begin, i, size, c);
+		insert(c < 0 ? 0xFFFD : c);
+	}
+}
+
+CodepointSet& CodepointSet::operator|=(CodepointSet const& other) {
+	if (other.bits.size() > bits.size())
+		bits.resize(other.bits.size());
+	for (size_t i = 0; i < other.bits.size(); ++i)
+		bits[i] |= other.bits[i];
+	return *this;
+}
+
+bool CodepointSet::contains(int32_t c) const {
+	if (c < 0) return false;
+	size_t word = static_cast<size_t>(c) / 64;
+	return word < bits.size() && (bits[word] >> (c % 64)) & 1;
+}
+
+bool CodepointSet::empty() const {
+	return std::all_of(bits.begin(), bits.end(), [](uint64_t w) { return w == 0; });
+}
+
+size_t CodepointSet::size() const {
+	size_t count = 0;
+	for (auto word : bits) {
+		for (; word; word &= word - 1)
+			++count;
+	}
+	return count;
+}
+
+std::vector<int> CodepointSet::codepoints() const {
+	std::vector<int> ret;
+	for (size_t i = 0; i < bits.size(); ++i) {
+		for (auto word = bits[i]; word; word &= word - 1) {
+			int bit = 0;
+			while (!((word >> bit) & 1)) ++bit;
+			ret.push_back(static_cast<int>(i * 64 + bit));
+		}
+	}
+	return ret;
+}
+}
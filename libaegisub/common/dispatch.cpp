@@ -23,6 +23,7 @@
 
 #include "libaegisub/util.h"
 
+#include <algorithm>
 #include <atomic>
 #include <boost/asio/io_service.hpp>
 #include <boost/asio/strand.hpp>
@@ -48,13 +49,36 @@ namespace {
 	};
 
 	class SerialQueue final : public agi::dispatch::Queue {
-		boost::asio::io_service::strand strand;
+		/// Shared with the queued thunks, which may outlive the queue
+		struct State {
+			boost::asio::io_service::strand strand;
+			/// Number of thunks other than idle ones which haven't started yet
+			std::atomic<size_t> pending{0};
+			State() : strand(*service) { }
+		};
+		std::shared_ptr<State> state = std::make_shared<State>();
+
+		static void RunIdle(std::shared_ptr<State> const& state, agi::dispatch::Thunk const& thunk) {
+			// Go to the back of the queue until everything else has run
+			if (state->pending)
+				state->strand.post([=] { RunIdle(state, thunk); });
+			else
+				thunk();
+		}
 
 		void DoInvoke(agi::dispatch::Thunk thunk) override {
-			strand.post(thunk);
+			auto state = this->state;
+			++state->pending;
+			state->strand.post([=] {
+				--state->pending;
+				thunk();
+			});
+		}
+
+		void DoInvokeIdle(agi::dispatch::Thunk thunk) override {
+			auto state = this->state;
+			state->strand.post([=] { RunIdle(state, thunk); });
 		}
-	public:
-		SerialQueue() : strand(*service) { }
 	};
 
 	struct IOServiceThreadPool {
@@ -95,8 +119,10 @@ void Init(std::function<void (Thunk)> invoke_main) {
 	}
 }
 
-void Queue::Async(Thunk thunk) {
-	DoInvoke([=] {
+/// Wrap a thunk run asynchronously so that any exceptions it throws are
+/// rethrown on the main thread
+static Thunk rethrow_on_main(Thunk thunk) {
+	return [=] {
 		try {
 			thunk();
 		}
@@ -104,7 +130,15 @@ void Queue::Async(Thunk thunk) {
 			auto e = std::current_exception();
 			invoke_main([=] { std::rethrow_exception(e); });
 		}
-	});
+	};
+}
+
+void Queue::Async(Thunk thunk) {
+	DoInvoke(rethrow_on_main(std::move(thunk)));
+}
+
+void Queue::AsyncIdle(Thunk thunk) {
+	DoInvokeIdle(rethrow_on_main(std::move(thunk)));
 }
 
 void Queue::Sync(Thunk thunk) {
@@ -142,4 +176,53 @@ std::unique_ptr<Queue> Create() {
 	return std::unique_ptr<Queue>(new SerialQueue);
 }
 
+void ParallelFor(size_t count, std::function<void (size_t)> const& fn) {
+	if (!count) return;
+
+	// Shared with the background tasks, which may only start after the
+	// calling thread has already done all of the work and returned
+	struct State {
+		std::function<void (size_t)> const *fn;
+		size_t count;
+		std::atomic<size_t> next{0};
+		size_t finished = 0;
+		std::exception_ptr error;
+		std::mutex mutex;
+		std::condition_variable all_finished;
+
+		void Work() {
+			size_t done = 0;
+			std::exception_ptr e;
+			for (size_t i; (i = next++) < count; ++done) {
+				try {
+					(*fn)(i);
+				}
+				catch (...) {
+					if (!e) e = std::current_exception();
+				}
+			}
+			if (!done) return;
+
+			std::lock_guard<std::mutex> lock(mutex);
+			if (e && !error) error = e;
+			finished += done;
+			if (finished == count)
+				all_finished.notify_all();
+		}
+	};
+
+	auto state = std::make_shared<State>();
+	state->fn = &fn;
+	state->count = count;
+
+	size_t threads = std::min<size_t>(count, std::max(1u, std::thread::hardware_concurrency()));
+	for (size_t i = 1; i < threads; ++i)
+		Background().Async([=] { state->Work(); });
+	state->Work();
+
+	std::unique_lock<std::mutex> lock(state->mutex);
+	state->all_finished.wait(lock, [&] { return state->finished == count; });
+	if (state->error) std::rethrow_exception(state->error);
+}
+
 } }
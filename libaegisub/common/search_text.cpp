@@ -0,0 +1,201 @@
+// Copyright (c) 2014, Thomas Goyne <plorkyeran@aegisub.org>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include "libaegisub/search_text.h"
+
+#include <algorithm>
+#include <unicode/uchar.h>
+#include <unicode/ustring.h>
+#include <unicode/utf16.h>
+#include <unicode/utf8.h>
+
+namespace agi {
+SearchText::SearchText(std::string const& source, bool strip_tags, bool fold_case)
+: source_size(source.size())
+{
+	if (!fold_case && (!strip_tags || source.find('{') == std::string::npos)) {
+		source_text = &source;
+		return;
+	}
+
+	bool changed = false;
+	text.reserve(source.size());
+
+	// Record that the last text_len bytes of text came from the given part
+	// of the source
+	auto add_span = [&](size_t src, size_t src_len, size_t text_len, bool exact) {
+		if (exact && !spans.empty()) {
+			auto& last = spans.back();
+			if (last.exact && last.source + last.source_len == src) {
+				last.text_len += text_len;
+				last.source_len += src_len;
+				return;
+			}
+		}
+		spans.push_back(Span{text.size() - text_len, src, text_len, src_len, exact});
+	};
+
+	auto add_run = [&](size_t begin, size_t end) {
+		if (!fold_case) {
+			text.append(source, begin, end - begin);
+			add_span(begin, end - begin, end - begin, true);
+			return;
+		}
+
+		size_t i = begin;
+		while (i < end) {
+			// ASCII only folds to ASCII, so runs of it are done here without
+			// involving ICU
+			if (static_cast<unsigned char>(source[i]) < 0x80) {
+				size_t run_start = i;
+				for (; i < end && static_cast<unsigned char>(source[i]) < 0x80; ++i) {
+					char c = source[i];
+					if (c >= 'A' && c <= 'Z') {
+						c += 'a' - 'A';
+						changed = true;
+					}
+					text += c;
+				}
+				add_span(run_start, i - run_start, i - run_start, true);
+				continue;
+			}
+
+			int32_t next = static_cast<int32_t>(i);
+			UChar32 c;
+			U8_NEXT(source.data(), next, static_cast<int32_t>(end), c);
+			size_t len = next - i;
+
+			UChar folded[8];
+			int32_t folded_len = 0;
+			UErrorCode err = U_ZERO_ERROR;
+			if (c >= 0) {
+				UChar unfolded[2];
+				int32_t unfolded_len = 0;
+				U16_APPEND_UNSAFE(unfolded, unfolded_len, c);
+				folded_len = u_strFoldCase(folded, 8, unfolded, unfolded_len, U_FOLD_CASE_DEFAULT, &err);
+			}
+
+			// Invalid UTF-8 and characters which fold to themselves are
+			// copied as-is
+			size_t text_start = text.size();
+			size_t chars = 1;
+			if (c >= 0 && U_SUCCESS(err)) {
+				chars = 0;
+				for (int32_t j = 0; j < folded_len; ) {
+					UChar32 f;
+					U16_NEXT(folded, j, folded_len, f);
+					char buf[U8_MAX_LENGTH];
+					int32_t buf_len = 0;
+					U8_APPEND_UNSAFE(buf, buf_len, f);
+					text.append(buf, buf_len);
+					++chars;
+				}
+			}
+			else
+				text.append(source, i, len);
+
+			size_t text_len = text.size() - text_start;
+			if (text.compare(text_start, text_len, source, i, len) != 0)
+				changed = true;
+			// A character which folds to a single character of the same
+			// length can still be treated as mapping byte for byte, as
+			// searches never start or end in the middle of a character
+			add_span(i, len, text_len, chars == 1 && text_len == len);
+			i = next;
+		}
+	};
+
+	size_t last = 0;
+	if (strip_tags) {
+		size_t block_start = std::string::npos;
+		for (size_t i = 0; i < source.size(); ++i) {
+			if (source[i] == '{' && block_start == std::string::npos)
+				block_start = i;
+			else if (source[i] == '}' && block_start != std::string::npos) {
+				if (block_start > last)
+					add_run(last, block_start);
+				last = i + 1;
+				block_start = std::string::npos;
+				changed = true;
+			}
+		}
+	}
+	if (last < source.size())
+		add_run(last, source.size());
+
+	if (!changed) {
+		std::string().swap(text);
+		std::vector<Span>().swap(spans);
+		source_text = &source;
+	}
+}
+
+size_t SearchText::FromSource(size_t pos) const {
+	if (source_text) return std::min(pos, source_size);
+
+	// First span which ends after pos
+	auto it = std::upper_bound(spans.begin(), spans.end(), pos, [](size_t p, Span const& s) {
+		return p < s.source + s.source_len;
+	});
+	if (it == spans.end()) return text.size();
+	if (pos <= it->source) return it->text;
+	if (it->exact) return it->text + (pos - it->source);
+	return it->text + it->text_len;
+}
+
+bool SearchText::ToSource(size_t& start, size_t& end) const {
+	if (source_text) return true;
+
+	size_t new_start;
+	// The last span starting at or before start, which contains it unless
+	// start is the end of the text
+	auto it = std::upper_bound(spans.begin(), spans.end(), start, [](size_t p, Span const& s) {
+		return p < s.text;
+	});
+	if (start >= text.size() || it == spans.begin())
+		new_start = source_size;
+	else {
+		--it;
+		if (it->exact)
+			new_start = it->source + (start - it->text);
+		else if (start == it->text)
+			new_start = it->source;
+		else
+			return false;
+	}
+
+	if (end <= start) {
+		start = end = new_start;
+		return true;
+	}
+
+	// The last span starting before end, which is the one ending the range
+	it = std::lower_bound(spans.begin(), spans.end(), end, [](Span const& s, size_t p) {
+		return s.text < p;
+	});
+	--it;
+	size_t offset = std::min(end, it->text + it->text_len) - it->text;
+	if (it->exact)
+		end = it->source + offset;
+	else if (offset == it->text_len)
+		end = it->source + it->source_len;
+	else
+		return false;
+
+	start = new_start;
+	return true;
+}
+}
@@ -0,0 +1,50 @@
+// Copyright (c) 2014, Thomas Goyne <plorkyeran@aegisub.org>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include "libaegisub/simd.h"
+
+#if defined(AGI_SIMD_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace {
+agi::simd::level detect_level() {
+#if !defined(AGI_SIMD_X86)
+	return agi::simd::level::none;
+#elif defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) return agi::simd::level::sse2;
+
+	// AVX2 needs both the instructions and the OS saving the YMM registers
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	if (!osxsave || (_xgetbv(0) & 6) != 6) return agi::simd::level::sse2;
+	__cpuidex(info, 7, 0);
+	return info[1] & (1 << 5) ? agi::simd::level::avx2 : agi::simd::level::sse2;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2") ? agi::simd::level::avx2 : agi::simd::level::sse2;
+#endif
+}
+}
+
+namespace agi { namespace simd {
+level detect() {
+	static const level best = detect_level();
+	return best;
+}
+} }
@@ -0,0 +1,188 @@
+// Copyright (c) 2014, Thomas Goyne <plorkyeran@aegisub.org>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include "libaegisub/slab_allocator.h"
+
+#include "libaegisub/exception.h"
+
+#include <algorithm>
+#include <boost/align/aligned_alloc.hpp>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <thread>
+
+namespace {
+const size_t block_align = alignof(std::max_align_t);
+
+size_t align_up(size_t size) {
+	return (size + block_align - 1) & ~(block_align - 1);
+}
+
+/// Index used to pick the calling thread's shard. Threads are numbered in
+/// the order they first allocate so that a small pool of worker threads
+/// ends up spread evenly across the shards.
+size_t thread_index() {
+	static std::atomic<size_t> next_index{0};
+	thread_local size_t index = next_index++;
+	return index;
+}
+}
+
+namespace agi {
+struct SlabAllocator::Shard {
+	std::mutex mutex;
+	/// Slabs with at least one free block, most recently freed into first
+	Slab *partial = nullptr;
+	/// Completely empty slab kept to be reused
+	Slab *spare = nullptr;
+	/// Number of slabs currently allocated, including the spare
+	size_t slab_count = 0;
+
+	void Unlink(Slab *slab);
+};
+
+struct SlabAllocator::Slab {
+	/// Shard which this slab was allocated by and whose lock guards it
+	Shard *shard;
+	Slab *prev = nullptr;
+	Slab *next = nullptr;
+	/// Blocks which have been allocated and then freed
+	void *free_list = nullptr;
+	/// Blocks which have never been allocated start at this index
+	size_t untouched = 0;
+	/// Blocks currently allocated
+	size_t live = 0;
+
+	Slab(Shard *shard) : shard(shard) { }
+
+	char *Block(size_t index, size_t block_size) {
+		return reinterpret_cast<char *>(this) + align_up(sizeof(Slab)) + index * block_size;
+	}
+};
+
+void SlabAllocator::Shard::Unlink(Slab *slab) {
+	if (slab->prev)
+		slab->prev->next = slab->next;
+	else
+		partial = slab->next;
+	if (slab->next)
+		slab->next->prev = slab->prev;
+	slab->prev = slab->next = nullptr;
+}
+
+SlabAllocator::SlabAllocator(size_t block_size)
+: block_size(align_up(std::max(block_size, sizeof(void *))))
+, blocks_per_slab((SlabSize - align_up(sizeof(Slab))) / this->block_size)
+, shard_count(std::max(std::thread::hardware_concurrency(), 1u))
+, shards(new Shard[shard_count])
+{
+	if (blocks_per_slab < 2)
+		throw InternalError("Block size too large for slab allocator");
+}
+
+SlabAllocator::~SlabAllocator() {
+	// Full slabs aren't tracked, so any blocks still allocated are leaked
+	for (size_t i = 0; i < shard_count; ++i) {
+		Shard& shard = shards[i];
+		while (shard.partial) {
+			Slab *next = shard.partial->next;
+			boost::alignment::aligned_free(shard.partial);
+			shard.partial = next;
+		}
+		if (shard.spare)
+			boost::alignment::aligned_free(shard.spare);
+	}
+}
+
+SlabAllocator::Slab *SlabAllocator::NewSlab(Shard& shard) {
+	if (shard.spare) {
+		Slab *slab = shard.spare;
+		shard.spare = nullptr;
+		return slab;
+	}
+
+	void *mem = boost::alignment::aligned_alloc(SlabSize, SlabSize);
+	if (!mem) throw std::bad_alloc();
+	++shard.slab_count;
+	return new (mem) Slab(&shard);
+}
+
+void SlabAllocator::FreeSlab(Slab *slab) {
+	Shard& shard = *slab->shard;
+	shard.Unlink(slab);
+	if (!shard.spare) {
+		slab->free_list = nullptr;
+		slab->untouched = 0;
+		shard.spare = slab;
+	}
+	else {
+		boost::alignment::aligned_free(slab);
+		--shard.slab_count;
+	}
+}
+
+void *SlabAllocator::Allocate() {
+	Shard& shard = shards[thread_index() % shard_count];
+	std::lock_guard<std::mutex> lock(shard.mutex);
+	if (!shard.partial)
+		shard.partial = NewSlab(shard);
+
+	Slab *slab = shard.partial;
+	void *block;
+	if (slab->free_list) {
+		block = slab->free_list;
+		slab->free_list = *static_cast<void **>(block);
+	}
+	else
+		block = slab->Block(slab->untouched++, block_size);
+
+	if (++slab->live == blocks_per_slab)
+		shard.Unlink(slab);
+	return block;
+}
+
+void SlabAllocator::Free(void *ptr) {
+	if (!ptr) return;
+	auto slab = reinterpret_cast<Slab *>(reinterpret_cast<uintptr_t>(ptr) & ~static_cast<uintptr_t>(SlabSize - 1));
+	Shard& shard = *slab->shard;
+
+	std::lock_guard<std::mutex> lock(shard.mutex);
+	*static_cast<void **>(ptr) = slab->free_list;
+	slab->free_list = ptr;
+
+	// Full slabs aren't in the partial list, so put it back at the front
+	// where the next allocation will reuse the block just freed
+	if (slab->live-- == blocks_per_slab) {
+		slab->next = shard.partial;
+		if (shard.partial) shard.partial->prev = slab;
+		shard.partial = slab;
+	}
+
+	if (!slab->live)
+		FreeSlab(slab);
+}
+
+size_t SlabAllocator::SlabCount() {
+	size_t count = 0;
+	for (size_t i = 0; i < shard_count; ++i) {
+		std::lock_guard<std::mutex> lock(shards[i].mutex);
+		count += shards[i].slab_count;
+	}
+	return count;
+}
+}
@@ -0,0 +1,223 @@
+// Copyright (c) 2014, Thomas Goyne <plorkyeran@aegisub.org>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+
+#include "libaegisub/yuv.h"
+
+#include <cmath>
+#include <cstring>
+
+#ifdef AGI_SIMD_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+/// Kr and Kb for each agi::ycbcr_matrix
+const double matrix_coefficients[][2] = {
+	{.299, .114},    // BT.601
+	{.2126, .0722},  // BT.709
+	{.3, .11},       // FCC
+	{.212, .087},    // SMPTE 240M
+	{.2627, .0593}   // BT.2020
+};
+
+const int shift = 13;
+const int round = 1 << (shift - 1);
+
+/// Fixed-point coefficients, with the colour at each pixel being
+/// y * (Y - y_offset) plus the chroma terms, all shifted down by shift
+struct coefficients {
+	int16_t y_offset;
+	int16_t y;
+	int16_t r_v;
+	int16_t g_u;
+	int16_t g_v;
+	int16_t b_u;
+
+	coefficients(agi::ycbcr_matrix matrix, agi::ycbcr_range range) {
+		double kr = matrix_coefficients[(int)matrix][0];
+		double kb = matrix_coefficients[(int)matrix][1];
+		double kg = 1 - kr - kb;
+
+		bool tv = range == agi::ycbcr_range::tv;
+		double y_scale = tv ? 255. / 219. : 1.;
+		double c_scale = tv ? 255. / 112. : 2.;
+
+		auto fixed = [](double v) { return static_cast<int16_t>(std::lround(v * (1 << shift))); };
+		y_offset = tv ? 16 : 0;
+		y = fixed(y_scale);
+		r_v = fixed(c_scale * (1 - kr));
+		g_u = fixed(-c_scale * (1 - kb) * kb / kg);
+		g_v = fixed(-c_scale * (1 - kr) * kr / kg);
+		b_u = fixed(c_scale * (1 - kb));
+	}
+};
+
+inline uint8_t clamp(int v) {
+	return static_cast<uint8_t>(v < 0 ? 0 : v > 255 ? 255 : v);
+}
+
+void convert_row_scalar(uint8_t *dst, const uint8_t *y, const uint8_t *u, const uint8_t *v, int width, coefficients const& c) {
+	for (int x = 0; x < width; ++x) {
+		int luma = c.y * (y[x] - c.y_offset) + round;
+		int cb = u[x / 2] - 128;
+		int cr = v[x / 2] - 128;
+		dst[x * 4 + 0] = clamp((luma + c.b_u * cb) >> shift);
+		dst[x * 4 + 1] = clamp((luma + c.g_u * cb + c.g_v * cr) >> shift);
+		dst[x * 4 + 2] = clamp((luma + c.r_v * cr) >> shift);
+		dst[x * 4 + 3] = 255;
+	}
+}
+
+#ifdef AGI_SIMD_X86
+/// Load four chroma samples and repeat each for two pixels
+inline __m128i load_chroma4(const uint8_t *src) {
+	int32_t bytes;
+	memcpy(&bytes, src, sizeof(bytes));
+	__m128i c = _mm_cvtsi32_si128(bytes);
+	return _mm_unpacklo_epi8(c, c);
+}
+
+inline __m128i pair_epi16(int16_t a, int16_t b) {
+	return _mm_setr_epi16(a, b, a, b, a, b, a, b);
+}
+
+/// Finish a channel for eight pixels from the fixed-point sums for the
+/// first and last four
+inline __m128i finish_sse2(__m128i lo, __m128i hi) {
+	const __m128i rnd = _mm_set1_epi32(round);
+	lo = _mm_srai_epi32(_mm_add_epi32(lo, rnd), shift);
+	hi = _mm_srai_epi32(_mm_add_epi32(hi, rnd), shift);
+	// Saturating to 16 and then 8 bits clamps the same way as the scalar code
+	__m128i packed = _mm_packs_epi32(lo, hi);
+	return _mm_packus_epi16(packed, packed);
+}
+
+/// Interleave eight pixels worth of channels and store them
+inline void store_bgra_sse2(uint8_t *dst, __m128i b, __m128i g, __m128i r) {
+	__m128i bg = _mm_unpacklo_epi8(b, g);
+	__m128i ra = _mm_unpacklo_epi8(r, _mm_set1_epi8(-1));
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(dst), _mm_unpacklo_epi16(bg, ra));
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 16), _mm_unpackhi_epi16(bg, ra));
+}
+
+void convert_row_sse2(uint8_t *dst, const uint8_t *y, const uint8_t *u, const uint8_t *v, int width, coefficients const& c) {
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i y_offset = _mm_set1_epi16(c.y_offset);
+	const __m128i c_offset = _mm_set1_epi16(128);
+	const __m128i yu_b = pair_epi16(c.y, c.b_u);
+	const __m128i yu_g = pair_epi16(c.y, c.g_u);
+	const __m128i v_g = pair_epi16(c.g_v, 0);
+	const __m128i yv_r = pair_epi16(c.y, c.r_v);
+
+	int x = 0;
+	for (; x + 8 <= width; x += 8) {
+		__m128i luma = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(y + x)), zero), y_offset);
+		__m128i cb = _mm_sub_epi16(_mm_unpacklo_epi8(load_chroma4(u + x / 2), zero), c_offset);
+		__m128i cr = _mm_sub_epi16(_mm_unpacklo_epi8(load_chroma4(v + x / 2), zero), c_offset);
+
+		// madd multiplies adjacent pairs of 16-bit values and sums each pair
+		// into 32 bits, so interleave each chroma term with the luma
+		__m128i yu_lo = _mm_unpacklo_epi16(luma, cb), yu_hi = _mm_unpackhi_epi16(luma, cb);
+		__m128i yv_lo = _mm_unpacklo_epi16(luma, cr), yv_hi = _mm_unpackhi_epi16(luma, cr);
+		__m128i v_lo = _mm_unpacklo_epi16(cr, zero), v_hi = _mm_unpackhi_epi16(cr, zero);
+
+		__m128i b = finish_sse2(_mm_madd_epi16(yu_lo, yu_b), _mm_madd_epi16(yu_hi, yu_b));
+		__m128i g = finish_sse2(
+			_mm_add_epi32(_mm_madd_epi16(yu_lo, yu_g), _mm_madd_epi16(v_lo, v_g)),
+			_mm_add_epi32(_mm_madd_epi16(yu_hi, yu_g), _mm_madd_epi16(v_hi, v_g)));
+		__m128i r = finish_sse2(_mm_madd_epi16(yv_lo, yv_r), _mm_madd_epi16(yv_hi, yv_r));
+		store_bgra_sse2(dst + x * 4, b, g, r);
+	}
+
+	convert_row_scalar(dst + x * 4, y + x, u + x / 2, v + x / 2, width - x, c);
+}
+
+AGI_TARGET_AVX2
+inline __m256i pair_epi16_avx2(int16_t a, int16_t b) {
+	return _mm256_setr_epi16(a, b, a, b, a, b, a, b, a, b, a, b, a, b, a, b);
+}
+
+/// Finish a channel for sixteen pixels, returning them as bytes
+AGI_TARGET_AVX2
+inline __m128i finish_avx2(__m256i lo, __m256i hi) {
+	const __m256i rnd = _mm256_set1_epi32(round);
+	lo = _mm256_srai_epi32(_mm256_add_epi32(lo, rnd), shift);
+	hi = _mm256_srai_epi32(_mm256_add_epi32(hi, rnd), shift);
+	// The unpacks and packs both work within each 128-bit lane, so this
+	// puts the pixels back in order
+	__m256i packed = _mm256_packs_epi32(lo, hi);
+	return _mm_packus_epi16(_mm256_castsi256_si128(packed), _mm256_extracti128_si256(packed, 1));
+}
+
+AGI_TARGET_AVX2
+void convert_row_avx2(uint8_t *dst, const uint8_t *y, const uint8_t *u, const uint8_t *v, int width, coefficients const& c) {
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i y_offset = _mm256_set1_epi16(c.y_offset);
+	const __m256i c_offset = _mm256_set1_epi16(128);
+	const __m256i yu_b = pair_epi16_avx2(c.y, c.b_u);
+	const __m256i yu_g = pair_epi16_avx2(c.y, c.g_u);
+	const __m256i v_g = pair_epi16_avx2(c.g_v, 0);
+	const __m256i yv_r = pair_epi16_avx2(c.y, c.r_v);
+
+	int x = 0;
+	for (; x + 16 <= width; x += 16) {
+		__m256i luma = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(y + x))), y_offset);
+		__m128i cb8 = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(u + x / 2));
+		__m128i cr8 = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(v + x / 2));
+		__m256i cb = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_unpacklo_epi8(cb8, cb8)), c_offset);
+		__m256i cr = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_unpacklo_epi8(cr8, cr8)), c_offset);
+
+		__m256i yu_lo = _mm256_unpacklo_epi16(luma, cb), yu_hi = _mm256_unpackhi_epi16(luma, cb);
+		__m256i yv_lo = _mm256_unpacklo_epi16(luma, cr), yv_hi = _mm256_unpackhi_epi16(luma, cr);
+		__m256i v_lo = _mm256_unpacklo_epi16(cr, zero), v_hi = _mm256_unpackhi_epi16(cr, zero);
+
+		__m128i b = finish_avx2(_mm256_madd_epi16(yu_lo, yu_b), _mm256_madd_epi16(yu_hi, yu_b));
+		__m128i g = finish_avx2(
+			_mm256_add_epi32(_mm256_madd_epi16(yu_lo, yu_g), _mm256_madd_epi16(v_lo, v_g)),
+			_mm256_add_epi32(_mm256_madd_epi16(yu_hi, yu_g), _mm256_madd_epi16(v_hi, v_g)));
+		__m128i r = finish_avx2(_mm256_madd_epi16(yv_lo, yv_r), _mm256_madd_epi16(yv_hi, yv_r));
+
+		store_bgra_sse2(dst + x * 4, b, g, r);
+		store_bgra_sse2(dst + x * 4 + 32, _mm_srli_si128(b, 8), _mm_srli_si128(g, 8), _mm_srli_si128(r, 8));
+	}
+
+	convert_row_sse2(dst + x * 4, y + x, u + x / 2, v + x / 2, width - x, c);
+}
+#endif
+}
+
+namespace agi {
+void YUV420ToBGRA(uint8_t *dst, ptrdiff_t dst_stride,
+	const uint8_t *y, ptrdiff_t y_stride,
+	const uint8_t *u, const uint8_t *v, ptrdiff_t uv_stride,
+	int width, int height, ycbcr_matrix matrix, ycbcr_range range,
+	simd::level level)
+{
+	auto convert_row = convert_row_scalar;
+#ifdef AGI_SIMD_X86
+	if (level == simd::level::avx2)
+		convert_row = convert_row_avx2;
+	else if (level == simd::level::sse2)
+		convert_row = convert_row_sse2;
+#endif
+
+	coefficients c(matrix, range);
+	for (int row = 0; row < height; ++row)
+		convert_row(dst + row * dst_stride, y + row * y_stride,
+			u + row / 2 * uv_stride, v + row / 2 * uv_stride, width, c);
+}
+}
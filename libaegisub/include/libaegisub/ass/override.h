@@ -0,0 +1,175 @@
+// Copyright (c) 2014, Thomas Goyne <plorkyeran@aegisub.org>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+
+#pragma once
+
+#include <boost/utility/string_view.hpp>
+#include <cstddef>
+#include <string>
+
+namespace agi { namespace ass {
+/// Semantic type of an override tag parameter
+enum class ParameterClass {
+	NORMAL,
+	ABSOLUTE_SIZE,
+	ABSOLUTE_POS_X,
+	ABSOLUTE_POS_Y,
+	RELATIVE_SIZE_X,
+	RELATIVE_SIZE_Y,
+	RELATIVE_TIME_START,
+	RELATIVE_TIME_END,
+	KARAOKE,
+	DRAWING,
+	ALPHA,
+	COLOR
+};
+
+/// Data type of an override tag parameter
+enum class ParameterType {
+	INT,
+	FLOAT,
+	TEXT,
+	BOOL,
+	BLOCK
+};
+
+/// The most parameters any tag has (\fade)
+const size_t max_parameters = 7;
+
+/// Prototype of a single override tag parameter
+struct ParameterProto {
+	/// Bitmask of the parameter counts for which this parameter is present,
+	/// with bit n - 1 set for n parameters
+	int optional;
+	ParameterType type;
+	ParameterClass classification;
+};
+
+/// Prototype of an override tag
+struct TagProto {
+	/// Name of the tag, with slash
+	const char *name;
+	size_t param_count;
+	ParameterProto params[max_parameters];
+};
+
+/// A parameter of a tag parsed by ParseTag
+struct Parameter {
+	ParameterType type = ParameterType::TEXT;
+	ParameterClass classification = ParameterClass::NORMAL;
+
+	/// Is this parameter actually present?
+	bool omitted = true;
+
+	/// Text of the parameter with surrounding whitespace removed, pointing
+	/// into the string which was parsed
+	boost::string_view value;
+
+	/// Get the value as an integer, parsing alpha values as hex
+	int GetInt(int def = 0) const;
+	double GetDouble(double def = 0) const;
+	bool GetBool(bool def = false) const { return GetInt(def) != 0; }
+};
+
+/// An override tag parsed in place, without copying any of it
+struct Tag {
+	/// The entire tag, starting with the slash
+	boost::string_view text;
+
+	/// Name of the tag, with slash, or the entire text for unknown tags
+	boost::string_view name;
+
+	/// Prototype of the tag, or nullptr if it is not a known tag
+	TagProto const *proto = nullptr;
+
+	/// Number of parameters the tag has, present or not
+	size_t param_count = 0;
+	Parameter params[max_parameters];
+
+	/// How many \t tags this tag is nested in
+	int depth = 0;
+
+	bool IsValid() const { return proto != nullptr; }
+};
+
+/// Find the prototype for a tag
+/// @param text Tag text starting with the slash
+/// @return The first prototype whose name is a prefix of the text, or nullptr
+TagProto const *FindTag(boost::string_view text);
+
+/// Split the parameter part of a tag into trimmed parameters
+/// @param out Storage for the first max_count parameters
+/// @return The total number of parameters, which may exceed max_count
+size_t SplitParameters(boost::string_view text, boost::string_view *out, size_t max_count);
+
+/// Parse a single override tag in place
+/// @param text Tag text starting with the slash, which must outlive tag
+void ParseTag(boost::string_view text, Tag &tag);
+
+/// @class DialogueVisitor
+/// @brief Receives the parts of a dialogue line from VisitDialogue, in order
+///
+/// All of the string references passed point into the visited text.
+class DialogueVisitor {
+public:
+	virtual ~DialogueVisitor() = default;
+
+	/// Text outside of override blocks
+	virtual void VisitText(boost::string_view) { }
+	/// Text outside of override blocks while \p is nonzero
+	virtual void VisitDrawing(boost::string_view, int /* scale */) { }
+	/// Contents of a {} block with no slashes in it
+	virtual void VisitComment(boost::string_view) { }
+	/// A tag in an override block. The tags within a \t are visited right
+	/// after the \t itself, with depth one higher.
+	virtual void VisitTag(Tag const&) { }
+};
+
+/// @brief Visit the blocks and tags of a dialogue line
+///
+/// The line is split exactly as AssDialogue::ParseTags splits it, but no
+/// memory is allocated and nothing is copied.
+void VisitDialogue(boost::string_view text, DialogueVisitor &visitor);
+
+/// @class TextRewriter
+/// @brief Builds a modified copy of a string from replacements of parts of it
+///
+/// Replacements have to be made front to back, which is the order a visitor
+/// sees the parts of a line in, and everything between them is copied
+/// unchanged. Nothing is copied at all if nothing is replaced, and reusing
+/// one output string for many lines avoids allocating for each of them.
+class TextRewriter {
+	boost::string_view source;
+	const char *copied;
+	std::string &out;
+	bool changed = false;
+
+public:
+	/// @param source Text to rewrite
+	/// @param out String to write the result to, which is cleared first
+	TextRewriter(boost::string_view source, std::string &out);
+
+	/// Replace a part of the source, which must not overlap anything
+	/// already replaced or come before it
+	void Replace(boost::string_view part, boost::string_view replacement);
+	void Replace(boost::string_view part, int replacement);
+
+	/// Copy the rest of the source to the output
+	/// @return Was anything replaced? If not, the output is left empty.
+	bool Finish();
+};
+} }
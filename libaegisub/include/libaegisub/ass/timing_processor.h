@@ -0,0 +1,74 @@
+// Copyright (c) 2014, Thomas Goyne <plorkyeran@aegisub.org>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#pragma once
+
+#include <libaegisub/ass/time.h>
+
+#include <vector>
+
+namespace agi {
+namespace vfr { class Framerate; }
+
+namespace ass {
+/// Start and end time of a line being post-processed
+struct TimingLine {
+	Time start;
+	Time end;
+};
+
+/// Settings for TimingPostProcess; each step is skipped when disabled
+struct TimingSettings {
+	/// Milliseconds to move each start earlier by, or 0 to skip
+	int lead_in = 0;
+	/// Milliseconds to move each end later by, or 0 to skip
+	int lead_out = 0;
+
+	/// Join lines which are separated by a small gap or overlap
+	bool adjacent = false;
+	/// Largest gap in milliseconds to close
+	int adjacent_gap = 0;
+	/// Largest overlap in milliseconds to remove
+	int adjacent_overlap = 0;
+	/// Where to put the join between the end of the first line (0) and the
+	/// start of the second (1)
+	double adjacent_bias = 0.5;
+
+	/// Snap starts and ends to nearby keyframes
+	bool snap = false;
+	/// Maximum distance in milliseconds to move a start later
+	int before_start = 0;
+	/// Maximum distance in milliseconds to move a start earlier
+	int after_start = 0;
+	/// Maximum distance in milliseconds to move an end later
+	int before_end = 0;
+	/// Maximum distance in milliseconds to move an end earlier
+	int after_end = 0;
+};
+
+/// @brief Apply lead-in, lead-out, adjacency and keyframe snapping to lines
+/// @param lines     Lines to process, sorted by start time
+/// @param settings  Which steps to run, and their parameters
+/// @param fps       Frame rate used to map times to keyframes; required for snapping
+/// @param keyframes Sorted keyframe frame numbers; snapping is skipped if empty
+///
+/// Lead-in extends each start back to at most the latest end of an earlier
+/// line which doesn't overlap it, and lead-out extends each end forward to
+/// at most the earliest start of a later line which doesn't overlap it, so
+/// neither creates new overlaps. Each step runs in O(n log n) time.
+void TimingPostProcess(std::vector<TimingLine>& lines, TimingSettings const& settings,
+	vfr::Framerate const& fps, std::vector<int> const& keyframes);
+} }
@@ -14,13 +14,29 @@
 //
 // Aegisub Project http://www.aegisub.org/
 
+#include <libaegisub/simd.h>
+
+#include <functional>
 #include <string>
 #include <vector>
 
 namespace agi { namespace ass {
 /// Encode a blob of data, using ASS's nonstandard variant
-std::string UUEncode(const char *begin, const char *end, bool insert_linebreaks=true);
+/// @param level Instruction set to use, which must be supported by the CPU
+std::string UUEncode(const char *begin, const char *end, bool insert_linebreaks=true,
+	simd::level level = simd::detect());
+
+/// @brief Encode a blob of data without building the entire encoded string
+/// @param write Called with each piece of the encoded data in order
+///
+/// Pieces only end between lines, and put together are identical to what
+/// the string version returns.
+void UUEncode(const char *begin, const char *end,
+	std::function<void (const char *, size_t)> const& write,
+	bool insert_linebreaks=true, simd::level level = simd::detect());
 
 /// Decode an ASS uuencoded string
-std::vector<char> UUDecode(const char *begin, const char *end);
+/// @param level Instruction set to use, which must be supported by the CPU
+std::vector<char> UUDecode(const char *begin, const char *end,
+	simd::level level = simd::detect());
 } }
@@ -0,0 +1,113 @@
+// Copyright (c) 2014, Thomas Goyne <plorkyeran@aegisub.org>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#pragma once
+
+#include <libaegisub/fs_fwd.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace agi {
+/// Summary of a run of 16-bit mono samples
+struct AudioPeak {
+	/// Most negative sample in the run
+	int16_t min = 0;
+	/// Most positive sample in the run
+	int16_t max = 0;
+	/// Sum of the negative samples divided by the length of the run
+	int16_t avg_min = 0;
+	/// Sum of the positive samples divided by the length of the run
+	int16_t avg_max = 0;
+};
+
+/// @class AudioPeakIndex
+/// @brief Multi-resolution min/max/average summary of a 16-bit mono track
+///
+/// Level zero has one entry per BaseRun samples and each following level
+/// merges Fanout entries of the level below it, so any range of samples can
+/// be summarised by reading a bounded number of entries regardless of its
+/// length.
+///
+/// The index is filled in order by a single writer (normally the decoder
+/// thread of a caching audio provider) while any number of readers query the
+/// part which has already been indexed.
+class AudioPeakIndex {
+public:
+	/// Number of samples summarised by each entry in the finest level
+	static const int BaseRun = 256;
+	/// Number of entries of each level merged into one entry of the next
+	static const int Fanout = 4;
+
+private:
+	int64_t num_samples;
+	std::vector<std::vector<AudioPeak>> levels;
+	/// Number of entries written so far to each level
+	std::vector<size_t> filled;
+	/// Samples for which every covering entry in every level is available
+	std::atomic<int64_t> indexed_samples{0};
+
+	/// Accumulator for the level zero entry currently being built
+	int pending_count = 0;
+	int16_t pending_min = 0, pending_max = 0;
+	int64_t pending_neg = 0, pending_pos = 0;
+
+	void PushEntry(size_t level, AudioPeak const& peak);
+	void FlushPending();
+	void Publish();
+
+public:
+	/// @brief Create an empty index
+	/// @param num_samples Total number of samples which will be indexed
+	AudioPeakIndex(int64_t num_samples);
+
+	/// @brief Add the next run of samples
+	/// @param buf   Samples to add
+	/// @param count Number of samples in buf
+	///
+	/// Samples must be added in order starting from sample zero.
+	void AddSamples(const int16_t *buf, int64_t count);
+
+	/// Number of samples from the start of the track which can be queried
+	int64_t GetIndexedSamples() const { return indexed_samples; }
+	int64_t GetNumSamples() const { return num_samples; }
+	bool IsComplete() const { return indexed_samples == num_samples; }
+
+	/// @brief Summarise a range of samples
+	/// @param start First sample of the range
+	/// @param count Length of the range in samples
+	/// @param[out] out Summary of the range
+	/// @return Whether the range could be answered from the index
+	///
+	/// Ranges shorter than Fanout * BaseRun samples or which extend beyond
+	/// the indexed part of the track are not answered, as the rounding to
+	/// entry boundaries would be too coarse or the data isn't there yet.
+	bool GetPeak(int64_t start, int64_t count, AudioPeak &out) const;
+
+	/// @brief Write a complete index to disk
+	/// @param filename File to write to
+	/// @param sample_rate Sample rate of the indexed track, used to validate the file when loading
+	/// @param source Identity of the audio which was indexed, used to validate the file when loading
+	void Save(fs::path const& filename, int sample_rate, std::string const& source) const;
+
+	/// @brief Load an index previously written with Save
+	/// @return The index, or nullptr if the file does not exist or does not match the track
+	static std::unique_ptr<AudioPeakIndex> Load(fs::path const& filename, int64_t num_samples, int sample_rate, std::string const& source);
+};
+}
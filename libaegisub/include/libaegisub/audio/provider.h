@@ -20,16 +20,20 @@
 #include <libaegisub/fs_fwd.h>
 
 #include <atomic>
+#include <memory>
+#include <string>
 #include <vector>
 
 namespace agi {
+class AudioPeakIndex;
+
 class AudioProvider {
 protected:
 	int channels = 0;
 	/// Total number of samples per channel
 	int64_t num_samples = 0;
 	/// Samples per channel which have been decoded and can be fetched with FillBuffer
-	/// Only applicable for the cache providers
+	/// Only applicable for the cache providers, which may not decode in order
 	std::atomic<int64_t> decoded_samples{0};
 	int sample_rate = 0;
 	int bytes_per_sample = 0;
@@ -41,6 +45,11 @@ protected:
 
 	void ZeroFill(void *buf, int64_t count) const;
 
+	/// Convert samples in this provider's format to 16-bit mono
+	void ConvertToInt16Mono(void *src, int16_t *dst, int64_t count, bool asAmplitude=false) const;
+	/// Add a run of decoded samples in this provider's format to a peak index
+	void AddToPeakIndex(AudioPeakIndex &index, void *buf, int64_t count) const;
+
 public:
 	virtual ~AudioProvider() = default;
 
@@ -58,6 +67,22 @@ public:
 
 	/// Does this provider benefit from external caching?
 	virtual bool NeedsCache() const { return false; }
+
+	/// Have all of the samples in the given range been decoded?
+	/// Providers which decode out of order need to override this
+	virtual bool IsDecoded(int64_t start, int64_t count) const { return start + count <= decoded_samples; }
+
+	/// Ask a provider which decodes in the background to decode the samples
+	/// from start onwards next, as they're about to be used
+	virtual void Prioritize(int64_t /*start*/) const { }
+
+	/// @brief Open a second instance of this provider
+	/// @return A provider with the same audio which can be used in parallel
+	///         with this one, or nullptr if that isn't supported
+	virtual std::unique_ptr<AudioProvider> Duplicate() const { return nullptr; }
+
+	/// Get the peak index for the decoded audio, if this provider builds one
+	virtual AudioPeakIndex const* GetPeakIndex() const { return nullptr; }
 };
 
 /// Helper base class for an audio provider which wraps another provider
@@ -93,8 +118,24 @@ std::unique_ptr<AudioProvider> CreatePCMAudioProvider(fs::path const& filename,
 
 std::unique_ptr<AudioProvider> CreateConvertAudioProvider(std::unique_ptr<AudioProvider> source_provider);
 std::unique_ptr<AudioProvider> CreateLockAudioProvider(std::unique_ptr<AudioProvider> source_provider);
-std::unique_ptr<AudioProvider> CreateHDAudioProvider(std::unique_ptr<AudioProvider> source_provider, fs::path const& dir);
-std::unique_ptr<AudioProvider> CreateRAMAudioProvider(std::unique_ptr<AudioProvider> source_provider);
+/// @param save_to If not empty, where to save the audio with SaveDecodedAudio once it has all been decoded
+std::unique_ptr<AudioProvider> CreateHDAudioProvider(std::unique_ptr<AudioProvider> source_provider, fs::path const& dir, fs::path const& save_to);
+/// @param save_to If not empty, where to save the audio with SaveDecodedAudio once it has all been decoded
+std::unique_ptr<AudioProvider> CreateRAMAudioProvider(std::unique_ptr<AudioProvider> source_provider, fs::path const& save_to);
+
+/// @brief Save all of a provider's audio in a form which can be memory mapped by a later session
+/// @param provider  Provider to save. All of its audio should have been decoded.
+/// @param filename  File to write. The peak index, if any, is written alongside it with the extension .peaks
+/// @param cancelled Abandon the file if this becomes true before it is finished
+/// @return Whether the file was written
+bool SaveDecodedAudio(AudioProvider const& provider, fs::path const& filename, std::atomic<bool> const& cancelled);
+/// Does filename hold audio saved with SaveDecodedAudio from a provider with source's format and length?
+bool HasSavedAudio(AudioProvider const& source, fs::path const& filename);
+/// @brief Open audio saved with SaveDecodedAudio in place of decoding source
+///
+/// The source provider is only used for its format and is released once
+/// the file has been checked against it.
+std::unique_ptr<AudioProvider> CreateSavedAudioProvider(std::unique_ptr<AudioProvider> source_provider, fs::path const& filename);
 
 void SaveAudioClip(AudioProvider const& provider, fs::path const& path, int start_time, int end_time);
 }
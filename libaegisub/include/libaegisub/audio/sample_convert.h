@@ -0,0 +1,42 @@
+// Copyright (c) 2014, Thomas Goyne <plorkyeran@aegisub.org>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+
+#pragma once
+
+#include <libaegisub/simd.h>
+
+#include <cstdint>
+
+namespace agi {
+/// @brief Convert interleaved audio samples to 16-bit mono
+/// @param src              Samples to convert
+/// @param dst              Buffer for count converted samples
+/// @param count            Number of samples per channel to convert
+/// @param bytes_per_sample Size of each sample of each channel in src
+/// @param float_samples    src holds floats or doubles rather than integers
+/// @param channels         Number of interleaved channels in src
+/// @param level            Instruction set to use, which must be supported by the CPU
+///
+/// 8-bit samples are unsigned with a bias of 128 and all other integer
+/// sizes are signed, with the 16 most significant bits of each used.
+/// Floating point samples are scaled by 32768 and clamped to the range of
+/// int16_t, rounding towards zero. The channels are then averaged, again
+/// rounding towards zero. All implementations give identical results.
+void ConvertSamplesToInt16Mono(const void *src, int16_t *dst, int64_t count,
+	int bytes_per_sample, bool float_samples, int channels,
+	simd::level level = simd::detect());
+}
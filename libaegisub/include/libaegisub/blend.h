@@ -0,0 +1,40 @@
+// Copyright (c) 2014, Thomas Goyne <plorkyeran@aegisub.org>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#pragma once
+
+#include <libaegisub/simd.h>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace agi {
+/// @brief Composite a single-colour coverage mask onto a BGRA image
+/// @param dst         First destination pixel of the first row
+/// @param dst_stride  Bytes from one destination row to the next; negative for bottom-up images
+/// @param mask        First coverage value of the first row
+/// @param mask_stride Bytes from one mask row to the next
+/// @param width       Width of the mask in pixels
+/// @param height      Height of the mask in pixels
+/// @param color       Colour packed as 0xRRGGBBAA, where AA is transparency as in ASS_Image
+/// @param level       Instruction set to use, which must be supported by the CPU
+///
+/// Each destination pixel becomes (k * colour + (255 - k) * pixel) / 255,
+/// where k = coverage * (255 - AA) / 255 and both divisions truncate, and
+/// its alpha channel is cleared. All implementations give identical results.
+void BlendMask(uint8_t *dst, ptrdiff_t dst_stride, const uint8_t *mask, ptrdiff_t mask_stride,
+	int width, int height, uint32_t color, simd::level level = simd::detect());
+}
@@ -0,0 +1,54 @@
+// Copyright (c) 2014, Thomas Goyne <plorkyeran@aegisub.org>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace agi {
+/// @class CodepointSet
+/// @brief A set of Unicode codepoints stored as a bitset
+///
+/// The bitset only grows as far as the highest codepoint in it, so the set
+/// for Latin text is a few words, and adding a codepoint is always constant
+/// time rather than needing the set to be sorted.
+class CodepointSet {
+	std::vector<uint64_t> bits;
+
+public:
+	/// Add a codepoint to the set. Negative values are ignored.
+	void insert(int32_t c);
+
+	/// Add a block of ASS dialogue text, as the characters which need glyphs
+	/// to render it. \\N and \\n are skipped, \\h is a non-breaking space, and
+	/// invalid UTF-8 is replaced by U+FFFD.
+	void insert_text(const char *begin, const char *end);
+	void insert_text(std::string const& text) { insert_text(text.data(), text.data() + text.size()); }
+
+	/// Add every codepoint in another set
+	CodepointSet& operator|=(CodepointSet const& other);
+
+	bool contains(int32_t c) const;
+	bool empty() const;
+	size_t size() const;
+
+	/// All of the codepoints in the set, in ascending order
+	std::vector<int> codepoints() const;
+};
+}
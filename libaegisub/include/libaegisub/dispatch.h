@@ -23,12 +23,18 @@ namespace agi {
 
 		class Queue {
 			virtual void DoInvoke(Thunk thunk)=0;
+			virtual void DoInvokeIdle(Thunk thunk) { DoInvoke(thunk); }
 		public:
 			virtual ~Queue() { }
 
 			/// Invoke the thunk on this processing queue, returning immediately
 			void Async(Thunk thunk);
 
+			/// Invoke the thunk on this processing queue once nothing queued
+			/// with Async or Sync is waiting to run, returning immediately.
+			/// Only serial queues defer the thunk; others run it as Async.
+			void AsyncIdle(Thunk thunk);
+
 			/// Invoke the thunk on this processing queue, returning only when
 			/// it's complete
 			void Sync(Thunk thunk);
@@ -46,5 +52,10 @@ namespace agi {
 
 		/// Create a new serial queue
 		std::unique_ptr<Queue> Create();
+
+		/// Call fn(i) for each i in [0, count), spread over the background
+		/// queue and the calling thread, returning once every call has
+		/// finished. The first exception thrown by fn is then rethrown.
+		void ParallelFor(size_t count, std::function<void (size_t)> const& fn);
 	}
 }
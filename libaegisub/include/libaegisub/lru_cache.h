@@ -0,0 +1,147 @@
+// Copyright (c) 2014, Thomas Goyne <plorkyeran@aegisub.org>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#pragma once
+
+#include <boost/intrusive/list.hpp>
+#include <cstddef>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+
+namespace agi {
+/// @class LRUCache
+/// @brief Size-limited cache which evicts the least recently used entries
+/// @tparam Value Type of the cached values, which must be default
+///               constructible and movable
+///
+/// The size limit is a hard limit: older entries are evicted before a new
+/// entry is inserted if it would otherwise be exceeded.
+template<typename Key, typename Value>
+class LRUCache {
+public:
+	/// Counters describing how well the cache is working
+	struct Stats {
+		/// Lookups which found an entry
+		size_t hits = 0;
+		/// Lookups which didn't find an entry
+		size_t misses = 0;
+		/// Entries evicted to make room for newer ones
+		size_t evictions = 0;
+		/// Number of entries currently cached
+		size_t entries = 0;
+		/// Total size of the cached entries
+		size_t size = 0;
+		/// Maximum total size of the cached entries
+		size_t max_size = 0;
+	};
+
+private:
+	struct Entry final : public boost::intrusive::list_base_hook<> {
+		Key key;
+		Value value;
+		/// Size counted against the limit when the entry was inserted
+		size_t size = 0;
+
+		Entry(Key const& key) : key(key) { }
+		Entry(Entry const&) = delete;
+	};
+
+	std::unordered_map<Key, Entry> entries;
+	/// Cached entries with the most recently used ones at the front
+	boost::intrusive::list<Entry, boost::intrusive::constant_time_size<false>> lru;
+	Stats stats;
+
+	/// Evict the least recently used entry, returning its value for reuse
+	Value Evict() {
+		auto& oldest = lru.back();
+		lru.pop_back();
+		stats.size -= oldest.size;
+		Value value = std::move(oldest.value);
+		entries.erase(oldest.key);
+		++stats.evictions;
+		return value;
+	}
+
+public:
+	/// @param max_size Maximum total size of the cached entries
+	LRUCache(size_t max_size) { stats.max_size = max_size; }
+
+	LRUCache(LRUCache const&) = delete;
+	LRUCache& operator=(LRUCache const&) = delete;
+
+	/// @brief Look up an entry, making it the most recently used one
+	/// @return The cached value, or nullptr if there isn't one
+	///
+	/// Counts as a hit or a miss.
+	Value *Find(Key const& key) {
+		auto it = entries.find(key);
+		if (it == entries.end()) {
+			++stats.misses;
+			return nullptr;
+		}
+
+		++stats.hits;
+		auto& entry = it->second;
+		lru.splice(lru.begin(), lru, lru.iterator_to(entry));
+		return &entry.value;
+	}
+
+	/// Check if there is an entry for key without counting it as a use
+	bool Contains(Key const& key) const { return entries.count(key) != 0; }
+
+	/// @brief Add an entry as the most recently used one
+	/// @param key  Key of the new entry, which must not already be cached
+	/// @param size Expected size of the entry, which room is made for first
+	/// @param fill Called with the new value to fill it in, returning the
+	///             size to count the entry as. The value passed is that of
+	///             the last entry evicted to make room, if any, so that its
+	///             buffers can be reused.
+	/// @return false if the entry is too big to cache at all
+	template<typename Fill>
+	bool Insert(Key const& key, size_t size, Fill&& fill) {
+		if (size > stats.max_size) return false;
+
+		Value recycled{};
+		while (!lru.empty() && stats.size + size > stats.max_size)
+			recycled = Evict();
+
+		auto& entry = entries.emplace(std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple(key)).first->second;
+		entry.value = std::move(recycled);
+		entry.size = fill(entry.value);
+		lru.push_front(entry);
+		stats.size += entry.size;
+
+		// A reused buffer may have been larger than needed
+		while (stats.size > stats.max_size && &lru.back() != &entry)
+			Evict();
+		return true;
+	}
+
+	/// Remove every entry
+	void Clear() {
+		lru.clear();
+		entries.clear();
+		stats.size = 0;
+	}
+
+	Stats GetStats() const {
+		Stats ret = stats;
+		ret.entries = entries.size();
+		return ret;
+	}
+};
+}
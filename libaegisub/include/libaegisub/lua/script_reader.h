@@ -23,6 +23,9 @@ struct lua_State;
 namespace agi { namespace lua {
 	/// Load a Lua or Moonscript file at the given path
 	bool LoadFile(lua_State *L, agi::fs::path const& filename);
+	/// Make LoadFile cache the compiled bytecode of the files it loads in the
+	/// given directory, and use the cached copy when the source is unchanged
+	void EnableBytecodeCache(lua_State *L, agi::fs::path const& cache_dir);
 	/// Install our module loader and add include_path to the module search
 	/// path of the given lua state
 	bool Install(lua_State *L, std::vector<fs::path> const& include_path);
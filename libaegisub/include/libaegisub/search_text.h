@@ -0,0 +1,74 @@
+// Copyright (c) 2014, Thomas Goyne <plorkyeran@aegisub.org>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace agi {
+/// @class SearchText
+/// @brief A string prepared for repeated searching
+///
+/// Override blocks can be stripped and the text case folded once up front,
+/// so that each search is a plain substring search, with ranges found in the
+/// prepared text mapped back to the original string afterwards.
+///
+/// When nothing is stripped or folded no copy is made and Text() refers to
+/// the source string, which must then outlive this object.
+class SearchText {
+	/// A piece of the prepared text and the part of the source it came from
+	struct Span {
+		size_t text;
+		size_t source;
+		size_t text_len;
+		size_t source_len;
+		/// Maps byte for byte. If false, the span is a single character
+		/// which was folded to something else and only its ends map to the
+		/// source.
+		bool exact;
+	};
+
+	std::string text;
+	const std::string *source_text = nullptr;
+	std::vector<Span> spans;
+	size_t source_size;
+
+public:
+	/// @brief Prepare a string for searching
+	/// @param source     String to search
+	/// @param strip_tags Remove {override blocks}
+	/// @param fold_case  Case fold the text, for case-insensitive searches
+	SearchText(std::string const& source, bool strip_tags, bool fold_case);
+
+	/// The text to search in
+	std::string const& Text() const { return source_text ? *source_text : text; }
+
+	/// @brief Convert a position in the source to one in Text()
+	///
+	/// Positions within stripped blocks or inside a folded character map to
+	/// the next position in the text.
+	size_t FromSource(size_t pos) const;
+
+	/// @brief Convert a range in Text() to the matching range in the source
+	/// @return false if the range starts or ends inside a character which
+	///         was folded to more than one character
+	///
+	/// Blocks within the range are included in it, and blocks immediately
+	/// before or after it are not.
+	bool ToSource(size_t& start, size_t& end) const;
+};
+}
@@ -0,0 +1,43 @@
+// Copyright (c) 2014, Thomas Goyne <plorkyeran@aegisub.org>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#pragma once
+
+#if defined(__x86_64__) || defined(_M_X64)
+/// SSE2 is part of the x86-64 baseline, so kernels using it need no runtime
+/// check beyond this, while AVX2 kernels must be selected at runtime
+#define AGI_SIMD_X86 1
+#endif
+
+#if defined(AGI_SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+/// Allow a function to use AVX2 intrinsics without building the entire
+/// file with -mavx2 (MSVC allows this without any annotation)
+#define AGI_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define AGI_TARGET_AVX2
+#endif
+
+namespace agi { namespace simd {
+/// Instruction sets which kernels may have implementations for
+enum class level {
+	none,
+	sse2,
+	avx2
+};
+
+/// Best instruction set supported by both the build and the running CPU
+level detect();
+} }
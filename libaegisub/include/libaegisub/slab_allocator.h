@@ -0,0 +1,99 @@
+// Copyright (c) 2014, Thomas Goyne <plorkyeran@aegisub.org>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+
+namespace agi {
+/// @class SlabAllocator
+/// @brief Allocator for large numbers of objects of a single size
+///
+/// Blocks are carved out of aligned slabs of SlabSize bytes, so allocating
+/// many objects touches the heap once per slab rather than once per object
+/// and objects allocated together end up next to each other in memory.
+/// Slabs are returned to the heap once every block in them has been freed,
+/// except for one empty slab which is kept around to avoid thrashing when
+/// a single object is repeatedly allocated and freed.
+///
+/// The slabs are split between several independently locked shards and
+/// each thread allocates from its own shard, so threads allocating at the
+/// same time (such as when parsing a file in parallel) don't all contend
+/// on a single lock. Blocks may be freed from any thread, not just the one
+/// which allocated them; they go back to the shard they came from.
+class SlabAllocator {
+	struct Slab;
+	struct Shard;
+
+	size_t block_size;
+	size_t blocks_per_slab;
+	size_t shard_count;
+	std::unique_ptr<Shard[]> shards;
+
+	Slab *NewSlab(Shard& shard);
+	void FreeSlab(Slab *slab);
+
+public:
+	/// Size of each slab in bytes; also their alignment
+	static const size_t SlabSize = 64 * 1024;
+
+	/// @brief Constructor
+	/// @param block_size Size of the objects to allocate
+	SlabAllocator(size_t block_size);
+	~SlabAllocator();
+
+	SlabAllocator(SlabAllocator const&) = delete;
+	SlabAllocator& operator=(SlabAllocator const&) = delete;
+
+	/// Allocate a block, throwing std::bad_alloc on failure
+	void *Allocate();
+	/// Free a block returned by Allocate
+	void Free(void *ptr);
+
+	/// Number of slabs currently held by all shards
+	size_t SlabCount();
+};
+
+/// @class SlabAllocated
+/// @brief Base class which makes new and delete of T use a SlabAllocator
+///
+/// The allocator is shared by every instance of T and is never destroyed,
+/// so objects may safely outlive main().
+template<typename T>
+class SlabAllocated {
+	static SlabAllocator& Allocator() {
+		static auto allocator = new SlabAllocator(sizeof(T));
+		return *allocator;
+	}
+
+public:
+	static void *operator new(size_t size) {
+		return size == sizeof(T) ? Allocator().Allocate() : ::operator new(size);
+	}
+
+	static void operator delete(void *ptr, size_t size) {
+		if (size == sizeof(T))
+			Allocator().Free(ptr);
+		else
+			::operator delete(ptr);
+	}
+
+	/// Number of slabs currently used for objects of type T
+	static size_t SlabCount() { return Allocator().SlabCount(); }
+};
+}
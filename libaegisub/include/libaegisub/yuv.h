@@ -0,0 +1,49 @@
+// Copyright (c) 2014, Thomas Goyne <plorkyeran@aegisub.org>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+
+#pragma once
+
+#include <libaegisub/simd.h>
+#include <libaegisub/ycbcr_conv.h>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace agi {
+/// @brief Convert a planar 8-bit YCbCr 4:2:0 image to BGRA
+/// @param dst        First destination pixel of the first row
+/// @param dst_stride Bytes from one destination row to the next
+/// @param y          First luma sample of the first row
+/// @param y_stride   Bytes from one luma row to the next
+/// @param u          First Cb sample of the first row
+/// @param v          First Cr sample of the first row
+/// @param uv_stride  Bytes from one chroma row to the next
+/// @param width      Width of the image in pixels
+/// @param height     Height of the image in pixels
+/// @param matrix     Matrix the image was encoded with
+/// @param range      Range the image was encoded with
+/// @param level      Instruction set to use, which must be supported by the CPU
+///
+/// Each chroma sample covers two by two luma samples, rounding up for odd
+/// sizes, and the alpha channel is set to 255. The conversion uses 13-bit
+/// fixed-point coefficients, and all implementations give identical results.
+void YUV420ToBGRA(uint8_t *dst, ptrdiff_t dst_stride,
+	const uint8_t *y, ptrdiff_t y_stride,
+	const uint8_t *u, const uint8_t *v, ptrdiff_t uv_stride,
+	int width, int height, ycbcr_matrix matrix, ycbcr_range range,
+	simd::level level = simd::detect());
+}
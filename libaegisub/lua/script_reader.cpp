@@ -17,12 +17,255 @@
 #include "libaegisub/lua/script_reader.h"
 
 #include "libaegisub/file_mapping.h"
+#include "libaegisub/io.h"
 #include "libaegisub/log.h"
 #include "libaegisub/lua/utils.h"
 #include "libaegisub/split.h"
 
 #include <boost/algorithm/string/replace.hpp>
+#include <boost/crc.hpp>
+#include <cstring>
 #include <lauxlib.h>
+#include <limits>
+#include <luajit.h>
+
+namespace {
+	using namespace agi::lua;
+
+	typedef boost::crc_optimal<64, 0x42F0E1EBA9EA3693ULL, ~0ULL, ~0ULL, true, true> crc_64_type;
+
+	uint64_t checksum(const char *data, size_t size) {
+		crc_64_type crc;
+		crc.process_bytes(data, size);
+		return crc.checksum();
+	}
+
+	/// A moonscript line table as (lua line, character offset) pairs
+	typedef std::vector<std::pair<int, int>> LineTable;
+
+	/// Everything which has to match for a cached chunk to be usable in
+	/// place of compiling the source. The chunk name is included as it's
+	/// embedded in the bytecode and used for error messages.
+	std::string cache_header(std::string const& chunkname, const char *source, size_t size, std::string const& compiler) {
+		return "Aegisub Lua bytecode 2\n" LUAJIT_VERSION " " + std::to_string(sizeof(void *) * 8) + "\n"
+			+ compiler + "\n"
+			+ chunkname + "\n"
+			+ std::to_string(size) + " " + std::to_string(checksum(source, size)) + "\n";
+	}
+
+	/// Identify the MoonScript compiler which a .moon file would be compiled
+	/// with. Loading the compiler to ask for its version would defeat the
+	/// point of the cache, so instead this is the size and checksum of the
+	/// moonscript module which require would load, which changes along with
+	/// the compiler's version.
+	std::string moonscript_version(lua_State *L) {
+		lua_getfield(L, LUA_REGISTRYINDEX, "moonscript version");
+		if (lua_isstring(L, -1)) {
+			auto version = get_string(L, -1);
+			lua_pop(L, 1);
+			return version;
+		}
+		lua_pop(L, 1);
+
+		lua_getglobal(L, "package");
+		lua_getfield(L, -1, "path");
+		auto package_paths = get_string(L, -1);
+		lua_pop(L, 2);
+
+		std::string version = "MoonScript not found";
+		for (auto tok : agi::Split(package_paths, ';')) {
+			std::string filename;
+			boost::replace_all_copy(std::back_inserter(filename), tok, "?", "moonscript");
+			if (!agi::fs::FileExists(filename))
+				continue;
+
+			try {
+				agi::read_file_mapping file(filename);
+				auto size = static_cast<size_t>(file.size());
+				version = "MoonScript " + std::to_string(size) + " " + std::to_string(checksum(file.read(), size));
+			}
+			catch (agi::Exception const& e) {
+				LOG_D("auto4/lua/cache") << "Error reading " << filename << ": " << e.GetMessage();
+			}
+			break;
+		}
+
+		push_value(L, version);
+		lua_setfield(L, LUA_REGISTRYINDEX, "moonscript version");
+		return version;
+	}
+
+	/// Get the path to the cache entry for a file, or an empty path if the
+	/// cache isn't enabled for this state. There's one entry per source
+	/// file, so editing a script replaces its entry rather than adding one.
+	agi::fs::path cache_path(lua_State *L, std::string const& chunkname) {
+		agi::fs::path path;
+		lua_getfield(L, LUA_REGISTRYINDEX, "bytecode cache");
+		if (lua_isstring(L, -1))
+			path = agi::fs::path(lua_tostring(L, -1))/(std::to_string(checksum(chunkname.data(), chunkname.size())) + ".luac");
+		lua_pop(L, 1);
+		return path;
+	}
+
+	bool parse_int(const char *&pos, const char *end, char terminator, int& out) {
+		bool negative = pos != end && *pos == '-';
+		if (negative) ++pos;
+		const char *digits = pos;
+		long value = 0;
+		for (; pos != end && *pos >= '0' && *pos <= '9'; ++pos)
+			value = value * 10 + (*pos - '0');
+		if (pos == digits || pos == end || *pos != terminator || value > std::numeric_limits<int>::max())
+			return false;
+		++pos;
+		out = static_cast<int>(negative ? -value : value);
+		return true;
+	}
+
+	void set_line_table(lua_State *L, std::string const& chunkname, LineTable const& line_table) {
+		lua_createtable(L, 0, line_table.size());
+		for (auto const& entry : line_table) {
+			push_value(L, entry.second);
+			lua_rawseti(L, -2, entry.first);
+		}
+		lua_setfield(L, LUA_REGISTRYINDEX, ("moonscript line table: " + chunkname).c_str());
+	}
+
+	/// Load the chunk from the cache entry at path, leaving the function on
+	/// the stack. Returns false and leaves the stack unchanged if the entry
+	/// is missing, stale or corrupt.
+	bool load_cached(lua_State *L, agi::fs::path const& path, std::string const& header, std::string const& chunkname, bool is_moon) {
+		if (path.empty() || !agi::fs::FileExists(path)) return false;
+
+		try {
+			agi::read_file_mapping file(path);
+			const char *pos = file.read();
+			const char *end = pos + file.size();
+			if (static_cast<size_t>(end - pos) < header.size() || memcmp(pos, header.data(), header.size()))
+				return false;
+			pos += header.size();
+
+			int count;
+			if (!parse_int(pos, end, '\n', count) || count < 0)
+				return false;
+			LineTable line_table(count);
+			for (auto& entry : line_table) {
+				if (!parse_int(pos, end, ' ', entry.first) || !parse_int(pos, end, '\n', entry.second))
+					return false;
+			}
+
+			if (luaL_loadbuffer(L, pos, end - pos, chunkname.c_str())) {
+				lua_pop(L, 1);
+				return false;
+			}
+
+			if (is_moon)
+				set_line_table(L, chunkname, line_table);
+			return true;
+		}
+		catch (agi::Exception const& e) {
+			LOG_D("auto4/lua/cache") << "Error reading " << path << ": " << e.GetMessage();
+			return false;
+		}
+	}
+
+	int append_chunk(lua_State *, const void *data, size_t size, void *ud) {
+		static_cast<std::string *>(ud)->append(static_cast<const char *>(data), size);
+		return 0;
+	}
+
+	/// Write the function on the top of the stack to the cache
+	void save_cached(lua_State *L, agi::fs::path const& path, std::string const& header, LineTable const& line_table) {
+		std::string bytecode;
+		if (lua_dump(L, append_chunk, &bytecode))
+			return;
+
+		try {
+			agi::fs::CreateDirectory(path.parent_path());
+			agi::io::Save file(path, true);
+			auto& out = file.Get();
+			out << header << line_table.size() << '\n';
+			for (auto const& entry : line_table)
+				out << entry.first << ' ' << entry.second << '\n';
+			out.write(bytecode.data(), bytecode.size());
+		}
+		catch (agi::Exception const& e) {
+			// Another script may be writing the same entry, so failing is
+			// expected and not a problem
+			LOG_D("auto4/lua/cache") << "Error writing " << path << ": " << e.GetMessage();
+		}
+	}
+
+	/// Push moonscript's loadstring function and its table of line tables,
+	/// loading the compiler the first time it's needed. This is done
+	/// lazily as it's slow to load and isn't needed at all when every
+	/// MoonScript file used is in the bytecode cache.
+	bool push_moonscript(lua_State *L) {
+		lua_getfield(L, LUA_REGISTRYINDEX, "moonscript");
+		if (!lua_isnil(L, -1)) {
+			lua_getfield(L, LUA_REGISTRYINDEX, "moonscript line tables");
+			return true;
+		}
+		lua_pop(L, 1);
+
+		if (luaL_loadstring(L, "return require('moonscript').loadstring, require('moonscript.line_tables')") || lua_pcall(L, 0, 2, 0))
+			return false; // leaves error message
+		lua_pushvalue(L, -2);
+		lua_setfield(L, LUA_REGISTRYINDEX, "moonscript");
+		lua_pushvalue(L, -1);
+		lua_setfield(L, LUA_REGISTRYINDEX, "moonscript line tables");
+		return true;
+	}
+
+	/// Compile MoonScript source, leaving the function or an error message
+	/// on the stack. On success line_table is set to the mapping from
+	/// lines in the generated Lua to offsets in the MoonScript source.
+	bool compile_moonscript(lua_State *L, const char *buff, size_t size, std::string const& chunkname, LineTable& line_table) {
+		if (!push_moonscript(L))
+			return false;
+		int line_tables = lua_gettop(L);
+
+		// It might be nice to have a dedicated lua state for compiling
+		// MoonScript to Lua
+		lua_pushvalue(L, line_tables - 1);
+		lua_pushlstring(L, buff, size);
+		push_value(L, chunkname);
+		try
+		{
+			if (lua_pcall(L, 2, 2, 0)) {
+				lua_replace(L, line_tables - 1);
+				lua_settop(L, line_tables - 1);
+				return false; // Leaves error message on stack
+			}
+		}
+		catch (const std::exception& except)
+		{
+			LOG_E("auto4/lua/moon") << except.what();
+		}
+
+		// loadstring returns nil, error on error or a function on success
+		if (lua_isnil(L, -2)) {
+			lua_replace(L, line_tables - 1);
+			lua_settop(L, line_tables - 1);
+			return false;
+		}
+		lua_pop(L, 1); // Remove the extra nil
+
+		lua_getfield(L, line_tables, chunkname.c_str());
+		if (lua_istable(L, -1)) {
+			lua_for_each(L, [&] {
+				if (lua_isnumber(L, -2) && lua_isnumber(L, -1))
+					line_table.emplace_back(lua_tointeger(L, -2), lua_tointeger(L, -1));
+			});
+		}
+		else
+			lua_pop(L, 1);
+
+		// Leave just the function on the stack
+		lua_replace(L, line_tables - 1);
+		lua_settop(L, line_tables - 1);
+		return true;
+	}
+}
 
 namespace agi { namespace lua {
 	bool LoadFile(lua_State *L, agi::fs::path const& raw_filename) {
@@ -44,42 +287,45 @@ namespace agi { namespace lua {
 			size -= 3;
 		}
 
-		if (!agi::fs::HasExtension(filename, "moon"))
-			return luaL_loadbuffer(L, buff, size, filename.string().c_str()) == 0;
-
-		// We have a MoonScript file, so we need to load it with that
-		// It might be nice to have a dedicated lua state for compiling
-		// MoonScript to Lua
-		lua_getfield(L, LUA_REGISTRYINDEX, "moonscript");
-
-		// Save the text we'll be loading for the line number rewriting in the
-		// error handling
-		lua_pushlstring(L, buff, size);
-		lua_pushvalue(L, -1);
-		lua_setfield(L, LUA_REGISTRYINDEX, ("raw moonscript: " + filename.string()).c_str());
+		auto chunkname = filename.string();
+		bool is_moon = agi::fs::HasExtension(filename, "moon");
 
-		push_value(L, filename);
-		try
-		{
-			if (lua_pcall(L, 2, 2, 0))
-				return false; // Leaves error message on stack
+		if (is_moon) {
+			// Save the text we'll be loading for the line number rewriting
+			// in the error handling
+			lua_pushlstring(L, buff, size);
+			lua_setfield(L, LUA_REGISTRYINDEX, ("raw moonscript: " + chunkname).c_str());
 		}
-		catch (const std::exception& except)
-		{
-			LOG_E("auto4/lua/moon") << except.what();
+
+		auto cache = cache_path(L, chunkname);
+		std::string header;
+		if (!cache.empty()) {
+			header = cache_header(chunkname, buff, size, is_moon ? moonscript_version(L) : "Lua");
+			if (load_cached(L, cache, header, chunkname, is_moon))
+				return true;
 		}
-		
 
-		// loadstring returns nil, error on error or a function on success
-		if (lua_isnil(L, 1)) {
-			lua_remove(L, 1);
-			return false;
+		LineTable line_table;
+		if (!is_moon) {
+			if (luaL_loadbuffer(L, buff, size, chunkname.c_str()))
+				return false;
+		}
+		else {
+			if (!compile_moonscript(L, buff, size, chunkname, line_table))
+				return false;
+			set_line_table(L, chunkname, line_table);
 		}
 
-		lua_pop(L, 1); // Remove the extra nil for the stackchecker
+		if (!cache.empty())
+			save_cached(L, cache, header, line_table);
 		return true;
 	}
 
+	void EnableBytecodeCache(lua_State *L, agi::fs::path const& cache_dir) {
+		push_value(L, cache_dir);
+		lua_setfield(L, LUA_REGISTRYINDEX, "bytecode cache");
+	}
+
 	static int module_loader(lua_State *L) {
 		int pretop = lua_gettop(L);
 		std::string module(check_string(L, -1));
@@ -154,12 +400,7 @@ namespace agi { namespace lua {
 		lua_rawseti(L, -2, 2);
 		lua_pop(L, 2); // loaders, package
 
-		luaL_loadstring(L, "return require('moonscript').loadstring");
-		if (lua_pcall(L, 0, 1, 0)) {
-			return false; // leave error message
-		}
-		lua_setfield(L, LUA_REGISTRYINDEX, "moonscript");
-
+		// The MoonScript compiler is loaded when it's first needed by LoadFile
 		return true;
 	}
 } }
@@ -89,13 +89,25 @@ void *check_udata(lua_State *L, int idx, const char *mt) {
 }
 
 static int moon_line(lua_State *L, int lua_line, std::string const& file) {
-	if (luaL_dostring(L, "return require 'moonscript.line_tables'")) {
-		lua_pop(L, 1); // pop error message
-		return lua_line;
+	// Files loaded with LoadFile have their line table stored in the
+	// registry, as ones loaded from the bytecode cache never go through
+	// the MoonScript compiler
+	lua_getfield(L, LUA_REGISTRYINDEX, ("moonscript line table: " + file).c_str());
+	if (lua_istable(L, -1)) {
+		// Stack layout needs to match the line_tables lookup below
+		lua_pushnil(L);
+		lua_insert(L, -2);
 	}
+	else {
+		lua_pop(L, 1);
+		if (luaL_dostring(L, "return require 'moonscript.line_tables'")) {
+			lua_pop(L, 1); // pop error message
+			return lua_line;
+		}
 
-	push_value(L, file);
-	lua_rawget(L, -2);
+		push_value(L, file);
+		lua_rawget(L, -2);
+	}
 
 	if (!lua_istable(L, -1)) {
 		lua_pop(L, 2);
@@ -107,4 +107,22 @@ std::unique_ptr<Queue> Create() {
     return std::unique_ptr<Queue>(new GCDQueue(dispatch_queue_create("Aegisub worker queue",
                                                                      DISPATCH_QUEUE_SERIAL)));
 }
+
+void ParallelFor(size_t count, std::function<void (size_t)> const& fn) {
+    std::mutex m;
+    std::exception_ptr e;
+    auto fn_ptr = &fn;
+    auto m_ptr = &m;
+    auto e_ptr = &e;
+    dispatch_apply(count, dispatch_get_global_queue(0, DISPATCH_QUEUE_PRIORITY_DEFAULT), ^(size_t i) {
+        try {
+            (*fn_ptr)(i);
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(*m_ptr);
+            if (!*e_ptr) *e_ptr = std::current_exception();
+        }
+    });
+    if (e) std::rethrow_exception(e);
+}
 } }
@@ -16,6 +16,8 @@
 
 #include "ass_attachment.h"
 
+#include "text_file_writer.h"
+
 #include <libaegisub/ass/uuencode.h>
 #include <libaegisub/file_mapping.h>
 #include <libaegisub/io.h>
@@ -26,7 +28,7 @@
 AssEntryGroup AssAttachment::Group() const { return group; }
 
 AssAttachment::AssAttachment(std::string const& header, AssEntryGroup group)
-: entry_data(header + "\r\n")
+: data(std::make_shared<std::vector<char>>())
 , filename(header.substr(10))
 , group(group)
 {
@@ -43,19 +45,43 @@ AssAttachment::AssAttachment(agi::fs::path const& name, AssEntryGroup group)
 
 	agi::read_file_mapping file(name);
 	auto buff = file.read();
-	entry_data = (group == AssEntryGroup::FONT ? "fontname: " : "filename: ") + filename.get() + "\r\n";
-	entry_data = entry_data.get() + agi::ass::UUEncode(buff, buff + file.size());
+	data = std::make_shared<std::vector<char>>(buff, buff + file.size());
+}
+
+void AssAttachment::SetEncodedData(std::string const& encoded) {
+	data = std::make_shared<std::vector<char>>(agi::ass::UUDecode(encoded.data(), encoded.data() + encoded.size()));
+}
+
+std::string AssAttachment::GetHeader() const {
+	return (group == AssEntryGroup::FONT ? "fontname: " : "filename: ") + filename.get();
+}
+
+std::string AssAttachment::GetEntryData() const {
+	auto entry = GetHeader();
+	entry += "\r\n";
+	entry += agi::ass::UUEncode(data->data(), data->data() + data->size());
+	return entry;
+}
+
+void AssAttachment::WriteEntryData(std::function<void (const char *, size_t)> const& write) const {
+	auto header = GetHeader() + "\r\n";
+	write(header.data(), header.size());
+	agi::ass::UUEncode(data->data(), data->data() + data->size(), write);
+}
+
+void AssAttachment::WriteEntryData(TextFileWriter &file) const {
+	WriteEntryData([&](const char *str, size_t len) {
+		file.WriteLineToFile(std::string(str, len), false);
+	});
+	file.WriteLineToFile("");
 }
 
 size_t AssAttachment::GetSize() const {
-	auto header_end = entry_data.get().find('\n');
-	return entry_data.get().size() - header_end - 1;
+	return data->size();
 }
 
 void AssAttachment::Extract(agi::fs::path const& filename) const {
-	auto header_end = entry_data.get().find('\n');
-	auto decoded = agi::ass::UUDecode(entry_data.get().c_str() + header_end + 1, &entry_data.get().back() + 1);
-	agi::io::Save(filename, true).Get().write(&decoded[0], decoded.size());
+	agi::io::Save(filename, true).Get().write(data->data(), data->size());
 }
 
 std::string AssAttachment::GetFileName(bool raw) const {
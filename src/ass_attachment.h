@@ -19,23 +19,39 @@
 #include <libaegisub/fs_fwd.h>
 
 #include <boost/flyweight.hpp>
+#include <functional>
+#include <memory>
+#include <vector>
+
+class TextFileWriter;
 
 /// @class AssAttachment
+///
+/// The attached file is stored decoded, and is shared by every copy of the
+/// attachment. It is only uuencoded again when the file is written.
 class AssAttachment final : public AssEntry {
-	/// ASS uuencoded entry data, including header.
-	boost::flyweight<std::string> entry_data;
+	/// Contents of the attached file
+	std::shared_ptr<const std::vector<char>> data;
 
 	/// Name of the attached file, with SSA font mangling if it is a ttf
 	boost::flyweight<std::string> filename;
 
 	AssEntryGroup group;
 
+	/// The fontname: or filename: line which starts the entry
+	std::string GetHeader() const;
+
 public:
 	/// Get the size of the attached file in bytes
 	size_t GetSize() const;
 
-	/// Add a line of data (without newline) read from a subtitle file
-	void AddData(std::string const& data) { entry_data = entry_data.get() + data + "\r\n"; }
+	/// Get the contents of the attached file, which copies of this
+	/// attachment share until it is replaced
+	std::shared_ptr<const std::vector<char>> const& GetData() const { return data; }
+
+	/// Set the contents of the attached file from uuencoded data read from a
+	/// subtitle file, with line breaks removed
+	void SetEncodedData(std::string const& encoded);
 
 	/// Extract the contents of this attachment to a file
 	/// @param filename Path to save the attachment to
@@ -45,7 +61,16 @@ public:
 	/// @param raw If false, remove the SSA filename mangling
 	std::string GetFileName(bool raw=false) const;
 
-	std::string const& GetEntryData() const { return entry_data; }
+	/// Get the header and uuencoded data, as written to a subtitle file
+	std::string GetEntryData() const;
+
+	/// @brief Produce the same thing as GetEntryData without uuencoding all
+	///        of the data to a string first
+	/// @param write Called with each piece of the entry in order
+	void WriteEntryData(std::function<void (const char *, size_t)> const& write) const;
+
+	/// Write the same thing as GetEntryData to a file
+	void WriteEntryData(TextFileWriter &file) const;
 	AssEntryGroup Group() const override;
 
 	AssAttachment(AssAttachment const& rgt) = default;
@@ -39,6 +39,7 @@
 #include <libaegisub/split.h>
 #include <libaegisub/make_unique.h>
 
+#include <atomic>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/algorithm/string/join.hpp>
 #include <boost/algorithm/string/trim.hpp>
@@ -49,7 +50,7 @@
 
 using namespace boost::adaptors;
 
-static int next_id = 0;
+static std::atomic<int> next_id{0};
 
 AssDialogue::AssDialogue() {
 	Id = ++next_id;
@@ -64,7 +65,7 @@ AssDialogue::AssDialogue(AssDialogue const& that)
 
 AssDialogue::AssDialogue(AssDialogueBase const& that) : AssDialogueBase(that) { }
 
-AssDialogue::AssDialogue(std::string const& data) {
+AssDialogue::AssDialogue(boost::string_view data) {
 	Id = ++next_id;
 	Parse(data);
 }
@@ -72,34 +73,41 @@ AssDialogue::AssDialogue(std::string const& data) {
 AssDialogue::~AssDialogue () { }
 
 class tokenizer {
-	agi::StringRange str;
-	agi::split_iterator<agi::StringRange::const_iterator> pos;
+	typedef boost::iterator_range<const char *> range;
+	range str;
+	agi::split_iterator<const char *> pos;
 
 public:
-	tokenizer(agi::StringRange const& str) : str(str) , pos(agi::Split(str, ',')) { }
+	tokenizer(range const& str) : str(str) , pos(agi::Split(str, ',')) { }
 
-	agi::StringRange next_tok() {
+	range next_tok() {
 		if (pos.eof())
 			throw SubtitleFormatParseError("Failed parsing line: " + std::string(str.begin(), str.end()));
 		return *pos++;
 	}
 
-	std::string next_str() { return agi::str(next_tok()); }
-	std::string next_str_trim() { return agi::str(boost::trim_copy(next_tok())); }
+	std::string next_str() {
+		auto tok = next_tok();
+		return std::string(tok.begin(), tok.end());
+	}
+	std::string next_str_trim() {
+		auto tok = boost::trim_copy(next_tok());
+		return std::string(tok.begin(), tok.end());
+	}
 };
 
-void AssDialogue::Parse(std::string const& raw) {
-	agi::StringRange str;
-	if (boost::starts_with(raw, "Dialogue:")) {
+void AssDialogue::Parse(boost::string_view raw) {
+	boost::iterator_range<const char *> str;
+	if (raw.starts_with("Dialogue:")) {
 		Comment = false;
-		str = agi::StringRange(raw.begin() + 10, raw.end());
+		str = boost::make_iterator_range(raw.begin() + 10, raw.end());
 	}
-	else if (boost::starts_with(raw, "Comment:")) {
+	else if (raw.starts_with("Comment:")) {
 		Comment = true;
-		str = agi::StringRange(raw.begin() + 9, raw.end());
+		str = boost::make_iterator_range(raw.begin() + 9, raw.end());
 	}
 	else
-		throw SubtitleFormatParseError("Failed parsing line: " + raw);
+		throw SubtitleFormatParseError("Failed parsing line: " + raw.to_string());
 
 	tokenizer tkn(str);
 
@@ -31,9 +31,11 @@
 #include "ass_override.h"
 
 #include <libaegisub/ass/time.h>
+#include <libaegisub/slab_allocator.h>
 
 #include <array>
 #include <boost/flyweight.hpp>
+#include <boost/utility/string_view.hpp>
 #include <vector>
 
 enum class AssBlockType {
@@ -146,10 +148,10 @@ struct AssDialogueBase {
 	boost::flyweight<std::string> Text;
 };
 
-class AssDialogue final : public AssEntry, public AssDialogueBase, public AssEntryListHook {
+class AssDialogue final : public AssEntry, public AssDialogueBase, public AssEntryListHook, public agi::SlabAllocated<AssDialogue> {
 	/// @brief Parse raw ASS data into everything else
 	/// @param data ASS line
-	void Parse(std::string const& data);
+	void Parse(boost::string_view data);
 public:
 	AssEntryGroup Group() const override { return AssEntryGroup::DIALOGUE; }
 
@@ -172,7 +174,7 @@ public:
 	AssDialogue();
 	AssDialogue(AssDialogue const&);
 	AssDialogue(AssDialogueBase const&);
-	AssDialogue(std::string const& data);
+	AssDialogue(boost::string_view data);
 	~AssDialogue();
 };
 
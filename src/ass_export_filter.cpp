@@ -34,6 +34,9 @@
 
 #include "ass_export_filter.h"
 
+#include "ass_dialogue.h"
+#include "ass_file.h"
+
 #include <libaegisub/format.h>
 
 static FilterList& filters() {
@@ -48,6 +51,17 @@ AssExportFilter::AssExportFilter(std::string name, std::string description, int
 {
 }
 
+PerLineExportFilter::PerLineExportFilter(std::string name, std::string description, int priority)
+: AssExportFilter(std::move(name), std::move(description), priority)
+{
+}
+
+void PerLineExportFilter::ProcessSubs(AssFile *subs, wxWindow *) {
+	PrepareLines(*subs);
+	for (auto& line : subs->Events)
+		ProcessLine(line);
+}
+
 void AssExportFilterChain::Register(std::unique_ptr<AssExportFilter> filter) {
 	int filter_copy = 1;
 	std::string name = filter->name;
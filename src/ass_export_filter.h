@@ -38,6 +38,7 @@
 #include <memory>
 #include <string>
 
+class AssDialogue;
 class AssFile;
 class AssExportFilterChain;
 class wxWindow;
@@ -82,6 +83,31 @@ public:
 	virtual void LoadSettings(bool is_default, agi::Context *c) { }
 };
 
+/// @class PerLineExportFilter
+/// @brief Base class for export filters which modify each line independently
+///
+/// Per-line filters must not look at or modify anything other than the line
+/// they are given once PrepareLines has returned, as the exporter runs them
+/// on many lines at once, in a single pass along with any other per-line
+/// filters next to them in the chain.
+class PerLineExportFilter : public AssExportFilter {
+public:
+	PerLineExportFilter(std::string name, std::string description, int priority = 0);
+
+	/// Run PrepareLines, then ProcessLine on each line
+	void ProcessSubs(AssFile *subs, wxWindow *parent_window=nullptr) override;
+
+	/// @brief Get ready to process the lines of a file with ProcessLine
+	/// @param subs File the lines are from
+	///
+	/// Per-line filters run earlier in the chain may not have processed the
+	/// lines yet, so only the rest of the file should be looked at.
+	virtual void PrepareLines(AssFile const& subs) { }
+
+	/// Process a single line. May be called from several threads at once.
+	virtual void ProcessLine(AssDialogue &line) const=0;
+};
+
 typedef boost::intrusive::make_list<AssExportFilter, boost::intrusive::constant_time_size<false>>::type FilterList;
 
 class AssExportFilterChain {
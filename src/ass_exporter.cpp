@@ -34,6 +34,7 @@
 
 #include "ass_exporter.h"
 
+#include "ass_dialogue.h"
 #include "ass_export_filter.h"
 #include "ass_file.h"
 #include "compat.h"
@@ -41,6 +42,9 @@
 #include "project.h"
 #include "subtitle_format.h"
 
+#include <libaegisub/dispatch.h>
+
+#include <algorithm>
 #include <memory>
 #include <wx/sizer.h>
 
@@ -79,17 +83,55 @@ std::vector<std::string> AssExporter::GetAllFilterNames() const {
 	return names;
 }
 
+void AssExporter::RunLineFilters(AssFile &subs, std::vector<PerLineExportFilter*> const& line_filters) {
+	for (auto filter : line_filters)
+		filter->PrepareLines(subs);
+
+	std::vector<AssDialogue *> lines;
+	lines.reserve(subs.Events.size());
+	for (auto& line : subs.Events)
+		lines.push_back(&line);
+
+	const size_t chunk_size = 1024;
+	agi::dispatch::ParallelFor((lines.size() + chunk_size - 1) / chunk_size, [&](size_t chunk) {
+		size_t chunk_end = std::min(lines.size(), (chunk + 1) * chunk_size);
+		for (size_t i = chunk * chunk_size; i < chunk_end; ++i) {
+			for (auto filter : line_filters)
+				filter->ProcessLine(*lines[i]);
+		}
+	});
+}
+
 void AssExporter::Export(agi::fs::path const& filename, std::string const& charset, wxWindow *export_dialog) {
+	const SubtitleFormat *writer = SubtitleFormat::GetWriter(filename);
+	if (!writer)
+		throw agi::InvalidInputException("Unknown file type.");
+
+	// Nothing to modify, so there's no need for a copy
+	if (filters.empty()) {
+		writer->ExportFile(c->ass.get(), filename, c->project->Timecodes(), charset);
+		return;
+	}
+
 	AssFile subs(*c->ass);
 
+	// Adjacent per-line filters are run together in a single pass over the lines
+	std::vector<PerLineExportFilter*> line_filters;
 	for (auto filter : filters) {
+		auto line_filter = dynamic_cast<PerLineExportFilter*>(filter);
+		if (!line_filter && !line_filters.empty()) {
+			RunLineFilters(subs, line_filters);
+			line_filters.clear();
+		}
+
 		filter->LoadSettings(is_default, c);
-		filter->ProcessSubs(&subs, export_dialog);
+		if (line_filter)
+			line_filters.push_back(line_filter);
+		else
+			filter->ProcessSubs(&subs, export_dialog);
 	}
-
-	const SubtitleFormat *writer = SubtitleFormat::GetWriter(filename);
-	if (!writer)
-		throw agi::InvalidInputException("Unknown file type.");
+	if (!line_filters.empty())
+		RunLineFilters(subs, line_filters);
 
 	writer->ExportFile(&subs, filename, c->project->Timecodes(), charset);
 }
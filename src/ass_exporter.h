@@ -39,12 +39,13 @@
 #include <vector>
 
 class AssExportFilter;
+class PerLineExportFilter;
+class AssFile;
 namespace agi { struct Context; }
 class wxSizer;
 class wxWindow;
 
 class AssExporter {
-	typedef std::vector<AssExportFilter*>::const_iterator filter_iterator;
 
 	/// Sizers for configuration panels
 	std::map<std::string, wxSizer*> Sizers;
@@ -59,6 +60,10 @@ class AssExporter {
 	/// their default settings
 	bool is_default = true;
 
+	/// Run a range of per-line filters on the lines of a file, all of them
+	/// on each line before moving on to the next
+	static void RunLineFilters(AssFile &subs, std::vector<PerLineExportFilter*> const& line_filters);
+
 public:
 	AssExporter(agi::Context *c);
 
@@ -32,34 +32,16 @@
 /// @ingroup subs_storage
 ///
 
+#include <libaegisub/ass/override.h>
+
 #include <memory>
 #include <vector>
 
 class AssDialogueBlockOverride;
 
 /// Type of parameter
-enum class AssParameterClass {
-	NORMAL,
-	ABSOLUTE_SIZE,
-	ABSOLUTE_POS_X,
-	ABSOLUTE_POS_Y,
-	RELATIVE_SIZE_X,
-	RELATIVE_SIZE_Y,
-	RELATIVE_TIME_START,
-	RELATIVE_TIME_END,
-	KARAOKE,
-	DRAWING,
-	ALPHA,
-	COLOR
-};
-
-enum class VariableDataType {
-	INT,
-	FLOAT,
-	TEXT,
-	BOOL,
-	BLOCK
-};
+typedef agi::ass::ParameterClass AssParameterClass;
+typedef agi::ass::ParameterType VariableDataType;
 
 /// A single parameter to an override tag
 class AssOverrideParameter {
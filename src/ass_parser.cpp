@@ -23,18 +23,75 @@
 #include "subtitle_format.h"
 
 #include <libaegisub/ass/uuencode.h>
+#include <libaegisub/dispatch.h>
 #include <libaegisub/make_unique.h>
 #include <libaegisub/util.h>
 
 #include <algorithm>
+#include <atomic>
 #include <boost/algorithm/string/case_conv.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/algorithm/string/trim.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/regex.hpp>
 #include <boost/variant.hpp>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <thread>
 #include <unordered_map>
 
+namespace {
+/// Number of event lines parsed by each background task
+const size_t event_chunk_size = 2048;
+
+/// State shared between the tasks parsing a run of event lines, which may
+/// outlive AddEventLines if a task is only started after all of the chunks
+/// have been claimed by other threads
+struct EventBatch {
+	std::vector<boost::string_view> const *lines;
+	std::vector<AssDialogue *> parsed;
+	/// Index of the line which failed to parse in each chunk, or SIZE_MAX
+	std::vector<size_t> error_line;
+	std::vector<std::exception_ptr> error;
+	size_t chunks;
+
+	std::atomic<size_t> next_chunk{0};
+	size_t finished = 0;
+	std::mutex mutex;
+	std::condition_variable all_finished;
+
+	void ParseChunk(size_t chunk) {
+		size_t begin = chunk * event_chunk_size;
+		size_t end = std::min(begin + event_chunk_size, lines->size());
+		for (size_t i = begin; i < end; ++i) {
+			auto line = (*lines)[i];
+			if (!line.starts_with("Dialogue:") && !line.starts_with("Comment:"))
+				continue;
+			try {
+				parsed[i] = new AssDialogue(line);
+			}
+			catch (...) {
+				error_line[chunk] = i;
+				error[chunk] = std::current_exception();
+				return;
+			}
+		}
+	}
+
+	/// Parse chunks until there are none left to claim
+	void Work() {
+		for (size_t chunk; (chunk = next_chunk++) < chunks; ) {
+			ParseChunk(chunk);
+			std::lock_guard<std::mutex> lock(mutex);
+			if (++finished == chunks)
+				all_finished.notify_all();
+		}
+	}
+};
+}
+
 class AssParser::HeaderToProperty {
 	using field = boost::variant<
 		std::string ProjectProperties::*,
@@ -118,18 +175,24 @@ void AssParser::ParseAttachmentLine(std::string const& data) {
 
 	// Data is over, add attachment to the file
 	if (!valid_data || is_filename) {
-		target->Attachments.push_back(*attach.release());
+		FinishAttachment();
 		AddLine(data);
 	}
 	else {
-		attach->AddData(data);
+		attach_data += data;
 
 		// Done building
 		if (data.size() < 80)
-			target->Attachments.push_back(*attach.release());
+			FinishAttachment();
 	}
 }
 
+void AssParser::FinishAttachment() {
+	attach->SetEncodedData(attach_data);
+	attach_data.clear();
+	target->Attachments.push_back(*attach.release());
+}
+
 void AssParser::ParseScriptInfoLine(std::string const& data) {
 	if (boost::starts_with(data, ";")) {
 		// Skip stupid comments added by other programs
@@ -223,6 +286,46 @@ void AssParser::ParseExtradataLine(std::string const &data) {
 	}
 }
 
+bool AssParser::InEvents() const {
+	return !attach && state == &AssParser::ParseEventLine;
+}
+
+void AssParser::AddEventLines(std::vector<boost::string_view> const& lines) {
+	if (lines.empty()) return;
+
+	auto batch = std::make_shared<EventBatch>();
+	batch->lines = &lines;
+	batch->parsed.resize(lines.size(), nullptr);
+	batch->chunks = (lines.size() + event_chunk_size - 1) / event_chunk_size;
+	batch->error_line.resize(batch->chunks, SIZE_MAX);
+	batch->error.resize(batch->chunks);
+
+	// The calling thread parses chunks too, so this finishes even if every
+	// thread in the pool is busy with something else
+	size_t threads = std::min<size_t>(batch->chunks, std::max(1u, std::thread::hardware_concurrency()));
+	for (size_t i = 1; i < threads; ++i)
+		agi::dispatch::Background().Async([=] { batch->Work(); });
+	batch->Work();
+	{
+		std::unique_lock<std::mutex> lock(batch->mutex);
+		batch->all_finished.wait(lock, [&] { return batch->finished == batch->chunks; });
+	}
+
+	// Add everything before the first bad line, just as adding them one at a
+	// time would have
+	size_t error_line = *std::min_element(batch->error_line.begin(), batch->error_line.end());
+	for (size_t i = 0; i < batch->parsed.size(); ++i) {
+		if (!batch->parsed[i]) continue;
+		if (i < error_line)
+			target->Events.push_back(*batch->parsed[i]);
+		else
+			delete batch->parsed[i];
+	}
+
+	if (error_line != SIZE_MAX)
+		std::rethrow_exception(batch->error[error_line / event_chunk_size]);
+}
+
 void AssParser::AddLine(std::string const& data) {
 	// Special-case for attachments since a line could theoretically be both a
 	// valid attachment data line and a valid section header, and if an
@@ -12,7 +12,10 @@
 // ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
 // OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 
+#include <boost/utility/string_view.hpp>
 #include <memory>
+#include <string>
+#include <vector>
 
 class AssAttachment;
 class AssFile;
@@ -24,9 +27,13 @@ class AssParser {
 	AssFile *target;
 	int version;
 	std::unique_ptr<AssAttachment> attach;
+	/// uuencoded data of the attachment being read, decoded once all of it
+	/// has been read
+	std::string attach_data;
 	void (AssParser::*state)(std::string const&);
 
 	void ParseAttachmentLine(std::string const& data);
+	void FinishAttachment();
 	void ParseEventLine(std::string const& data);
 	void ParseStyleLine(std::string const& data);
 	void ParseScriptInfoLine(std::string const& data);
@@ -40,4 +47,15 @@ public:
 	~AssParser();
 
 	void AddLine(std::string const& data);
+
+	/// Will the next line passed to AddLine be parsed as an event?
+	bool InEvents() const;
+
+	/// @brief Add a run of lines from the events section
+	/// @param lines Trimmed lines, none of which are section headers
+	///
+	/// Equivalent to calling AddLine for each line, but long runs are split
+	/// into chunks which are parsed on the background thread pool. The lines
+	/// are parsed in place, so they must stay valid until this returns.
+	void AddEventLines(std::vector<boost::string_view> const& lines);
 };
@@ -30,12 +30,13 @@
 #include "ass_entry.h"
 
 #include <libaegisub/color.h>
+#include <libaegisub/slab_allocator.h>
 
 #include <array>
 
 class wxArrayString;
 
-class AssStyle final : public AssEntry, public AssEntryListHook {
+class AssStyle final : public AssEntry, public AssEntryListHook, public agi::SlabAllocated<AssStyle> {
 	std::string data;
 
 public:
@@ -20,11 +20,15 @@
 #include "ass_file.h"
 #include "export_fixstyle.h"
 #include "include/aegisub/subtitles_provider.h"
+#include "options.h"
 #include "video_frame.h"
 #include "video_provider_manager.h"
 
 #include <libaegisub/dispatch.h>
 
+#include <algorithm>
+#include <cstdlib>
+
 enum {
 	NEW_SUBS_FILE = -1,
 	SUBS_FILE_ALREADY_LOADED = -2
@@ -96,6 +100,7 @@ AsyncVideoProvider::AsyncVideoProvider(agi::fs::path const& video_filename, std:
 , subs_provider(get_subs_provider(parent, br))
 , source_provider(VideoProviderFactory::GetProvider(video_filename, colormatrix, br))
 , parent(parent)
+, prefetch_frames(OPT_GET("Provider/Video/Cache/Prefetch")->GetInt())
 {
 }
 
@@ -138,12 +143,46 @@ void AsyncVideoProvider::RequestFrame(int new_frame, double new_time) throw() {
 	uint_fast32_t req_version = ++version;
 
 	worker->Async([=]{
+		// Guess which way the user is moving through the video from the
+		// previous request. Anything other than a short step is a seek,
+		// after which there's no telling what will be wanted next.
+		int step = frame_number < 0 ? 0 : new_frame - frame_number;
+
 		time = new_time;
 		frame_number = new_frame;
 		ProcAsync(req_version, false);
+
+		if (prefetch_frames <= 0 || step == 0 || std::abs(step) > 4) return;
+
+		// When moving backwards the preceding frames are still decoded in
+		// order, as decoding any one of them already means decoding forward
+		// from the previous keyframe
+		int first = step > 0 ? new_frame + 1 : new_frame - prefetch_frames;
+		int last = step > 0 ? new_frame + prefetch_frames : new_frame - 1;
+		first = std::max(first, 0);
+		last = std::min(last, source_provider->GetFrameCount() - 1);
+		if (first <= last)
+			worker->AsyncIdle([=] { Prefetch(req_version, first, last); });
 	});
 }
 
+void AsyncVideoProvider::Prefetch(uint_fast32_t req_version, int frame, int last) {
+	// Give up as soon as the user has done anything else, including seeking
+	// elsewhere or editing the subtitles
+	if (req_version != version) return;
+
+	try {
+		if (!source_provider->PrefetchFrame(frame)) return;
+	}
+	catch (VideoProviderError const&) {
+		// Errors will be reported if the frame is actually requested
+		return;
+	}
+
+	if (frame < last)
+		worker->AsyncIdle([=] { Prefetch(req_version, frame + 1, last); });
+}
+
 bool AsyncVideoProvider::NeedUpdate(std::vector<AssDialogueBase const*> const& visible_lines) {
 	// Always need to render after a seek
 	if (single_frame != NEW_SUBS_FILE || frame_number != last_rendered)
@@ -49,6 +49,7 @@ class AsyncVideoProvider {
 	wxEvtHandler *parent;
 
 	int frame_number = -1; ///< Last frame number requested
+	int prefetch_frames = 0; ///< Number of frames to decode ahead of the current one
 	double time = -1.; ///< Time of the frame to pass to the subtitle renderer
 
 	/// Copy of the subtitles file to avoid having to touch the project context
@@ -72,6 +73,17 @@ class AsyncVideoProvider {
 	/// Produce a frame if req_version is still the current version
 	void ProcAsync(uint_fast32_t req_version, bool check_updated);
 
+	/// @brief Decode frames into the video cache ahead of them being requested
+	/// @param req_version Version of the request which started the prefetch
+	/// @param frame Next frame to decode
+	/// @param last Last frame to decode
+	///
+	/// Decodes a single frame and then queues the rest as idle work, so that
+	/// requests which arrive in the meantime are handled first and a real
+	/// request waits for at most the one frame being prefetched. Stops as
+	/// soon as anything else has been requested.
+	void Prefetch(uint_fast32_t req_version, int frame, int last);
+
 	/// Monotonic counter used to drop frames when changes arrive faster than
 	/// they can be rendered
 	std::atomic<uint_fast32_t> version{ 0 };
@@ -800,10 +800,9 @@ void AudioDisplay::OnLoadTimer(wxTimerEvent&)
 		if (new_pos > audio_load_position)
 			audio_load_position = new_pos;
 
-		const double left = last_sample_decoded * 1000.0 / provider->GetSampleRate() / ms_per_pixel;
-		const double right = new_decoded_count * 1000.0 / provider->GetSampleRate() / ms_per_pixel;
-
-		if (left < scroll_left + pixel_audio_width && right >= scroll_left)
+		// The newly decoded audio could be anywhere as it isn't necessarily
+		// decoded in order
+		if (new_decoded_count != last_sample_decoded)
 			Refresh();
 		else
 			RefreshRect(scrollbar->GetBounds());
@@ -25,12 +25,14 @@
 #include <libaegisub/log.h>
 #include <libaegisub/path.h>
 
+#include <boost/crc.hpp>
 #include <boost/range/iterator_range.hpp>
 
 using namespace agi;
 
 std::unique_ptr<AudioProvider> CreateAvisynthAudioProvider(fs::path const& filename, BackgroundRunner *);
 std::unique_ptr<AudioProvider> CreateFFmpegSourceAudioProvider(fs::path const& filename, BackgroundRunner *);
+void ExpectFFmpegSourceAudio(fs::path const& filename);
 
 namespace {
 struct factory {
@@ -51,10 +53,45 @@ const factory providers[] = {
 };
 }
 
+namespace {
+/// Saved audio is 16-bit, and its peak index has an 8-byte entry for every
+/// 256 samples plus coarser levels a third that size again, so the peak
+/// indexes need about 1/48 as much space as the audio they belong to
+const int PeakIndexSizeRatio = 48;
+
+/// Where decoded audio from the given file is kept between sessions
+fs::path SavedAudioFilename(fs::path const& filename, AudioProvider const& provider, Path const& path_helper) {
+	boost::crc_32_type hash;
+	hash.process_bytes(filename.string().c_str(), filename.string().size());
+
+	return path_helper.Decode("?local/audiocache/" +
+		std::to_string(hash.checksum()) + "_" +
+		std::to_string(fs::Size(filename)) + "_" +
+		std::to_string(fs::ModifiedTime(filename)) + "_" +
+		std::to_string(static_cast<unsigned>(provider.GetHash())) + ".pcm");
+}
+
+/// Trim the saved audio and the peak indexes saved alongside it to the size
+/// and number of files set for the persistent cache
+void CleanSavedAudio(fs::path const& dir) {
+	auto size = OPT_GET("Audio/Cache/Persistent/Size")->GetInt();
+	auto files = OPT_GET("Audio/Cache/Persistent/Files")->GetInt();
+	CleanCache(dir, "*.pcm", size, files);
+	// Sizes are in whole megabytes, so round up to avoid a limit of zero
+	CleanCache(dir, "*.peaks", size / PeakIndexSizeRatio + 1, files);
+}
+}
+
 std::vector<std::string> GetAudioProviderNames() {
 	return ::GetClasses(boost::make_iterator_range(std::begin(providers), std::end(providers)));
 }
 
+void ExpectAudioFromVideo(fs::path const& filename) {
+#ifdef WITH_FFMS2
+	ExpectFFmpegSourceAudio(filename);
+#endif
+}
+
 std::unique_ptr<agi::AudioProvider> GetAudioProvider(fs::path const& filename,
                                                      Path const& path_helper,
                                                      BackgroundRunner *br) {
@@ -112,6 +149,23 @@ std::unique_ptr<agi::AudioProvider> GetAudioProvider(fs::path const& filename,
 	if (!cache || !needs_cache)
 		return CreateLockAudioProvider(std::move(provider));
 
+	// Reuse audio decoded by an earlier session if there is any. Providers
+	// which don't set a hash may produce audio which depends on more than
+	// the file itself (such as an Avisynth script's sources), so only ones
+	// which do are saved.
+	fs::path save_to;
+	if (OPT_GET("Audio/Cache/Persistent/Enabled")->GetBool() && provider->GetHash()) {
+		save_to = SavedAudioFilename(filename, *provider, path_helper);
+		if (HasSavedAudio(*provider, save_to)) {
+			LOG_I("audio_provider") << "Using saved audio " << save_to;
+			fs::Touch(save_to);
+			return CreateSavedAudioProvider(std::move(provider), save_to);
+		}
+
+		fs::CreateDirectory(save_to.parent_path());
+		CleanSavedAudio(save_to.parent_path());
+	}
+
 	// Convert to RAM
 	if (cache == 1) {
 		if (sizeof(void*) == 4 && (provider->GetNumSamples() * provider->GetChannels() * provider->GetBytesPerSample() >= (1 << 30))) {
@@ -125,7 +179,7 @@ std::unique_ptr<agi::AudioProvider> GetAudioProvider(fs::path const& filename,
 			cache = 2;
 		}
 		else
-			return CreateRAMAudioProvider(std::move(provider));
+			return CreateRAMAudioProvider(std::move(provider), save_to);
 	}
 
 	// Convert to HD
@@ -134,7 +188,7 @@ std::unique_ptr<agi::AudioProvider> GetAudioProvider(fs::path const& filename,
 		if (path == "default")
 			path = "?temp";
 		auto cache_dir = path_helper.MakeAbsolute(path_helper.Decode(path), "?temp");
-		return CreateHDAudioProvider(std::move(provider), cache_dir);
+		return CreateHDAudioProvider(std::move(provider), cache_dir, save_to);
 	}
 
 	throw InternalError("Invalid audio caching method");
@@ -29,3 +29,8 @@ std::unique_ptr<agi::AudioProvider> GetAudioProvider(agi::fs::path const& filena
                                                      agi::Path const& path_helper,
                                                      agi::BackgroundRunner *br);
 std::vector<std::string> GetAudioProviderNames();
+
+/// Note that audio is about to be loaded from a file which is first being
+/// opened as video, so that providers which have to index the file can do
+/// both in one pass
+void ExpectAudioFromVideo(agi::fs::path const& filename);
@@ -52,7 +52,14 @@ class FFmpegSourceAudioProvider final : public agi::AudioProvider, FFmpegSourceP
 	mutable char FFMSErrMsg[1024];			///< FFMS error message
 	mutable FFMS_ErrorInfo ErrInfo;			///< FFMS error codes/messages
 
+	/// The file, index and track the audio source was opened from, kept for
+	/// opening duplicates of it
+	agi::fs::path Filename;
+	std::shared_ptr<FFMS_Index> Index;
+	int TrackNumber = -1;
+
 	void LoadAudio(agi::fs::path const& filename);
+	void OpenAudioSource();
 	void FillBuffer(void *Buf, int64_t Start, int64_t Count) const override {
 		if (FFMS_GetAudio(AudioSource, Buf, Start, Count, &ErrInfo))
 			throw agi::AudioDecodeError(std::string("Failed to get audio samples: ") + ErrInfo.Buffer);
@@ -60,8 +67,16 @@ class FFmpegSourceAudioProvider final : public agi::AudioProvider, FFmpegSourceP
 
 public:
 	FFmpegSourceAudioProvider(agi::fs::path const& filename, agi::BackgroundRunner *br);
+	/// Open another source for a track which has already been indexed
+	FFmpegSourceAudioProvider(agi::fs::path const& filename, std::shared_ptr<FFMS_Index> index, int track);
 
 	bool NeedsCache() const override { return true; }
+
+	std::unique_ptr<agi::AudioProvider> Duplicate() const override {
+		auto dup = agi::make_unique<FFmpegSourceAudioProvider>(Filename, Index, TrackNumber);
+		dup->audioHash = audioHash;
+		return dup;
+	}
 };
 
 /// @brief Constructor
@@ -77,12 +92,26 @@ FFmpegSourceAudioProvider::FFmpegSourceAudioProvider(agi::fs::path const& filena
 	SetLogLevel();
 
 	LoadAudio(filename);
-	audioHash = std::hash<std::string>{}(filename.filename().string());
 }
 catch (agi::EnvironmentError const& err) {
 	throw agi::AudioProviderError(err.GetMessage());
 }
 
+FFmpegSourceAudioProvider::FFmpegSourceAudioProvider(agi::fs::path const& filename, std::shared_ptr<FFMS_Index> index, int track)
+: FFmpegSourceProvider(nullptr)
+, AudioSource(nullptr, FFMS_DestroyAudioSource)
+, Filename(filename)
+, Index(std::move(index))
+, TrackNumber(track)
+{
+	ErrInfo.Buffer		= FFMSErrMsg;
+	ErrInfo.BufferSize	= sizeof(FFMSErrMsg);
+	ErrInfo.ErrorType	= FFMS_ERROR_SUCCESS;
+	ErrInfo.SubType		= FFMS_ERROR_SUCCESS;
+
+	OpenAudioSource();
+}
+
 void FFmpegSourceAudioProvider::LoadAudio(agi::fs::path const& filename) {
 	FFMS_Indexer *Indexer = FFMS_CreateIndexer(filename.string().c_str(), &ErrInfo);
 	if (!Indexer) {
@@ -96,7 +125,7 @@ void FFmpegSourceAudioProvider::LoadAudio(agi::fs::path const& filename) {
 
 	// initialize the track number to an invalid value so we can detect later on
 	// whether the user actually had to choose a track or not
-	int TrackNumber = -1;
+	TrackNumber = -1;
 	if (TrackList.size() > 1) {
 		auto Selection = AskForTrackSelection(TrackList, FFMS_TYPE_AUDIO);
 		if (Selection == TrackSelection::None)
@@ -108,45 +137,21 @@ void FFmpegSourceAudioProvider::LoadAudio(agi::fs::path const& filename) {
 	else
 		throw agi::AudioDataNotFound("no audio tracks found");
 
-	// generate a name for the cache file
-	agi::fs::path CacheName = GetCacheFilename(filename);
-
-	// try to read index
-	agi::scoped_holder<FFMS_Index*, void (FFMS_CC*)(FFMS_Index*)>
-		Index(FFMS_ReadIndex(CacheName.string().c_str(), &ErrInfo), FFMS_DestroyIndex);
-
-	if (Index && FFMS_IndexBelongsToFile(Index, filename.string().c_str(), &ErrInfo))
-		Index = nullptr;
-
-	if (Index) {
-		// we already have an index, but the desired track may not have been
-		// indexed, and if it wasn't we need to reindex
-		FFMS_Track *TempTrackData = FFMS_GetTrackFromIndex(Index, TrackNumber);
-		if (FFMS_GetNumFrames(TempTrackData) <= 0)
-			Index = nullptr;
-	}
-
-	// reindex if the error handling mode has changed
-	FFMS_IndexErrorHandling ErrorHandling = GetErrorHandlingMode();
-#if FFMS_VERSION >= ((2 << 24) | (17 << 16) | (2 << 8) | 0)
-	if (Index && FFMS_GetErrorHandling(Index) != ErrorHandling)
-		Index = nullptr;
-#endif
+	Filename = filename;
+	Index = GetIndex(Indexer, filename, FFMS_TYPE_AUDIO, TrackNumber);
 
-	// moment of truth
-	if (!Index) {
-		TrackSelection TrackMask = static_cast<TrackSelection>(TrackNumber);
-		if (OPT_GET("Provider/FFmpegSource/Index All Tracks")->GetBool())
-			TrackMask = TrackSelection::All;
-		Index = DoIndexing(Indexer, CacheName, TrackMask, ErrorHandling);
-	}
-	else
-		FFMS_CancelIndexing(Indexer);
+	// Identifies the decoded audio for the caches, so it has to include
+	// everything which affects what is decoded
+	audioHash = std::hash<std::string>{}(filename.filename().string() + "/" +
+		std::to_string(TrackNumber) + "/" +
+		std::to_string(GetErrorHandlingMode()) + "/" +
+		std::to_string(OPT_GET("Provider/Audio/FFmpegSource/Downmix")->GetBool()));
 
-	// update access time of index file so it won't get cleaned away
-	agi::fs::Touch(CacheName);
+	OpenAudioSource();
+}
 
-	AudioSource = FFMS_CreateAudioSource(filename.string().c_str(), TrackNumber, Index, FFMS_DELAY_FIRST_VIDEO_TRACK, &ErrInfo);
+void FFmpegSourceAudioProvider::OpenAudioSource() {
+	AudioSource = FFMS_CreateAudioSource(Filename.string().c_str(), TrackNumber, Index.get(), FFMS_DELAY_FIRST_VIDEO_TRACK, &ErrInfo);
 	if (!AudioSource)
 		throw agi::AudioProviderError(std::string("Failed to open audio track: ") + ErrInfo.Buffer);
 
@@ -191,6 +196,10 @@ void FFmpegSourceAudioProvider::LoadAudio(agi::fs::path const& filename) {
 
 }
 
+void ExpectFFmpegSourceAudio(agi::fs::path const& filename) {
+	FFmpegSourceProvider::ExpectAudio(filename);
+}
+
 std::unique_ptr<agi::AudioProvider> CreateFFmpegSourceAudioProvider(agi::fs::path const& file, agi::BackgroundRunner *br) {
 	return agi::make_unique<FFmpegSourceAudioProvider>(file, br);
 }
@@ -37,6 +37,7 @@
 #include <libaegisub/make_unique.h>
 
 #include <algorithm>
+#include <cmath>
 #include <wx/dc.h>
 
 namespace {
@@ -195,16 +196,32 @@ void AudioRenderer::Render(wxDC &dc, wxPoint origin, const int start, const int
 	// And the offset in it to start its use at
 	const int firstbitmapoffset = start % cache_bitmap_width;
 	// The last bitmap required
-	const int lastbitmap = std::min<int>(end / cache_bitmap_width, NumBlocks(provider->GetDecodedSamples()) - 1);
+	const int lastbitmap = std::min<int>(end / cache_bitmap_width, NumBlocks(provider->GetNumSamples()) - 1);
+	// Samples covered by each bitmap
+	const double bitmap_samples = cache_bitmap_width * pixel_ms * provider->GetSampleRate() / 1000.0;
 
 	// Set a clipping region so that the first and last bitmaps don't draw
 	// outside the requested range
 	const wxDCClipper clipper(dc, wxRect(origin, wxSize(length, pixel_height)));
 	origin.x -= firstbitmapoffset;
 
+	// The audio may be decoded out of order, so any of the bitmaps can be
+	// missing. Those are drawn blank and the provider asked to decode the
+	// first one next.
+	bool prioritized = false;
 	for (int i = firstbitmap; i <= lastbitmap; ++i)
 	{
-		dc.DrawBitmap(GetCachedBitmap(i, style), origin);
+		const auto first_sample = static_cast<int64_t>(i * bitmap_samples);
+		const auto last_sample = static_cast<int64_t>(std::ceil((i + 1) * bitmap_samples));
+		if (provider->IsDecoded(first_sample, last_sample - first_sample))
+			dc.DrawBitmap(GetCachedBitmap(i, style), origin);
+		else
+		{
+			renderer->RenderBlank(dc, wxRect(origin.x, origin.y, cache_bitmap_width, pixel_height), style);
+			if (!prioritized)
+				provider->Prioritize(first_sample);
+			prioritized = true;
+		}
 		origin.x += cache_bitmap_width;
 	}
 
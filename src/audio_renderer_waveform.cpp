@@ -32,6 +32,7 @@
 #include "audio_colorscheme.h"
 #include "options.h"
 
+#include <libaegisub/audio/peak_index.h>
 #include <libaegisub/audio/provider.h>
 
 #include <algorithm>
@@ -83,25 +84,42 @@ void AudioWaveformRenderer::Render(wxBitmap &bmp, int start, AudioRenderingStyle
 	wxPen pen_peaks(wxPen(pal->get(0.4f)));
 	wxPen pen_avgs(wxPen(pal->get(0.7f)));
 
+	// Use the provider's peak index when it has one, so that zoomed out
+	// views don't need to read every sample in the visible range
+	auto peaks = provider->GetPeakIndex();
+
 	for (int x = 0; x < rect.width; ++x)
 	{
-		provider->GetInt16MonoAudio(reinterpret_cast<int16_t*>(audio_buffer.get()), (int64_t)cur_sample, (int64_t)pixel_samples);
-		cur_sample += pixel_samples;
-
 		int peak_min = 0, peak_max = 0;
 		int64_t avg_min_accum = 0, avg_max_accum = 0;
-		auto aud = reinterpret_cast<const int16_t *>(audio_buffer.get());
-		for (int si = pixel_samples; si > 0; --si, ++aud)
+
+		agi::AudioPeak peak;
+		if (peaks && peaks->GetPeak((int64_t)cur_sample, (int64_t)pixel_samples, peak))
 		{
-			if (*aud > 0)
-			{
-				peak_max = std::max(peak_max, (int)*aud);
-				avg_max_accum += *aud;
-			}
-			else
+			cur_sample += pixel_samples;
+			peak_min = peak.min;
+			peak_max = peak.max;
+			avg_min_accum = (int64_t)(peak.avg_min * pixel_samples);
+			avg_max_accum = (int64_t)(peak.avg_max * pixel_samples);
+		}
+		else
+		{
+			provider->GetInt16MonoAudio(reinterpret_cast<int16_t*>(audio_buffer.get()), (int64_t)cur_sample, (int64_t)pixel_samples);
+			cur_sample += pixel_samples;
+
+			auto aud = reinterpret_cast<const int16_t *>(audio_buffer.get());
+			for (int si = pixel_samples; si > 0; --si, ++aud)
 			{
-				peak_min = std::min(peak_min, (int)*aud);
-				avg_min_accum += *aud;
+				if (*aud > 0)
+				{
+					peak_max = std::max(peak_max, (int)*aud);
+					avg_max_accum += *aud;
+				}
+				else
+				{
+					peak_min = std::min(peak_min, (int)*aud);
+					avg_min_accum += *aud;
+				}
 			}
 		}
 
@@ -45,9 +45,13 @@
 #include <libaegisub/make_unique.h>
 #include <libaegisub/split.h>
 
+#include <atomic>
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/algorithm/string/trim.hpp>
+#include <boost/functional/hash.hpp>
 #include <future>
+#include <mutex>
+#include <unordered_map>
 
 #include <wx/dcmemory.h>
 #include <wx/log.h>
@@ -60,106 +64,225 @@
 #include <libaegisub/charset_conv_win.h>
 #endif
 
-namespace Automation4 {
-	bool CalculateTextExtents(AssStyle *style, std::string const& text, double &width, double &height, double &descent, double &extlead)
-	{
-		width = height = descent = extlead = 0;
+namespace {
+/// Everything about a style which affects which font is used to measure it
+struct FontKey {
+	std::string face;
+	int size;
+	bool bold, italic, underline, strikeout;
+	int encoding;
+
+	bool operator==(FontKey const& o) const {
+		return size == o.size && bold == o.bold && italic == o.italic &&
+			underline == o.underline && strikeout == o.strikeout &&
+			encoding == o.encoding && face == o.face;
+	}
+};
+
+struct FontKeyHash {
+	size_t operator()(FontKey const& k) const {
+		size_t seed = std::hash<std::string>()(k.face);
+		boost::hash_combine(seed, k.size);
+		boost::hash_combine(seed, k.bold | k.italic << 1 | k.underline << 2 | k.strikeout << 3);
+		boost::hash_combine(seed, k.encoding);
+		return seed;
+	}
+};
 
-		double fontsize = style->fontsize * 64;
-		double spacing = style->spacing * 64;
+/// Raw measurements as returned by the platform's text extent function
+struct RawExtents {
+	int width, height, descent, extlead;
+};
+
+std::atomic<uint64_t> calls{0}, font_hits{0}, glyph_lookups{0}, glyph_hits{0};
+
+/// A font selected into a DC, along with everything measured with it so far
+///
+/// Measuring a string with no inter-character spacing is done in one go
+/// (so that kerning is applied) and cached per string; with spacing each
+/// character is measured separately and cached per character.
+class MeasuringFont {
+	std::mutex mutex;
+	std::unordered_map<uint32_t, RawExtents> glyphs;
+	std::unordered_map<std::string, RawExtents> strings;
+
+#ifdef WIN32
+	HDC dc = nullptr;
+	HFONT font = nullptr;
+	HGDIOBJ old_font = nullptr;
+	TEXTMETRIC tm;
+
+	RawExtents Measure(const wchar_t *str, int len) {
+		SIZE sz;
+		GetTextExtentPoint32(dc, str, len, &sz);
+		return RawExtents{sz.cx, sz.cy, tm.tmDescent, tm.tmExternalLeading};
+	}
+#else
+	wxMemoryDC dc;
+
+	RawExtents Measure(wxString const& str) {
+		wxCoord width, height, descent, extlead;
+		dc.GetTextExtent(str, &width, &height, &descent, &extlead);
+		return RawExtents{width, height, descent, extlead};
+	}
+#endif
+
+	/// Look up a measurement, adding it with measure() on a miss
+	template<typename Map, typename Key, typename Func>
+	RawExtents const& Get(Map& map, Key const& key, Func&& measure) {
+		++glyph_lookups;
+		auto it = map.find(key);
+		if (it != map.end()) {
+			++glyph_hits;
+			return it->second;
+		}
+		// Templates can measure a huge number of distinct strings, so just
+		// start over rather than growing without bound
+		if (map.size() >= 16384)
+			map.clear();
+		return map.emplace(key, measure()).first->second;
+	}
 
+public:
+	bool Init(FontKey const& key, double fontsize) {
 #ifdef WIN32
 		// This is almost copypasta from TextSub
-		auto dc = CreateCompatibleDC(nullptr);
+		dc = CreateCompatibleDC(nullptr);
 		if (!dc) return false;
 
 		SetMapMode(dc, MM_TEXT);
 
 		LOGFONTW lf = {0};
 		lf.lfHeight = (LONG)fontsize;
-		lf.lfWeight = style->bold ? FW_BOLD : FW_NORMAL;
-		lf.lfItalic = style->italic;
-		lf.lfUnderline = style->underline;
-		lf.lfStrikeOut = style->strikeout;
-		lf.lfCharSet = style->encoding;
+		lf.lfWeight = key.bold ? FW_BOLD : FW_NORMAL;
+		lf.lfItalic = key.italic;
+		lf.lfUnderline = key.underline;
+		lf.lfStrikeOut = key.strikeout;
+		lf.lfCharSet = key.encoding;
 		lf.lfOutPrecision = OUT_TT_PRECIS;
 		lf.lfClipPrecision = CLIP_DEFAULT_PRECIS;
 		lf.lfQuality = ANTIALIASED_QUALITY;
 		lf.lfPitchAndFamily = DEFAULT_PITCH|FF_DONTCARE;
-		wcsncpy(lf.lfFaceName, agi::charset::ConvertW(style->font).c_str(), 31);
+		wcsncpy(lf.lfFaceName, agi::charset::ConvertW(key.face).c_str(), 31);
 
-		auto font = CreateFontIndirect(&lf);
+		font = CreateFontIndirect(&lf);
 		if (!font) return false;
 
-		auto old_font = SelectObject(dc, font);
+		old_font = SelectObject(dc, font);
+		GetTextMetrics(dc, &tm);
+#else
+		// fix fontsize to be 72 DPI
+		//fontsize = -FT_MulDiv((int)(fontsize+0.5), 72, thedc.GetPPI().y);
+
+		// USING wxTheFontList SEEMS TO CAUSE BAD LEAKS!
+		wxFont thefont(
+			(int)fontsize,
+			wxFONTFAMILY_DEFAULT,
+			key.italic ? wxFONTSTYLE_ITALIC : wxFONTSTYLE_NORMAL,
+			key.bold ? wxFONTWEIGHT_BOLD : wxFONTWEIGHT_NORMAL,
+			key.underline,
+			to_wx(key.face),
+			wxFONTENCODING_SYSTEM); // FIXME! make sure to get the right encoding here, make some translation table between windows and wx encodings
+		dc.SetFont(thefont);
+#endif
+		return true;
+	}
+
+#ifdef WIN32
+	~MeasuringFont() {
+		if (old_font) SelectObject(dc, old_font);
+		if (font) DeleteObject(font);
+		if (dc) DeleteDC(dc);
+	}
+#endif
 
-		std::wstring wtext(agi::charset::ConvertW(text));
+	void Measure(std::string const& text, double fontsize, double spacing, double &width, double &height, double &descent, double &extlead) {
+		std::lock_guard<std::mutex> lock(mutex);
+#ifdef WIN32
 		if (spacing != 0 ) {
+			std::wstring wtext(agi::charset::ConvertW(text));
 			width = 0;
 			for (auto c : wtext) {
-				SIZE sz;
-				GetTextExtentPoint32(dc, &c, 1, &sz);
-				width += sz.cx + spacing;
-				height = sz.cy;
+				auto const& sz = Get(glyphs, static_cast<uint32_t>(c), [&] { return Measure(&c, 1); });
+				width += sz.width + spacing;
+				height = sz.height;
 			}
 		}
 		else {
-			SIZE sz;
-			GetTextExtentPoint32(dc, &wtext[0], (int)wtext.size(), &sz);
-			width = sz.cx;
-			height = sz.cy;
+			auto const& sz = Get(strings, text, [&] {
+				std::wstring wtext(agi::charset::ConvertW(text));
+				return Measure(&wtext[0], (int)wtext.size());
+			});
+			width = sz.width;
+			height = sz.height;
 		}
 
-		TEXTMETRIC tm;
-		GetTextMetrics(dc, &tm);
 		descent = tm.tmDescent;
 		extlead = tm.tmExternalLeading;
-
-		SelectObject(dc, old_font);
-		DeleteObject(font);
-		DeleteObject(dc);
-
-#else // not WIN32
-		wxMemoryDC thedc;
-
-		// fix fontsize to be 72 DPI
-		//fontsize = -FT_MulDiv((int)(fontsize+0.5), 72, thedc.GetPPI().y);
-
-		// now try to get a font!
-		// use the font list to get some caching... (chance is the script will need the same font very often)
-		// USING wxTheFontList SEEMS TO CAUSE BAD LEAKS!
-		//wxFont *thefont = wxTheFontList->FindOrCreateFont(
-		wxFont thefont(
-			(int)fontsize,
-			wxFONTFAMILY_DEFAULT,
-			style->italic ? wxFONTSTYLE_ITALIC : wxFONTSTYLE_NORMAL,
-			style->bold ? wxFONTWEIGHT_BOLD : wxFONTWEIGHT_NORMAL,
-			style->underline,
-			to_wx(style->font),
-			wxFONTENCODING_SYSTEM); // FIXME! make sure to get the right encoding here, make some translation table between windows and wx encodings
-		thedc.SetFont(thefont);
-
-		wxString wtext(to_wx(text));
+#else
 		if (spacing) {
 			// If there's inter-character spacing, kerning info must not be used, so calculate width per character
 			// NOTE: Is kerning actually done either way?!
-			for (auto const& wc : wtext) {
-				int a, b, c, d;
-				thedc.GetTextExtent(wc, &a, &b, &c, &d);
-				double scaling = fontsize / (double)(b > 0 ? b : 1); // semi-workaround for missing OS/2 table data for scaling
-				width += (a + spacing)*scaling;
-				height = b > height ? b*scaling : height;
-				descent = c > descent ? c*scaling : descent;
-				extlead = d > extlead ? d*scaling : extlead;
+			for (auto const& wc : to_wx(text)) {
+				auto const& e = Get(glyphs, static_cast<uint32_t>(wc.GetValue()), [&] { return Measure(wxString(wc)); });
+				double scaling = fontsize / (double)(e.height > 0 ? e.height : 1); // semi-workaround for missing OS/2 table data for scaling
+				width += (e.width + spacing)*scaling;
+				height = e.height > height ? e.height*scaling : height;
+				descent = e.descent > descent ? e.descent*scaling : descent;
+				extlead = e.extlead > extlead ? e.extlead*scaling : extlead;
 			}
 		} else {
 			// If the inter-character spacing should be zero, kerning info can (and must) be used, so calculate everything in one go
-			wxCoord lwidth, lheight, ldescent, lextlead;
-			thedc.GetTextExtent(wtext, &lwidth, &lheight, &ldescent, &lextlead);
-			double scaling = fontsize / (double)(lheight > 0 ? lheight : 1); // semi-workaround for missing OS/2 table data for scaling
-			width = lwidth*scaling; height = lheight*scaling; descent = ldescent*scaling; extlead = lextlead*scaling;
+			auto const& e = Get(strings, text, [&] { return Measure(to_wx(text)); });
+			double scaling = fontsize / (double)(e.height > 0 ? e.height : 1); // semi-workaround for missing OS/2 table data for scaling
+			width = e.width*scaling; height = e.height*scaling; descent = e.descent*scaling; extlead = e.extlead*scaling;
 		}
 #endif
+	}
+};
+
+/// Get the font to measure a style with, creating it if needed
+std::shared_ptr<MeasuringFont> get_font(AssStyle *style, double fontsize) {
+	static std::mutex mutex;
+	// Deliberately never destroyed, as the DCs can't be freed after the
+	// GUI toolkit has been shut down
+	static auto fonts = new std::unordered_map<FontKey, std::shared_ptr<MeasuringFont>, FontKeyHash>;
+
+	FontKey key{style->font, (int)fontsize, style->bold, style->italic,
+		style->underline, style->strikeout, style->encoding};
+
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = fonts->find(key);
+	if (it != fonts->end()) {
+		++font_hits;
+		return it->second;
+	}
+
+	auto font = std::make_shared<MeasuringFont>();
+	if (!font->Init(key, fontsize))
+		return nullptr;
+
+	// Each font holds a DC and a font handle, which are limited resources
+	// on Windows, so only keep the fonts which a script is currently using
+	if (fonts->size() >= 64)
+		fonts->clear();
+	fonts->emplace(std::move(key), font);
+	return font;
+}
+}
+
+namespace Automation4 {
+	bool CalculateTextExtents(AssStyle *style, std::string const& text, double &width, double &height, double &descent, double &extlead)
+	{
+		width = height = descent = extlead = 0;
+		++calls;
+
+		double fontsize = style->fontsize * 64;
+		double spacing = style->spacing * 64;
+
+		auto font = get_font(style, fontsize);
+		if (!font) return false;
+		font->Measure(text, fontsize, spacing, width, height, descent, extlead);
 
 		// Compensate for scaling
 		width = style->scalex / 100 * width / 64;
@@ -170,6 +293,15 @@ namespace Automation4 {
 		return true;
 	}
 
+	TextExtentsStats GetTextExtentsStats() {
+		TextExtentsStats stats;
+		stats.calls = calls;
+		stats.font_hits = font_hits;
+		stats.glyph_lookups = glyph_lookups;
+		stats.glyph_hits = glyph_hits;
+		return stats;
+	}
+
 	ExportFilter::ExportFilter(std::string const& name, std::string const& description, int priority)
 	: AssExportFilter(name, description, priority)
 	{
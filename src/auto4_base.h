@@ -42,6 +42,7 @@
 #include "ass_export_filter.h"
 
 #include <boost/filesystem/path.hpp>
+#include <cstdint>
 #include <memory>
 #include <vector>
 
@@ -61,6 +62,21 @@ namespace Automation4 {
 	// Calculate the extents of a text string given a style
 	bool CalculateTextExtents(AssStyle *style, std::string const& text, double &width, double &height, double &descent, double &extlead);
 
+	/// Running totals of how CalculateTextExtents was answered
+	struct TextExtentsStats {
+		/// Number of calls
+		uint64_t calls = 0;
+		/// Calls which reused an already created font
+		uint64_t font_hits = 0;
+		/// Strings and characters looked up in the per-font measurement caches
+		uint64_t glyph_lookups = 0;
+		/// Lookups which didn't need to measure anything
+		uint64_t glyph_hits = 0;
+	};
+
+	/// Get the statistics for all calls to CalculateTextExtents so far
+	TextExtentsStats GetTextExtentsStats();
+
 	class ScriptDialog;
 
 	class ExportFilter : public AssExportFilter {
@@ -40,6 +40,7 @@
 #include "ass_style.h"
 #include "async_video_provider.h"
 #include "auto4_lua_factory.h"
+#include "auto4_lua_manifest.h"
 #include "audio_controller.h"
 #include "audio_timing.h"
 #include "command/command.h"
@@ -55,6 +56,7 @@
 
 #include <libaegisub/dispatch.h>
 #include <libaegisub/format.h>
+#include <libaegisub/log.h>
 #include <libaegisub/lua/ffi.h>
 #include <libaegisub/lua/modules.h>
 #include <libaegisub/lua/script_reader.h>
@@ -72,11 +74,15 @@
 #include <wx/clipbrd.h>
 #include <wx/log.h>
 #include <wx/msgdlg.h>
+#include <wx/timer.h>
 
 using namespace agi::lua;
 using namespace Automation4;
 
 namespace {
+	/// Commands are registered from the threads which scripts are loaded on
+	std::mutex command_mutex;
+
 	wxString get_wxstring(lua_State *L, int idx)
 	{
 		return wxString::FromUTF8(lua_tostring(L, idx));
@@ -372,6 +378,35 @@ namespace {
 
 		void ProcessSubs(AssFile *subs, wxWindow *export_dialog) override;
 	};
+	class LuaScript;
+
+	/// Placeholder for a macro of a script which was set up from its
+	/// manifest entry, which runs the script the first time it's needed
+	class LuaLazyCommand final : public cmd::Command {
+		LuaScript *script;
+		std::string cmd_name;
+		wxString display;
+		wxString help;
+		int cmd_type;
+
+		LuaCommand *Target() const;
+
+	public:
+		LuaLazyCommand(LuaScript *script, LuaManifestMacro const& macro);
+		~LuaLazyCommand();
+
+		const char* name() const override { return cmd_name.c_str(); }
+		wxString StrMenu(const agi::Context *) const override { return display; }
+		wxString StrDisplay(const agi::Context *) const override { return display; }
+		wxString StrHelp() const override;
+
+		int Type() const override;
+
+		void operator()(agi::Context *c) override;
+		bool Validate(const agi::Context *c) override;
+		bool IsActive(const agi::Context *c) override;
+	};
+
 	class LuaScript final : public Script {
 		lua_State *L = nullptr;
 
@@ -383,10 +418,31 @@ namespace {
 		std::vector<cmd::Command*> macros;
 		std::vector<std::unique_ptr<ExportFilter>> filters;
 
+		/// Was the script set up from its manifest entry? If so, macros holds
+		/// placeholders and the script is only run when one of them is used.
+		bool lazy = false;
+		/// The macros registered when a lazy script is run, which the
+		/// placeholders forward to
+		std::vector<std::unique_ptr<LuaCommand>> lazy_targets;
+		/// Number of placeholder macros currently running
+		int lazy_calls = 0;
+		/// Closes the Lua state of a lazy script once it's been idle for a while
+		std::unique_ptr<wxTimer> idle_timer;
+
 		/// load script and create internal structures etc.
 		void Create();
+		/// register placeholder macros from the script's manifest entry
+		void CreateLazy(LuaManifestEntry const& entry);
+		/// create the Lua environment and run the script
+		bool Load();
 		/// destroy internal structures, unreg features and delete environment
 		void Destroy();
+		/// delete the Lua environment and everything which refers to it
+		void CloseState();
+		/// close the Lua state of a lazy script if it isn't in use
+		void Unload();
+		/// record the script's metadata so that it can be loaded lazily next time
+		void UpdateManifest();
 
 		static int LuaInclude(lua_State *L);
 
@@ -395,9 +451,19 @@ namespace {
 		~LuaScript() { Destroy(); }
 
 		void RegisterCommand(LuaCommand *command);
-		void UnregisterCommand(LuaCommand *command);
+		void UnregisterCommand(cmd::Command *command);
 		void RegisterFilter(LuaExportFilter *filter);
 
+		bool IsLazy() const { return lazy; }
+		bool IsLoaded() const { return L != nullptr; }
+		void AddLazyTarget(std::unique_ptr<LuaCommand> command);
+		/// Get the macro a placeholder forwards to, optionally running the
+		/// script if it isn't already
+		LuaCommand *GetLazyTarget(std::string const& cmd_name, bool load);
+		/// Note that a placeholder started or finished running its macro
+		void BeginLazyCall();
+		void EndLazyCall();
+
 		static LuaScript* GetScriptObject(lua_State *L);
 
 		// Script implementation
@@ -407,7 +473,7 @@ namespace {
 		std::string GetDescription() const override { return description; }
 		std::string GetAuthor() const override { return author; }
 		std::string GetVersion() const override { return version; }
-		bool GetLoadedState() const override { return L != nullptr; }
+		bool GetLoadedState() const override { return L != nullptr || lazy; }
 
 		std::vector<cmd::Command*> GetMacros() const override { return macros; }
 		std::vector<ExportFilter*> GetFilters() const override;
@@ -416,24 +482,87 @@ namespace {
 	LuaScript::LuaScript(agi::fs::path const& filename)
 	: Script(filename)
 	{
-		Create();
+		LuaManifestEntry entry;
+		if (OPT_GET("Automation/Lazy Load")->GetBool() && FindManifestEntry(filename, entry))
+			CreateLazy(entry);
+		else
+			Create();
 	}
 
 	void LuaScript::Create()
 	{
 		Destroy();
+		lazy = false;
+		if (Load())
+			UpdateManifest();
+		else
+			RemoveManifestEntry(GetFilename());
+	}
 
+	void LuaScript::CreateLazy(LuaManifestEntry const& entry)
+	{
+		lazy = true;
+		name = entry.name;
+		description = entry.description;
+		author = entry.author;
+		version = entry.version;
+
+		for (auto const& macro : entry.macros) {
+			auto command = agi::make_unique<LuaLazyCommand>(this, macro);
+			macros.push_back(command.get());
+			std::lock_guard<std::mutex> lock(command_mutex);
+			cmd::reg(std::move(command));
+		}
+	}
+
+	void LuaScript::UpdateManifest()
+	{
+		if (!OPT_GET("Automation/Lazy Load")->GetBool()) return;
+
+		// Export filters have to exist before the export dialog is opened,
+		// so scripts which register them are always run at startup
+		if (!filters.empty()) {
+			RemoveManifestEntry(GetFilename());
+			return;
+		}
+
+		LuaManifestEntry entry;
+		entry.name = name;
+		entry.description = description;
+		entry.author = author;
+		entry.version = version;
+		for (auto command : macros) {
+			LuaManifestMacro macro;
+			macro.name = from_wx(command->StrDisplay(nullptr));
+			macro.help = from_wx(command->StrHelp());
+			macro.validate = !!(command->Type() & cmd::COMMAND_VALIDATE);
+			macro.toggle = !!(command->Type() & cmd::COMMAND_TOGGLE);
+			entry.macros.push_back(std::move(macro));
+		}
+		StoreManifestEntry(GetFilename(), std::move(entry));
+	}
+
+	bool LuaScript::Load()
+	{
 		name = GetPrettyFilename().string();
 
 		// create lua environment
 		L = luaL_newstate();
 		if (!L) {
 			description = "Could not initialize Lua state";
-			return;
+			return false;
 		}
 
 		bool loaded = false;
-		BOOST_SCOPE_EXIT_ALL(&) { if (!loaded) Destroy(); };
+		BOOST_SCOPE_EXIT_ALL(&) {
+			if (loaded) return;
+			// A lazy script's placeholders stay around so that it can be
+			// retried after fixing whatever went wrong
+			if (lazy)
+				CloseState();
+			else
+				Destroy();
+		};
 		LuaStackcheck stackcheck(L);
 
 		// register standard libs
@@ -453,10 +582,16 @@ namespace {
 		if (!Install(L, include_path)) {
 			description = get_string_or_default(L, 1);
 			lua_pop(L, 1);
-			return;
+			return false;
 		}
 		stackcheck.check_stack(0);
 
+		// Reuse the compiled versions of unchanged scripts and modules
+		if (OPT_GET("Automation/Bytecode Cache/Enabled")->GetBool()) {
+			EnableBytecodeCache(L, config::path->Decode("?local/luacache/"));
+			stackcheck.check_stack(0);
+		}
+
 		// prepare stuff in the registry
 
 		// store the script's filename
@@ -498,7 +633,7 @@ namespace {
 		if (!LoadFile(L, GetFilename())) {
 			description = get_string_or_default(L, 1);
 			lua_pop(L, 1);
-			return;
+			return false;
 		}
 		stackcheck.check_stack(1);
 
@@ -512,7 +647,7 @@ namespace {
 			// error occurred, assumed to be on top of Lua stack
 			description = agi::format("Error initialising Lua script \"%s\":\n\n%s", GetPrettyFilename().string(), get_string_or_default(L, -1));
 			lua_pop(L, 2); // error + error handler
-			return;
+			return false;
 		}
 		lua_pop(L, 1); // error handler
 		stackcheck.check_stack(0);
@@ -521,7 +656,7 @@ namespace {
 		if (lua_isnumber(L, -1) && lua_tointeger(L, -1) == 3) {
 			lua_pop(L, 1); // just to avoid tripping the stackcheck in debug
 			description = "Attempted to load an Automation 3 script as an Automation 4 Lua script. Automation 3 is no longer supported.";
-			return;
+			return false;
 		}
 
 		name = get_global_string(L, "script_name");
@@ -535,24 +670,86 @@ namespace {
 		lua_pop(L, 1);
 		// if we got this far, the script should be ready
 		loaded = true;
+		return true;
 	}
 
 	void LuaScript::Destroy()
 	{
-		// Assume the script object is clean if there's no Lua state
-		if (!L) return;
-
 		// loops backwards because commands remove themselves from macros when
 		// they're unregistered
 		for (int i = macros.size() - 1; i >= 0; --i)
 			cmd::unreg(macros[i]->name());
 
+		CloseState();
+	}
+
+	void LuaScript::CloseState()
+	{
+		// Assume the script object is clean if there's no Lua state
+		if (!L) return;
+
+		lazy_targets.clear();
 		filters.clear();
 
 		lua_close(L);
 		L = nullptr;
 	}
 
+	void LuaScript::Unload()
+	{
+		if (!L || lazy_calls || !filters.empty()) return;
+		LOG_D("automation/lua") << "Closing idle script " << GetPrettyFilename();
+		CloseState();
+	}
+
+	void LuaScript::AddLazyTarget(std::unique_ptr<LuaCommand> command)
+	{
+		lazy_targets.push_back(std::move(command));
+	}
+
+	LuaCommand *LuaScript::GetLazyTarget(std::string const& cmd_name, bool load)
+	{
+		if (!L) {
+			if (!load) return nullptr;
+			if (!Load()) {
+				wxLogError(_("Failed to load Automation script '%s':\n%s"), GetPrettyFilename().wstring(), description);
+				return nullptr;
+			}
+		}
+
+		for (auto const& command : lazy_targets) {
+			if (command->name() == cmd_name)
+				return command.get();
+		}
+
+		if (load)
+			wxLogError(_("The Automation script '%s' no longer has the macro '%s'. Reload the script to update the menus."), GetPrettyFilename().wstring(), to_wx(cmd_name));
+		return nullptr;
+	}
+
+	void LuaScript::BeginLazyCall()
+	{
+		++lazy_calls;
+		if (idle_timer)
+			idle_timer->Stop();
+	}
+
+	void LuaScript::EndLazyCall()
+	{
+		--lazy_calls;
+
+		int minutes = OPT_GET("Automation/Idle Unload")->GetInt();
+		if (minutes <= 0) return;
+
+		// Created here rather than in the constructor as scripts are
+		// constructed on worker threads and timers must be on the main one
+		if (!idle_timer) {
+			idle_timer = agi::make_unique<wxTimer>();
+			idle_timer->Bind(wxEVT_TIMER, [=](wxTimerEvent&) { Unload(); });
+		}
+		idle_timer->Start(minutes * 60 * 1000, wxTIMER_ONE_SHOT);
+	}
+
 	std::vector<ExportFilter*> LuaScript::GetFilters() const
 	{
 		std::vector<ExportFilter *> ret;
@@ -563,16 +760,27 @@ namespace {
 
 	void LuaScript::RegisterCommand(LuaCommand *command)
 	{
-		for (auto macro : macros) {
-			if (macro->name() == command->name()) {
+		auto check_name = [&](cmd::Command *macro) {
+			if (macro->name() == std::string(command->name())) {
 				error(L, "A macro named '%s' is already defined in script '%s'",
 					command->StrDisplay(nullptr).utf8_str().data(), name.c_str());
 			}
+		};
+
+		// Macros of lazy scripts are owned by the script rather than being
+		// registered, and macros holds the placeholders for them
+		if (lazy) {
+			for (auto const& macro : lazy_targets)
+				check_name(macro.get());
+			return;
 		}
+
+		for (auto macro : macros)
+			check_name(macro);
 		macros.push_back(command);
 	}
 
-	void LuaScript::UnregisterCommand(LuaCommand *command)
+	void LuaScript::UnregisterCommand(cmd::Command *command)
 	{
 		macros.erase(remove(macros.begin(), macros.end(), command), macros.end());
 	}
@@ -623,6 +831,7 @@ namespace {
 	void LuaThreadedCall(lua_State *L, int nargs, int nresults, std::string const& title, wxWindow *parent, bool can_open_config)
 	{
 		bool failed = false;
+		auto extents_before = GetTextExtentsStats();
 		BackgroundScriptRunner bsr(parent, title);
 		bsr.Run([&](ProgressSink *ps) {
 			LuaProgressSink lps(L, ps, can_open_config);
@@ -645,6 +854,15 @@ namespace {
 
 			lua_gc(L, LUA_GCCOLLECT, 0);
 		});
+
+		auto extents = GetTextExtentsStats();
+		if (uint64_t calls = extents.calls - extents_before.calls) {
+			uint64_t lookups = extents.glyph_lookups - extents_before.glyph_lookups;
+			LOG_I("automation/lua") << title << ": " << calls << " text_extents calls, "
+				<< 100 * (extents.font_hits - extents_before.font_hits) / calls << "% font cache hits, "
+				<< (lookups ? 100 * (extents.glyph_hits - extents_before.glyph_hits) / lookups : 0) << "% glyph cache hits";
+		}
+
 		if (failed)
 			throw agi::UserCancelException("Script threw an error");
 	}
@@ -675,10 +893,12 @@ namespace {
 	// LuaFeatureMacro
 	int LuaCommand::LuaRegister(lua_State *L)
 	{
-		static std::mutex mutex;
 		auto command = agi::make_unique<LuaCommand>(L);
-		{
-			std::lock_guard<std::mutex> lock(mutex);
+		auto script = LuaScript::GetScriptObject(L);
+		if (script->IsLazy())
+			script->AddLazyTarget(std::move(command));
+		else {
+			std::lock_guard<std::mutex> lock(command_mutex);
 			cmd::reg(std::move(command));
 		}
 		return 0;
@@ -918,6 +1138,75 @@ namespace {
 		return result;
 	}
 
+	// LuaLazyCommand
+	LuaLazyCommand::LuaLazyCommand(LuaScript *script, LuaManifestMacro const& macro)
+	: script(script)
+	, cmd_name(agi::format("automation/lua/%s/%s", script->GetFilename().stem().string(), macro.name))
+	, display(to_wx(macro.name))
+	, help(to_wx(macro.help))
+	, cmd_type(cmd::COMMAND_NORMAL)
+	{
+		if (macro.validate)
+			cmd_type |= cmd::COMMAND_VALIDATE;
+		if (macro.toggle)
+			cmd_type |= cmd::COMMAND_TOGGLE;
+	}
+
+	LuaLazyCommand::~LuaLazyCommand()
+	{
+		script->UnregisterCommand(this);
+	}
+
+	LuaCommand *LuaLazyCommand::Target() const
+	{
+		return script->GetLazyTarget(cmd_name, false);
+	}
+
+	wxString LuaLazyCommand::StrHelp() const
+	{
+		if (auto target = Target())
+			return target->StrHelp();
+		return help;
+	}
+
+	int LuaLazyCommand::Type() const
+	{
+		if (auto target = Target())
+			return target->Type();
+		return cmd_type;
+	}
+
+	bool LuaLazyCommand::Validate(const agi::Context *c)
+	{
+		// Running the script just to find out if the menu item should be
+		// enabled would defeat the point, so it's checked when it's run
+		if (auto target = Target())
+			return target->Validate(c);
+		return true;
+	}
+
+	bool LuaLazyCommand::IsActive(const agi::Context *c)
+	{
+		if (auto target = Target())
+			return target->IsActive(c);
+		return false;
+	}
+
+	void LuaLazyCommand::operator()(agi::Context *c)
+	{
+		bool was_loaded = script->IsLoaded();
+		auto target = script->GetLazyTarget(cmd_name, true);
+		if (!target) return;
+
+		// If the script had to be loaded, Validate hasn't been run for real
+		if (!was_loaded && !target->Validate(c))
+			return;
+
+		script->BeginLazyCall();
+		BOOST_SCOPE_EXIT_ALL(&) { script->EndLazyCall(); };
+		(*target)(c);
+	}
+
 	// LuaFeatureFilter
 	LuaExportFilter::LuaExportFilter(lua_State *L)
 	: ExportFilter(check_string(L, 1), lua_tostring(L, 2), lua_tointeger(L, 3))
@@ -1028,6 +1317,12 @@ namespace Automation4 {
 	LuaScriptFactory::LuaScriptFactory()
 	: ScriptFactory("Lua", "*.lua,*.moon")
 	{
+		// Entries for scripts which have since been moved or deleted are
+		// never replaced, so trim the bytecode cache once per session
+		if (OPT_GET("Automation/Bytecode Cache/Enabled")->GetBool())
+			CleanCache(config::path->Decode("?local/luacache/"), "*.luac",
+				OPT_GET("Automation/Bytecode Cache/Size")->GetInt(),
+				OPT_GET("Automation/Bytecode Cache/Files")->GetInt());
 	}
 
 	std::unique_ptr<Script> LuaScriptFactory::Produce(agi::fs::path const& filename) const
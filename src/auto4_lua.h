@@ -33,6 +33,7 @@
 #include <vector>
 #include <wx/string.h>
 
+class AssDialogue;
 class AssEntry;
 class wxControl;
 class wxWindow;
@@ -62,6 +63,8 @@ namespace Automation4 {
 		void CheckAllowModify();
 		/// throws an error if the line index is out of bounds
 		void CheckBounds(int idx);
+		/// throws an error if the line at the (zero-based) index isn't dialogue
+		const AssDialogue *CheckDialogue(size_t idx);
 
 		/// How ass file been modified by the script since the last commit
 		int modification_type = 0;
@@ -99,6 +102,12 @@ namespace Automation4 {
 		void ObjectDeleteRange(lua_State *L);
 		void ObjectAppend(lua_State *L);
 		void ObjectInsert(lua_State *L);
+		/// subs.get_fields(first, last, field[, field2, ...]): return an array
+		/// of the values of each field for the dialogue lines in [first, last]
+		int ObjectGetFields(lua_State *L);
+		/// subs.set_fields(first, {field = {values}, ...}): set the given
+		/// fields of consecutive dialogue lines starting at first
+		void ObjectSetFields(lua_State *L);
 		void ObjectGarbageCollect(lua_State *L);
 		int ObjectIPairs(lua_State *L);
 		int IterNext(lua_State *L);
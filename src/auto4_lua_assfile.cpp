@@ -124,6 +124,106 @@ namespace {
 		}
 	}
 
+	/// Dialogue fields which can be read and written in bulk by
+	/// subs.get_fields and subs.set_fields
+	enum class DialogueField {
+		Comment, Layer, Start, End, Style, Actor, Effect,
+		MarginL, MarginR, MarginT, Text
+	};
+
+	struct DialogueFieldInfo {
+		const char *name;
+		DialogueField field;
+		/// What sort of change modifying this field is
+		int commit_type;
+	};
+
+	const DialogueFieldInfo dialogue_fields[] = {
+		{"comment",    DialogueField::Comment, AssFile::COMMIT_DIAG_META},
+		{"layer",      DialogueField::Layer,   AssFile::COMMIT_DIAG_META},
+		{"start_time", DialogueField::Start,   AssFile::COMMIT_DIAG_TIME},
+		{"end_time",   DialogueField::End,     AssFile::COMMIT_DIAG_TIME},
+		{"style",      DialogueField::Style,   AssFile::COMMIT_DIAG_META},
+		{"actor",      DialogueField::Actor,   AssFile::COMMIT_DIAG_META},
+		{"effect",     DialogueField::Effect,  AssFile::COMMIT_DIAG_META},
+		{"margin_l",   DialogueField::MarginL, AssFile::COMMIT_DIAG_META},
+		{"margin_r",   DialogueField::MarginR, AssFile::COMMIT_DIAG_META},
+		{"margin_t",   DialogueField::MarginT, AssFile::COMMIT_DIAG_META},
+		{"margin_b",   DialogueField::MarginT, AssFile::COMMIT_DIAG_META},
+		{"text",       DialogueField::Text,    AssFile::COMMIT_DIAG_TEXT},
+	};
+
+	DialogueFieldInfo const& check_dialogue_field(lua_State *L, int idx)
+	{
+		// Checked explicitly rather than with lua_tostring as this is also
+		// used on table keys, which converting to a string would break
+		if (lua_type(L, idx) != LUA_TSTRING)
+			error(L, "Field names must be strings");
+		const char *name = lua_tostring(L, idx);
+		for (auto const& info : dialogue_fields) {
+			if (strcmp(info.name, name) == 0)
+				return info;
+		}
+		error(L, "Unknown or unsupported dialogue field: '%s'", name);
+	}
+
+	void push_dialogue_field(lua_State *L, const AssDialogue *dia, DialogueField field)
+	{
+		switch (field) {
+			case DialogueField::Comment: push_value(L, dia->Comment); break;
+			case DialogueField::Layer:   push_value(L, dia->Layer); break;
+			case DialogueField::Start:   push_value(L, (int)dia->Start); break;
+			case DialogueField::End:     push_value(L, (int)dia->End); break;
+			case DialogueField::Style:   push_value(L, dia->Style.get()); break;
+			case DialogueField::Actor:   push_value(L, dia->Actor.get()); break;
+			case DialogueField::Effect:  push_value(L, dia->Effect.get()); break;
+			case DialogueField::MarginL: push_value(L, dia->Margin[0]); break;
+			case DialogueField::MarginR: push_value(L, dia->Margin[1]); break;
+			case DialogueField::MarginT: push_value(L, dia->Margin[2]); break;
+			case DialogueField::Text:    push_value(L, dia->Text.get()); break;
+		}
+	}
+
+	/// Set a field of the line from the value on the top of the stack,
+	/// returning false if the value is of the wrong type
+	bool set_dialogue_field(lua_State *L, AssDialogue *dia, DialogueField field)
+	{
+		switch (field) {
+			case DialogueField::Comment:
+				if (!lua_isboolean(L, -1)) return false;
+				dia->Comment = !!lua_toboolean(L, -1);
+				return true;
+			case DialogueField::Style:
+			case DialogueField::Actor:
+			case DialogueField::Effect:
+			case DialogueField::Text:
+			{
+				if (!lua_isstring(L, -1)) return false;
+				std::string value(lua_tostring(L, -1));
+				if (field == DialogueField::Style) dia->Style = value;
+				else if (field == DialogueField::Actor) dia->Actor = value;
+				else if (field == DialogueField::Effect) dia->Effect = value;
+				else dia->Text = value;
+				return true;
+			}
+			default:
+				break;
+		}
+
+		if (!lua_isnumber(L, -1)) return false;
+		int value = lua_tointeger(L, -1);
+		switch (field) {
+			case DialogueField::Layer:   dia->Layer = value; break;
+			case DialogueField::Start:   dia->Start = value; break;
+			case DialogueField::End:     dia->End = value; break;
+			case DialogueField::MarginL: dia->Margin[0] = value; break;
+			case DialogueField::MarginR: dia->Margin[1] = value; break;
+			case DialogueField::MarginT: dia->Margin[2] = value; break;
+			default: break;
+		}
+		return true;
+	}
+
 	template<typename T, typename U>
 	const T *check_cast_constptr(const U *value) {
 		return typeid(const T) == typeid(*value) ? static_cast<const T *>(value) : nullptr;
@@ -362,6 +462,10 @@ namespace Automation4 {
 					lua_pushcclosure(L, closure_wrapper_v<&LuaAssFile::ObjectAppend, false>, 1);
 				else if (strcmp(idx, "script_resolution") == 0)
 					lua_pushcclosure(L, closure_wrapper<&LuaAssFile::LuaGetScriptResolution>, 1);
+				else if (strcmp(idx, "get_fields") == 0)
+					lua_pushcclosure(L, closure_wrapper<&LuaAssFile::ObjectGetFields>, 1);
+				else if (strcmp(idx, "set_fields") == 0)
+					lua_pushcclosure(L, closure_wrapper_v<&LuaAssFile::ObjectSetFields, false>, 1);
 				else {
 					// idiot
 					lua_pop(L, 1);
@@ -593,6 +697,112 @@ namespace Automation4 {
 		lines.insert(lines.begin() + before - 1, new_entries.begin(), new_entries.end());
 	}
 
+	const AssDialogue *LuaAssFile::CheckDialogue(size_t idx)
+	{
+		auto dia = lines[idx] ? check_cast_constptr<AssDialogue>(lines[idx]) : nullptr;
+		if (!dia)
+			error(L, "Line %d is not a dialogue line", (int)idx + 1);
+		return dia;
+	}
+
+	int LuaAssFile::ObjectGetFields(lua_State *L)
+	{
+		size_t first = check_uint(L, 1);
+		size_t last = check_uint(L, 2);
+		int field_count = lua_gettop(L) - 2;
+		argcheck(L, first > 0 && first <= last + 1, 1, "Out of range line index");
+		argcheck(L, last <= lines.size(), 2, "Out of range line index");
+		argcheck(L, field_count > 0, 3, "No fields requested");
+
+		std::vector<DialogueField> fields;
+		fields.reserve(field_count);
+		for (int i = 0; i < field_count; ++i)
+			fields.push_back(check_dialogue_field(L, i + 3).field);
+
+		if (!lua_checkstack(L, field_count + 1))
+			return error(L, "Too many fields requested");
+
+		size_t count = last - first + 1;
+		int base = lua_gettop(L);
+		for (int i = 0; i < field_count; ++i)
+			lua_createtable(L, count, 0);
+
+		for (size_t i = 0; i < count; ++i) {
+			auto dia = CheckDialogue(first + i - 1);
+			for (int j = 0; j < field_count; ++j) {
+				push_dialogue_field(L, dia, fields[j]);
+				lua_rawseti(L, base + j + 1, i + 1);
+			}
+		}
+
+		return field_count;
+	}
+
+	void LuaAssFile::ObjectSetFields(lua_State *L)
+	{
+		CheckAllowModify();
+
+		size_t first = check_uint(L, 1);
+		argcheck(L, first > 0, 1, "Out of range line index");
+		argcheck(L, lua_istable(L, 2), 2, "Expected a table of fields");
+
+		// Collect the columns, each of which must cover the same lines
+		std::vector<DialogueFieldInfo const*> fields;
+		size_t count = 0;
+		int commit_type = 0;
+		lua_pushvalue(L, 2);
+		lua_for_each(L, [&] {
+			auto& info = check_dialogue_field(L, -2);
+			if (!lua_istable(L, -1))
+				error(L, "Values for field '%s' must be an array", info.name);
+			size_t len = lua_objlen(L, -1);
+			if (fields.empty())
+				count = len;
+			else if (len != count)
+				error(L, "Field '%s' has %d values but other fields have %d", info.name, (int)len, (int)count);
+			fields.push_back(&info);
+			commit_type |= info.commit_type;
+		});
+
+		if (fields.empty() || count == 0) return;
+		argcheck(L, first - 1 + count <= lines.size(), 1, "Out of range line index");
+
+		// Validate everything before modifying anything so that an error
+		// doesn't leave a partially-applied change behind
+		for (size_t i = 0; i < count; ++i)
+			CheckDialogue(first + i - 1);
+
+		// The columns are pushed in the same order as fields so they can be
+		// looked up by stack index while iterating over the lines
+		int base = lua_gettop(L);
+		if (!lua_checkstack(L, (int)fields.size() + 1))
+			error(L, "Too many fields");
+		for (auto info : fields)
+			lua_getfield(L, 2, info->name);
+
+		std::vector<std::unique_ptr<AssDialogue>> updated;
+		updated.reserve(count);
+		for (size_t i = 0; i < count; ++i) {
+			// Lines can't be modified in place as the original is still
+			// owned by the file until processing completes
+			auto dia = agi::make_unique<AssDialogue>(*CheckDialogue(first + i - 1));
+			for (size_t j = 0; j < fields.size(); ++j) {
+				lua_rawgeti(L, base + j + 1, i + 1);
+				if (!set_dialogue_field(L, dia.get(), fields[j]->field))
+					error(L, "Invalid value for field '%s' of line %d", fields[j]->name, (int)(first + i));
+				lua_pop(L, 1);
+			}
+			updated.push_back(std::move(dia));
+		}
+		lua_settop(L, base);
+
+		for (size_t i = 0; i < count; ++i) {
+			QueueLineForDeletion(first + i - 1);
+			AssignLine(first + i - 1, std::move(updated[i]));
+		}
+		modification_type |= commit_type;
+	}
+
 	void LuaAssFile::ObjectGarbageCollect(lua_State *L)
 	{
 		references--;
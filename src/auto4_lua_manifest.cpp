@@ -0,0 +1,214 @@
+// Copyright (c) 2014, Thomas Goyne <plorkyeran@aegisub.org>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+/// @file auto4_lua_manifest.cpp
+/// @brief Cached registration metadata for lazily-loaded Lua scripts
+/// @ingroup scripting
+
+#include "auto4_lua_manifest.h"
+
+#include "options.h"
+
+#include <libaegisub/cajun/elements.h>
+#include <libaegisub/cajun/reader.h>
+#include <libaegisub/cajun/writer.h>
+#include <libaegisub/dispatch.h>
+#include <libaegisub/fs.h>
+#include <libaegisub/io.h>
+#include <libaegisub/log.h>
+#include <libaegisub/path.h>
+
+#include <map>
+#include <mutex>
+
+namespace Automation4 {
+	// In the same namespace as the types so that they're found when
+	// comparing vectors of them
+	static bool operator==(LuaManifestMacro const& a, LuaManifestMacro const& b) {
+		return a.name == b.name && a.help == b.help && a.validate == b.validate && a.toggle == b.toggle;
+	}
+
+	static bool operator==(LuaManifestEntry const& a, LuaManifestEntry const& b) {
+		return a.modified == b.modified && a.size == b.size
+			&& a.name == b.name && a.description == b.description
+			&& a.author == b.author && a.version == b.version
+			&& a.macros == b.macros;
+	}
+}
+
+namespace {
+using namespace Automation4;
+
+class Manifest {
+	std::mutex mutex;
+	agi::fs::path filename;
+	/// Entries by script path; only valid once loaded is set
+	std::map<std::string, LuaManifestEntry> entries;
+	bool loaded = false;
+	/// Has a save been queued which hasn't run yet?
+	bool save_queued = false;
+
+	void Load() {
+		if (loaded) return;
+		loaded = true;
+		filename = config::path->Decode("?local/automation_manifest.json");
+
+		try {
+			json::UnknownElement root;
+			json::Reader::Read(root, *agi::io::Open(filename));
+			for (auto const& script : static_cast<json::Object const&>(root)) {
+				json::Object const& obj = script.second;
+				LuaManifestEntry entry;
+				entry.modified = static_cast<json::Integer const&>(obj.at("modified"));
+				entry.size = static_cast<json::Integer const&>(obj.at("size"));
+				entry.name = static_cast<json::String const&>(obj.at("name"));
+				entry.description = static_cast<json::String const&>(obj.at("description"));
+				entry.author = static_cast<json::String const&>(obj.at("author"));
+				entry.version = static_cast<json::String const&>(obj.at("version"));
+				for (json::Object const& macro : static_cast<json::Array const&>(obj.at("macros"))) {
+					LuaManifestMacro m;
+					m.name = static_cast<json::String const&>(macro.at("name"));
+					m.help = static_cast<json::String const&>(macro.at("help"));
+					m.validate = static_cast<json::Boolean const&>(macro.at("validate"));
+					m.toggle = static_cast<json::Boolean const&>(macro.at("toggle"));
+					entry.macros.push_back(std::move(m));
+				}
+				entries[script.first] = std::move(entry);
+			}
+		}
+		catch (agi::Exception const& e) {
+			LOG_D("auto4/lua/manifest") << "Cannot load manifest: " << e.GetMessage();
+			entries.clear();
+		}
+		catch (std::exception const& e) {
+			// Malformed manifests just get rebuilt
+			LOG_D("auto4/lua/manifest") << "Cannot load manifest: " << e.what();
+			entries.clear();
+		}
+	}
+
+	void Save() {
+		json::Object root;
+		for (auto const& script : entries) {
+			auto const& entry = script.second;
+			json::Array macros;
+			for (auto const& macro : entry.macros) {
+				json::Object m;
+				m["name"] = macro.name;
+				m["help"] = macro.help;
+				m["validate"] = macro.validate;
+				m["toggle"] = macro.toggle;
+				macros.push_back(std::move(m));
+			}
+
+			json::Object obj;
+			obj["modified"] = entry.modified;
+			obj["size"] = entry.size;
+			obj["name"] = entry.name;
+			obj["description"] = entry.description;
+			obj["author"] = entry.author;
+			obj["version"] = entry.version;
+			obj["macros"] = std::move(macros);
+			root[script.first] = std::move(obj);
+		}
+
+		try {
+			agi::JsonWriter::Write(root, agi::io::Save(filename).Get());
+		}
+		catch (agi::fs::FileSystemError const& e) {
+			LOG_E("auto4/lua/manifest") << "Cannot save manifest: " << e.GetMessage();
+		}
+	}
+
+	/// Save the manifest once the main thread is next idle. Scripts are
+	/// loaded while the main thread waits for them, so every change made
+	/// while scanning a directory of scripts ends up in a single save.
+	void QueueSave() {
+		if (save_queued) return;
+		save_queued = true;
+		agi::dispatch::Main().Async([this] {
+			std::lock_guard<std::mutex> lock(mutex);
+			save_queued = false;
+			Save();
+		});
+	}
+
+public:
+	bool Find(agi::fs::path const& script, LuaManifestEntry& entry) {
+		std::lock_guard<std::mutex> lock(mutex);
+		Load();
+
+		auto it = entries.find(script.string());
+		if (it == entries.end()) return false;
+
+		try {
+			if (it->second.modified != agi::fs::ModifiedTime(script) || it->second.size != static_cast<int64_t>(agi::fs::Size(script)))
+				return false;
+		}
+		catch (agi::fs::FileSystemError const&) {
+			return false;
+		}
+
+		entry = it->second;
+		return true;
+	}
+
+	void Store(agi::fs::path const& script, LuaManifestEntry entry) {
+		try {
+			entry.modified = agi::fs::ModifiedTime(script);
+			entry.size = agi::fs::Size(script);
+		}
+		catch (agi::fs::FileSystemError const&) {
+			Remove(script);
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		Load();
+
+		auto& existing = entries[script.string()];
+		if (existing == entry) return;
+		existing = std::move(entry);
+		QueueSave();
+	}
+
+	void Remove(agi::fs::path const& script) {
+		std::lock_guard<std::mutex> lock(mutex);
+		Load();
+		if (entries.erase(script.string()))
+			QueueSave();
+	}
+};
+
+Manifest& manifest() {
+	static Manifest instance;
+	return instance;
+}
+}
+
+namespace Automation4 {
+	bool FindManifestEntry(agi::fs::path const& script, LuaManifestEntry& entry) {
+		return manifest().Find(script, entry);
+	}
+
+	void StoreManifestEntry(agi::fs::path const& script, LuaManifestEntry entry) {
+		manifest().Store(script, std::move(entry));
+	}
+
+	void RemoveManifestEntry(agi::fs::path const& script) {
+		manifest().Remove(script);
+	}
+}
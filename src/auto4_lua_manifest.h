@@ -0,0 +1,72 @@
+// Copyright (c) 2014, Thomas Goyne <plorkyeran@aegisub.org>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+/// @file auto4_lua_manifest.h
+/// @brief Cached registration metadata for lazily-loaded Lua scripts
+/// @ingroup scripting
+
+#pragma once
+
+#include <libaegisub/fs_fwd.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Automation4 {
+	/// A macro registered by a script
+	struct LuaManifestMacro {
+		/// Name passed to register_macro, which is also its menu path
+		std::string name;
+		std::string help;
+		/// Does the macro have a validation function?
+		bool validate = false;
+		/// Does the macro have an is-active function?
+		bool toggle = false;
+	};
+
+	/// Everything about a script needed to show it in the UI before it runs
+	struct LuaManifestEntry {
+		/// Modification time of the script file the entry was made from
+		int64_t modified = 0;
+		/// Size of the script file the entry was made from
+		int64_t size = 0;
+
+		std::string name;
+		std::string description;
+		std::string author;
+		std::string version;
+		std::vector<LuaManifestMacro> macros;
+	};
+
+	/// @brief Look up the manifest entry for a script
+	/// @param script Path to the script
+	/// @param[out] entry Set to the entry if one is found
+	/// @return Was there an entry which is still valid for the file?
+	///
+	/// Entries are invalidated by changes to the script file, but not by
+	/// changes to anything it includes; reloading the script refreshes them.
+	bool FindManifestEntry(agi::fs::path const& script, LuaManifestEntry& entry);
+
+	/// Record the entry for a script which was just run. If this changes
+	/// the manifest, it's saved once the scripts currently being loaded
+	/// have all finished. The modification time and size are filled in
+	/// from the file.
+	void StoreManifestEntry(agi::fs::path const& script, LuaManifestEntry entry);
+
+	/// Forget a script which can't be loaded lazily
+	void RemoveManifestEntry(agi::fs::path const& script);
+}
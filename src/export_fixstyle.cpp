@@ -43,17 +43,34 @@
 #include <wx/intl.h>
 
 AssFixStylesFilter::AssFixStylesFilter()
-: AssExportFilter(from_wx(_("Fix Styles")), from_wx(_("Fixes styles by replacing any style that isn't available on file with Default.")), -5000)
+: PerLineExportFilter(from_wx(_("Fix Styles")), from_wx(_("Fixes styles by replacing any style that isn't available on file with Default.")), -5000)
 {
 }
 
-void AssFixStylesFilter::ProcessSubs(AssFile *subs) {
-	auto styles = subs->GetStyles();
+namespace {
+std::vector<std::string> sorted_styles(AssFile const& subs) {
+	auto styles = subs.GetStyles();
 	for (auto& str : styles) boost::to_lower(str);
 	sort(begin(styles), end(styles));
+	return styles;
+}
+
+void fix_style(std::vector<std::string> const& styles, AssDialogue &diag) {
+	if (!binary_search(begin(styles), end(styles), boost::to_lower_copy(diag.Style.get())))
+		diag.Style = "Default";
+}
+}
+
+void AssFixStylesFilter::ProcessSubs(AssFile *subs) {
+	auto styles = sorted_styles(*subs);
+	for (auto& diag : subs->Events)
+		fix_style(styles, diag);
+}
+
+void AssFixStylesFilter::PrepareLines(AssFile const& subs) {
+	styles = sorted_styles(subs);
+}
 
-	for (auto& diag : subs->Events) {
-		if (!binary_search(begin(styles), end(styles), boost::to_lower_copy(diag.Style.get())))
-			diag.Style = "Default";
-	}
+void AssFixStylesFilter::ProcessLine(AssDialogue &diag) const {
+	fix_style(styles, diag);
 }
@@ -34,11 +34,19 @@
 
 #include "ass_export_filter.h"
 
+#include <string>
+#include <vector>
+
 /// @class AssFixStylesFilter
 /// @brief Fixes styles by replacing any style that isn't available on file with Default
-class AssFixStylesFilter final : public AssExportFilter {
+class AssFixStylesFilter final : public PerLineExportFilter {
+	/// Lowercase names of the styles in the file being processed, sorted
+	std::vector<std::string> styles;
+
 public:
+	using PerLineExportFilter::ProcessSubs;
 	static void ProcessSubs(AssFile *subs);
-	void ProcessSubs(AssFile *subs, wxWindow *) override { ProcessSubs(subs); }
+	void PrepareLines(AssFile const& subs) override;
+	void ProcessLine(AssDialogue &diag) const override;
 	AssFixStylesFilter();
 };
@@ -30,14 +30,13 @@
 #include "export_framerate.h"
 
 #include "ass_dialogue.h"
-#include "ass_file.h"
 #include "async_video_provider.h"
 #include "compat.h"
 #include "format.h"
 #include "include/aegisub/context.h"
 #include "project.h"
 
-#include <libaegisub/of_type_adaptor.h>
+#include <libaegisub/ass/override.h>
 
 #include <utility>
 #include <wx/button.h>
@@ -49,16 +48,12 @@
 #include <wx/textctrl.h>
 
 AssTransformFramerateFilter::AssTransformFramerateFilter()
-: AssExportFilter(from_wx(_("Transform Framerate")),
+: PerLineExportFilter(from_wx(_("Transform Framerate")),
 	from_wx(_("Transform subtitle times, including those in override tags, from an input framerate to an output framerate.\n\nThis is useful for converting regular time subtitles to VFRaC time subtitles for hardsubbing.\nIt can also be used to convert subtitles to a different speed video, such as NTSC to PAL speedup.")),
 	1000)
 {
 }
 
-void AssTransformFramerateFilter::ProcessSubs(AssFile *subs, wxWindow *) {
-	TransformFrameRate(subs);
-}
-
 wxWindow *AssTransformFramerateFilter::GetConfigDialogWindow(wxWindow *parent, agi::Context *c) {
 	LoadSettings(true, c);
 
@@ -152,64 +147,87 @@ static int trunc_cs(int time) {
 	return (time / 10) * 10;
 }
 
-void AssTransformFramerateFilter::TransformTimeTags(std::string const& name, AssOverrideParameter *curParam, void *curData) {
-	VariableDataType type = curParam->GetType();
-	if (type != VariableDataType::INT && type != VariableDataType::FLOAT) return;
-
-	AssTransformFramerateFilter *instance = static_cast<AssTransformFramerateFilter*>(curData);
-	AssDialogue *curDiag = instance->line;
-
-	int parVal = curParam->Get<int>();
-
-	switch (curParam->classification) {
-		case AssParameterClass::RELATIVE_TIME_START: {
-			int value = instance->ConvertTime(trunc_cs(curDiag->Start) + parVal) - instance->newStart;
-
-			// An end time of 0 is actually the end time of the line, so ensure
-			// nonzero is never converted to 0
-			// Needed here rather than the end case because start/end here mean
-			// which end of the line the time is relative to, not whether it's
-			// the start or end time (compare \move and \fad)
-			if (value == 0 && parVal != 0) value = 1;
-			curParam->Set(value);
-			break;
-		}
-		case AssParameterClass::RELATIVE_TIME_END:
-			curParam->Set(instance->newEnd - instance->ConvertTime(trunc_cs(curDiag->End) - parVal));
-			break;
-		case AssParameterClass::KARAOKE: {
-			int start = curDiag->Start / 10 + instance->oldK + parVal;
-			int value = (instance->ConvertTime(start * 10) - instance->newStart) / 10 - instance->newK;
-			instance->oldK += parVal;
-			instance->newK += value;
-			curParam->Set(value);
-			break;
+struct AssTransformFramerateFilter::LineState {
+	AssDialogue const& line;
+	int newStart;
+	int newEnd;
+	int newK;
+	int oldK;
+};
+
+void AssTransformFramerateFilter::TransformTimeTags(agi::ass::Tag const& tag, LineState &state, agi::ass::TextRewriter &rewriter) const {
+	for (size_t i = 0; i < tag.param_count; ++i) {
+		auto const& param = tag.params[i];
+		if (param.omitted) continue;
+		if (param.type != VariableDataType::INT && param.type != VariableDataType::FLOAT) continue;
+
+		int parVal = param.GetInt();
+
+		switch (param.classification) {
+			case AssParameterClass::RELATIVE_TIME_START: {
+				int value = ConvertTime(trunc_cs(state.line.Start) + parVal) - state.newStart;
+
+				// An end time of 0 is actually the end time of the line, so ensure
+				// nonzero is never converted to 0
+				// Needed here rather than the end case because start/end here mean
+				// which end of the line the time is relative to, not whether it's
+				// the start or end time (compare \move and \fad)
+				if (value == 0 && parVal != 0) value = 1;
+				rewriter.Replace(param.value, value);
+				break;
+			}
+			case AssParameterClass::RELATIVE_TIME_END:
+				rewriter.Replace(param.value, state.newEnd - ConvertTime(trunc_cs(state.line.End) - parVal));
+				break;
+			case AssParameterClass::KARAOKE: {
+				int start = state.line.Start / 10 + state.oldK + parVal;
+				int value = (ConvertTime(start * 10) - state.newStart) / 10 - state.newK;
+				state.oldK += parVal;
+				state.newK += value;
+				rewriter.Replace(param.value, value);
+				break;
+			}
+			default:
+				break;
 		}
-		default:
-			return;
 	}
 }
 
-void AssTransformFramerateFilter::TransformFrameRate(AssFile *subs) {
+void AssTransformFramerateFilter::ProcessLine(AssDialogue &line) const {
 	if (!Input.IsLoaded() || !Output.IsLoaded()) return;
-	for (auto& curDialogue : subs->Events) {
-		line = &curDialogue;
-		newK = 0;
-		oldK = 0;
-		newStart = trunc_cs(ConvertTime(curDialogue.Start));
-		newEnd = trunc_cs(ConvertTime(curDialogue.End) + 9);
-
-		// Process stuff
-		auto blocks = line->ParseTags();
-		for (auto block : blocks | agi::of_type<AssDialogueBlockOverride>())
-			block->ProcessParameters(TransformTimeTags, this);
-		curDialogue.Start = newStart;
-		curDialogue.End = newEnd;
-		curDialogue.UpdateText(blocks);
-	}
+
+	struct visitor final : agi::ass::DialogueVisitor {
+		AssTransformFramerateFilter const *filter;
+		LineState &state;
+		agi::ass::TextRewriter &rewriter;
+		visitor(AssTransformFramerateFilter const *filter, LineState &state, agi::ass::TextRewriter &rewriter)
+		: filter(filter), state(state), rewriter(rewriter) { }
+		void VisitTag(agi::ass::Tag const& tag) override {
+			filter->TransformTimeTags(tag, state, rewriter);
+		}
+	};
+
+	LineState state{
+		line,
+		trunc_cs(ConvertTime(line.Start)),
+		trunc_cs(ConvertTime(line.End) + 9),
+		0, 0
+	};
+
+	// Times in tags are relative to the original start and end, so they
+	// have to be transformed before the line's times are updated
+	std::string text;
+	agi::ass::TextRewriter rewriter(line.Text.get(), text);
+	visitor v(this, state, rewriter);
+	agi::ass::VisitDialogue(line.Text.get(), v);
+	if (rewriter.Finish())
+		line.Text = text;
+
+	line.Start = state.newStart;
+	line.End = state.newEnd;
 }
 
-int AssTransformFramerateFilter::ConvertTime(int time) {
+int AssTransformFramerateFilter::ConvertTime(int time) const {
 	int frame = Output.FrameAtTime(time);
 	int frameStart = Output.TimeAtFrame(frame);
 	int frameEnd = Output.TimeAtFrame(frame + 1);
@@ -32,20 +32,18 @@
 #include <libaegisub/vfr.h>
 
 class AssDialogue;
-class AssOverrideParameter;
+namespace agi { namespace ass {
+	struct Tag;
+	class TextRewriter;
+} }
 class wxCheckBox;
 class wxRadioButton;
 class wxTextCtrl;
 
 /// @class AssTransformFramerateFilter
 /// @brief Transform subtitle times, including those in override tags, from an input framerate to an output framerate
-class AssTransformFramerateFilter final : public AssExportFilter {
+class AssTransformFramerateFilter final : public PerLineExportFilter {
 	agi::Context *c = nullptr;
-	AssDialogue *line = nullptr;
-	int newStart = 0;
-	int newEnd = 0;
-	int newK = 0;
-	int oldK = 0;
 
 	// Yes, these are backwards. It sort of makes sense if you think about what it's doing.
 	agi::vfr::Framerate Input;  ///< Destination frame rate
@@ -59,14 +57,14 @@ class AssTransformFramerateFilter final : public AssExportFilter {
 
 	wxCheckBox *Reverse; ///< Switch input and output
 
-	/// @brief Apply the transformation to a file
-	/// @param subs File to process
-	void TransformFrameRate(AssFile *subs);
-	/// @brief Transform a single tag
-	/// @param name Name of the tag
-	/// @param curParam Current parameter being processed
-	/// @param userdata Filter instance
-	static void TransformTimeTags(std::string const& name, AssOverrideParameter *curParam, void *userdata);
+	/// State of the line being transformed
+	struct LineState;
+
+	/// @brief Transform the times in a single tag
+	/// @param tag Tag to transform
+	/// @param state Line the tag is in
+	/// @param rewriter Rewriter for the line's text
+	void TransformTimeTags(agi::ass::Tag const& tag, LineState &state, agi::ass::TextRewriter &rewriter) const;
 
 	/// @brief Convert a time from the input frame rate to the output frame rate
 	/// @param time Time in ms to convert
@@ -76,10 +74,10 @@ class AssTransformFramerateFilter final : public AssExportFilter {
 	///   1. The frame number
 	///   2. The relative distance between the beginning of the frame which time
 	///      is in and the beginning of the next frame
-	int ConvertTime(int time);
+	int ConvertTime(int time) const;
 public:
 	AssTransformFramerateFilter();
-	void ProcessSubs(AssFile *subs, wxWindow *) override;
+	void ProcessLine(AssDialogue &line) const override;
 	wxWindow *GetConfigDialogWindow(wxWindow *parent, agi::Context *c) override;
 	void LoadSettings(bool is_default, agi::Context *c) override;
 };
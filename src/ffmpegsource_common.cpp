@@ -47,6 +47,9 @@
 #include <boost/algorithm/string/case_conv.hpp>
 #include <boost/crc.hpp>
 #include <boost/filesystem/path.hpp>
+#include <condition_variable>
+#include <mutex>
+#include <set>
 #include <wx/intl.h>
 #include <wx/choicdlg.h>
 
@@ -70,14 +73,59 @@ FFmpegSourceProvider::FFmpegSourceProvider(agi::BackgroundRunner *br)
 	FFMS_Init(0, 0);
 }
 
+namespace {
+/// An index shared by every provider opening the same file
+struct SharedIndex {
+	/// The index, for as long as any provider is still using it
+	std::weak_ptr<FFMS_Index> index;
+	/// Keeps the index alive once the video provider is done with it, until
+	/// the audio provider about to open the same file has taken it
+	std::shared_ptr<FFMS_Index> held_for_audio;
+	/// A provider is currently indexing the file
+	bool indexing = false;
+	/// Progress of the running pass, for providers waiting on it
+	int64_t current = 0;
+	int64_t total = 0;
+};
+
+std::mutex index_mutex;
+std::condition_variable index_cv;
+/// Indexes keyed by cache filename, which changes whenever the file does
+std::map<agi::fs::path, SharedIndex> indexes;
+/// Files which are about to have their audio loaded
+std::set<agi::fs::path> expected_audio;
+
+std::shared_ptr<FFMS_Index> make_shared_index(FFMS_Index *index) {
+	if (!index) return nullptr;
+	return std::shared_ptr<FFMS_Index>(index, FFMS_DestroyIndex);
+}
+
+/// Replace the index for a file. A different file is being opened, so any
+/// index held for an audio provider which never came is released.
+void store_index(SharedIndex& shared, std::shared_ptr<FFMS_Index> const& index) {
+	for (auto& other : indexes) {
+		if (&other.second != &shared)
+			other.second.held_for_audio.reset();
+	}
+	shared.index = index;
+}
+
+struct IndexProgress {
+	agi::ProgressSink *ps;
+	SharedIndex *shared;
+};
+
 /// @brief Does indexing of a source file
-/// @param Indexer		A pointer to the indexer object representing the file to be indexed
-/// @param CacheName    The filename of the output index file
-/// @param Trackmask    A binary mask of the track numbers to index
-FFMS_Index *FFmpegSourceProvider::DoIndexing(FFMS_Indexer *Indexer,
-	                                         agi::fs::path const& CacheName,
-	                                         TrackSelection Track,
-	                                         FFMS_IndexErrorHandling IndexEH) {
+/// @param Indexer   A pointer to the indexer object representing the file to be indexed
+/// @param CacheName The filename of the output index file
+/// @param Track     Track number to index in addition to the video tracks, or -1 for none
+/// @param AllAudio  Index all audio tracks
+/// @param shared    Where to publish progress for anyone waiting on this pass
+FFMS_Index *DoIndexing(agi::BackgroundRunner *br, FFMS_Indexer *Indexer,
+	                   agi::fs::path const& CacheName,
+	                   int Track, bool AllAudio,
+	                   FFMS_IndexErrorHandling IndexEH,
+	                   SharedIndex& shared) {
 	char FFMSErrMsg[1024];
 	FFMS_ErrorInfo ErrInfo;
 	ErrInfo.Buffer		= FFMSErrMsg;
@@ -85,31 +133,36 @@ FFMS_Index *FFmpegSourceProvider::DoIndexing(FFMS_Indexer *Indexer,
 	ErrInfo.ErrorType	= FFMS_ERROR_SUCCESS;
 	ErrInfo.SubType		= FFMS_ERROR_SUCCESS;
 
-	// index all audio tracks
 	FFMS_Index *Index;
 	br->Run([&](agi::ProgressSink *ps) {
 		ps->SetTitle(from_wx(_("Indexing")));
 		ps->SetMessage(from_wx(_("Reading timecodes and frame/sample data")));
+		IndexProgress progress{ps, &shared};
 		TIndexCallback callback = [](int64_t Current, int64_t Total, void *Private) -> int {
-			auto ps = static_cast<agi::ProgressSink *>(Private);
-			ps->SetProgress(Current, Total);
-			return ps->IsCancelled();
+			auto progress = static_cast<IndexProgress *>(Private);
+			progress->ps->SetProgress(Current, Total);
+			{
+				std::lock_guard<std::mutex> lock(index_mutex);
+				progress->shared->current = Current;
+				progress->shared->total = Total;
+			}
+			return progress->ps->IsCancelled();
 		};
 #if FFMS_VERSION >= ((2 << 24) | (21 << 16) | (0 << 8) | 0)
-		if (Track == TrackSelection::All)
+		if (AllAudio)
 			FFMS_TrackTypeIndexSettings(Indexer, FFMS_TYPE_AUDIO, 1, 0);
-		else if (Track != TrackSelection::None)
-			FFMS_TrackIndexSettings(Indexer, static_cast<int>(Track), 1, 0);
-		FFMS_SetProgressCallback(Indexer, callback, ps);
+		if (Track >= 0)
+			FFMS_TrackIndexSettings(Indexer, Track, 1, 0);
+		FFMS_SetProgressCallback(Indexer, callback, &progress);
 		Index = FFMS_DoIndexing2(Indexer, IndexEH, &ErrInfo);
 #else
 		int Trackmask = 0;
-		if (Track == TrackSelection::All)
+		if (AllAudio)
 			Trackmask = std::numeric_limits<int>::max();
-		else if (Track != TrackSelection::None)
-			Trackmask = 1 << static_cast<int>(Track);
+		else if (Track >= 0)
+			Trackmask = 1 << Track;
 		Index = FFMS_DoIndexing(Indexer, Trackmask, 0,
-			nullptr, nullptr, IndexEH, callback, ps, &ErrInfo);
+			nullptr, nullptr, IndexEH, callback, &progress, &ErrInfo);
 #endif
 	});
 
@@ -121,6 +174,115 @@ FFMS_Index *FFmpegSourceProvider::DoIndexing(FFMS_Indexer *Indexer,
 
 	return Index;
 }
+}
+
+std::shared_ptr<FFMS_Index> FFmpegSourceProvider::GetIndex(FFMS_Indexer *Indexer, agi::fs::path const& filename, FFMS_TrackType Type, int Track) {
+	// Only needed if this ends up doing the indexing
+	std::unique_ptr<FFMS_Indexer, void (FFMS_CC*)(FFMS_Indexer*)> IndexerPtr(Indexer, FFMS_CancelIndexing);
+
+	char FFMSErrMsg[1024];
+	FFMS_ErrorInfo ErrInfo;
+	ErrInfo.Buffer		= FFMSErrMsg;
+	ErrInfo.BufferSize	= sizeof(FFMSErrMsg);
+	ErrInfo.ErrorType	= FFMS_ERROR_SUCCESS;
+	ErrInfo.SubType		= FFMS_ERROR_SUCCESS;
+
+	auto CacheName = GetCacheFilename(filename);
+	FFMS_IndexErrorHandling ErrorHandling = GetErrorHandlingMode();
+
+	// An index is usable if it has the track we want and was made the same
+	// way we'd make a new one
+	auto usable = [&](FFMS_Index *Index) {
+		if (!Index || FFMS_IndexBelongsToFile(Index, filename.string().c_str(), &ErrInfo))
+			return false;
+		// video tracks are always indexed, but a bit of sanity checking never hurt anyone
+		if (Track >= 0 && FFMS_GetNumFrames(FFMS_GetTrackFromIndex(Index, Track)) <= 0)
+			return false;
+#if FFMS_VERSION >= ((2 << 24) | (17 << 16) | (2 << 8) | 0)
+		// the error handling mode only affects audio
+		if (Type == FFMS_TYPE_AUDIO && FFMS_GetErrorHandling(Index) != ErrorHandling)
+			return false;
+#endif
+		return true;
+	};
+
+	std::unique_lock<std::mutex> lock(index_mutex);
+	bool AudioExpected = expected_audio.erase(filename) > 0;
+	auto& shared = indexes[CacheName];
+
+	// Another provider is indexing the file, so show its progress until it's
+	// done and then see if what it produced has what we need
+	while (shared.indexing) {
+		lock.unlock();
+		br->Run([&](agi::ProgressSink *ps) {
+			ps->SetTitle(from_wx(_("Indexing")));
+			ps->SetMessage(from_wx(_("Reading timecodes and frame/sample data")));
+			std::unique_lock<std::mutex> lock(index_mutex);
+			while (shared.indexing && !ps->IsCancelled()) {
+				ps->SetProgress(shared.current, shared.total);
+				index_cv.wait_for(lock, std::chrono::milliseconds(100));
+			}
+		});
+		lock.lock();
+		if (shared.indexing)
+			throw agi::UserCancelException("indexing cancelled by user");
+	}
+
+	auto Index = shared.index.lock();
+	if (!usable(Index.get())) {
+		Index = make_shared_index(FFMS_ReadIndex(CacheName.string().c_str(), &ErrInfo));
+		if (usable(Index.get()))
+			store_index(shared, Index);
+		else
+			Index = nullptr;
+	}
+
+	if (!Index) {
+		// Index the audio along with the video if it's going to be opened
+		// right afterwards, rather than reading the whole file twice
+		bool AllAudio = AudioExpected
+			|| OPT_GET("Provider/FFmpegSource/Index All Tracks")->GetBool()
+			|| (Type == FFMS_TYPE_VIDEO && OPT_GET("Video/Open Audio")->GetBool());
+
+		shared.indexing = true;
+		shared.current = shared.total = 0;
+		lock.unlock();
+
+		try {
+			Index = make_shared_index(DoIndexing(br, IndexerPtr.release(), CacheName,
+				Type == FFMS_TYPE_AUDIO ? Track : -1, AllAudio, ErrorHandling, shared));
+		}
+		catch (...) {
+			lock.lock();
+			shared.indexing = false;
+			index_cv.notify_all();
+			throw;
+		}
+
+		lock.lock();
+		shared.indexing = false;
+		store_index(shared, Index);
+		index_cv.notify_all();
+	}
+
+	// The providers opening the file are what keep the index alive, except
+	// that audio is usually opened right after the video provider has
+	// finished with it, so hold on to it until then
+	if (Type == FFMS_TYPE_AUDIO)
+		shared.held_for_audio.reset();
+	else if ((AudioExpected || OPT_GET("Video/Open Audio")->GetBool()) && FFMS_GetFirstTrackOfType(Index.get(), FFMS_TYPE_AUDIO, nullptr) != -1)
+		shared.held_for_audio = Index;
+
+	// update access time of index file so it won't get cleaned away
+	agi::fs::Touch(CacheName);
+
+	return Index;
+}
+
+void FFmpegSourceProvider::ExpectAudio(agi::fs::path const& filename) {
+	std::lock_guard<std::mutex> lock(index_mutex);
+	expected_audio.insert(filename);
+}
 
 /// @brief Finds all tracks of the given type and return their track numbers and respective codec names
 /// @param Indexer	The indexer object representing the source file
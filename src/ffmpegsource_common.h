@@ -34,6 +34,7 @@
 
 #ifdef WITH_FFMS2
 #include <map>
+#include <memory>
 
 #include <ffms.h>
 
@@ -61,9 +62,22 @@ public:
 
 	void CleanCache();
 
-	FFMS_Index *DoIndexing(FFMS_Indexer *Indexer, agi::fs::path const& Cachename,
-		                   TrackSelection Track,
-		                   FFMS_IndexErrorHandling IndexEH);
+	/// @brief Get an index of a file which includes the given track
+	/// @param Indexer  Indexer for the file, which is always consumed
+	/// @param filename The file being opened
+	/// @param Type     Type of the track being opened
+	/// @param Track    Track number, or -1 for just the video tracks
+	///
+	/// Providers opening the same file share the index. If another provider
+	/// is already indexing the file this waits for that pass to finish rather
+	/// than starting a second one, and a new pass includes the audio tracks
+	/// whenever they're going to be needed by the audio provider too.
+	std::shared_ptr<FFMS_Index> GetIndex(FFMS_Indexer *Indexer, agi::fs::path const& filename, FFMS_TrackType Type, int Track);
+
+	/// Note that a file about to be opened as video will have its audio
+	/// loaded afterwards, so that both can be indexed in one pass
+	static void ExpectAudio(agi::fs::path const& filename);
+
 	std::map<int, std::string> GetTracksOfType(FFMS_Indexer *Indexer, FFMS_TrackType Type);
 	TrackSelection AskForTrackSelection(const std::map<int, std::string>& TrackList, FFMS_TrackType Type);
 	agi::fs::path GetCacheFilename(agi::fs::path const& filename);
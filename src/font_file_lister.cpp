@@ -22,6 +22,8 @@
 #include "compat.h"
 #include "format.h"
 
+#include <libaegisub/ass/override.h>
+#include <libaegisub/dispatch.h>
 #include <libaegisub/format_flyweight.h>
 #include <libaegisub/format_path.h>
 
@@ -59,50 +61,59 @@ FontCollector::FontCollector(FontCollectorStatusCallback status_callback)
 {
 }
 
-void FontCollector::ProcessDialogueLine(const AssDialogue *line, int index) {
+void FontCollector::ProcessDialogueLine(const AssDialogue *line, int index, ScanResult &result) const {
 	if (line->Comment) return;
 
 	auto style_it = styles.find(line->Style);
 	if (style_it == end(styles)) {
-		status_callback(fmt_tl("Style '%s' does not exist\n", line->Style), 2);
-		++missing;
+		result.missing_styles.push_back(line->Style);
 		return;
 	}
 
-	StyleInfo style = style_it->second;
-	StyleInfo initial = style;
-
-	bool overriden = false;
-
-	for (auto& block : line->ParseTags()) {
-		switch (block->GetType()) {
-		case AssBlockType::OVERRIDE:
-			for (auto const& tag : static_cast<AssDialogueBlockOverride&>(*block).Tags) {
-				if (tag.Name == "\\r") {
-					style = styles[tag.Params[0].Get(line->Style.get())];
-					overriden = false;
-				}
-				else if (tag.Name == "\\b") {
-					style.bold = tag.Params[0].Get(initial.bold);
-					overriden = true;
-				}
-				else if (tag.Name == "\\i") {
-					style.italic = tag.Params[0].Get(initial.italic);
-					overriden = true;
-				}
-				else if (tag.Name == "\\fn") {
-					style.facename = tag.Params[0].Get(initial.facename);
-					overriden = true;
-				}
+	struct visitor final : agi::ass::DialogueVisitor {
+		FontCollector const& collector;
+		const AssDialogue *line;
+		int index;
+		ScanResult &result;
+		StyleInfo style;
+		StyleInfo initial;
+		bool overriden = false;
+
+		visitor(FontCollector const& collector, const AssDialogue *line, int index, ScanResult &result, StyleInfo const& style)
+		: collector(collector), line(line), index(index), result(result), style(style), initial(style)
+		{
+		}
+
+		void VisitTag(agi::ass::Tag const& tag) override {
+			// Tags within \t can't change the font
+			if (tag.depth > 0) return;
+
+			auto const& param = tag.params[0];
+			if (tag.name == "\\r") {
+				auto reset = param.omitted
+					? collector.styles.find(line->Style)
+					: collector.styles.find(param.value.to_string());
+				style = reset == end(collector.styles) ? StyleInfo{} : reset->second;
+				overriden = false;
+			}
+			else if (tag.name == "\\b") {
+				style.bold = param.GetInt(initial.bold);
+				overriden = true;
 			}
-			break;
-		case AssBlockType::PLAIN: {
-			auto text = block->GetText();
+			else if (tag.name == "\\i") {
+				style.italic = param.GetBool(initial.italic);
+				overriden = true;
+			}
+			else if (tag.name == "\\fn") {
+				style.facename = param.omitted ? initial.facename : param.value.to_string();
+				overriden = true;
+			}
+		}
 
-			if (text.empty())
-				continue;
+		void VisitText(boost::string_view text) override {
+			if (text.empty()) return;
 
-			auto& usage = used_styles[style];
+			auto& usage = result.used_styles[style];
 
 			if (overriden) {
 				auto& lines = usage.lines;
@@ -110,45 +121,17 @@ void FontCollector::ProcessDialogueLine(const AssDialogue *line, int index) {
 					lines.push_back(index);
 			}
 
-			auto& chars = usage.chars;
-			auto size = static_cast<int>(text.size());
-			for (int i = 0; i < size; ) {
-				if (text[i] == '\\' && i + 1 < size) {
-					char next = text[++i];
-					if (next == 'N' || next == 'n') {
-						++i;
-						continue;
-					}
-					if (next == 'h') {
-						++i;
-						chars.push_back(0xA0);
-						continue;
-					}
-
-					chars.push_back('\\');
-					continue;
-				}
-
-				UChar32 c;
-				U8_NEXT(&text[0], i, size, c);
-				chars.push_back(c);
-			}
-
-			sort(begin(chars), end(chars));
-			chars.erase(unique(chars.begin(), chars.end()), chars.end());
-			break;
-		}
-		case AssBlockType::DRAWING:
-		case AssBlockType::COMMENT:
-			break;
+			usage.chars.insert_text(text.data(), text.data() + text.size());
 		}
-	}
+	} v(*this, line, index, result, style_it->second);
+
+	agi::ass::VisitDialogue(line->Text.get(), v);
 }
 
 void FontCollector::ProcessChunk(std::pair<StyleInfo, UsageData> const& style) {
 	if (style.second.chars.empty()) return;
 
-	auto res = lister.GetFontPaths(style.first.facename, style.first.bold, style.first.italic, style.second.chars);
+	auto res = lister.GetFontPaths(style.first.facename, style.first.bold, style.first.italic, style.second.chars.codepoints());
 
 	if (res.paths.empty()) {
 		status_callback(fmt_tl("Could not find font '%s'\n", style.first.facename), 2);
@@ -212,9 +195,29 @@ std::vector<agi::fs::path> FontCollector::GetFontPaths(const AssFile *file) {
 		used_styles[info].styles.push_back(style.name);
 	}
 
-	int index = 0;
+	std::vector<const AssDialogue *> lines;
 	for (auto const& diag : file->Events)
-		ProcessDialogueLine(&diag, ++index);
+		lines.push_back(&diag);
+
+	const size_t chunk_size = 4096;
+	std::vector<ScanResult> chunks((lines.size() + chunk_size - 1) / chunk_size);
+	agi::dispatch::ParallelFor(chunks.size(), [&](size_t chunk) {
+		size_t chunk_end = std::min(lines.size(), (chunk + 1) * chunk_size);
+		for (size_t i = chunk * chunk_size; i < chunk_end; ++i)
+			ProcessDialogueLine(lines[i], static_cast<int>(i + 1), chunks[chunk]);
+	});
+
+	for (auto const& chunk : chunks) {
+		for (auto const& style : chunk.missing_styles) {
+			status_callback(fmt_tl("Style '%s' does not exist\n", style), 2);
+			++missing;
+		}
+		for (auto const& style : chunk.used_styles) {
+			auto& usage = used_styles[style.first];
+			usage.chars |= style.second.chars;
+			usage.lines.insert(usage.lines.end(), style.second.lines.begin(), style.second.lines.end());
+		}
+	}
 
 	status_callback(_("Searching for font files\n"), 0);
 	for (auto const& style : used_styles) ProcessChunk(style);
@@ -14,6 +14,7 @@
 //
 // Aegisub Project http://www.aegisub.org/
 
+#include <libaegisub/codepoint_set.h>
 #include <libaegisub/fs_fwd.h>
 #include <libaegisub/scoped_ptr.h>
 
@@ -85,12 +86,18 @@ using FontFileLister = CoreTextFontFileLister;
 
 typedef struct _FcConfig FcConfig;
 typedef struct _FcFontSet FcFontSet;
+typedef struct _FcPattern FcPattern;
 
 /// @class FontConfigFontFileLister
 /// @brief fontconfig powered font lister
 class FontConfigFontFileLister {
 	agi::scoped_holder<FcConfig*> config;
 
+	/// Lowercase family and full names -> outline fonts in config with that
+	/// name, application fonts first, built once so that looking up a style
+	/// doesn't have to check the name of every installed font
+	std::unordered_map<std::string, std::vector<FcPattern *>> families;
+
 	/// @brief Case-insensitive match ASS/SSA font family against full name. (also known as "name for humans")
 	/// @param family font fullname
 	/// @param bold weight attribute
@@ -127,7 +134,7 @@ class FontCollector {
 
 	/// Data about where each style is used
 	struct UsageData {
-		std::vector<int> chars;          ///< Characters used in this style which glyphs will be needed for
+		agi::CodepointSet chars;         ///< Characters used in this style which glyphs will be needed for
 		std::vector<int> lines;          ///< Lines on which this style is used via overrides
 		std::vector<std::string> styles; ///< ASS styles which use this style
 	};
@@ -148,8 +155,16 @@ class FontCollector {
 	/// Number of fonts which were found, but did not contain all used glyphs
 	int missing_glyphs = 0;
 
+	/// Styles used on a range of lines. Ranges of lines are scanned in
+	/// parallel and the results then merged in order.
+	struct ScanResult {
+		std::map<StyleInfo, UsageData> used_styles;
+		/// Names of styles which don't exist, once for each line using one
+		std::vector<std::string> missing_styles;
+	};
+
 	/// Gather all of the unique styles with text on a line
-	void ProcessDialogueLine(const AssDialogue *line, int index);
+	void ProcessDialogueLine(const AssDialogue *line, int index, ScanResult &result) const;
 
 	/// Get the font for a single style
 	void ProcessChunk(std::pair<StyleInfo, UsageData> const& style);
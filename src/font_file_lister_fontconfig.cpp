@@ -19,32 +19,36 @@
 #include <libaegisub/charset_conv_win.h>
 #include <libaegisub/log.h>
 
+#include <algorithm>
 #include <boost/algorithm/string/case_conv.hpp>
 #include <boost/filesystem/path.hpp>
 #include <fontconfig/fontconfig.h>
 #include <wx/intl.h>
 
 namespace {
-bool pattern_matches(FcPattern *pat, const char *field, std::string const& name) {
+void add_names(FcPattern *pat, const char *field, std::vector<std::string> &names) {
 	FcChar8 *str;
 	for (int i = 0; FcPatternGetString(pat, field, i, &str) == FcResultMatch; ++i) {
-		std::string sstr((char *)str);
-		boost::to_lower(sstr);
-		if (sstr == name)
-			return true;
+		std::string name((char *)str);
+		boost::to_lower(name);
+		if (std::find(names.begin(), names.end(), name) == names.end())
+			names.push_back(std::move(name));
 	}
-	return false;
 }
 
-void find_font(FcFontSet *src, FcFontSet *dst, std::string const& family) {
+void index_fonts(FcFontSet *src, std::unordered_map<std::string, std::vector<FcPattern *>> &families) {
 	if (!src) return;
 
+	std::vector<std::string> names;
 	for (FcPattern *pat : boost::make_iterator_range(&src->fonts[0], &src->fonts[src->nfont])) {
 		int val;
 		if (FcPatternGetBool(pat, FC_OUTLINE, 0, &val) != FcResultMatch || val != FcTrue) continue;
 
-		if (pattern_matches(pat, FC_FULLNAME, family) || pattern_matches(pat, FC_FAMILY, family))
-			FcFontSetAdd(dst, FcPatternDuplicate(pat));
+		names.clear();
+		add_names(pat, FC_FULLNAME, names);
+		add_names(pat, FC_FAMILY, names);
+		for (auto const& name : names)
+			families[name].push_back(pat);
 	}
 }
 
@@ -55,6 +59,9 @@ FontConfigFontFileLister::FontConfigFontFileLister(FontCollectorStatusCallback &
 {
 	cb(_("Updating font cache\n"), 0);
 	FcConfigBuildFonts(config);
+
+	index_fonts(FcConfigGetFonts(config, FcSetApplication), families);
+	index_fonts(FcConfigGetFonts(config, FcSetSystem), families);
 }
 
 CollectionResult FontConfigFontFileLister::GetFontPaths(std::string const& facename, int bold, bool italic, std::vector<int> const& characters) {
@@ -84,8 +91,11 @@ CollectionResult FontConfigFontFileLister::GetFontPaths(std::string const& facen
 	// include the first family and fullname, so we can't always verify that
 	// we got the actual font we were asking for after the fact
 	agi::scoped_holder<FcFontSet*> fset(FcFontSetCreate(), FcFontSetDestroy);
-	find_font(FcConfigGetFonts(config, FcSetApplication), fset, family);
-	find_font(FcConfigGetFonts(config, FcSetSystem), fset, family);
+	auto it = families.find(family);
+	if (it != families.end()) {
+		for (FcPattern *font : it->second)
+			FcFontSetAdd(fset, FcPatternDuplicate(font));
+	}
 
 	// Get the best match from fontconfig
 	FcResult result;
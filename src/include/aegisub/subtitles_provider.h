@@ -43,10 +43,39 @@ struct VideoFrame;
 
 class SubtitlesProvider {
 	std::vector<char> buffer;
+
+	/// What is currently loaded into the provider, used to send only the
+	/// lines which have changed when the header, styles and fonts have not
+	struct LoadedScript;
+	std::unique_ptr<LoadedScript> loaded;
+
 	virtual void LoadSubtitles(const char *data, size_t len)=0;
 
+	/// @brief Replace some of the lines of the loaded script, keeping everything else loaded
+	/// @param removed Indices of the currently loaded lines to remove, in ascending order
+	/// @param data    Serialized lines to append after the remaining lines
+	/// @param len     Length of data in bytes
+	/// @param order   Relative position in the script of each line after the update
+	/// @return false if the lines can't be updated and the script must be reloaded instead
+	virtual bool UpdateEvents(std::vector<size_t> const& removed, const char *data, size_t len, std::vector<int> const& order) { return false; }
+
+	/// @brief Make a font attached to the script available to the renderer
+	/// @param name Name of the font file
+	/// @param data Contents of the font file
+	/// @return false if the font has to be included in the script text instead
+	///
+	/// Called for every font attachment each time the script is loaded, just
+	/// before the script itself, so the fonts passed since the previous load
+	/// are the complete set for the new script. The same data is passed again
+	/// for fonts which were already attached to the previous script.
+	virtual bool AddFont(std::string const& name, std::shared_ptr<const std::vector<char>> const& data) { return false; }
+
+	/// Bring the loaded lines up to date with subs, if the rest of the script is unchanged
+	bool UpdateLoadedEvents(AssFile *subs, int time);
+
 public:
-	virtual ~SubtitlesProvider() = default;
+	SubtitlesProvider();
+	virtual ~SubtitlesProvider();
 	void LoadSubtitles(AssFile *subs, int time = -1);
 	virtual void DrawSubtitles(VideoFrame &dst, double time)=0;
 	virtual void Reinitialize() { }
@@ -48,6 +48,12 @@ public:
 	/// Override this method to actually get frames
 	virtual void GetFrame(int n, VideoFrame &frame)=0;
 
+	/// @brief Get a frame in whichever format is cheapest to store
+	///
+	/// Unlike GetFrame this may return planar YCbCr frames, which the frame
+	/// cache keeps as-is and converts to BGRA only when they're requested.
+	virtual void GetNativeFrame(int n, VideoFrame &frame) { GetFrame(n, frame); }
+
 	/// Set the YCbCr matrix to the specified one
 	///
 	/// Providers are free to disregard this, and should if the requested
@@ -78,6 +84,11 @@ public:
 	/// @return Returns true if caching is desired, false otherwise.
 	virtual bool WantsCaching() const { return false; }
 
+	/// @brief Decode a frame into the frame cache without returning it
+	/// @param n Frame number to decode
+	/// @return Whether the frame was cached; false if this provider has no cache
+	virtual bool PrefetchFrame(int /*n*/) { return false; }
+
 	/// Should the video properties in the script be set to this video's property if they already have values?
 	virtual bool ShouldSetVideoProperties() const { return true; }
 
@@ -0,0 +1,331 @@
+// Copyright (c) 2014, Thomas Goyne <plorkyeran@aegisub.org>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+/// @file libass_renderer_pool.cpp
+/// @brief Pool of libass renderers for rendering frames concurrently
+/// @ingroup subtitle_rendering
+
+#include "libass_renderer_pool.h"
+
+#include <libaegisub/exception.h>
+#include <libaegisub/make_unique.h>
+
+#include <algorithm>
+#include <map>
+#include <shared_mutex>
+#include <thread>
+
+namespace {
+/// Guards the fonts registered with each ASS_Library, which are added to
+/// when setting a pool's fonts or parsing scripts with embedded fonts and
+/// read when rendering
+std::shared_timed_mutex library_mutex;
+
+struct EmbeddedFont {
+	std::string name;
+	std::shared_ptr<const std::vector<char>> data;
+	/// Number of pools whose script needs this font
+	size_t users;
+};
+
+/// The pools using a library and the embedded fonts which have been added
+/// to it, in the order they were added
+struct LibraryState {
+	size_t pools = 0;
+	std::vector<EmbeddedFont> fonts;
+
+	EmbeddedFont *Find(std::shared_ptr<const std::vector<char>> const& data) {
+		auto it = std::find_if(fonts.begin(), fonts.end(), [&](EmbeddedFont const& font) { return font.data == data; });
+		return it == fonts.end() ? nullptr : &*it;
+	}
+};
+
+/// Guarded by library_mutex
+std::map<ASS_Library *, LibraryState> libraries;
+
+void add_font(ASS_Library *library, EmbeddedFont const& font) {
+	ass_add_font(library, font.name.c_str(), font.data->data(), static_cast<int>(font.data->size()));
+}
+
+ASS_Track *parse(ASS_Library *library, std::vector<char> const& script, bool bidi_brackets) {
+	// libass modifies the buffer while parsing, so each track needs its own copy
+	std::vector<char> copy(script);
+	ASS_Track *track;
+	{
+		std::unique_lock<std::shared_timed_mutex> lock(library_mutex);
+		track = ass_read_memory(library, copy.data(), copy.size(), nullptr);
+	}
+	if (track && bidi_brackets)
+		ass_track_set_feature(track, ASS_FEATURE_BIDI_BRACKETS, 1);
+	return track;
+}
+}
+
+namespace libass {
+ASS_Renderer *CreateRenderer(ASS_Library *library) {
+	std::shared_lock<std::shared_timed_mutex> lock(library_mutex);
+	auto renderer = ass_renderer_init(library);
+	if (renderer) {
+		ass_set_font_scale(renderer, 1.);
+		ass_set_fonts(renderer, nullptr, "Sans", 1, nullptr, true);
+	}
+	return renderer;
+}
+
+struct RendererPool::EventUpdate {
+	std::vector<size_t> removed;
+	std::vector<char> added;
+	std::vector<int> order;
+
+	void Apply(ASS_Track *track) const {
+		size_t next_removed = 0;
+		int kept = 0;
+		for (int i = 0; i < track->n_events; ++i) {
+			if (next_removed < removed.size() && removed[next_removed] == static_cast<size_t>(i)) {
+				ass_free_event(track, i);
+				++next_removed;
+				continue;
+			}
+			if (kept != i)
+				track->events[kept] = track->events[i];
+			++kept;
+		}
+		track->n_events = kept;
+
+		// The track is left in the events section after parsing, so new
+		// lines are parsed exactly as they would have been in the full file
+		if (!added.empty())
+			ass_process_data(track, const_cast<char *>(added.data()), static_cast<int>(added.size()));
+
+		// Events are drawn in ReadOrder within each layer, which for a
+		// parsed file is the position in the file
+		for (int i = 0; i < track->n_events && static_cast<size_t>(i) < order.size(); ++i)
+			track->events[i].ReadOrder = order[i];
+	}
+};
+}
+
+namespace libass {
+struct RendererPool::Slot {
+	ASS_Renderer *renderer = nullptr;
+	ASS_Track *track = nullptr;
+	/// Script generation the track was loaded from
+	uint64_t generation = 0;
+	/// Number of event updates applied to the track
+	size_t updates_applied = 0;
+	bool busy = false;
+
+	~Slot() {
+		if (track) ass_free_track(track);
+		if (renderer) ass_renderer_done(renderer);
+	}
+};
+
+RendererPool::RendererPool(ASS_Library *library, size_t max_renderers)
+: library(library)
+, max_renderers(max_renderers ? max_renderers : std::max(1u, std::thread::hardware_concurrency()))
+{
+	std::unique_lock<std::shared_timed_mutex> lock(library_mutex);
+	++libraries[library].pools;
+}
+
+RendererPool::~RendererPool() {
+	Reset();
+	if (spare_track) ass_free_track(spare_track);
+
+	// Fonts left unused are removed by the next pool to set its fonts once
+	// it's the only one left
+	std::unique_lock<std::shared_timed_mutex> lock(library_mutex);
+	auto& state = libraries[library];
+	--state.pools;
+	for (auto const& font : fonts)
+		--state.Find(font.second)->users;
+}
+
+void RendererPool::SetScript(const char *data, size_t len, bool bidi_brackets) {
+	auto new_script = std::make_shared<const std::vector<char>>(data, data + len);
+	auto track = parse(library, *new_script, bidi_brackets);
+	if (!track) throw agi::InternalError("libass failed to load subtitles.");
+
+	std::unique_lock<std::mutex> lock(mutex);
+	script = std::move(new_script);
+	this->bidi_brackets = bidi_brackets;
+	++generation;
+	updates.clear();
+	updates_size = 0;
+	if (spare_track) ass_free_track(spare_track);
+	spare_track = track;
+}
+
+bool RendererPool::UpdateEvents(std::vector<size_t> const& removed, const char *data, size_t len, std::vector<int> const& order) {
+	auto update = std::make_shared<EventUpdate>();
+	update->removed = removed;
+	update->added.assign(data, data + len);
+	update->order = order;
+
+	std::unique_lock<std::mutex> lock(mutex);
+	if (!script) return false;
+
+	// Each update has to be replayed by every track created from the script
+	// later, so start over once that approaches the cost of parsing it
+	size_t size = len + (removed.size() + order.size()) * sizeof(int);
+	if (updates_size + size > script->size())
+		return false;
+
+	updates.push_back(std::move(update));
+	updates_size += size;
+	return true;
+}
+
+RendererPool::Slot *RendererPool::Acquire() {
+	std::unique_lock<std::mutex> lock(mutex);
+
+	Slot *slot = nullptr;
+	while (!slot) {
+		// Prefer an idle slot which already has the current script loaded
+		for (auto& s : slots) {
+			if (s->busy) continue;
+			if (!slot || s->generation == generation)
+				slot = s.get();
+			if (s->generation == generation) break;
+		}
+		if (slot) break;
+
+		if (slots.size() < max_renderers) {
+			slots.push_back(agi::make_unique<Slot>());
+			slot = slots.back().get();
+			break;
+		}
+
+		slot_released.wait(lock);
+	}
+	slot->busy = true;
+
+	if (slot->generation == generation && slot->track) {
+		if (slot->updates_applied == updates.size())
+			return slot;
+
+		// Only the events have changed since this slot was last used
+		std::vector<std::shared_ptr<const EventUpdate>> pending(updates.begin() + slot->updates_applied, updates.end());
+		slot->updates_applied = updates.size();
+		lock.unlock();
+
+		for (auto const& update : pending)
+			update->Apply(slot->track);
+		return slot;
+	}
+
+	// Load the current script into the slot, reusing the already-parsed
+	// track if no other slot has taken it yet
+	auto current = script;
+	auto current_generation = generation;
+	auto pending = updates;
+	bool brackets = bidi_brackets;
+	ASS_Track *track = spare_track;
+	spare_track = nullptr;
+	lock.unlock();
+
+	if (!slot->renderer)
+		slot->renderer = CreateRenderer(library);
+	if (slot->track) {
+		ass_free_track(slot->track);
+		slot->track = nullptr;
+	}
+	if (!track && current)
+		track = parse(library, *current, brackets);
+	if (track) {
+		for (auto const& update : pending)
+			update->Apply(track);
+	}
+	slot->track = track;
+	slot->generation = current_generation;
+	slot->updates_applied = pending.size();
+	return slot;
+}
+
+void RendererPool::Release(Slot *slot) {
+	std::unique_lock<std::mutex> lock(mutex);
+	slot->busy = false;
+	slot_released.notify_all();
+}
+
+void RendererPool::Render(int width, int height, long long time, std::function<void (ASS_Image *)> const& consume) {
+	Slot *slot = Acquire();
+	try {
+		ASS_Image *img = nullptr;
+		if (slot->renderer && slot->track) {
+			ass_set_frame_size(slot->renderer, width, height);
+			std::shared_lock<std::shared_timed_mutex> lock(library_mutex);
+			img = ass_render_frame(slot->renderer, slot->track, time, nullptr);
+		}
+		consume(img);
+	}
+	catch (...) {
+		Release(slot);
+		throw;
+	}
+	Release(slot);
+}
+
+void RendererPool::Reset() {
+	std::unique_lock<std::mutex> lock(mutex);
+	slot_released.wait(lock, [&] {
+		return std::none_of(slots.begin(), slots.end(), [](std::unique_ptr<Slot> const& s) { return s->busy; });
+	});
+	slots.clear();
+}
+
+void RendererPool::SetFonts(std::vector<Font> const& new_fonts) {
+	std::unique_lock<std::shared_timed_mutex> library_lock(library_mutex);
+	auto& state = libraries[library];
+	for (auto const& font : new_fonts) {
+		if (auto existing = state.Find(font.second))
+			++existing->users;
+		else {
+			state.fonts.push_back(EmbeddedFont{font.first, font.second, 1});
+			add_font(library, state.fonts.back());
+		}
+	}
+	for (auto const& font : fonts)
+		--state.Find(font.second)->users;
+	fonts = new_fonts;
+
+	auto unused = [](EmbeddedFont const& font) { return font.users == 0; };
+	if (state.pools > 1 || std::none_of(state.fonts.begin(), state.fonts.end(), unused))
+		return;
+	library_lock.unlock();
+
+	// Nothing else is using the library, so once this pool's renderers and
+	// tracks are gone it can start over with just the fonts still needed
+	std::unique_lock<std::mutex> lock(mutex);
+	slot_released.wait(lock, [&] {
+		return std::none_of(slots.begin(), slots.end(), [](std::unique_ptr<Slot> const& s) { return s->busy; });
+	});
+	slots.clear();
+	if (spare_track) {
+		ass_free_track(spare_track);
+		spare_track = nullptr;
+	}
+
+	// Another pool may have started using the library in the meantime
+	library_lock.lock();
+	if (state.pools > 1) return;
+	ass_clear_fonts(library);
+	state.fonts.erase(std::remove_if(state.fonts.begin(), state.fonts.end(), unused), state.fonts.end());
+	for (auto const& font : state.fonts)
+		add_font(library, font);
+}
+}
@@ -0,0 +1,139 @@
+// Copyright (c) 2014, Thomas Goyne <plorkyeran@aegisub.org>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+/// @file libass_renderer_pool.h
+/// @brief Pool of libass renderers for rendering frames concurrently
+/// @ingroup subtitle_rendering
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+extern "C" {
+#include <ass.h>
+}
+
+namespace libass {
+/// @brief Create a renderer using the system fonts
+/// @param library libass library to create the renderer with
+///
+/// Safe to call while fonts are being added to the library by a pool.
+ASS_Renderer *CreateRenderer(ASS_Library *library);
+
+/// @class RendererPool
+/// @brief A set of ASS_Renderers, each with its own copy of the script
+///
+/// libass renderers and tracks can't be used from more than one thread at a
+/// time, so rendering is done by checking out a renderer and track pair from
+/// the pool. Pairs are created on demand up to a maximum, so a pool which is
+/// only ever used from one thread only ever holds one renderer.
+///
+/// Several pools may share one ASS_Library. Parsing a script may register
+/// embedded fonts with it, so parsing is excluded from running at the same
+/// time as rendering in any pool.
+class RendererPool {
+public:
+	/// An embedded font: the name of the font file and its contents
+	typedef std::pair<std::string, std::shared_ptr<const std::vector<char>>> Font;
+
+private:
+	struct Slot;
+	struct EventUpdate;
+
+	ASS_Library *library;
+	const size_t max_renderers;
+
+	/// Embedded fonts the current script needs, which are kept in the library
+	std::vector<Font> fonts;
+
+	std::mutex mutex;
+	std::condition_variable slot_released;
+	std::vector<std::unique_ptr<Slot>> slots;
+
+	/// Script text which each slot's track is loaded from
+	std::shared_ptr<const std::vector<char>> script;
+	/// Incremented every time the script is changed
+	uint64_t generation = 0;
+	/// Changes to the events made since the script was set, which have to
+	/// be applied to each track loaded from it
+	std::vector<std::shared_ptr<const EventUpdate>> updates;
+	/// Total size of the updates, used to decide when reloading is cheaper
+	size_t updates_size = 0;
+	/// Track parsed when the script was set, handed to the first slot which needs it
+	ASS_Track *spare_track = nullptr;
+	bool bidi_brackets = false;
+
+	Slot *Acquire();
+	void Release(Slot *slot);
+
+public:
+	/// @brief Constructor
+	/// @param library       libass library to create renderers and tracks with
+	/// @param max_renderers Maximum number of renderers to create; 0 for one per CPU core
+	RendererPool(ASS_Library *library, size_t max_renderers = 0);
+	~RendererPool();
+
+	RendererPool(RendererPool const&) = delete;
+	RendererPool& operator=(RendererPool const&) = delete;
+
+	/// @brief Set the script to render
+	/// @param data          Script in ASS format
+	/// @param len           Length of data in bytes
+	/// @param bidi_brackets Enable Unicode 6.3 bracket pair matching
+	///
+	/// Throws agi::InternalError if libass can't parse the script.
+	void SetScript(const char *data, size_t len, bool bidi_brackets);
+
+	/// @brief Replace some of the events of the script without reparsing the rest of it
+	/// @param removed Indices of the events to remove, in ascending order
+	/// @param data    Dialogue lines in ASS format to append after the remaining events
+	/// @param len     Length of data in bytes
+	/// @param order   ReadOrder to give each event after the update
+	/// @return false if the script should be set again instead, as the
+	///         accumulated updates would now be slower to apply than parsing it
+	bool UpdateEvents(std::vector<size_t> const& removed, const char *data, size_t len, std::vector<int> const& order);
+
+	/// @brief Render a frame
+	/// @param width   Frame width
+	/// @param height  Frame height
+	/// @param time    Time to render at in milliseconds
+	/// @param consume Function to process the rendered images with
+	///
+	/// Safe to call from multiple threads at once. The images passed to
+	/// consume are only valid until it returns.
+	void Render(int width, int height, long long time, std::function<void (ASS_Image *)> const& consume);
+
+	/// Discard all renderers so that new ones are created with the current font configuration
+	void Reset();
+
+	/// @brief Set the embedded fonts which the script needs
+	///
+	/// Fonts which aren't already in the library are added to it, and are
+	/// visible to every pool sharing the library. libass can only remove
+	/// fonts all at once, which means discarding every renderer and track
+	/// using the library, so fonts which no pool needs any more are only
+	/// removed when this is the only pool using the library. This pool's
+	/// renderers and tracks are then recreated on demand.
+	void SetFonts(std::vector<Font> const& fonts);
+};
+}
@@ -345,6 +345,10 @@ void Automation(wxTreebook *book, Preferences *parent) {
 	wxArrayString ar_choice(4, ar_arr);
 	p->OptionChoice(general, _("Autoreload on Export"), ar_choice, "Automation/Autoreload Mode");
 
+	p->OptionAdd(general, _("Run scripts on first use"), "Automation/Lazy Load");
+	p->OptionAdd(general, _("Close idle scripts after (minutes, 0 = never)"), "Automation/Idle Unload", 0, 1440);
+	p->OptionAdd(general, _("Cache compiled scripts"), "Automation/Bytecode Cache/Enabled");
+
 	p->SetSizerAndFit(p->sizer);
 }
 
@@ -391,6 +395,10 @@ void Advanced_Audio(wxTreebook *book, Preferences *parent) {
 	wxArrayString ct_choice(3, ct_arr);
 	p->OptionChoice(cache, _("Cache type"), ct_choice, "Audio/Cache/Type");
 	p->OptionBrowse(cache, _("Path"), "Audio/Cache/HD/Location");
+	p->OptionAdd(cache, _("Keep decoded audio between sessions"), "Audio/Cache/Persistent/Enabled");
+	p->CellSkip(cache);
+	p->OptionAdd(cache, _("Decoded audio cache max size (MB)"), "Audio/Cache/Persistent/Size", 0, 100000);
+	p->OptionAdd(cache, _("Decoded audio cache max files"), "Audio/Cache/Persistent/Files", 0, 1000);
 
 	auto spectrum = p->PageSizer(_("Spectrum"));
 
@@ -457,6 +465,8 @@ void Advanced_Video(wxTreebook *book, Preferences *parent) {
 	wxArrayString sp_choice = to_wx(SubtitlesProviderFactory::GetClasses());
 	p->OptionChoice(expert, _("Subtitles provider"), sp_choice, "Subtitle/Provider");
 
+	p->OptionAdd(expert, _("Frames to prefetch"), "Provider/Video/Cache/Prefetch", 0, 100);
+
 #ifdef WITH_AVISYNTH
 	auto avisynth = p->PageSizer("Avisynth");
 	p->OptionAdd(avisynth, _("Allow pre-2.56a Avisynth"), "Provider/Avisynth/Allow Ancient");
@@ -212,6 +212,9 @@ void Project::LoadUnloadFiles(ProjectProperties properties) {
 
 	bool loaded_video = false;
 	if (video != video_file) {
+		if (!video.empty() && video == audio && audio != audio_file)
+			ExpectAudioFromVideo(video);
+
 		if (video.empty())
 			CloseVideo();
 		else if ((loaded_video = DoLoadVideo(video))) {
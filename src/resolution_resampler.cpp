@@ -21,8 +21,8 @@
 #include "ass_style.h"
 #include "utils.h"
 
+#include <libaegisub/ass/override.h>
 #include <libaegisub/exception.h>
-#include <libaegisub/of_type_adaptor.h>
 #include <libaegisub/split.h>
 #include <libaegisub/util.h>
 #include <libaegisub/ycbcr_conv.h>
@@ -107,13 +107,11 @@ namespace {
 		bool convert_colors;
 	};
 
-	void resample_tags(std::string const& name, AssOverrideParameter *cur, void *ud) {
-		resample_state *state = static_cast<resample_state *>(ud);
-
+	void resample_parameter(resample_state *state, agi::ass::Parameter const& param, agi::ass::TextRewriter &rewriter) {
 		double resizer = 1.0;
 		int shift = 0;
 
-		switch (cur->classification) {
+		switch (param.classification) {
 			case AssParameterClass::ABSOLUTE_SIZE:
 				resizer = state->ry;
 				break;
@@ -136,46 +134,61 @@ namespace {
 				break;
 
 			case AssParameterClass::DRAWING: {
-				cur->Set(transform_drawing(
-					cur->Get<std::string>(),
+				rewriter.Replace(param.value, transform_drawing(
+					param.value.to_string(),
 					state->margin[LEFT], state->margin[TOP], state->rx, state->ry));
 				return;
 			}
 
 			case AssParameterClass::COLOR:
 				if (state->convert_colors)
-					cur->Set<std::string>(state->conv.rgb_to_rgb(agi::Color{cur->Get<std::string>()}).GetAssOverrideFormatted());
+					rewriter.Replace(param.value, state->conv.rgb_to_rgb(agi::Color{param.value.to_string()}).GetAssOverrideFormatted());
 				return;
 
 			default:
 				return;
 		}
 
-		VariableDataType curType = cur->GetType();
-		if (curType == VariableDataType::FLOAT)
-			cur->Set((cur->Get<double>() + shift) * resizer);
-		else if (curType == VariableDataType::INT)
-			cur->Set<int>((cur->Get<int>() + shift) * resizer + 0.5);
+		if (param.type == VariableDataType::FLOAT)
+			rewriter.Replace(param.value, float_to_string((param.GetDouble() + shift) * resizer));
+		else if (param.type == VariableDataType::INT)
+			rewriter.Replace(param.value, int((param.GetInt() + shift) * resizer + 0.5));
 	}
 
-	void resample_line(resample_state *state, AssDialogue &diag) {
-		if (diag.Comment && (boost::starts_with(diag.Effect.get(), "template") || boost::starts_with(diag.Effect.get(), "code")))
-			return;
+	struct resample_visitor final : agi::ass::DialogueVisitor {
+		resample_state *state;
+		agi::ass::TextRewriter &rewriter;
+
+		resample_visitor(resample_state *state, agi::ass::TextRewriter &rewriter)
+		: state(state), rewriter(rewriter) { }
+
+		void VisitTag(agi::ass::Tag const& tag) override {
+			for (size_t i = 0; i < tag.param_count; ++i) {
+				if (!tag.params[i].omitted)
+					resample_parameter(state, tag.params[i], rewriter);
+			}
+		}
 
-		auto blocks = diag.ParseTags();
+		void VisitDrawing(boost::string_view drawing, int) override {
+			rewriter.Replace(drawing, transform_drawing(drawing.to_string(), 0, 0, state->rx / state->ar, state->ry));
+		}
+	};
 
-		for (auto block : blocks | agi::of_type<AssDialogueBlockOverride>())
-			block->ProcessParameters(resample_tags, state);
+	/// @param text Buffer for the new text, reused between lines
+	void resample_line(resample_state *state, AssDialogue &diag, std::string &text) {
+		if (diag.Comment && (boost::starts_with(diag.Effect.get(), "template") || boost::starts_with(diag.Effect.get(), "code")))
+			return;
 
-		for (auto drawing : blocks | agi::of_type<AssDialogueBlockDrawing>())
-			drawing->text = transform_drawing(drawing->text, 0, 0, state->rx / state->ar, state->ry);
+		agi::ass::TextRewriter rewriter(diag.Text.get(), text);
+		resample_visitor visitor(state, rewriter);
+		agi::ass::VisitDialogue(diag.Text.get(), visitor);
+		if (rewriter.Finish())
+			diag.Text = text;
 
 		for (size_t i = 0; i < 3; ++i) {
 			if (diag.Margin[i])
 				diag.Margin[i] = int((diag.Margin[i] + state->margin[i]) * (i < 2 ? state->rx : state->ry) + 0.5);
 		}
-
-		diag.UpdateText(blocks);
 	}
 
 	void resample_style(resample_state *state, AssStyle &style) {
@@ -284,8 +297,9 @@ void ResampleResolution(AssFile *ass, ResampleSettings settings) {
 
 	for (auto& line : ass->Styles)
 		resample_style(&state, line);
+	std::string text;
 	for (auto& line : ass->Events)
-		resample_line(&state, line);
+		resample_line(&state, line, text);
 
 	ass->SetScriptInfo("PlayResX", std::to_string(settings.dest_x));
 	ass->SetScriptInfo("PlayResY", std::to_string(settings.dest_y));
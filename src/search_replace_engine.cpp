@@ -23,16 +23,23 @@
 #include "selection_controller.h"
 #include "text_selection_controller.h"
 
+#include <libaegisub/dispatch.h>
 #include <libaegisub/exception.h>
+#include <libaegisub/make_unique.h>
+#include <libaegisub/search_text.h>
 #include <libaegisub/util.h>
 
+#include <atomic>
 #include <boost/locale/conversion.hpp>
+#include <unordered_map>
 
 #include <wx/msgdlg.h>
 
 namespace {
 static const size_t bad_pos = -1;
 static const MatchState bad_match{nullptr, 0, bad_pos};
+/// Number of lines searched by each background task
+static const size_t search_chunk_size = 1024;
 
 auto get_dialogue_field(SearchReplaceSettings::Field field) -> decltype(&AssDialogueBase::Text) {
 	switch (field) {
@@ -128,15 +135,180 @@ matcher get_matcher(SearchReplaceSettings const& settings, Accessor&& a) {
 	};
 }
 
-template<typename Iterator, typename Container>
-Iterator circular_next(Iterator it, Container& c) {
-	++it;
-	if (it == c.end())
-		it = c.begin();
-	return it;
 }
 
-}
+struct SearchReplaceEngine::Index {
+	struct Entry {
+		/// Field value the text was prepared from. Flyweights with the same
+		/// value share storage, so comparing against the line's current
+		/// value tells if it has changed since.
+		boost::flyweight<std::string> value;
+		agi::SearchText text;
+
+		Entry(boost::flyweight<std::string> const& value, bool strip_tags, bool fold_case)
+		: value(value), text(this->value.get(), strip_tags, fold_case) { }
+	};
+
+	decltype(&AssDialogueBase::Text) field = nullptr;
+	bool strip_tags = false;
+	bool fold_case = false;
+
+	/// Every line in the file, in order
+	std::vector<AssDialogue *> lines;
+	/// Prepared field of each line, or null if it hasn't been needed yet
+	std::vector<std::unique_ptr<Entry>> entries;
+	bool lines_changed = true;
+
+	bool use_regex = false;
+	bool exact_match = false;
+	std::string look_for;
+	boost::u32regex regex;
+	std::string regex_source;
+	int regex_flags = 0;
+
+	void Prepare(SearchReplaceSettings const& settings, AssFile *ass) {
+		auto new_field = get_dialogue_field(settings.field);
+		bool new_fold_case = !settings.use_regex && !settings.match_case;
+		if (new_field != field || settings.skip_tags != strip_tags || new_fold_case != fold_case) {
+			field = new_field;
+			strip_tags = settings.skip_tags;
+			fold_case = new_fold_case;
+			entries.clear();
+			entries.resize(lines.size());
+		}
+
+		if (lines_changed) {
+			// Keep the entries for lines which are still there
+			std::unordered_map<const AssDialogue *, std::unique_ptr<Entry>> old;
+			for (size_t i = 0; i < lines.size(); ++i) {
+				if (entries[i])
+					old.emplace(lines[i], std::move(entries[i]));
+			}
+
+			lines.clear();
+			for (auto& diag : ass->Events)
+				lines.push_back(&diag);
+			entries.clear();
+			entries.resize(lines.size());
+
+			if (!old.empty()) {
+				for (size_t i = 0; i < lines.size(); ++i) {
+					auto it = old.find(lines[i]);
+					if (it != old.end())
+						entries[i] = std::move(it->second);
+				}
+			}
+			lines_changed = false;
+		}
+
+		use_regex = settings.use_regex;
+		exact_match = settings.exact_match;
+		if (use_regex) {
+			int flags = boost::u32regex::perl;
+			if (!settings.match_case)
+				flags |= boost::u32regex::icase;
+			if (settings.find != regex_source || flags != regex_flags) {
+				regex = boost::make_u32regex(settings.find, flags);
+				regex_source = settings.find;
+				regex_flags = flags;
+			}
+		}
+		else if (fold_case)
+			look_for = agi::SearchText(settings.find, false, true).Text();
+		else
+			look_for = settings.find;
+	}
+
+	/// Get the prepared field for a line, preparing it if the line is new or
+	/// has changed. May be called from multiple threads for different lines.
+	Entry const& Get(size_t i) {
+		auto& value = lines[i]->*field;
+		auto& entry = entries[i];
+		if (entry && entry->value == value)
+			return *entry;
+
+		auto normalized = boost::locale::normalize(value.get());
+		if (normalized != value.get())
+			value = normalized;
+		entry = agi::make_unique<Entry>(value, strip_tags, fold_case);
+		return *entry;
+	}
+
+	/// Find the first match in an entry which starts at or after the
+	/// position pos in its prepared text, and set pos to the end of it
+	MatchState Find(Entry const& entry, size_t& pos) {
+		auto const& text = entry.text.Text();
+		while (pos <= text.size()) {
+			size_t start, end;
+			if (use_regex) {
+				boost::smatch result;
+				if (!u32regex_search(text.cbegin() + pos, text.cend(), result, regex, pos > 0 ? boost::match_not_bol : boost::match_default))
+					return bad_match;
+				start = pos + result.position();
+				end = start + result.length();
+			}
+			else {
+				if (exact_match && text.size() - pos != look_for.size())
+					return bad_match;
+				start = text.find(look_for, pos);
+				if (start == std::string::npos)
+					return bad_match;
+				end = start + look_for.size();
+			}
+
+			size_t text_end = end;
+			if (entry.text.ToSource(start, end)) {
+				pos = text_end;
+				return {use_regex ? &regex : nullptr, start, end};
+			}
+			// Only matched part of a character which was folded to several,
+			// so look for another match after it
+			pos = start + 1;
+		}
+		return bad_match;
+	}
+
+	/// Find the first match in a line at or after the position pos in its field
+	MatchState Match(size_t i, size_t pos) {
+		auto const& entry = Get(i);
+		size_t text_pos = entry.text.FromSource(pos);
+		return Find(entry, text_pos);
+	}
+
+	/// @brief Find the first matching line out of count lines starting at first
+	/// @param pos     Position in the first line to start searching from
+	/// @param include Filter for which lines to search
+	/// @param found   Set to the index of the matching line
+	///
+	/// The lines are searched in parallel, in chunks handed out in order so
+	/// that once a match has been found only earlier chunks still need to
+	/// be finished.
+	MatchState FindFirst(size_t first, size_t count, size_t pos, std::function<bool (const AssDialogue *)> const& include, size_t& found) {
+		size_t chunks = (count + search_chunk_size - 1) / search_chunk_size;
+		std::vector<std::pair<size_t, MatchState>> results(chunks, std::make_pair(size_t(0), bad_match));
+		std::atomic<size_t> best{chunks};
+
+		agi::dispatch::ParallelFor(chunks, [&](size_t chunk) {
+			size_t chunk_end = std::min(count, (chunk + 1) * search_chunk_size);
+			for (size_t k = chunk * search_chunk_size; k < chunk_end && chunk < best; ++k) {
+				size_t i = (first + k) % lines.size();
+				if (!include(lines[i])) continue;
+
+				if (MatchState ms = Match(i, k == 0 ? pos : 0)) {
+					results[chunk] = std::make_pair(i, ms);
+					size_t current = best;
+					while (chunk < current && !best.compare_exchange_weak(current, chunk)) ;
+					return;
+				}
+			}
+		});
+
+		if (best == chunks)
+			return bad_match;
+		found = results[best].first;
+		return results[best].second;
+	}
+};
 
 std::function<MatchState (const AssDialogue*, size_t)> SearchReplaceEngine::GetMatcher(SearchReplaceSettings const& settings) {
 	if (settings.skip_tags)
@@ -146,9 +318,20 @@ std::function<MatchState (const AssDialogue*, size_t)> SearchReplaceEngine::GetM
 
 SearchReplaceEngine::SearchReplaceEngine(agi::Context *c)
 : context(c)
+, index(agi::make_unique<Index>())
+, commit_connection(c->ass->AddCommitListener(&SearchReplaceEngine::OnCommit, this))
 {
 }
 
+SearchReplaceEngine::~SearchReplaceEngine() { }
+
+void SearchReplaceEngine::OnCommit(int type) {
+	// Lines whose fields changed are noticed and re-prepared when they're
+	// next searched, so only changes to which lines exist matter here
+	if (type == AssFile::COMMIT_NEW || type & (AssFile::COMMIT_ORDER | AssFile::COMMIT_DIAG_ADDREM))
+		index->lines_changed = true;
+}
+
 void SearchReplaceEngine::Replace(AssDialogue *diag, MatchState &ms) {
 	auto& diag_field = diag->*get_dialogue_field(settings.field);
 	auto text = diag_field.get();
@@ -167,10 +350,16 @@ bool SearchReplaceEngine::FindReplace(bool replace) {
 	if (!initialized)
 		return false;
 
-	auto matches = GetMatcher(settings);
+	index->Prepare(settings, context->ass.get());
+	auto const& lines = index->lines;
+	if (lines.empty())
+		return true;
 
 	AssDialogue *line = context->selectionController->GetActiveLine();
-	auto it = context->ass->iterator_to(*line);
+	size_t line_index = std::find(lines.begin(), lines.end(), line) - lines.begin();
+	if (line_index == lines.size())
+		return false;
+	size_t first = line_index;
 	size_t pos = 0;
 
 	auto replace_ms = bad_match;
@@ -178,7 +367,7 @@ bool SearchReplaceEngine::FindReplace(bool replace) {
 		if (settings.field == SearchReplaceSettings::Field::TEXT)
 			pos = context->textSelectionController->GetSelectionStart();
 
-		if ((replace_ms = matches(line, pos))) {
+		if ((replace_ms = index->Match(line_index, pos))) {
 			size_t end = bad_pos;
 			if (settings.field == SearchReplaceSettings::Field::TEXT)
 				end = context->textSelectionController->GetSelectionEnd();
@@ -203,28 +392,36 @@ bool SearchReplaceEngine::FindReplace(bool replace) {
 	// For non-text fields we just look for matching lines rather than each
 	// match within the line, so move to the next line
 	else if (settings.field != SearchReplaceSettings::Field::TEXT)
-		it = circular_next(it, context->ass->Events);
+		first = (line_index + 1) % lines.size();
+
+	// Search every line other than the starting one, or just the starting
+	// line if it's the only one
+	size_t count = lines.size() - (first == line_index ? 0 : 1);
+	if (!count) count = 1;
 
 	auto const& sel = context->selectionController->GetSelectedSet();
 	bool selection_only = sel.size() > 1 && settings.limit_to == SearchReplaceSettings::Limit::SELECTED;
+	bool ignore_comments = settings.ignore_comments;
+
+	size_t found;
+	MatchState ms = index->FindFirst(first, count, pos, [&](const AssDialogue *diag) {
+		if (selection_only && !sel.count(const_cast<AssDialogue *>(diag))) return false;
+		return !(ignore_comments && diag->Comment);
+	}, found);
+
+	if (ms) {
+		AssDialogue *diag = lines[found];
+		if (selection_only)
+			// We're cycling through the selection, so don't muck with it
+			context->selectionController->SetActiveLine(diag);
+		else
+			context->selectionController->SetSelectionAndActive({ diag }, diag);
 
-	do {
-		if (selection_only && !sel.count(&*it)) continue;
-		if (settings.ignore_comments && it->Comment) continue;
-
-		if (MatchState ms = matches(&*it, pos)) {
-			if (selection_only)
-				// We're cycling through the selection, so don't muck with it
-				context->selectionController->SetActiveLine(&*it);
-			else
-				context->selectionController->SetSelectionAndActive({ &*it }, &*it);
-
-			if (settings.field == SearchReplaceSettings::Field::TEXT)
-				context->textSelectionController->SetSelection(ms.start, ms.end);
+		if (settings.field == SearchReplaceSettings::Field::TEXT)
+			context->textSelectionController->SetSelection(ms.start, ms.end);
 
-			return true;
-		}
-	} while (pos = 0, &*(it = circular_next(it, context->ass->Events)) != line);
+		return true;
+	}
 
 	// Replaced something and didn't find another match, so select the newly
 	// inserted text
@@ -238,35 +435,64 @@ bool SearchReplaceEngine::ReplaceAll() {
 	if (!initialized)
 		return false;
 
-	size_t count = 0;
-
-	auto matches = GetMatcher(settings);
+	index->Prepare(settings, context->ass.get());
+	auto const& lines = index->lines;
 
 	auto const& sel = context->selectionController->GetSelectedSet();
 	bool selection_only = settings.limit_to == SearchReplaceSettings::Limit::SELECTED;
 
-	for (auto& diag : context->ass->Events) {
-		if (selection_only && !sel.count(&diag)) continue;
-		if (settings.ignore_comments && diag.Comment) continue;
-
-		if (settings.use_regex) {
-			if (MatchState ms = matches(&diag, 0)) {
-				auto& diag_field = diag.*get_dialogue_field(settings.field);
-				std::string const& text = diag_field.get();
-				count += std::distance(
-					boost::u32regex_iterator<std::string::const_iterator>(begin(text), end(text), *ms.re),
-					boost::u32regex_iterator<std::string::const_iterator>());
-				diag_field = u32regex_replace(text, *ms.re, settings.replace_with);
+	// The new values are worked out in parallel, and then assigned to the
+	// lines once every chunk is done
+	size_t chunks = (lines.size() + search_chunk_size - 1) / search_chunk_size;
+	std::vector<std::vector<std::pair<size_t, std::string>>> replaced(chunks);
+	std::vector<size_t> counts(chunks, 0);
+
+	agi::dispatch::ParallelFor(chunks, [&](size_t chunk) {
+		size_t chunk_end = std::min(lines.size(), (chunk + 1) * search_chunk_size);
+		for (size_t i = chunk * search_chunk_size; i < chunk_end; ++i) {
+			AssDialogue *diag = lines[i];
+			if (selection_only && !sel.count(diag)) continue;
+			if (settings.ignore_comments && diag->Comment) continue;
+
+			auto const& entry = index->Get(i);
+			std::string const& text = entry.value.get();
+			size_t pos = 0;
+
+			if (settings.use_regex) {
+				if (MatchState ms = index->Find(entry, pos)) {
+					counts[chunk] += std::distance(
+						boost::u32regex_iterator<std::string::const_iterator>(begin(text), end(text), *ms.re),
+						boost::u32regex_iterator<std::string::const_iterator>());
+					replaced[chunk].emplace_back(i, u32regex_replace(text, *ms.re, settings.replace_with));
+				}
+				continue;
 			}
-			continue;
-		}
 
-		size_t pos = 0;
-		while (MatchState ms = matches(&diag, pos)) {
-			++count;
-			Replace(&diag, ms);
-			pos = ms.end;
+			std::string result;
+			size_t last = 0;
+			size_t count = 0;
+			while (MatchState ms = index->Find(entry, pos)) {
+				// Replacing an empty match would never finish
+				if (ms.start == ms.end) break;
+				result.append(text, last, ms.start - last);
+				result += settings.replace_with;
+				last = ms.end;
+				++count;
+			}
+			if (count) {
+				result.append(text, last, std::string::npos);
+				counts[chunk] += count;
+				replaced[chunk].emplace_back(i, std::move(result));
+			}
 		}
+	});
+
+	size_t count = 0;
+	auto field = get_dialogue_field(settings.field);
+	for (size_t chunk = 0; chunk < chunks; ++chunk) {
+		count += counts[chunk];
+		for (auto& line : replaced[chunk])
+			lines[line.first]->*field = std::move(line.second);
 	}
 
 	if (count > 0) {
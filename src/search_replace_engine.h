@@ -14,8 +14,11 @@
 //
 // Aegisub Project http://www.aegisub.org/
 
+#include <libaegisub/signal.h>
+
 #include <functional>
 #include <boost/regex/icu.hpp>
+#include <memory>
 #include <string>
 
 namespace agi { struct Context; }
@@ -55,12 +58,19 @@ struct SearchReplaceSettings {
 };
 
 class SearchReplaceEngine {
+	struct Index;
+
 	agi::Context *context;
 	bool initialized = false;
 	SearchReplaceSettings settings;
+	/// Searchable copies of the field being searched in each line, kept
+	/// between searches and only rebuilt for lines which have changed
+	std::unique_ptr<Index> index;
+	agi::signal::Connection commit_connection;
 
 	bool FindReplace(bool replace);
 	void Replace(AssDialogue *line, MatchState &ms);
+	void OnCommit(int type);
 
 public:
 	bool FindNext() { return FindReplace(false); }
@@ -72,4 +82,5 @@ public:
 	static std::function<MatchState (const AssDialogue*, size_t)> GetMatcher(SearchReplaceSettings const& settings);
 
 	SearchReplaceEngine(agi::Context *c);
+	~SearchReplaceEngine();
 };
@@ -38,6 +38,8 @@
 #include <libaegisub/path.h>
 #include <libaegisub/util.h>
 
+#include <unordered_map>
+
 #include <wx/msgdlg.h>
 
 namespace {
@@ -48,37 +50,105 @@ namespace {
 		else
 			timer->Stop();
 	}
+
+	bool same_line(AssDialogueBase const& a, AssDialogueBase const& b) {
+		return a.Comment == b.Comment
+			&& a.Layer == b.Layer
+			&& a.Margin == b.Margin
+			&& a.Start == b.Start
+			&& a.End == b.End
+			&& a.Style == b.Style
+			&& a.Actor == b.Actor
+			&& a.Effect == b.Effect
+			&& a.ExtradataIds == b.ExtradataIds
+			&& a.Text == b.Text;
+	}
+
+	/// Reuse the previous snapshot's copy of a section of the file if it
+	/// hasn't changed, or make a new copy if it has
+	template<typename T, typename Container, typename Equal>
+	std::shared_ptr<const std::vector<T>> share_or_copy(std::shared_ptr<const std::vector<T>> const& previous, Container const& current, Equal equal) {
+		if (previous && previous->size() == (size_t)std::distance(current.begin(), current.end())
+			&& std::equal(current.begin(), current.end(), previous->begin(), equal))
+			return previous;
+		return std::make_shared<const std::vector<T>>(current.begin(), current.end());
+	}
 }
 
+/// A snapshot of the file for the undo stack
+///
+/// Consecutive snapshots share everything which didn't change between them:
+/// each section of the header is shared as a whole, and dialogue lines are
+/// shared individually, so each commit only copies the lines it modified.
 struct SubsController::UndoInfo {
 	wxString undo_description;
 	int commit_id;
 
-	std::vector<std::pair<std::string, std::string>> script_info;
-	std::vector<AssStyle> styles;
-	std::vector<AssDialogueBase> events;
-	std::vector<AssAttachment> attachments;
-	std::vector<ExtradataEntry> extradata;
+	std::shared_ptr<const std::vector<std::pair<std::string, std::string>>> script_info;
+	std::shared_ptr<const std::vector<AssStyle>> styles;
+	std::vector<std::shared_ptr<const AssDialogueBase>> events;
+	std::shared_ptr<const std::vector<AssAttachment>> attachments;
+	std::shared_ptr<const std::vector<ExtradataEntry>> extradata;
 
 	mutable std::vector<int> selection;
 	int active_line_id = 0;
 	int pos = 0, sel_start = 0, sel_end = 0;
 
-	UndoInfo(const agi::Context *c, wxString const& d, int commit_id)
+	/// @param previous Snapshot to share unchanged data with, if any
+	UndoInfo(const agi::Context *c, wxString const& d, int commit_id, UndoInfo const* previous)
 	: undo_description(d)
 	, commit_id(commit_id)
-	, attachments(c->ass->Attachments)
-	, extradata(c->ass->Extradata)
 	{
-		script_info.reserve(c->ass->Info.size());
-		for (auto const& info : c->ass->Info)
-			script_info.emplace_back(info.Key(), info.Value());
-
-		styles.reserve(c->ass->Styles.size());
-		styles.assign(c->ass->Styles.begin(), c->ass->Styles.end());
+		auto const& ass = *c->ass;
+
+		std::vector<std::pair<std::string, std::string>> info;
+		info.reserve(ass.Info.size());
+		for (auto const& line : ass.Info)
+			info.emplace_back(line.Key(), line.Value());
+		if (previous && *previous->script_info == info)
+			script_info = previous->script_info;
+		else
+			script_info = std::make_shared<const std::vector<std::pair<std::string, std::string>>>(std::move(info));
+
+		styles = share_or_copy(previous ? previous->styles : nullptr, ass.Styles,
+			[](AssStyle const& a, AssStyle const& b) { return a.GetEntryData() == b.GetEntryData(); });
+		// Copies of an attachment share their data, so unchanged attachments
+		// can be recognized without comparing it
+		attachments = share_or_copy(previous ? previous->attachments : nullptr, ass.Attachments,
+			[](AssAttachment const& a, AssAttachment const& b) {
+				return a.GetData() == b.GetData() && a.Group() == b.Group() && a.GetFileName(true) == b.GetFileName(true);
+			});
+		extradata = share_or_copy(previous ? previous->extradata : nullptr, ass.Extradata,
+			[](ExtradataEntry const& a, ExtradataEntry const& b) { return a.id == b.id && a.key == b.key && a.value == b.value; });
+
+		// Lines are usually at the same index as in the previous snapshot,
+		// so only fall back to looking them up by ID when they aren't
+		std::unordered_map<int, size_t> previous_index;
+		events.reserve(ass.Events.size());
+		size_t i = 0;
+		for (auto const& line : ass.Events) {
+			const AssDialogueBase *old = nullptr;
+			size_t old_index = i++;
+			if (previous) {
+				auto const& old_events = previous->events;
+				if (old_index >= old_events.size() || old_events[old_index]->Id != line.Id) {
+					if (previous_index.empty()) {
+						previous_index.reserve(old_events.size());
+						for (size_t j = 0; j < old_events.size(); ++j)
+							previous_index.emplace(old_events[j]->Id, j);
+					}
+					auto it = previous_index.find(line.Id);
+					old_index = it == previous_index.end() ? old_events.size() : it->second;
+				}
+				if (old_index < old_events.size())
+					old = old_events[old_index].get();
+			}
 
-		events.reserve(c->ass->Events.size());
-		events.assign(c->ass->Events.begin(), c->ass->Events.end());
+			if (old && same_line(*old, line))
+				events.push_back(previous->events[old_index]);
+			else
+				events.push_back(std::make_shared<const AssDialogueBase>(line));
+		}
 
 		UpdateActiveLine(c);
 		UpdateSelection(c);
@@ -97,23 +167,39 @@ struct SubsController::UndoInfo {
 
 		sort(begin(selection), end(selection));
 
+		// Lines which are identical in the snapshot are moved back into the
+		// file rather than recreated, so only the lines which actually differ
+		// are allocated
+		std::unordered_map<int, AssDialogue *> existing;
+		for (auto& line : old.Events)
+			existing.emplace(line.Id, &line);
+
 		AssDialogue *active_line = nullptr;
 		Selection new_sel;
 
-		for (auto const& info : script_info)
+		for (auto const& info : *script_info)
 			c->ass->Info.push_back(*new AssInfo(info.first, info.second));
-		for (auto const& style : styles)
+		for (auto const& style : *styles)
 			c->ass->Styles.push_back(*new AssStyle(style));
-		c->ass->Attachments = attachments;
+		c->ass->Attachments = *attachments;
 		for (auto const& event : events) {
-			auto copy = new AssDialogue(event);
-			c->ass->Events.push_back(*copy);
-			if (copy->Id == active_line_id)
-				active_line = copy;
-			if (binary_search(begin(selection), end(selection), copy->Id))
-				new_sel.insert(copy);
+			AssDialogue *line;
+			auto it = existing.find(event->Id);
+			if (it != existing.end() && same_line(*it->second, *event)) {
+				line = it->second;
+				line->unlink();
+				existing.erase(it);
+			}
+			else
+				line = new AssDialogue(*event);
+
+			c->ass->Events.push_back(*line);
+			if (line->Id == active_line_id)
+				active_line = line;
+			if (binary_search(begin(selection), end(selection), line->Id))
+				new_sel.insert(line);
 		}
-		c->ass->Extradata = extradata;
+		c->ass->Extradata = *extradata;
 
 		c->ass->Commit("", AssFile::COMMIT_NEW);
 		c->selectionController->SetSelectionAndActive(std::move(new_sel), active_line);
@@ -317,8 +403,8 @@ void SubsController::OnCommit(AssFileCommit c) {
 		// If only one line changed just modify it instead of copying the file
 		if (c.single_line && c.single_line->Group() == AssEntryGroup::DIALOGUE) {
 			for (auto& diag : undo_stack.back().events) {
-				if (diag.Id == c.single_line->Id) {
-					diag = *c.single_line;
+				if (diag->Id == c.single_line->Id) {
+					diag = std::make_shared<const AssDialogueBase>(*c.single_line);
 					break;
 				}
 			}
@@ -339,7 +425,7 @@ void SubsController::OnCommit(AssFileCommit c) {
 
 	redo_stack.clear();
 
-	undo_stack.emplace_back(context, c.message, commit_id);
+	undo_stack.emplace_back(context, c.message, commit_id, undo_stack.empty() ? nullptr : &undo_stack.back());
 
 	int depth = std::max<int>(OPT_GET("Limits/Undo Levels")->GetInt(), 2);
 	while ((int)undo_stack.size() > depth)
@@ -29,17 +29,84 @@
 #include "version.h"
 
 #include <libaegisub/ass/uuencode.h>
+#include <libaegisub/file_mapping.h>
 #include <libaegisub/fs.h>
 
+#include <algorithm>
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/utility/string_view.hpp>
+#include <cstring>
+
 DEFINE_EXCEPTION(AssParseError, SubtitleFormatParseError);
 
+namespace {
+bool is_space(char c) {
+	return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
+
+/// Split the next line off of a UTF-8 buffer, trimmed the same way as
+/// TextFileReader trims lines
+boost::string_view next_line(const char *&pos, const char *end) {
+	const char *eol = static_cast<const char *>(memchr(pos, '\n', end - pos));
+	if (!eol) eol = end;
+
+	const char *begin = pos;
+	const char *last = eol;
+	pos = eol == end ? end : eol + 1;
+
+	while (begin != last && is_space(*begin)) ++begin;
+	while (last != begin && is_space(last[-1])) --last;
+	if (last - begin >= 3 && !memcmp(begin, "\xEF\xBB\xBF", 3))
+		begin += 3;
+	return boost::string_view(begin, last - begin);
+}
+
+bool is_section_header(boost::string_view line) {
+	return !line.empty() && line.front() == '[' && line.back() == ']';
+}
+}
+
 void AssSubtitleFormat::ReadFile(AssFile *target, agi::fs::path const& filename, agi::vfr::Framerate const& fps, std::string const& encoding) const {
 	int version = !agi::fs::HasExtension(filename, "ssa");
-
-	TextFileReader file(filename, encoding);
 	AssParser parser(target, version);
-	while (file.HasMoreLines())
-		parser.AddLine(file.ReadLineFromFile());
+
+	if (!boost::iequals(encoding, "utf-8")) {
+		TextFileReader file(filename, encoding);
+		while (file.HasMoreLines())
+			parser.AddLine(file.ReadLineFromFile());
+		return;
+	}
+
+	// UTF-8 files need no conversion, so lines are sliced directly out of
+	// the mapped file and the events section is handed to the parser in
+	// one piece so that it can be parsed in parallel
+	agi::read_file_mapping file(filename);
+	const char *pos = file.read();
+	const char *end = pos + file.size();
+
+	std::vector<boost::string_view> events;
+	while (pos != end) {
+		auto line = next_line(pos, end);
+		if (!parser.InEvents() || is_section_header(line)) {
+			parser.AddLine(line.to_string());
+			continue;
+		}
+
+		events.clear();
+		events.push_back(line);
+		const char *section_end = pos;
+		while (pos != end) {
+			section_end = pos;
+			line = next_line(pos, end);
+			if (is_section_header(line)) {
+				pos = section_end;
+				break;
+			}
+			if (!line.empty())
+				events.push_back(line);
+		}
+		parser.AddEventLines(events);
+	}
 }
 
 #ifdef _WIN32
@@ -83,10 +150,19 @@ struct Writer {
 				group = line.Group();
 			}
 
-			file.WriteLineToFile(line.GetEntryData());
+			WriteEntry(line);
 		}
 	}
 
+	template<typename T>
+	void WriteEntry(T const& line) {
+		file.WriteLineToFile(line.GetEntryData());
+	}
+
+	void WriteEntry(AssAttachment const& attachment) {
+		attachment.WriteEntryData(file);
+	}
+
 	void Write(ProjectProperties const& properties) {
 		file.WriteLineToFile("");
 		file.WriteLineToFile("[Aegisub Project Garbage]");
@@ -41,8 +41,8 @@
 #include "text_file_reader.h"
 #include "text_file_writer.h"
 
+#include <libaegisub/ass/override.h>
 #include <libaegisub/format.h>
-#include <libaegisub/of_type_adaptor.h>
 
 #include <boost/algorithm/string/case_conv.hpp>
 #include <boost/algorithm/string/predicate.hpp>
@@ -463,64 +463,60 @@ bool SRTSubtitleFormat::CanSave(const AssFile *file) const {
 		if (line.Style != def)
 			return false;
 
-		auto blocks = line.ParseTags();
-		for (auto ovr : blocks | agi::of_type<AssDialogueBlockOverride>()) {
-			// Verify that all overrides used are supported
-			for (auto const& tag : ovr->Tags) {
-				if (tag.Name.size() != 2)
-					return false;
-				if (!strchr("bisu", tag.Name[1]))
-					return false;
+		// Verify that all overrides used are supported
+		struct visitor final : agi::ass::DialogueVisitor {
+			bool supported = true;
+			void VisitTag(agi::ass::Tag const& tag) override {
+				if (tag.depth == 0 && (tag.name.size() != 2 || !strchr("bisu", tag.name[1])))
+					supported = false;
 			}
-		}
+		} v;
+		agi::ass::VisitDialogue(line.Text.get(), v);
+		if (!v.supported)
+			return false;
 	}
 
 	return true;
 }
 
 std::string SRTSubtitleFormat::ConvertTags(const AssDialogue *diag) const {
-	struct tag_state { char tag; bool value; };
-	tag_state tag_states[] = {
-		{'b', false},
-		{'i', false},
-		{'s', false},
-		{'u', false}
-	};
-
-	std::string final;
-	for (auto& block : diag->ParseTags()) {
-		switch (block->GetType()) {
-		case AssBlockType::OVERRIDE:
-			for (auto const& tag : static_cast<AssDialogueBlockOverride&>(*block).Tags) {
-				if (!tag.IsValid() || tag.Name.size() != 2)
-					continue;
-				for (auto& state : tag_states) {
-					if (state.tag != tag.Name[1]) continue;
-
-					bool temp = tag.Params[0].Get(false);
-					if (temp && !state.value)
-						final += agi::format("<%c>", state.tag);
-					if (!temp && state.value)
-						final += agi::format("</%c>", state.tag);
-					state.value = temp;
-				}
+	struct visitor final : agi::ass::DialogueVisitor {
+		struct tag_state { char tag; bool value; };
+		tag_state tag_states[4] = {
+			{'b', false},
+			{'i', false},
+			{'s', false},
+			{'u', false}
+		};
+		std::string final;
+
+		void VisitTag(agi::ass::Tag const& tag) override {
+			if (tag.depth > 0 || !tag.IsValid() || tag.name.size() != 2)
+				return;
+			for (auto& state : tag_states) {
+				if (state.tag != tag.name[1]) continue;
+
+				bool temp = tag.params[0].GetBool(false);
+				if (temp && !state.value)
+					final += agi::format("<%c>", state.tag);
+				if (!temp && state.value)
+					final += agi::format("</%c>", state.tag);
+				state.value = temp;
 			}
-			break;
-		case AssBlockType::PLAIN:
-			final += block->GetText();
-			break;
-		case AssBlockType::DRAWING:
-		case AssBlockType::COMMENT:
-			break;
 		}
-	}
+
+		void VisitText(boost::string_view text) override {
+			final.append(text.data(), text.size());
+		}
+	} v;
+	agi::ass::VisitDialogue(diag->Text.get(), v);
 
 	// Ensure all tags are closed
 	// Otherwise unclosed overrides might affect lines they shouldn't, see bug #809 for example
-	for (auto state : tag_states) {
+	for (auto state : v.tag_states) {
 		if (state.value)
-			final += agi::format("</%c>", state.tag);
+			v.final += agi::format("</%c>", state.tag);
 	}
 
-	return final;
+	return v.final;
 }
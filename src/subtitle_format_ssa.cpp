@@ -68,14 +68,14 @@ void SsaSubtitleFormat::WriteFile(const AssFile *src, agi::fs::path const& filen
 	file.WriteLineToFile("[Fonts]");
 	for (auto const& line : src->Attachments) {
 		if (line.Group() == AssEntryGroup::FONT)
-			file.WriteLineToFile(line.GetEntryData());
+			line.WriteEntryData(file);
 	}
 
 	file.WriteLineToFile("");
 	file.WriteLineToFile("[Graphics]");
 	for (auto const& line : src->Attachments) {
 		if (line.Group() == AssEntryGroup::GRAPHIC)
-			file.WriteLineToFile(line.GetEntryData());
+			line.WriteEntryData(file);
 	}
 
 	file.WriteLineToFile("");
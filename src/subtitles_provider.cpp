@@ -26,6 +26,12 @@
 #include "subtitles_provider_csri.h"
 #include "subtitles_provider_libass.h"
 
+#include <libaegisub/make_unique.h>
+
+#include <algorithm>
+#include <boost/functional/hash.hpp>
+#include <unordered_map>
+
 namespace {
 	struct factory {
 		std::string name;
@@ -68,8 +74,155 @@ std::unique_ptr<SubtitlesProvider> SubtitlesProviderFactory::GetProvider(agi::Ba
 	throw error;
 }
 
-void SubtitlesProvider::LoadSubtitles(AssFile *subs, int time) {
+namespace {
+/// Hash of everything about a line which affects how it is rendered.
+/// Equal flyweights share their value, so hashing the address is enough.
+size_t hash_line(AssDialogueBase const& line) {
+	size_t hash = 0;
+	boost::hash_combine(hash, line.Layer);
+	boost::hash_combine(hash, line.Margin[0]);
+	boost::hash_combine(hash, line.Margin[1]);
+	boost::hash_combine(hash, line.Margin[2]);
+	boost::hash_combine(hash, static_cast<int>(line.Start));
+	boost::hash_combine(hash, static_cast<int>(line.End));
+	boost::hash_combine(hash, &line.Style.get());
+	boost::hash_combine(hash, &line.Actor.get());
+	boost::hash_combine(hash, &line.Effect.get());
+	boost::hash_combine(hash, &line.Text.get());
+	return hash;
+}
+
+bool same_line(AssDialogueBase const& a, AssDialogueBase const& b) {
+	return a.Layer == b.Layer
+		&& a.Margin == b.Margin
+		&& a.Start == b.Start
+		&& a.End == b.End
+		&& a.Style == b.Style
+		&& a.Actor == b.Actor
+		&& a.Effect == b.Effect
+		&& a.Text == b.Text;
+}
+
+bool is_visible(AssDialogue const& line, int time) {
+	return !line.Comment && (time < 0 || !(line.Start > time || line.End <= time));
+}
+}
+
+struct SubtitlesProvider::LoadedScript {
+	/// The script info and styles sections
+	std::string header;
+	/// Font attachments, which share their data with the file's copies so
+	/// that unchanged fonts can be recognized without comparing their data
+	std::vector<AssAttachment> fonts;
+	/// Copies of the loaded lines, in the order the provider has them
+	std::vector<AssDialogueBase> lines;
+	/// Relative position in the script of each loaded line
+	std::vector<int> order;
+
+	bool SameFonts(AssFile const& subs) const {
+		auto it = fonts.begin();
+		for (auto const& attachment : subs.Attachments) {
+			if (attachment.Group() != AssEntryGroup::FONT) continue;
+			if (it == fonts.end() || it->GetData() != attachment.GetData() || it->GetFileName(true) != attachment.GetFileName(true))
+				return false;
+			++it;
+		}
+		return it == fonts.end();
+	}
+};
+
+SubtitlesProvider::SubtitlesProvider() = default;
+SubtitlesProvider::~SubtitlesProvider() = default;
+
+bool SubtitlesProvider::UpdateLoadedEvents(AssFile *subs, int time) {
+	auto& lines = loaded->lines;
+
+	std::unordered_multimap<size_t, size_t> unmatched;
+	unmatched.reserve(lines.size());
+	for (size_t i = 0; i < lines.size(); ++i)
+		unmatched.emplace(hash_line(lines[i]), i);
+
+	// Match each line in the file to an identical loaded line. Lines which
+	// have no match are new or changed, and are only sent to the provider if
+	// they would have been included in a full load.
+	std::vector<int> position(lines.size(), -1);
+	std::vector<AssDialogue const*> added;
+	std::vector<int> added_position;
+	int pos = 0;
+	for (auto const& line : subs->Events) {
+		int line_pos = pos++;
+		if (line.Comment) continue;
+
+		auto range = unmatched.equal_range(hash_line(line));
+		auto match = std::find_if(range.first, range.second, [&](std::pair<const size_t, size_t> const& p) {
+			return same_line(lines[p.second], line);
+		});
+		if (match != range.second) {
+			position[match->second] = line_pos;
+			unmatched.erase(match);
+		}
+		else if (is_visible(line, time)) {
+			added.push_back(&line);
+			added_position.push_back(line_pos);
+		}
+	}
+
+	std::vector<size_t> removed;
+	std::vector<int> order;
+	order.reserve(lines.size() - unmatched.size() + added.size());
+	for (size_t i = 0; i < lines.size(); ++i) {
+		if (position[i] < 0)
+			removed.push_back(i);
+		else
+			order.push_back(position[i]);
+	}
+	order.insert(order.end(), added_position.begin(), added_position.end());
+
+	if (removed.empty() && added.empty() && order == loaded->order)
+		return true;
+
 	buffer.clear();
+	for (auto line : added) {
+		auto data = line->GetEntryData();
+		buffer.insert(buffer.end(), data.begin(), data.end());
+		buffer.push_back('\n');
+	}
+
+	if (!UpdateEvents(removed, buffer.data(), buffer.size(), order))
+		return false;
+
+	size_t kept = 0;
+	for (size_t i = 0; i < lines.size(); ++i) {
+		if (position[i] >= 0) {
+			if (kept != i) lines[kept] = std::move(lines[i]);
+			++kept;
+		}
+	}
+	lines.erase(lines.begin() + kept, lines.end());
+	for (auto line : added)
+		lines.push_back(*line);
+	loaded->order = std::move(order);
+	return true;
+}
+
+void SubtitlesProvider::LoadSubtitles(AssFile *subs, int time) {
+	std::string header = "\xEF\xBB\xBF[Script Info]\n";
+	for (auto const& line : subs->Info) {
+		header += line.GetEntryData();
+		header += '\n';
+	}
+	header += "[V4+ Styles]\n";
+	for (auto const& line : subs->Styles) {
+		header += line.GetEntryData();
+		header += '\n';
+	}
+
+	if (loaded && loaded->header == header && loaded->SameFonts(*subs) && UpdateLoadedEvents(subs, time))
+		return;
+	loaded.reset();
+
+	auto script = agi::make_unique<LoadedScript>();
+	buffer.assign(header.begin(), header.end());
 
 	auto push_header = [&](const char *str) {
 		buffer.insert(buffer.end(), str, str + strlen(str));
@@ -79,30 +232,37 @@ void SubtitlesProvider::LoadSubtitles(AssFile *subs, int time) {
 		buffer.push_back('\n');
 	};
 
-	push_header("\xEF\xBB\xBF[Script Info]\n");
-	for (auto const& line : subs->Info)
-		push_line(line.GetEntryData());
-
-	push_header("[V4+ Styles]\n");
-	for (auto const& line : subs->Styles)
-		push_line(line.GetEntryData());
-
-	if (!subs->Attachments.empty()) {
-		// TODO: some scripts may have a lot of attachments, 
-		// so ideally we'd want to write only those actually used on the requested video frame,
-		// but this would require some pre-parsing of the attached font files with FreeType,
-		// which isn't probably trivial.
-		push_header("[Fonts]\n");
-		for (auto const& attachment : subs->Attachments)
-			if (attachment.Group() == AssEntryGroup::FONT)
-				push_line(attachment.GetEntryData());
+	// Fonts which the provider can't take directly are uuencoded into the
+	// script, the same as when it's saved
+	bool fonts_header = false;
+	for (auto const& attachment : subs->Attachments) {
+		if (attachment.Group() != AssEntryGroup::FONT) continue;
+		if (!AddFont(attachment.GetFileName(), attachment.GetData())) {
+			if (!fonts_header) {
+				push_header("[Fonts]\n");
+				fonts_header = true;
+			}
+			attachment.WriteEntryData([&](const char *str, size_t len) {
+				buffer.insert(buffer.end(), str, str + len);
+			});
+			buffer.push_back('\n');
+		}
+		script->fonts.push_back(attachment);
 	}
 
 	push_header("[Events]\n");
+	int pos = 0;
 	for (auto const& line : subs->Events) {
-		if (!line.Comment && (time < 0 || !(line.Start > time || line.End <= time)))
+		int line_pos = pos++;
+		if (is_visible(line, time)) {
 			push_line(line.GetEntryData());
+			script->lines.push_back(line);
+			script->order.push_back(line_pos);
+		}
 	}
 
 	LoadSubtitles(&buffer[0], buffer.size());
+
+	script->header = std::move(header);
+	loaded = std::move(script);
 }
@@ -36,10 +36,12 @@
 
 #include "compat.h"
 #include "include/aegisub/subtitles_provider.h"
+#include "libass_renderer_pool.h"
 #include "video_frame.h"
 #include "options.h"
 
 #include <libaegisub/background_runner.h>
+#include <libaegisub/blend.h>
 #include <libaegisub/dispatch.h>
 #include <libaegisub/exception.h>
 #include <libaegisub/log.h>
@@ -47,13 +49,7 @@
 #include <libaegisub/util.h>
 
 #include <atomic>
-#if BOOST_VERSION >= 106900
-#include <boost/gil.hpp>
-#else
-#include <boost/gil/gil_all.hpp>
-#endif
 #include <memory>
-#include <mutex>
 
 #include <wx/intl.h>
 #include <wx/thread.h>
@@ -64,7 +60,11 @@ extern "C" {
 
 namespace {
 std::unique_ptr<agi::dispatch::Queue> cache_queue;
+/// Library shared by every provider. The embedded fonts each provider's
+/// script needs are tracked by its renderer pool.
 ASS_Library *library;
+/// Set once fontconfig has finished building its cache
+std::atomic<bool> fonts_cached{false};
 
 void msg_callback(int level, const char *fmt, va_list args, void *) {
 	if (level >= 7) return;
@@ -81,34 +81,30 @@ void msg_callback(int level, const char *fmt, va_list args, void *) {
 		LOG_D("subtitle/provider/libass") << buf;
 }
 
-// Stuff used on the cache thread, owned by a shared_ptr in case the provider
-// gets deleted before the cache finishing updating
-struct cache_thread_shared {
-	ASS_Renderer *renderer = nullptr;
-	std::atomic<bool> ready{false};
-	~cache_thread_shared() { if (renderer) ass_renderer_done(renderer); }
-};
-
 class LibassSubtitlesProvider final : public SubtitlesProvider {
 	agi::BackgroundRunner *br;
-	std::shared_ptr<cache_thread_shared> shared;
-	ASS_Track* ass_track = nullptr;
+	libass::RendererPool pool;
+
+	/// Fonts passed to AddFont for the script which is about to be loaded
+	std::vector<libass::RendererPool::Font> pending_fonts;
 
-	ASS_Renderer *renderer() {
-		if (shared->ready)
-			return shared->renderer;
+	/// Wait for fontconfig to finish building its cache, which is only done
+	/// once for all providers
+	void WaitForFontCache() {
+		if (fonts_cached)
+			return;
 
 		auto block = [&] {
-			if (shared->ready)
+			if (fonts_cached)
 				return;
 			agi::util::sleep_for(250);
-			if (shared->ready)
+			if (fonts_cached)
 				return;
 			br->Run([=](agi::ProgressSink *ps) {
 				ps->SetTitle(from_wx(_("Updating font index")));
 				ps->SetMessage(from_wx(_("This may take several minutes")));
 				ps->SetIndeterminate();
-				while (!shared->ready && !ps->IsCancelled())
+				while (!fonts_cached && !ps->IsCancelled())
 					agi::util::sleep_for(250);
 			});
 		};
@@ -117,94 +113,68 @@ class LibassSubtitlesProvider final : public SubtitlesProvider {
 			block();
 		else
 			agi::dispatch::Main().Sync(block);
-		return shared->renderer;
 	}
 
 public:
 	LibassSubtitlesProvider(agi::BackgroundRunner *br);
-	~LibassSubtitlesProvider();
 
 	void LoadSubtitles(const char *data, size_t len) override {
-		if (ass_track) ass_free_track(ass_track);
-		ass_track = ass_read_memory(library, const_cast<char *>(data), len, nullptr);
-		if (!ass_track) throw agi::InternalError("libass failed to load subtitles.");
-		if (OPT_GET("Experiments/Unicode63 Bracket Matching")->GetBool()) ass_track_set_feature(ass_track, ASS_FEATURE_BIDI_BRACKETS, 1);
+		pool.SetFonts(pending_fonts);
+		pending_fonts.clear();
+		pool.SetScript(data, len, OPT_GET("Experiments/Unicode63 Bracket Matching")->GetBool());
+	}
+
+	bool UpdateEvents(std::vector<size_t> const& removed, const char *data, size_t len, std::vector<int> const& order) override {
+		return pool.UpdateEvents(removed, data, len, order);
+	}
+
+	bool AddFont(std::string const& name, std::shared_ptr<const std::vector<char>> const& data) override {
+		pending_fonts.emplace_back(name, data);
+		return true;
 	}
 
 	void DrawSubtitles(VideoFrame &dst, double time) override;
 
 	void Reinitialize() override {
 		// No need to reinit if we're not even done with the initial init
-		if (!shared->ready)
+		if (!fonts_cached)
 			return;
 
-		ass_renderer_done(shared->renderer);
-		shared->renderer = ass_renderer_init(library);
-		ass_set_font_scale(shared->renderer, 1.);
-		ass_set_fonts(shared->renderer, nullptr, "Sans", 1, nullptr, true);
+		pool.Reset();
 	}
 };
 
 LibassSubtitlesProvider::LibassSubtitlesProvider(agi::BackgroundRunner *br)
 : br(br)
-, shared(std::make_shared<cache_thread_shared>())
+, pool(library)
 {
-	auto state = shared;
-	cache_queue->Async([state] {
-		auto ass_renderer = ass_renderer_init(library);
-		if (ass_renderer) {
-			ass_set_font_scale(ass_renderer, 1.);
-			ass_set_fonts(ass_renderer, nullptr, "Sans", 1, nullptr, true);
-		}
-		state->renderer = ass_renderer;
-		state->ready = true;
-	});
 }
 
-LibassSubtitlesProvider::~LibassSubtitlesProvider() {
-	if (ass_track) ass_free_track(ass_track);
-}
-
-#define _r(c) ((c)>>24)
-#define _g(c) (((c)>>16)&0xFF)
-#define _b(c) (((c)>>8)&0xFF)
-#define _a(c) ((c)&0xFF)
-
 void LibassSubtitlesProvider::DrawSubtitles(VideoFrame &frame,double time) {
-	ass_set_frame_size(renderer(), frame.width, frame.height);
-
-	ASS_Image* img = ass_render_frame(renderer(), ass_track, int(time * 1000), nullptr);
+	WaitForFontCache();
 
 	// libass actually returns several alpha-masked monochrome images.
 	// Here, we loop through their linked list, get the colour of the current, and blend into the frame.
 	// This is repeated for all of them.
-
-	using namespace boost::gil;
-	auto dst = interleaved_view(frame.width, frame.height, (bgra8_pixel_t*)frame.data.data(), frame.width * 4);
-	if (frame.flipped)
-		dst = flipped_up_down_view(dst);
-
-	for (; img; img = img->next) {
-		unsigned int opacity = 255 - ((unsigned int)_a(img->color));
-		unsigned int r = (unsigned int)_r(img->color);
-		unsigned int g = (unsigned int)_g(img->color);
-		unsigned int b = (unsigned int)_b(img->color);
-
-		auto srcview = interleaved_view(img->w, img->h, (gray8_pixel_t*)img->bitmap, img->stride);
-		auto dstview = subimage_view(dst, img->dst_x, img->dst_y, img->w, img->h);
-
-		transform_pixels(dstview, srcview, dstview, [=](const bgra8_pixel_t frame, const gray8_pixel_t src) -> bgra8_pixel_t {
-			unsigned int k = ((unsigned)src) * opacity / 255;
-			unsigned int ck = 255 - k;
-
-			bgra8_pixel_t ret;
-			ret[0] = (k * b + ck * frame[0]) / 255;
-			ret[1] = (k * g + ck * frame[1]) / 255;
-			ret[2] = (k * r + ck * frame[2]) / 255;
-			ret[3] = 0;
-			return ret;
-		});
-	}
+	pool.Render(frame.width, frame.height, int(time * 1000), [&](ASS_Image *img) {
+		const ptrdiff_t frame_stride = frame.width * 4;
+		for (; img; img = img->next) {
+			if (img->w <= 0 || img->h <= 0) continue;
+
+			uint8_t *dst;
+			ptrdiff_t dst_stride;
+			if (frame.flipped) {
+				dst = &frame.data[(frame.height - 1 - img->dst_y) * frame_stride + img->dst_x * 4];
+				dst_stride = -frame_stride;
+			}
+			else {
+				dst = &frame.data[img->dst_y * frame_stride + img->dst_x * 4];
+				dst_stride = frame_stride;
+			}
+
+			agi::BlendMask(dst, dst_stride, img->bitmap, img->stride, img->w, img->h, img->color);
+		}
+	});
 }
 }
 
@@ -223,9 +193,9 @@ void CacheFonts() {
 
 	// Initialize a renderer to force fontconfig to update its cache
 	cache_queue->Async([] {
-		auto ass_renderer = ass_renderer_init(library);
-		ass_set_fonts(ass_renderer, nullptr, "Sans", 1, nullptr, true);
-		ass_renderer_done(ass_renderer);
+		if (auto ass_renderer = libass::CreateRenderer(library))
+			ass_renderer_done(ass_renderer);
+		fonts_cached = true;
 	});
 }
 }
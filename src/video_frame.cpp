@@ -16,6 +16,8 @@
 
 #include "video_frame.h"
 
+#include <libaegisub/yuv.h>
+
 #if BOOST_VERSION >= 106900
 #include <boost/gil.hpp>
 #else
@@ -37,9 +39,35 @@ namespace {
 	};
 }
 
+void ConvertToBGRA(VideoFrame const& src, VideoFrame &dst) {
+	if (src.format == VideoFrame::Format::BGRA) {
+		dst = src;
+		return;
+	}
+
+	dst.data.resize(src.width * src.height * 4);
+	dst.width = src.width;
+	dst.height = src.height;
+	dst.pitch = src.width * 4;
+	dst.flipped = src.flipped;
+	dst.format = VideoFrame::Format::BGRA;
+
+	const unsigned char *y = src.data.data();
+	const unsigned char *u = y + src.pitch * src.height;
+	const unsigned char *v = u + src.chroma_pitch * ((src.height + 1) / 2);
+	agi::YUV420ToBGRA(dst.data.data(), dst.pitch, y, src.pitch, u, v, src.chroma_pitch,
+		src.width, src.height, src.matrix, src.range);
+}
+
 wxImage GetImage(VideoFrame const& frame) {
 	using namespace boost::gil;
 
+	if (frame.format != VideoFrame::Format::BGRA) {
+		VideoFrame bgra;
+		ConvertToBGRA(frame, bgra);
+		return GetImage(bgra);
+	}
+
 	wxImage img(frame.width, frame.height);
 	auto src = interleaved_view(frame.width, frame.height, (bgra8_pixel_t*)frame.data.data(), frame.pitch);
 	auto dst = interleaved_view(frame.width, frame.height, (rgb8_pixel_t*)img.GetData(), 3 * frame.width);
@@ -14,16 +14,37 @@
 //
 // Aegisub Project http://www.aegisub.org/
 
+#include <libaegisub/ycbcr_conv.h>
+
 #include <vector>
 
 class wxImage;
 
 struct VideoFrame {
+	/// Layout of the pixel data
+	enum class Format {
+		/// Packed 8-bit BGRA, with pitch bytes per row
+		BGRA,
+		/// Planar 8-bit YCbCr with half-size chroma: a luma plane with pitch
+		/// bytes per row, followed by the Cb and then the Cr plane, each with
+		/// chroma_pitch bytes per row and (height + 1) / 2 rows
+		YUV420
+	};
+
 	std::vector<unsigned char> data;
 	size_t width;
 	size_t height;
 	size_t pitch;
 	bool flipped;
+
+	Format format = Format::BGRA;
+	/// Only used for YUV420 frames
+	size_t chroma_pitch = 0;
+	agi::ycbcr_matrix matrix = agi::ycbcr_matrix::bt601;
+	agi::ycbcr_range range = agi::ycbcr_range::tv;
 };
 
+/// Copy a frame to dst, converting it to BGRA if needed
+void ConvertToBGRA(VideoFrame const& src, VideoFrame &dst);
+
 wxImage GetImage(VideoFrame const& frame);
@@ -19,44 +19,44 @@
 #include "options.h"
 #include "video_frame.h"
 
+#include <libaegisub/log.h>
+#include <libaegisub/lru_cache.h>
 #include <libaegisub/make_unique.h>
 
-#include <list>
-
 namespace {
-/// A video frame and its frame number
-struct CachedFrame {
-	VideoFrame frame;
-	int frame_number;
-
-	CachedFrame(VideoFrame const& frame, int frame_number)
-	: frame(frame), frame_number(frame_number) { }
-
-	CachedFrame(CachedFrame const&) = delete;
-};
-
 /// @class VideoProviderCache
 /// @brief A wrapper around a video provider which provides LRU caching
 class VideoProviderCache final : public VideoProvider {
 	/// The source provider to get frames from
 	std::unique_ptr<VideoProvider> master;
 
-	/// @brief Maximum size of the cache in bytes
+	/// @brief Cached frames indexed by frame number
 	///
-	/// Note that this is a soft limit. The cache stops allocating new frames
-	/// once it has exceeded the limit, but it never tries to shrink
-	const size_t max_cache_size = OPT_GET("Provider/Video/Cache/Size")->GetInt() << 20; // convert MB to bytes
+	/// Provider/Video/Cache/Size is a hard limit: older frames are evicted
+	/// before a new frame is inserted if it would otherwise be exceeded
+	agi::LRUCache<int, VideoFrame> cache{static_cast<size_t>(OPT_GET("Provider/Video/Cache/Size")->GetInt()) << 20}; // convert MB to bytes
+
+	/// Number of frames decoded ahead of being requested
+	size_t prefetches = 0;
 
-	/// Cache of video frames with the most recently used ones at the front
-	std::list<CachedFrame> cache;
+	/// Scratch frame for decoding frames into before they're cached
+	VideoFrame decode_buffer;
+
+	/// Add a frame to the cache as the most recently used one
+	void Insert(int n, VideoFrame const& frame);
 
 public:
 	VideoProviderCache(std::unique_ptr<VideoProvider> master) : master(std::move(master)) { }
+	~VideoProviderCache();
+
+	/// Get the hit, miss and eviction counts and the current size of the cache
+	agi::LRUCache<int, VideoFrame>::Stats GetStats() const { return cache.GetStats(); }
 
 	void GetFrame(int n, VideoFrame &frame) override;
+	bool PrefetchFrame(int n) override;
 
 	void SetColorSpace(std::string const& m) override {
-		cache.clear();
+		cache.Clear();
 		return master->SetColorSpace(m);
 	}
 
@@ -74,28 +74,50 @@ public:
 	bool HasAudio() const override                 { return master->HasAudio(); }
 };
 
+VideoProviderCache::~VideoProviderCache() {
+	auto stats = GetStats();
+	LOG_I("video/cache") << "Frame cache statistics: "
+		<< stats.hits << " hits, " << stats.misses << " misses, " << prefetches << " prefetched, " << stats.evictions << " evictions, "
+		<< (stats.size >> 20) << " of " << (stats.max_size >> 20) << " MB in use";
+}
+
 void VideoProviderCache::GetFrame(int n, VideoFrame &out) {
-	size_t total_size = 0;
+	if (auto cached = cache.Find(n)) {
+		ConvertToBGRA(*cached, out);
+		return;
+	}
 
-	for (auto cur = cache.begin(); cur != cache.end(); ++cur) {
-		if (cur->frame_number == n) {
-			cache.splice(cache.begin(), cache, cur); // Move to front
-			out = cache.front().frame;
-			return;
-		}
+	master->GetNativeFrame(n, decode_buffer);
+	Insert(n, decode_buffer);
+	ConvertToBGRA(decode_buffer, out);
+}
 
-		total_size += cur->frame.data.size();
-	}
+bool VideoProviderCache::PrefetchFrame(int n) {
+	// Already-cached frames are deliberately not moved to the front, as
+	// they haven't actually been used
+	if (cache.Contains(n)) return true;
 
-	master->GetFrame(n, out);
+	++prefetches;
+	master->GetNativeFrame(n, decode_buffer);
+	Insert(n, decode_buffer);
+	return true;
+}
 
-	if (total_size >= max_cache_size) {
-		cache.splice(cache.begin(), cache, --cache.end()); // Move last to front
-		cache.front().frame_number = n;
-		cache.front().frame = out;
-	}
-	else
-		cache.emplace_front(out, n);
+void VideoProviderCache::Insert(int n, VideoFrame const& frame) {
+	// The buffer of an evicted frame is reused when possible to avoid a
+	// large allocation per frame
+	cache.Insert(n, sizeof(VideoFrame) + frame.data.size(), [&](VideoFrame& cached) {
+		cached.data.assign(frame.data.begin(), frame.data.end());
+		cached.width = frame.width;
+		cached.height = frame.height;
+		cached.pitch = frame.pitch;
+		cached.flipped = frame.flipped;
+		cached.format = frame.format;
+		cached.chroma_pitch = frame.chroma_pitch;
+		cached.matrix = frame.matrix;
+		cached.range = frame.range;
+		return sizeof(VideoFrame) + cached.data.capacity();
+	});
 }
 }
 
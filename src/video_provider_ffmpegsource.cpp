@@ -43,6 +43,8 @@
 #include <libaegisub/fs.h>
 #include <libaegisub/make_unique.h>
 
+#include <cstring>
+
 namespace {
 typedef enum AGI_ColorSpaces {
 	AGI_CS_RGB = 0,
@@ -61,6 +63,31 @@ typedef enum AGI_ColorSpaces {
 	AGI_CS_ICTCP = 14
 } AGI_ColorSpaces;
 
+/// Get the matrix to convert native frames of the given colorspace with
+/// @return false if the colorspace isn't one ConvertToBGRA implements
+bool ycbcr_matrix_for(int cs, agi::ycbcr_matrix &matrix) {
+	switch (cs) {
+		case AGI_CS_BT470BG:
+		case AGI_CS_SMPTE170M:
+			matrix = agi::ycbcr_matrix::bt601;
+			return true;
+		case AGI_CS_BT709:
+			matrix = agi::ycbcr_matrix::bt709;
+			return true;
+		case AGI_CS_FCC:
+			matrix = agi::ycbcr_matrix::fcc;
+			return true;
+		case AGI_CS_SMPTE240M:
+			matrix = agi::ycbcr_matrix::smpte_240m;
+			return true;
+		case AGI_CS_BT2020_NCL:
+			matrix = agi::ycbcr_matrix::bt2020;
+			return true;
+		default:
+			return false;
+	}
+}
+
 /// @class FFmpegSourceVideoProvider
 /// @brief Implements video loading through the FFMS library.
 class FFmpegSourceVideoProvider final : public VideoProvider, FFmpegSourceProvider {
@@ -72,6 +99,7 @@ class FFmpegSourceVideoProvider final : public VideoProvider, FFmpegSourceProvid
 	int Height = -1;                ///< height in pixels
 	int CS = -1;                    ///< Reported colorspace of first frame
 	int CR = -1;                    ///< Reported colorrange of first frame
+	int RealCS = -1;                ///< Colorspace of the video before any override
 	double DAR;                     ///< display aspect ratio
 	std::vector<int> KeyFramesList; ///< list of keyframes
 	agi::vfr::Framerate Timecodes;  ///< vfr object
@@ -82,14 +110,35 @@ class FFmpegSourceVideoProvider final : public VideoProvider, FFmpegSourceProvid
 	FFMS_ErrorInfo ErrInfo;         ///< FFMS error codes/messages
 	bool has_audio = false;
 
+	/// Frames are returned as planar YCbCr rather than converted by FFMS
+	bool NativeYUV = false;
+	agi::ycbcr_matrix Matrix = agi::ycbcr_matrix::bt601; ///< Matrix of native frames
+	agi::ycbcr_range Range = agi::ycbcr_range::tv;       ///< Range of native frames
+	VideoFrame NativeFrame;         ///< Scratch frame for GetFrame in native mode
+
 	void LoadVideo(agi::fs::path const& filename, std::string const& colormatrix);
+	const FFMS_Frame *DecodeFrame(int n);
 
 public:
 	FFmpegSourceVideoProvider(agi::fs::path const& filename, std::string const& colormatrix, agi::BackgroundRunner *br);
 
 	void GetFrame(int n, VideoFrame &out) override;
+	void GetNativeFrame(int n, VideoFrame &out) override;
 
 	void SetColorSpace(std::string const& matrix) override {
+		if (NativeYUV) {
+			// The matrix is applied when the frame is converted to BGRA
+			if (matrix == ColorSpace) return;
+			if (matrix == RealColorSpace)
+				ycbcr_matrix_for(RealCS, Matrix);
+			else if (matrix == "TV.601")
+				Matrix = agi::ycbcr_matrix::bt601;
+			else
+				return;
+			ColorSpace = matrix;
+			return;
+		}
+
 #if FFMS_VERSION >= ((2 << 24) | (17 << 16) | (1 << 8) | 0)
 		if (matrix == ColorSpace) return;
 		if (matrix == RealColorSpace)
@@ -182,38 +231,7 @@ void FFmpegSourceVideoProvider::LoadVideo(agi::fs::path const& filename, std::st
 		TrackNumber = static_cast<int>(Selection);
 	}
 
-	// generate a name for the cache file
-	auto CacheName = GetCacheFilename(filename);
-
-	// try to read index
-	agi::scoped_holder<FFMS_Index*, void (FFMS_CC*)(FFMS_Index*)>
-		Index(FFMS_ReadIndex(CacheName.string().c_str(), &ErrInfo), FFMS_DestroyIndex);
-
-	if (Index && FFMS_IndexBelongsToFile(Index, filename.string().c_str(), &ErrInfo))
-		Index = nullptr;
-
-	// time to examine the index and check if the track we want is indexed
-	// technically this isn't really needed since all video tracks should always be indexed,
-	// but a bit of sanity checking never hurt anyone
-	if (Index && TrackNumber >= 0) {
-		FFMS_Track *TempTrackData = FFMS_GetTrackFromIndex(Index, TrackNumber);
-		if (FFMS_GetNumFrames(TempTrackData) <= 0)
-			Index = nullptr;
-	}
-
-	// moment of truth
-	if (!Index) {
-		auto TrackMask = TrackSelection::None;
-		if (OPT_GET("Provider/FFmpegSource/Index All Tracks")->GetBool() || OPT_GET("Video/Open Audio")->GetBool())
-			TrackMask = TrackSelection::All;
-		Index = DoIndexing(Indexer, CacheName, TrackMask, GetErrorHandlingMode());
-	}
-	else {
-		FFMS_CancelIndexing(Indexer);
-	}
-
-	// update access time of index file so it won't get cleaned away
-	agi::fs::Touch(CacheName);
+	auto Index = GetIndex(Indexer, filename, FFMS_TYPE_VIDEO, TrackNumber);
 
 	// we have now read the index and may proceed with cleaning the index cache
 	CleanCache();
@@ -221,18 +239,18 @@ void FFmpegSourceVideoProvider::LoadVideo(agi::fs::path const& filename, std::st
 	// track number still not set?
 	if (TrackNumber < 0) {
 		// just grab the first track
-		TrackNumber = FFMS_GetFirstIndexedTrackOfType(Index, FFMS_TYPE_VIDEO, &ErrInfo);
+		TrackNumber = FFMS_GetFirstIndexedTrackOfType(Index.get(), FFMS_TYPE_VIDEO, &ErrInfo);
 		if (TrackNumber < 0)
 			throw VideoNotSupported(std::string("Couldn't find any video tracks: ") + ErrInfo.Buffer);
 	}
 
 	// Check if there's an audio track
-	has_audio = FFMS_GetFirstTrackOfType(Index, FFMS_TYPE_AUDIO, nullptr) != -1;
+	has_audio = FFMS_GetFirstTrackOfType(Index.get(), FFMS_TYPE_AUDIO, nullptr) != -1;
 
 	// set thread count
 	int Threads = OPT_GET("Provider/Video/FFmpegSource/Decoding Threads")->GetInt();
 #if FFMS_VERSION < ((2 << 24) | (17 << 16) | (2 << 8) | 1)
-	if (FFMS_GetSourceType(Index) == FFMS_SOURCE_LAVF)
+	if (FFMS_GetSourceType(Index.get()) == FFMS_SOURCE_LAVF)
 		Threads = 1;
 #endif
 
@@ -244,7 +262,7 @@ void FFmpegSourceVideoProvider::LoadVideo(agi::fs::path const& filename, std::st
 	else
 		SeekMode = FFMS_SEEK_NORMAL;
 
-	VideoSource = FFMS_CreateVideoSource(filename.string().c_str(), TrackNumber, Index, Threads, SeekMode, &ErrInfo);
+	VideoSource = FFMS_CreateVideoSource(filename.string().c_str(), TrackNumber, Index.get(), Threads, SeekMode, &ErrInfo);
 	if (!VideoSource)
 		throw VideoOpenError(std::string("Failed to open video track: ") + ErrInfo.Buffer);
 
@@ -267,21 +285,40 @@ void FFmpegSourceVideoProvider::LoadVideo(agi::fs::path const& filename, std::st
 
 	if (CS == AGI_CS_UNSPECIFIED)
 		CS = Width > 1024 || Height >= 600 ? AGI_CS_BT709 : AGI_CS_BT470BG;
+	RealCS = CS;
 	RealColorSpace = ColorSpace = colormatrix_description(CS, CR);
 
+	// 4:2:0 video is returned as-is and only converted to BGRA when a frame
+	// is displayed, as that lets the frame cache hold over twice as many
+	// frames. Anything else, including rotated or flipped video and
+	// colorspaces ConvertToBGRA has no matrix for, is still converted by FFMS.
+	int EncodedFormat = TempFrame->EncodedPixelFormat;
+	NativeYUV = ycbcr_matrix_for(CS, Matrix)
+		&& (EncodedFormat == FFMS_GetPixFmt("yuv420p") || EncodedFormat == FFMS_GetPixFmt("yuvj420p"));
+#if FFMS_VERSION >= ((2 << 24) | (24 << 16) | (0 << 8) | 0)
+	NativeYUV = NativeYUV && VideoInfo->Rotation % 360 == 0;
+#endif
+#if FFMS_VERSION >= ((2 << 24) | (31 << 16) | (0 << 8) | 0)
+	NativeYUV = NativeYUV && VideoInfo->Flip == 0;
+#endif
+
 #if FFMS_VERSION >= ((2 << 24) | (17 << 16) | (1 << 8) | 0)
 	if (CS != AGI_CS_RGB && CS != AGI_CS_BT470BG && ColorSpace != colormatrix && colormatrix == "TV.601") {
 		CS = AGI_CS_BT470BG;
 		ColorSpace = colormatrix_description(AGI_CS_BT470BG, CR);
 	}
 
-	if (CS != VideoCS) {
+	if (CS != VideoCS && !NativeYUV) {
 		if (FFMS_SetInputFormatV(VideoSource, CS, CR, FFMS_GetPixFmt(""), &ErrInfo))
 			throw VideoOpenError(std::string("Failed to set input format: ") + ErrInfo.Buffer);
 	}
 #endif
 
-	const int TargetFormat[] = { FFMS_GetPixFmt("bgra"), -1 };
+	if (NativeYUV)
+		ycbcr_matrix_for(CS, Matrix);
+	Range = CR == FFMS_CR_JPEG ? agi::ycbcr_range::pc : agi::ycbcr_range::tv;
+
+	const int TargetFormat[] = { NativeYUV ? EncodedFormat : FFMS_GetPixFmt("bgra"), -1 };
 	if (FFMS_SetOutputFormatV2(VideoSource, TargetFormat, Width, Height, FFMS_RESIZER_BICUBIC, &ErrInfo))
 		throw VideoOpenError(std::string("Failed to set output format: ") + ErrInfo.Buffer);
 
@@ -314,14 +351,54 @@ void FFmpegSourceVideoProvider::LoadVideo(agi::fs::path const& filename, std::st
 		Timecodes = agi::vfr::Framerate(TimecodesVector);
 }
 
-void FFmpegSourceVideoProvider::GetFrame(int n, VideoFrame &out) {
+const FFMS_Frame *FFmpegSourceVideoProvider::DecodeFrame(int n) {
 	n = mid(0, n, GetFrameCount() - 1);
 
 	auto frame = FFMS_GetFrame(VideoSource, n, &ErrInfo);
 	if (!frame)
 		throw VideoDecodeError(std::string("Failed to retrieve frame: ") +  ErrInfo.Buffer);
+	return frame;
+}
+
+void FFmpegSourceVideoProvider::GetNativeFrame(int n, VideoFrame &out) {
+	if (!NativeYUV)
+		return GetFrame(n, out);
+
+	auto frame = DecodeFrame(n);
+
+	// Pack the planes without the decoder's row padding
+	const size_t ChromaWidth = (Width + 1) / 2, ChromaHeight = (Height + 1) / 2;
+	out.data.resize(Width * Height + 2 * ChromaWidth * ChromaHeight);
+	unsigned char *dst = out.data.data();
+	auto copy_plane = [&](int plane, size_t width, size_t height) {
+		for (size_t y = 0; y < height; ++y, dst += width)
+			memcpy(dst, frame->Data[plane] + y * frame->Linesize[plane], width);
+	};
+	copy_plane(0, Width, Height);
+	copy_plane(1, ChromaWidth, ChromaHeight);
+	copy_plane(2, ChromaWidth, ChromaHeight);
+
+	out.flipped = false;
+	out.width = Width;
+	out.height = Height;
+	out.pitch = Width;
+	out.chroma_pitch = ChromaWidth;
+	out.format = VideoFrame::Format::YUV420;
+	out.matrix = Matrix;
+	out.range = Range;
+}
+
+void FFmpegSourceVideoProvider::GetFrame(int n, VideoFrame &out) {
+	if (NativeYUV) {
+		GetNativeFrame(n, NativeFrame);
+		ConvertToBGRA(NativeFrame, out);
+		return;
+	}
+
+	auto frame = DecodeFrame(n);
 
 	out.data.assign(frame->Data[0], frame->Data[0] + frame->Linesize[0] * Height);
+	out.format = VideoFrame::Format::BGRA;
 	out.flipped = false;
 	out.width = Width;
 	out.height = Height;
@@ -0,0 +1,136 @@
+// Copyright (c) 2014, Thomas Goyne <plorkyeran@aegisub.org>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+
+#include "bench.h"
+
+#include <libaegisub/ass/override.h>
+
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace {
+/// Typesetting-heavy lines
+std::vector<std::string> script(size_t count) {
+	const char *words[] = {"Hello", "there", "{\\i1}", "{\\b1\\fs40}", "WORLD", "of",
+		"{\\pos(320,40)\\fad(100,200)}", "{\\t(0,500,\\fscx120\\bord3)}", "Lorem", "{\\k25}ipsum"};
+	std::mt19937 rng(0);
+	std::vector<std::string> lines;
+	for (size_t i = 0; i < count; ++i) {
+		std::string line;
+		for (int j = 0; j < 12; ++j) {
+			line += words[rng() % 10];
+			line += ' ';
+		}
+		lines.push_back(line);
+	}
+	return lines;
+}
+
+// The allocation pattern of AssDialogue::ParseTags and AssOverrideTag, which
+// copy every block, tag and parameter into strings of their own
+struct OldTag {
+	std::string name;
+	std::vector<std::string> params;
+};
+
+struct OldBlock {
+	std::string text;
+	std::vector<OldTag> tags;
+};
+
+std::vector<std::unique_ptr<OldBlock>> old_parse(std::string const& text) {
+	std::vector<std::unique_ptr<OldBlock>> blocks;
+	for (size_t cur = 0; cur < text.size(); ) {
+		std::unique_ptr<OldBlock> block(new OldBlock);
+		if (text[cur] == '{') {
+			size_t end = text.find('}', cur);
+			block->text = text.substr(cur + 1, end - cur - 1);
+			cur = end + 1;
+
+			size_t start = 0;
+			for (size_t i = 1; i <= block->text.size(); ++i) {
+				if (i < block->text.size() && block->text[i] != '\\') continue;
+				std::string tag = block->text.substr(start, i - start);
+				agi::ass::TagProto const *proto = agi::ass::FindTag(tag);
+				OldTag parsed;
+				parsed.name = proto ? proto->name : tag;
+				boost::string_view params[agi::ass::max_parameters];
+				size_t count = agi::ass::SplitParameters(boost::string_view(tag).substr(parsed.name.size()), params, agi::ass::max_parameters);
+				for (size_t j = 0; j < std::min(count, agi::ass::max_parameters); ++j)
+					parsed.params.push_back(params[j].to_string());
+				block->tags.push_back(std::move(parsed));
+				start = i;
+			}
+		}
+		else {
+			size_t end = std::min(text.find('{', cur + 1), text.size());
+			block->text = text.substr(cur, end - cur);
+			cur = end;
+		}
+		blocks.push_back(std::move(block));
+	}
+	return blocks;
+}
+}
+
+BENCHMARK(override_visitor) {
+	const size_t count = 50000;
+	auto lines = script(count);
+
+	// Keeps the results from being optimized out
+	volatile size_t sink = 0;
+	double old_time = bench::TimeRepeated([&] {
+		for (auto const& line : lines) {
+			for (auto const& block : old_parse(line))
+				for (auto const& tag : block->tags)
+					sink = sink + tag.params.size();
+		}
+	});
+	bench::Report("copy into blocks", old_time, count, "lines");
+
+	struct counter final : agi::ass::DialogueVisitor {
+		size_t params = 0;
+		void VisitTag(agi::ass::Tag const& tag) override { params += tag.param_count; }
+	} visitor;
+	double visit_time = bench::TimeRepeated([&] {
+		for (auto const& line : lines)
+			agi::ass::VisitDialogue(line, visitor);
+	});
+	bench::Report("visit in place", visit_time, count, "lines");
+
+	struct doubler final : agi::ass::DialogueVisitor {
+		agi::ass::TextRewriter *rewriter;
+		void VisitTag(agi::ass::Tag const& tag) override {
+			for (size_t i = 0; i < tag.param_count; ++i) {
+				if (!tag.params[i].omitted && tag.params[i].type == agi::ass::ParameterType::INT)
+					rewriter->Replace(tag.params[i].value, tag.params[i].GetInt() * 2);
+			}
+		}
+	} rewrite_visitor;
+	std::string out;
+	double rewrite_time = bench::TimeRepeated([&] {
+		for (auto const& line : lines) {
+			agi::ass::TextRewriter rewriter(line, out);
+			rewrite_visitor.rewriter = &rewriter;
+			agi::ass::VisitDialogue(line, rewrite_visitor);
+			sink = sink + rewriter.Finish();
+		}
+	});
+	bench::Report("rewrite in place", rewrite_time, count, "lines");
+
+}
@@ -0,0 +1,126 @@
+// Copyright (c) 2014, Thomas Goyne <plorkyeran@aegisub.org>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include "bench.h"
+
+#include <libaegisub/ass/time.h>
+#include <libaegisub/dispatch.h>
+#include <libaegisub/split.h>
+
+#include <algorithm>
+#include <boost/algorithm/string/trim.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/utility/string_view.hpp>
+#include <cstring>
+#include <random>
+
+namespace {
+/// Number of event lines parsed by each task, as in AssParser
+const size_t chunk_size = 2048;
+
+/// The fields AssDialogue::Parse fills in
+struct Event {
+	int layer;
+	agi::Time start, end;
+	std::string style, actor, effect, text;
+	int margin[3];
+};
+
+/// Tokenize an event line the way AssDialogue::Parse does, without
+/// needing the rest of the subtitle model
+void parse(boost::string_view raw, Event& event) {
+	auto str = boost::make_iterator_range(raw.begin() + 10, raw.end());
+	auto pos = agi::Split(str, ',');
+	auto next_str = [&] {
+		auto tok = *pos++;
+		return std::string(tok.begin(), tok.end());
+	};
+	auto next_str_trim = [&] {
+		auto tok = boost::trim_copy(*pos++);
+		return std::string(tok.begin(), tok.end());
+	};
+
+	event.layer = boost::lexical_cast<int>(next_str_trim());
+	event.start = next_str_trim();
+	event.end = next_str_trim();
+	event.style = next_str_trim();
+	event.actor = next_str_trim();
+	for (int& margin : event.margin)
+		margin = boost::lexical_cast<int>(next_str());
+	event.effect = next_str_trim();
+	event.text.assign((*pos).begin(), str.end());
+}
+
+/// The [Events] section of a karaoke-heavy script
+std::string script(size_t count) {
+	const char *words[] = {"{\\k20}Hello", "{\\k15}there", "{\\k30}WORLD", "{\\k10}of", "{\\k40}subtitles", "{\\k25}Lorem", "{\\k35}ipsum"};
+	std::mt19937 rng(0);
+	std::string file;
+	for (size_t i = 0; i < count; ++i) {
+		file += "Dialogue: 0,0:01:02.30,0:01:05.70,Default,Singer,0,0,0,,";
+		for (int j = 0; j < 10; ++j)
+			file += words[rng() % 7];
+		file += '\n';
+	}
+	return file;
+}
+
+std::vector<boost::string_view> split_lines(std::string const& file) {
+	std::vector<boost::string_view> lines;
+	const char *pos = file.data(), *end = pos + file.size();
+	while (pos != end) {
+		auto eol = static_cast<const char *>(memchr(pos, '\n', end - pos));
+		if (!eol) eol = end;
+		lines.emplace_back(pos, eol - pos);
+		pos = eol == end ? end : eol + 1;
+	}
+	return lines;
+}
+}
+
+BENCHMARK(ass_parse) {
+	const size_t count = 150000;
+	auto file = script(count);
+	auto lines = split_lines(file);
+	const size_t chunks = (count + chunk_size - 1) / chunk_size;
+	std::vector<Event> events(count);
+
+	double serial_time = bench::TimeRepeated([&] {
+		for (size_t i = 0; i < count; ++i)
+			parse(lines[i], events[i]);
+	});
+	bench::Report("serial", serial_time, count / 1e3, "klines");
+
+	// Each line copied into a string before being parsed
+	double copy_time = bench::TimeRepeated([&] {
+		agi::dispatch::ParallelFor(chunks, [&](size_t chunk) {
+			std::string line;
+			for (size_t i = chunk * chunk_size; i < std::min(count, (chunk + 1) * chunk_size); ++i) {
+				line.assign(lines[i].begin(), lines[i].end());
+				parse(line, events[i]);
+			}
+		});
+	});
+	bench::Report("parallel, copied lines", copy_time, count / 1e3, "klines");
+
+	double view_time = bench::TimeRepeated([&] {
+		agi::dispatch::ParallelFor(chunks, [&](size_t chunk) {
+			for (size_t i = chunk * chunk_size; i < std::min(count, (chunk + 1) * chunk_size); ++i)
+				parse(lines[i], events[i]);
+		});
+	});
+	bench::Report("parallel, in place", view_time, count / 1e3, "klines");
+}
@@ -0,0 +1,92 @@
+// Copyright (c) 2014, Thomas Goyne <plorkyeran@aegisub.org>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+
+#include "bench.h"
+
+#include <libaegisub/audio/sample_convert.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+namespace {
+// The per-sample conversion FillBufferInt16Mono used before the kernels,
+// with a buffer allocated for each call
+int16_t old_float_to_int16(float v) {
+	float expanded = v * 32768;
+	return expanded < -32768 ? -32768 :
+		expanded > 32767 ? 32767 :
+		static_cast<int16_t>(expanded);
+}
+
+void old_convert(const float *src, int16_t *dst, int64_t count, int channels) {
+	void *buff = malloc(sizeof(float) * count * channels);
+	memcpy(buff, src, sizeof(float) * count * channels);
+	auto samples = static_cast<float *>(buff);
+	for (int64_t i = 0; i < count; ++i) {
+		int ret = 0;
+		for (int c = 0; c < channels; ++c)
+			ret += old_float_to_int16(samples[i * channels + c]);
+		dst[i] = ret / channels;
+	}
+	free(buff);
+}
+
+/// Convert float audio in blocks the size the waveform renderer asks for
+void run(int channels) {
+	const int64_t block = 4096;
+	const int64_t count = block * 120;
+
+	std::mt19937 rng(0);
+	std::uniform_real_distribution<float> dist(-1.f, 1.f);
+	std::vector<float> src(count * channels);
+	for (auto& s : src) s = dist(rng);
+	std::vector<int16_t> dst(count);
+
+	auto channel_name = std::to_string(channels) + " channel float, ";
+	double old_time = bench::TimeRepeated([&] {
+		for (int64_t i = 0; i < count; i += block)
+			old_convert(&src[i * channels], &dst[i], block, channels);
+	});
+	bench::Report(channel_name + "old", old_time, count / 48000., "seconds of audio");
+
+	auto run_level = [&](const char *name, agi::simd::level level) {
+		// Copied first as the old path also has to fill its buffer
+		std::vector<float> scratch(block * channels);
+		double time = bench::TimeRepeated([&] {
+			for (int64_t i = 0; i < count; i += block) {
+				memcpy(scratch.data(), &src[i * channels], sizeof(float) * block * channels);
+				agi::ConvertSamplesToInt16Mono(scratch.data(), &dst[i], block, sizeof(float), true, channels, level);
+			}
+		});
+		bench::Report(channel_name + name, time, count / 48000., "seconds of audio");
+	};
+
+	run_level("scalar", agi::simd::level::none);
+	if (agi::simd::detect() >= agi::simd::level::sse2)
+		run_level("sse2", agi::simd::level::sse2);
+	if (agi::simd::detect() >= agi::simd::level::avx2)
+		run_level("avx2", agi::simd::level::avx2);
+}
+}
+
+BENCHMARK(audio_convert) {
+	run(1);
+	run(2);
+	run(6);
+	run(8);
+}
@@ -0,0 +1,71 @@
+// Copyright (c) 2013, Thomas Goyne <plorkyeran@aegisub.org>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+/// @file bench.h
+/// @brief Minimal harness for the benchmarks run by bench-run
+///
+/// Benchmarks are registered with BENCHMARK(name) and receive any extra
+/// command line arguments. Run `bench-run [filter] [args...]` to run every
+/// benchmark whose name contains filter.
+
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace bench {
+typedef std::vector<std::string> Args;
+
+struct Registration {
+	Registration(const char *name, void (*fn)(Args const&));
+};
+
+/// Run a function once and return how long it took in seconds
+template<typename Func>
+double Time(Func&& f) {
+	auto start = std::chrono::steady_clock::now();
+	f();
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/// Run a function repeatedly for at least min_seconds and return the
+/// average time per run in seconds
+template<typename Func>
+double TimeRepeated(Func&& f, double min_seconds = 0.5) {
+	size_t runs = 0;
+	double elapsed = Time([&] {
+		auto start = std::chrono::steady_clock::now();
+		do {
+			f();
+			++runs;
+		} while (std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() < min_seconds);
+	});
+	return elapsed / runs;
+}
+
+/// Print a single result line
+/// @param name    What was measured
+/// @param seconds Time taken
+/// @param units   Number of units processed in that time
+/// @param unit    Name of the unit, e.g. "frames" or "MB"
+void Report(std::string const& name, double seconds, double units, const char *unit);
+}
+
+#define BENCHMARK(name) \
+	static void bench_##name(bench::Args const&); \
+	static bench::Registration bench_reg_##name(#name, bench_##name); \
+	static void bench_##name(bench::Args const& args)
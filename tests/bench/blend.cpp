@@ -0,0 +1,53 @@
+// Copyright (c) 2014, Thomas Goyne <plorkyeran@aegisub.org>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include "bench.h"
+
+#include <libaegisub/blend.h>
+
+#include <random>
+
+namespace {
+/// Blend a set of glyph-sized masks onto a 1080p frame, roughly matching
+/// what a karaoke line with many layers produces
+void run(const char *name, agi::simd::level level) {
+	const int frame_width = 1920, frame_height = 1080;
+	const int glyph_width = 60, glyph_height = 72, glyphs = 400;
+
+	std::mt19937 rng(0);
+	std::vector<uint8_t> frame(frame_width * frame_height * 4, 128);
+	std::vector<uint8_t> mask(glyph_width * glyph_height);
+	for (auto& m : mask) m = static_cast<uint8_t>(rng());
+
+	double per_run = bench::TimeRepeated([&] {
+		for (int i = 0; i < glyphs; ++i) {
+			int x = (i * 97) % (frame_width - glyph_width);
+			int y = (i * 31) % (frame_height - glyph_height);
+			agi::BlendMask(&frame[(y * frame_width + x) * 4], frame_width * 4,
+				mask.data(), glyph_width, glyph_width, glyph_height, 0xFFC08040, level);
+		}
+	});
+	bench::Report(name, per_run, double(glyph_width) * glyph_height * glyphs / 1e6, "Mpixels");
+}
+}
+
+BENCHMARK(blend) {
+	run("scalar", agi::simd::level::none);
+	if (agi::simd::detect() >= agi::simd::level::sse2)
+		run("sse2", agi::simd::level::sse2);
+	if (agi::simd::detect() >= agi::simd::level::avx2)
+		run("avx2", agi::simd::level::avx2);
+}
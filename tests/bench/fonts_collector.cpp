@@ -0,0 +1,125 @@
+// Copyright (c) 2014, Thomas Goyne <plorkyeran@aegisub.org>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+
+#include "bench.h"
+
+#include <libaegisub/codepoint_set.h>
+#include <libaegisub/dispatch.h>
+
+#include <algorithm>
+#include <random>
+#include <unicode/utf8.h>
+
+namespace {
+struct Block {
+	size_t style;
+	std::string text;
+};
+
+/// Plain text blocks of a 40000 line script using 60 font variants, with
+/// mostly Latin text and some Japanese
+std::vector<std::vector<Block>> script() {
+	const char *words[] = {"Hello", "there", "WORLD", "of", "subtitles", "Lorem", "ipsum", "\\N",
+		"\xE3\x81\x93\xE3\x82\x93\xE3\x81\xAB\xE3\x81\xA1\xE3\x81\xAF", "\xE4\xB8\x96\xE7\x95\x8C"};
+	std::mt19937 rng(0);
+	std::vector<std::vector<Block>> lines(40000);
+	for (auto& line : lines) {
+		for (int block = 0; block < 3; ++block) {
+			Block b{rng() % 60, ""};
+			for (int j = 0; j < 5; ++j) {
+				b.text += words[rng() % 10];
+				b.text += ' ';
+			}
+			line.push_back(std::move(b));
+		}
+	}
+	return lines;
+}
+
+/// The character gathering the fonts collector did before it used
+/// CodepointSet, sorting each style's characters after every block
+void old_add(std::vector<int>& chars, std::string const& text) {
+	auto size = static_cast<int>(text.size());
+	for (int i = 0; i < size; ) {
+		if (text[i] == '\\' && i + 1 < size) {
+			char next = text[++i];
+			if (next == 'N' || next == 'n') {
+				++i;
+				continue;
+			}
+			if (next == 'h') {
+				++i;
+				chars.push_back(0xA0);
+				continue;
+			}
+
+			chars.push_back('\\');
+			continue;
+		}
+
+		UChar32 c;
+		U8_NEXT(&text[0], i, size, c);
+		chars.push_back(c);
+	}
+
+	sort(begin(chars), end(chars));
+	chars.erase(unique(chars.begin(), chars.end()), chars.end());
+}
+}
+
+BENCHMARK(fonts_collector) {
+	auto lines = script();
+
+	double old_time = bench::TimeRepeated([&] {
+		std::vector<std::vector<int>> chars(60);
+		for (auto const& line : lines) {
+			for (auto const& block : line)
+				old_add(chars[block.style], block.text);
+		}
+	});
+	bench::Report("sorted vectors", old_time, lines.size(), "lines");
+
+	double set_time = bench::TimeRepeated([&] {
+		std::vector<agi::CodepointSet> chars(60);
+		for (auto const& line : lines) {
+			for (auto const& block : line)
+				chars[block.style].insert_text(block.text);
+		}
+	});
+	bench::Report("codepoint sets", set_time, lines.size(), "lines");
+
+	// Each chunk of lines gets its own sets, which are merged afterwards
+	const size_t chunk_size = 4096;
+	double parallel_time = bench::TimeRepeated([&] {
+		size_t chunks = (lines.size() + chunk_size - 1) / chunk_size;
+		std::vector<std::vector<agi::CodepointSet>> chunk_chars(chunks, std::vector<agi::CodepointSet>(60));
+		agi::dispatch::ParallelFor(chunks, [&](size_t chunk) {
+			auto& chars = chunk_chars[chunk];
+			for (size_t i = chunk * chunk_size; i < std::min(lines.size(), (chunk + 1) * chunk_size); ++i) {
+				for (auto const& block : lines[i])
+					chars[block.style].insert_text(block.text);
+			}
+		});
+
+		std::vector<agi::CodepointSet> chars(60);
+		for (auto const& chunk : chunk_chars) {
+			for (size_t i = 0; i < chars.size(); ++i)
+				chars[i] |= chunk[i];
+		}
+	});
+	bench::Report("codepoint sets, parallel", parallel_time, lines.size(), "lines");
+}
@@ -0,0 +1,102 @@
+// Copyright (c) 2014, Thomas Goyne <plorkyeran@aegisub.org>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include "bench.h"
+
+#include "libass_renderer_pool.h"
+
+#include <libaegisub/format.h>
+#include <libaegisub/io.h>
+
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <thread>
+
+namespace {
+const int frames = 480;
+const int frame_ms = 42;
+
+/// Typesetting-heavy script: lots of blurred, bordered and animated signs
+/// plus vector drawings, all on screen at once
+std::string synthetic_script() {
+	std::string script =
+		"[Script Info]\n"
+		"ScriptType: v4.00+\n"
+		"PlayResX: 1920\n"
+		"PlayResY: 1080\n"
+		"\n"
+		"[V4+ Styles]\n"
+		"Format: Name, Fontname, Fontsize, PrimaryColour, SecondaryColour, OutlineColour, BackColour, Bold, Italic, Underline, StrikeOut, ScaleX, ScaleY, Spacing, Angle, BorderStyle, Outline, Shadow, Alignment, MarginL, MarginR, MarginV, Encoding\n"
+		"Style: Default,Sans,60,&H00FFFFFF,&H000000FF,&H00000000,&H80000000,0,0,0,0,100,100,0,0,1,3,2,2,20,20,20,1\n"
+		"\n"
+		"[Events]\n"
+		"Format: Layer, Start, End, Style, Name, MarginL, MarginR, MarginV, Effect, Text\n";
+
+	int duration = frames * frame_ms;
+	for (int i = 0; i < 200; ++i) {
+		int x = 100 + (i * 37) % 1700, y = 100 + (i * 53) % 900;
+		script += agi::format("Dialogue: %d,0:00:00.00,0:00:%02d.%02d,Default,,0,0,0,,{\\pos(%d,%d)\\blur%d\\bord%d\\t(\\frz%d\\fscx150)}Sign number %d\n",
+			i % 4, duration / 1000, duration % 1000 / 10, x, y, 2 + i % 6, 1 + i % 4, i * 7 % 360, i);
+		if (i % 4 == 0)
+			script += agi::format("Dialogue: 0,0:00:00.00,0:00:%02d.%02d,Default,,0,0,0,,{\\an7\\pos(%d,%d)\\blur3\\p1}m 0 0 l 200 0 200 80 0 80 b 40 120 160 120 200 80{\\p0}\n",
+				duration / 1000, duration % 1000 / 10, x, y);
+	}
+	return script;
+}
+}
+
+BENCHMARK(libass_pool) {
+	std::string script;
+	if (!args.empty()) {
+		auto in = agi::io::Open(args[0]);
+		script.assign(std::istreambuf_iterator<char>(*in), std::istreambuf_iterator<char>());
+	}
+	else
+		script = synthetic_script();
+
+	ASS_Library *library = ass_library_init();
+	ass_set_extract_fonts(library, 0);
+
+	unsigned int max_threads = std::max(1u, std::thread::hardware_concurrency());
+	for (unsigned int threads = 1; threads <= max_threads; threads *= 2) {
+		libass::RendererPool pool(library, threads);
+		pool.SetScript(script.data(), script.size(), false);
+
+		// Warm up every renderer's glyph and bitmap caches so that only
+		// steady-state rendering is measured
+		std::vector<std::thread> workers;
+		for (unsigned int i = 0; i < threads; ++i)
+			workers.emplace_back([&] { pool.Render(1920, 1080, 0, [](ASS_Image *) { }); });
+		for (auto& worker : workers) worker.join();
+		workers.clear();
+
+		std::atomic<int> next_frame{0};
+		double elapsed = bench::Time([&] {
+			for (unsigned int i = 0; i < threads; ++i) {
+				workers.emplace_back([&] {
+					for (int frame; (frame = next_frame++) < frames; )
+						pool.Render(1920, 1080, frame * frame_ms, [](ASS_Image *) { });
+				});
+			}
+			for (auto& worker : workers) worker.join();
+		});
+
+		bench::Report(agi::format("%u threads", threads), elapsed, frames, "frames");
+	}
+
+	ass_library_done(library);
+}
@@ -0,0 +1,59 @@
+// Copyright (c) 2013, Thomas Goyne <plorkyeran@aegisub.org>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include "bench.h"
+
+#include <libaegisub/dispatch.h>
+#include <libaegisub/log.h>
+
+#include <algorithm>
+#include <boost/locale/generator.hpp>
+#include <cstdio>
+#include <utility>
+
+namespace {
+std::vector<std::pair<const char *, void (*)(bench::Args const&)>>& benchmarks() {
+	static std::vector<std::pair<const char *, void (*)(bench::Args const&)>> list;
+	return list;
+}
+}
+
+namespace bench {
+Registration::Registration(const char *name, void (*fn)(Args const&)) {
+	benchmarks().emplace_back(name, fn);
+}
+
+void Report(std::string const& name, double seconds, double units, const char *unit) {
+	printf("  %-40s %10.3f ms %12.1f %s/s\n", name.c_str(), seconds * 1000., units / seconds, unit);
+}
+}
+
+int main(int argc, char **argv) {
+	agi::dispatch::Init([](agi::dispatch::Thunk f) { f(); });
+	std::locale::global(boost::locale::generator().generate(""));
+	agi::log::log = new agi::log::LogSink;
+
+	std::string filter = argc > 1 ? argv[1] : "";
+	bench::Args args(argv + std::min(argc, 2), argv + argc);
+
+	for (auto const& benchmark : benchmarks()) {
+		if (std::string(benchmark.first).find(filter) == std::string::npos) continue;
+		printf("%s\n", benchmark.first);
+		benchmark.second(args);
+	}
+
+	delete agi::log::log;
+}
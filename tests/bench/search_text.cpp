@@ -0,0 +1,87 @@
+// Copyright (c) 2014, Thomas Goyne <plorkyeran@aegisub.org>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include "bench.h"
+
+#include <libaegisub/dispatch.h>
+#include <libaegisub/search_text.h>
+#include <libaegisub/util.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <random>
+
+namespace {
+/// Typesetting-heavy lines, where a search with tags skipped has the most
+/// to strip on every line
+std::vector<std::string> script(size_t count) {
+	const char *words[] = {"Hello", "there", "{\\i1}", "{\\b1\\fs40}", "WORLD", "of", "{\\pos(320,40)}", "subtitles", "Lorem", "ipsum"};
+	std::mt19937 rng(0);
+	std::vector<std::string> lines;
+	for (size_t i = 0; i < count; ++i) {
+		std::string line;
+		for (int j = 0; j < 12; ++j) {
+			line += words[rng() % 10];
+			line += ' ';
+		}
+		lines.push_back(line);
+	}
+	return lines;
+}
+}
+
+BENCHMARK(search_text) {
+	const size_t count = 100000;
+	auto lines = script(count);
+	// Not present, so every line is searched
+	const std::string needle = "needle";
+
+	double old_time = bench::TimeRepeated([&] {
+		agi::util::tagless_find_helper helper;
+		for (auto const& line : lines) {
+			auto pos = agi::util::ifind(helper.strip_tags(line, 0), needle);
+			if (pos.first != (size_t)-1) break;
+		}
+	});
+	bench::Report("strip and fold every search", old_time, count, "lines");
+
+	std::vector<std::unique_ptr<agi::SearchText>> prepared(count);
+	double prepare_time = bench::Time([&] {
+		for (size_t i = 0; i < count; ++i)
+			prepared[i].reset(new agi::SearchText(lines[i], true, true));
+	});
+	bench::Report("prepare", prepare_time, count, "lines");
+
+	double find_time = bench::TimeRepeated([&] {
+		for (auto const& text : prepared) {
+			if (text->Text().find(needle) != std::string::npos) break;
+		}
+	});
+	bench::Report("prepared", find_time, count, "lines");
+
+	const size_t chunk_size = 1024;
+	double parallel_time = bench::TimeRepeated([&] {
+		std::atomic<bool> found{false};
+		agi::dispatch::ParallelFor((count + chunk_size - 1) / chunk_size, [&](size_t chunk) {
+			for (size_t i = chunk * chunk_size; i < std::min(count, (chunk + 1) * chunk_size); ++i) {
+				if (prepared[i]->Text().find(needle) != std::string::npos)
+					found = true;
+			}
+		});
+	});
+	bench::Report("prepared, parallel", parallel_time, count, "lines");
+}
@@ -0,0 +1,149 @@
+// Copyright (c) 2014, Thomas Goyne <plorkyeran@aegisub.org>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include "bench.h"
+
+#include <libaegisub/slab_allocator.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+
+namespace {
+const int lines = 100000;
+
+/// Stand-in for a dialogue line: about the same size, with an inline
+/// payload which is read back when iterating
+struct HeapLine {
+	char data[176];
+	int value;
+	HeapLine *next;
+};
+
+struct SlabLine : agi::SlabAllocated<SlabLine> {
+	char data[176];
+	int value;
+	SlabLine *next;
+};
+
+template<typename Line>
+void run(const char *name) {
+	// Interleave allocations of another size so that the heap isn't as
+	// tidy as it would be in a freshly started process
+	std::mt19937 rng(0);
+	std::vector<std::unique_ptr<char[]>> noise;
+
+	Line *head = nullptr;
+	auto copy = [&] {
+		Line *prev = nullptr;
+		for (int i = 0; i < lines; ++i) {
+			auto line = new Line;
+			line->value = i;
+			line->next = nullptr;
+			if (prev) prev->next = line;
+			else head = line;
+			prev = line;
+			if (rng() % 4 == 0)
+				noise.emplace_back(new char[rng() % 256 + 1]);
+		}
+	};
+	auto destroy = [&] {
+		while (head) {
+			Line *next = head->next;
+			delete head;
+			head = next;
+		}
+	};
+
+	double copy_time = 0, destroy_time = 0;
+	const int reps = 10;
+	long long sum = 0;
+	double iterate_time = 0;
+	for (int i = 0; i < reps; ++i) {
+		copy_time += bench::Time(copy);
+		iterate_time += bench::Time([&] {
+			for (Line *line = head; line; line = line->next)
+				sum += line->value;
+		});
+		destroy_time += bench::Time(destroy);
+		noise.clear();
+	}
+	if (sum == 0) return;
+
+	bench::Report(std::string(name) + " copy", copy_time / reps, lines / 1e3, "klines");
+	bench::Report(std::string(name) + " iterate", iterate_time / reps, lines / 1e3, "klines");
+	bench::Report(std::string(name) + " destroy", destroy_time / reps, lines / 1e3, "klines");
+}
+
+/// Parse event lines into objects on several threads at once, as loading
+/// a script does, and then free them all from the main thread
+template<typename Line>
+void run_parallel(const char *name, std::vector<std::string> const& text, size_t threads) {
+	std::vector<Line *> parsed(text.size());
+	auto parse = [&] {
+		std::vector<std::thread> workers;
+		for (size_t t = 0; t < threads; ++t) {
+			workers.emplace_back([&, t] {
+				size_t begin = text.size() * t / threads;
+				size_t end = text.size() * (t + 1) / threads;
+				for (size_t i = begin; i < end; ++i) {
+					auto line = new Line;
+					auto const& str = text[i];
+					size_t len = std::min(str.size(), sizeof(line->data) - 1);
+					memcpy(line->data, str.c_str(), len);
+					line->data[len] = 0;
+					line->value = atoi(line->data + 10);
+					line->next = nullptr;
+					parsed[i] = line;
+				}
+			});
+		}
+		for (auto& worker : workers) worker.join();
+	};
+
+	double parse_time = 0, destroy_time = 0;
+	const int reps = 10;
+	for (int i = 0; i < reps; ++i) {
+		parse_time += bench::Time(parse);
+		destroy_time += bench::Time([&] {
+			for (auto line : parsed) delete line;
+		});
+	}
+
+	auto label = std::string(name) + " " + std::to_string(threads) + " thread parse";
+	bench::Report(label, parse_time / reps, text.size() / 1e3, "klines");
+	bench::Report(label + " destroy", destroy_time / reps, text.size() / 1e3, "klines");
+}
+}
+
+BENCHMARK(slab_allocator) {
+	run<HeapLine>("new/delete");
+	run<SlabLine>("slab");
+
+	std::vector<std::string> text;
+	for (int i = 0; i < lines; ++i)
+		text.push_back("Dialogue: " + std::to_string(i % 10) + ",0:00:00.00,0:00:05.00,Default,,0,0,0,,Line number " + std::to_string(i));
+
+	size_t max_threads = std::max(4u, std::thread::hardware_concurrency());
+	for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+		run_parallel<HeapLine>("new/delete", text, threads);
+		run_parallel<SlabLine>("slab", text, threads);
+	}
+}
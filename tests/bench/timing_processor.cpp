@@ -0,0 +1,96 @@
+// Copyright (c) 2014, Thomas Goyne <plorkyeran@aegisub.org>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include "bench.h"
+
+#include <libaegisub/ass/timing_processor.h>
+#include <libaegisub/format.h>
+#include <libaegisub/vfr.h>
+
+#include <algorithm>
+#include <random>
+
+using agi::ass::TimingLine;
+
+namespace {
+/// A full season of episodes merged into one script: bursts of dialogue
+/// with plenty of overlapping signs
+std::vector<TimingLine> season(size_t count) {
+	std::mt19937 rng(0);
+	std::vector<TimingLine> lines;
+	int time = 0;
+	for (size_t i = 0; i < count; ++i) {
+		time += rng() % 1500;
+		lines.push_back(TimingLine{time, time + 500 + static_cast<int>(rng() % 4000)});
+	}
+	return lines;
+}
+
+/// The pairwise lead-in/lead-out previously used by the timing post-processor
+void quadratic_lead(std::vector<TimingLine>& lines, int lead_in, int lead_out) {
+	auto collides = [](TimingLine const& a, TimingLine const& b) {
+		return a.start < b.start ? b.start < a.end : a.start < b.end;
+	};
+	for (size_t i = 0; i < lines.size(); ++i) {
+		int start = lines[i].start - lead_in;
+		for (size_t j = 0; j < i; ++j) {
+			if (!collides(lines[i], lines[j]))
+				start = std::max<int>(start, lines[j].end);
+		}
+		lines[i].start = start;
+	}
+	for (size_t i = 0; i < lines.size(); ++i) {
+		int end = lines[i].end + lead_out;
+		for (size_t j = i + 1; j < lines.size(); ++j) {
+			if (!collides(lines[i], lines[j]))
+				end = std::min<int>(end, lines[j].start);
+		}
+		lines[i].end = end;
+	}
+}
+}
+
+BENCHMARK(timing_processor) {
+	agi::ass::TimingSettings settings;
+	settings.lead_in = 200;
+	settings.lead_out = 300;
+	settings.adjacent = true;
+	settings.adjacent_gap = 500;
+	settings.adjacent_overlap = 250;
+	settings.snap = true;
+	settings.before_start = settings.after_start = 300;
+	settings.before_end = settings.after_end = 300;
+
+	agi::vfr::Framerate fps(24000, 1001);
+	for (size_t count : {5000, 50000}) {
+		auto lines = season(count);
+		std::vector<int> keyframes;
+		for (int frame = 0, last = fps.FrameAtTime(lines.back().end); frame < last; frame += 50 + frame % 200)
+			keyframes.push_back(frame);
+
+		double sweep = bench::TimeRepeated([&] {
+			auto copy = lines;
+			agi::ass::TimingPostProcess(copy, settings, fps, keyframes);
+		});
+		bench::Report(agi::format("sweep, %d lines", count), sweep, count / 1e3, "klines");
+
+		double quadratic = bench::Time([&] {
+			auto copy = lines;
+			quadratic_lead(copy, settings.lead_in, settings.lead_out);
+		});
+		bench::Report(agi::format("quadratic lead-in/out, %d lines", count), quadratic, count / 1e3, "klines");
+	}
+}
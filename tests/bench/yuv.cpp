@@ -0,0 +1,50 @@
+// Copyright (c) 2014, Thomas Goyne <plorkyeran@aegisub.org>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+
+#include "bench.h"
+
+#include <libaegisub/yuv.h>
+
+#include <random>
+
+namespace {
+/// Convert a 1080p frame, as is done for each frame taken from the cache
+void run(const char *name, agi::simd::level level) {
+	const int width = 1920, height = 1080;
+
+	std::mt19937 rng(0);
+	std::vector<uint8_t> y(width * height), u(width * height / 4), v(width * height / 4);
+	for (auto& b : y) b = static_cast<uint8_t>(rng());
+	for (auto& b : u) b = static_cast<uint8_t>(rng());
+	for (auto& b : v) b = static_cast<uint8_t>(rng());
+	std::vector<uint8_t> bgra(width * height * 4);
+
+	double per_run = bench::TimeRepeated([&] {
+		agi::YUV420ToBGRA(bgra.data(), width * 4, y.data(), width, u.data(), v.data(), width / 2,
+			width, height, agi::ycbcr_matrix::bt709, agi::ycbcr_range::tv, level);
+	});
+	bench::Report(name, per_run, 1, "frames");
+}
+}
+
+BENCHMARK(yuv) {
+	run("scalar", agi::simd::level::none);
+	if (agi::simd::detect() >= agi::simd::level::sse2)
+		run("sse2", agi::simd::level::sse2);
+	if (agi::simd::detect() >= agi::simd::level::avx2)
+		run("avx2", agi::simd::level::avx2);
+}
@@ -0,0 +1,205 @@
+// Copyright (c) 2014, Thomas Goyne <plorkyeran@aegisub.org>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+
+#include <libaegisub/ass/override.h>
+
+#include <main.h>
+
+#include <vector>
+
+using namespace agi::ass;
+
+namespace {
+/// Records everything visited as a flat list of strings
+struct Recorder final : DialogueVisitor {
+	std::vector<std::string> seen;
+
+	void VisitText(boost::string_view text) override { seen.push_back("text:" + text.to_string()); }
+	void VisitDrawing(boost::string_view text, int scale) override {
+		seen.push_back("drawing" + std::to_string(scale) + ":" + text.to_string());
+	}
+	void VisitComment(boost::string_view text) override { seen.push_back("comment:" + text.to_string()); }
+	void VisitTag(Tag const& tag) override {
+		seen.push_back(std::string(tag.depth, '>') + tag.name.to_string());
+	}
+};
+
+std::vector<std::string> visit(std::string const& text) {
+	Recorder r;
+	VisitDialogue(text, r);
+	return r.seen;
+}
+
+Tag parse(std::string const& text) {
+	static std::string storage;
+	storage = text;
+	Tag tag;
+	ParseTag(storage, tag);
+	return tag;
+}
+}
+
+TEST(lagi_override, longest_name_wins) {
+	EXPECT_EQ("\\fs+", parse("\\fs+5").name);
+	EXPECT_EQ("\\fs", parse("\\fs20").name);
+	EXPECT_EQ("\\pbo", parse("\\pbo10").name);
+	EXPECT_EQ("\\p", parse("\\p1").name);
+	EXPECT_EQ("\\1c", parse("\\1c&HFF&").name);
+	EXPECT_EQ("\\c", parse("\\c&HFF&").name);
+}
+
+TEST(lagi_override, unknown_tag) {
+	auto tag = parse("\\foo(1,2)");
+	EXPECT_FALSE(tag.IsValid());
+	EXPECT_EQ("\\foo(1,2)", tag.name);
+	EXPECT_EQ(0u, tag.param_count);
+	EXPECT_FALSE(parse("text").IsValid());
+}
+
+TEST(lagi_override, parameters) {
+	auto tag = parse("\\pos( 10.5 , 20 )");
+	ASSERT_EQ(2u, tag.param_count);
+	EXPECT_EQ("10.5", tag.params[0].value);
+	EXPECT_DOUBLE_EQ(10.5, tag.params[0].GetDouble());
+	EXPECT_EQ(20, tag.params[1].GetInt());
+	EXPECT_EQ(ParameterClass::ABSOLUTE_POS_Y, tag.params[1].classification);
+
+	tag = parse("\\fs 30 ");
+	ASSERT_EQ(1u, tag.param_count);
+	EXPECT_EQ("30", tag.params[0].value);
+
+	EXPECT_EQ(-3, parse("\\be-3").params[0].GetInt());
+	EXPECT_EQ(3, parse("\\be3.7").params[0].GetInt());
+	EXPECT_EQ(0, parse("\\bex").params[0].GetInt());
+
+	tag = parse("\\b");
+	EXPECT_TRUE(tag.params[0].omitted);
+	EXPECT_EQ(5, tag.params[0].GetInt(5));
+}
+
+TEST(lagi_override, split_parameters) {
+	boost::string_view out[3];
+	EXPECT_EQ(0u, SplitParameters("", out, 3));
+	ASSERT_EQ(3u, SplitParameters("(a,(b,c)) junk", out, 3));
+	EXPECT_EQ("a", out[0]);
+	EXPECT_EQ("(b,c)", out[1]);
+	EXPECT_EQ(" junk", out[2]);
+	// Parameters past the end of the output are still counted
+	EXPECT_EQ(5u, SplitParameters("(1,2,3,4,5)", out, 3));
+	EXPECT_EQ("3", out[2]);
+}
+
+TEST(lagi_override, optional_parameters) {
+	auto tag = parse("\\t(\\fs20)");
+	ASSERT_EQ(4u, tag.param_count);
+	EXPECT_TRUE(tag.params[0].omitted);
+	EXPECT_TRUE(tag.params[1].omitted);
+	EXPECT_TRUE(tag.params[2].omitted);
+	EXPECT_EQ("\\fs20", tag.params[3].value);
+
+	tag = parse("\\t(2,\\fs20)");
+	EXPECT_TRUE(tag.params[0].omitted);
+	EXPECT_EQ("2", tag.params[2].value);
+
+	tag = parse("\\t(0,100,\\fs20)");
+	EXPECT_EQ("0", tag.params[0].value);
+	EXPECT_EQ("100", tag.params[1].value);
+	EXPECT_TRUE(tag.params[2].omitted);
+
+	tag = parse("\\t(0,100,2,\\fs20)");
+	EXPECT_EQ("2", tag.params[2].value);
+	EXPECT_EQ("\\fs20", tag.params[3].value);
+
+	// Too many parameters for any of them to be present
+	tag = parse("\\pos(1,2,3,4,5,6,7,8,9)");
+	EXPECT_TRUE(tag.params[0].omitted);
+	EXPECT_TRUE(tag.params[1].omitted);
+}
+
+TEST(lagi_override, clip) {
+	auto tag = parse("\\clip(1,2,3,4)");
+	ASSERT_EQ(4u, tag.param_count);
+	EXPECT_EQ(ParameterClass::ABSOLUTE_POS_X, tag.params[0].classification);
+
+	tag = parse("\\iclip(m 0 0 l 10 10)");
+	EXPECT_EQ("\\iclip", tag.name);
+	ASSERT_EQ(2u, tag.param_count);
+	EXPECT_TRUE(tag.params[0].omitted);
+	EXPECT_EQ(ParameterClass::DRAWING, tag.params[1].classification);
+	EXPECT_EQ("m 0 0 l 10 10", tag.params[1].value);
+
+	tag = parse("\\clip(2,m 0 0)");
+	EXPECT_EQ(2, tag.params[0].GetInt());
+	EXPECT_EQ("m 0 0", tag.params[1].value);
+}
+
+TEST(lagi_override, alpha) {
+	EXPECT_EQ(0x80, parse("\\alpha&H80&").params[0].GetInt());
+	EXPECT_EQ(0xFF, parse("\\1aFF").params[0].GetInt());
+	EXPECT_EQ(255, parse("\\1a&H1FF&").params[0].GetInt());
+	EXPECT_EQ(0, parse("\\3a&H").params[0].GetInt());
+}
+
+TEST(lagi_override, visit_blocks) {
+	EXPECT_TRUE(visit("").empty());
+	EXPECT_EQ((std::vector<std::string>{"text:a", "\\b", "\\i", "text:b", "comment:note", "text:c"}),
+		visit("a{\\b1\\i1}b{note}c"));
+	// Unclosed blocks are text, and empty blocks are not comments
+	EXPECT_EQ((std::vector<std::string>{"text:{\\b1", "text:{a"}), visit("{\\b1{a"));
+	EXPECT_TRUE(visit("{}").empty());
+	// Junk before the first slash is a tag of its own
+	EXPECT_EQ((std::vector<std::string>{"junk", "\\b"}), visit("{junk\\b1}"));
+}
+
+TEST(lagi_override, visit_drawings) {
+	EXPECT_EQ((std::vector<std::string>{"\\p", "drawing2:m 0 0 l 1 1", "\\p", "text:a"}),
+		visit("{\\p2}m 0 0 l 1 1{\\p0}a"));
+	// \t doesn't start a drawing
+	EXPECT_EQ((std::vector<std::string>{"\\t", ">\\p", "text:a"}), visit("{\\t(\\p1)}a"));
+}
+
+TEST(lagi_override, visit_transforms) {
+	EXPECT_EQ((std::vector<std::string>{"\\t", ">\\fs", ">\\t", ">>\\bord", "\\pos"}),
+		visit("{\\t(0,10,\\fs20\\t(\\bord2))\\pos(1,2)}"));
+}
+
+TEST(lagi_override, rewrite) {
+	struct Doubler final : DialogueVisitor {
+		TextRewriter& rewriter;
+		Doubler(TextRewriter& rewriter) : rewriter(rewriter) { }
+		void VisitTag(Tag const& tag) override {
+			for (size_t i = 0; i < tag.param_count; ++i) {
+				auto const& param = tag.params[i];
+				if (!param.omitted && param.type == ParameterType::INT)
+					rewriter.Replace(param.value, param.GetInt() * 2);
+			}
+		}
+	};
+
+	std::string text = "a{\\fad( 100 ,200)\\t(5,10,\\be1)}b";
+	std::string out = "previous contents";
+	TextRewriter rewriter(text, out);
+	Doubler doubler(rewriter);
+	VisitDialogue(text, doubler);
+	EXPECT_TRUE(rewriter.Finish());
+	EXPECT_EQ("a{\\fad( 200 ,400)\\t(10,20,\\be2)}b", out);
+
+	// Untouched lines aren't copied
+	TextRewriter unchanged(text, out);
+	EXPECT_FALSE(unchanged.Finish());
+	EXPECT_TRUE(out.empty());
+}
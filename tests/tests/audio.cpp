@@ -16,13 +16,16 @@
 
 #include <main.h>
 
+#include <libaegisub/audio/peak_index.h>
 #include <libaegisub/audio/provider.h>
+#include <libaegisub/audio/sample_convert.h>
 #include <libaegisub/fs.h>
 #include <libaegisub/make_unique.h>
 #include <libaegisub/path.h>
 #include <libaegisub/util.h>
 
 #include <boost/filesystem/fstream.hpp>
+#include <random>
 
 namespace bfs = boost::filesystem;
 
@@ -201,7 +204,7 @@ TEST(lagi_audio, volume_should_clamp_rather_than_wrap) {
 }
 
 TEST(lagi_audio, ram_cache) {
-	auto provider = agi::CreateRAMAudioProvider(agi::make_unique<TestAudioProvider<>>());
+	auto provider = agi::CreateRAMAudioProvider(agi::make_unique<TestAudioProvider<>>(), "");
 	EXPECT_EQ(1, provider->GetChannels());
 	EXPECT_EQ(90 * 48000, provider->GetNumSamples());
 	EXPECT_EQ(48000, provider->GetSampleRate());
@@ -217,8 +220,94 @@ TEST(lagi_audio, ram_cache) {
 		ASSERT_EQ(static_cast<uint16_t>((1 << 22) - 256 + i), buff[i]);
 }
 
+/// A source which can be duplicated and takes a while to decode each block
+struct SlowAudioProvider : TestAudioProvider<> {
+	int delay;
+	SlowAudioProvider(int64_t duration, int delay) : TestAudioProvider<>(duration), delay(delay) { }
+
+	void FillBuffer(void *buf, int64_t start, int64_t count) const override {
+		agi::util::sleep_for(delay);
+		TestAudioProvider<>::FillBuffer(buf, start, count);
+	}
+
+	std::unique_ptr<agi::AudioProvider> Duplicate() const override {
+		return agi::make_unique<SlowAudioProvider>(num_samples / 48000, delay);
+	}
+};
+
+TEST(lagi_audio, ram_cache_unaligned_frames) {
+	// 12-byte frames don't evenly divide the cache blocks, so the last
+	// samples are in a block of their own
+	struct SixChannelProvider : TestAudioProvider<> {
+		SixChannelProvider() {
+			channels = 6;
+			num_samples = (1 << 22) - 3;
+			decoded_samples = num_samples;
+		}
+
+		void FillBuffer(void *buf, int64_t start, int64_t count) const override {
+			auto out = static_cast<uint16_t *>(buf);
+			for (int64_t end = start + count; start < end; ++start) {
+				for (int c = 0; c < channels; ++c)
+					*out++ = (uint16_t)(start + c);
+			}
+		}
+	};
+
+	auto provider = agi::CreateRAMAudioProvider(agi::make_unique<SixChannelProvider>(), "");
+	while (provider->GetDecodedSamples() != provider->GetNumSamples()) agi::util::sleep_for(0);
+
+	const int64_t end = provider->GetNumSamples();
+	EXPECT_TRUE(provider->IsDecoded(0, end));
+	EXPECT_TRUE(provider->IsDecoded(end - 16, 16));
+
+	uint16_t buff[16 * 6];
+	provider->GetAudio(buff, end - 16, 16);
+	for (int i = 0; i < 16; ++i) {
+		for (int c = 0; c < 6; ++c)
+			ASSERT_EQ(static_cast<uint16_t>(end - 16 + i + c), buff[i * 6 + c]);
+	}
+}
+
+TEST(lagi_audio, ram_cache_parallel) {
+	auto provider = agi::CreateRAMAudioProvider(agi::make_unique<SlowAudioProvider>(10 * 60, 1), "");
+	while (provider->GetDecodedSamples() != provider->GetNumSamples()) agi::util::sleep_for(0);
+	EXPECT_TRUE(provider->IsDecoded(0, provider->GetNumSamples()));
+
+	std::vector<uint16_t> buff(provider->GetNumSamples());
+	provider->GetAudio(&buff[0], 0, buff.size());
+	for (size_t i = 0; i < buff.size(); ++i)
+		ASSERT_EQ(static_cast<uint16_t>(i), buff[i]);
+
+	auto peaks = provider->GetPeakIndex();
+	ASSERT_NE(nullptr, peaks);
+	EXPECT_TRUE(peaks->IsComplete());
+}
+
+TEST(lagi_audio, ram_cache_decodes_requested_audio_first) {
+	// 20 minutes is 28 blocks
+	auto provider = agi::CreateRAMAudioProvider(agi::make_unique<SlowAudioProvider>(20 * 60, 20), "");
+	const int64_t block = 1 << 21;
+	const int64_t end = provider->GetNumSamples() - 100;
+
+	// Not decoded yet, so it's silent
+	uint16_t buff[16];
+	provider->GetAudio(buff, end, 16);
+	EXPECT_FALSE(provider->IsDecoded(end, 16));
+	for (auto sample : buff)
+		EXPECT_EQ(0, sample);
+
+	while (!provider->IsDecoded(end, 16)) agi::util::sleep_for(1);
+	EXPECT_FALSE(provider->IsDecoded(10 * block, block));
+	EXPECT_LT(provider->GetDecodedSamples(), provider->GetNumSamples() / 2);
+
+	provider->GetAudio(buff, end, 16);
+	for (int i = 0; i < 16; ++i)
+		EXPECT_EQ(static_cast<uint16_t>(end + i), buff[i]);
+}
+
 TEST(lagi_audio, hd_cache) {
-	auto provider = agi::CreateHDAudioProvider(agi::make_unique<TestAudioProvider<>>(), agi::Path().Decode("?temp"));
+	auto provider = agi::CreateHDAudioProvider(agi::make_unique<TestAudioProvider<>>(), agi::Path().Decode("?temp"), "");
 	while (provider->GetDecodedSamples() != provider->GetNumSamples()) agi::util::sleep_for(0);
 
 	uint16_t buff[512];
@@ -228,6 +317,188 @@ TEST(lagi_audio, hd_cache) {
 		ASSERT_EQ(static_cast<uint16_t>((1 << 22) - 256 + i), buff[i]);
 }
 
+TEST(lagi_audio, hd_cache_saves_peaks_with_audio) {
+	auto path = agi::Path().Decode("?temp/hd_saved_audio.pcm");
+	auto peaks_path = agi::Path().Decode("?temp/hd_saved_audio.peaks");
+	agi::fs::Remove(path);
+	agi::fs::Remove(peaks_path);
+
+	{
+		auto provider = agi::CreateHDAudioProvider(agi::make_unique<TestAudioProvider<>>(), agi::Path().Decode("?temp"), path);
+		for (int i = 0; i < 1000 && !agi::fs::FileExists(peaks_path); ++i)
+			agi::util::sleep_for(10);
+	}
+
+	auto provider = agi::CreateSavedAudioProvider(agi::make_unique<TestAudioProvider<>>(), path);
+	ASSERT_NE(nullptr, provider->GetPeakIndex());
+	EXPECT_TRUE(provider->GetPeakIndex()->IsComplete());
+}
+
+TEST(lagi_audio, peak_index_matches_samples) {
+	TestAudioProvider<int16_t> provider(2);
+	std::vector<int16_t> samples(provider.GetNumSamples());
+	provider.GetAudio(samples.data(), 0, samples.size());
+
+	agi::AudioPeakIndex index(provider.GetNumSamples());
+	// Feed it in uneven chunks to exercise partial runs
+	for (size_t i = 0; i < samples.size(); i += 1000)
+		index.AddSamples(&samples[i], std::min<size_t>(1000, samples.size() - i));
+	ASSERT_TRUE(index.IsComplete());
+
+	// Ranges aligned to the entries used so that no rounding happens
+	for (int64_t start : {0, 16384, 32768}) {
+		for (int64_t count : {4096, 7168, 16384}) {
+			int min = 0, max = 0;
+			int64_t neg = 0, pos = 0;
+			for (int64_t i = start; i < start + count; ++i) {
+				min = std::min<int>(min, samples[i]);
+				max = std::max<int>(max, samples[i]);
+				(samples[i] > 0 ? pos : neg) += samples[i];
+			}
+
+			agi::AudioPeak peak;
+			ASSERT_TRUE(index.GetPeak(start, count, peak));
+			EXPECT_EQ(min, peak.min);
+			EXPECT_EQ(max, peak.max);
+			EXPECT_NEAR(neg / count, peak.avg_min, 2);
+			EXPECT_NEAR(pos / count, peak.avg_max, 2);
+		}
+	}
+}
+
+TEST(lagi_audio, peak_index_only_answers_indexed_ranges) {
+	std::vector<int16_t> samples(8192, 100);
+	agi::AudioPeakIndex index(samples.size() * 2);
+	index.AddSamples(samples.data(), samples.size());
+	EXPECT_EQ(8192, index.GetIndexedSamples());
+	EXPECT_FALSE(index.IsComplete());
+
+	agi::AudioPeak peak;
+	EXPECT_FALSE(index.GetPeak(0, 16, peak));
+	EXPECT_FALSE(index.GetPeak(4096, 8192, peak));
+	ASSERT_TRUE(index.GetPeak(0, 4096, peak));
+	EXPECT_EQ(0, peak.min);
+	EXPECT_EQ(100, peak.max);
+	EXPECT_EQ(100, peak.avg_max);
+}
+
+TEST(lagi_audio, peak_index_save_load) {
+	auto path = agi::Path().Decode("?temp/peak_index");
+	agi::fs::Remove(path);
+
+	std::vector<int16_t> samples(100000);
+	for (size_t i = 0; i < samples.size(); ++i)
+		samples[i] = (int16_t)(i * 7);
+	agi::AudioPeakIndex index(samples.size());
+	index.AddSamples(samples.data(), samples.size());
+	index.Save(path, 48000, "source");
+
+	EXPECT_EQ(nullptr, agi::AudioPeakIndex::Load(path, samples.size(), 44100, "source"));
+	EXPECT_EQ(nullptr, agi::AudioPeakIndex::Load(path, samples.size() + 1, 48000, "source"));
+	EXPECT_EQ(nullptr, agi::AudioPeakIndex::Load(path, samples.size(), 48000, "other"));
+	EXPECT_EQ(nullptr, agi::AudioPeakIndex::Load(path, samples.size(), 48000, ""));
+
+	auto loaded = agi::AudioPeakIndex::Load(path, samples.size(), 48000, "source");
+	ASSERT_NE(nullptr, loaded);
+	EXPECT_TRUE(loaded->IsComplete());
+
+	agi::AudioPeak expected, actual;
+	ASSERT_TRUE(index.GetPeak(1000, 50000, expected));
+	ASSERT_TRUE(loaded->GetPeak(1000, 50000, actual));
+	EXPECT_EQ(expected.min, actual.min);
+	EXPECT_EQ(expected.max, actual.max);
+	EXPECT_EQ(expected.avg_min, actual.avg_min);
+	EXPECT_EQ(expected.avg_max, actual.avg_max);
+
+	agi::fs::Remove(path);
+}
+
+TEST(lagi_audio, ram_cache_builds_peak_index) {
+	auto provider = agi::CreateRAMAudioProvider(agi::make_unique<TestAudioProvider<>>(), "");
+	while (provider->GetDecodedSamples() != provider->GetNumSamples()) agi::util::sleep_for(0);
+
+	auto peaks = provider->GetPeakIndex();
+	ASSERT_NE(nullptr, peaks);
+	EXPECT_TRUE(peaks->IsComplete());
+
+	agi::AudioPeak peak;
+	ASSERT_TRUE(peaks->GetPeak(0, 65536, peak));
+	EXPECT_EQ(SHRT_MIN, peak.min);
+	EXPECT_EQ(SHRT_MAX, peak.max);
+}
+
+TEST(lagi_audio, saved_audio) {
+	auto path = agi::Path().Decode("?temp/saved_audio.pcm");
+	agi::fs::Remove(path);
+	agi::fs::Remove(agi::Path().Decode("?temp/saved_audio.peaks"));
+
+	// Saving happens on the decoder thread after decoding finishes, and the
+	// peak index is the last thing written
+	{
+		auto provider = agi::CreateRAMAudioProvider(agi::make_unique<TestAudioProvider<>>(), path);
+		for (int i = 0; i < 1000 && !agi::fs::FileExists(agi::Path().Decode("?temp/saved_audio.peaks")); ++i)
+			agi::util::sleep_for(10);
+	}
+	ASSERT_TRUE(agi::HasSavedAudio(TestAudioProvider<>(), path));
+
+	auto provider = agi::CreateSavedAudioProvider(agi::make_unique<TestAudioProvider<>>(), path);
+	EXPECT_EQ(provider->GetNumSamples(), provider->GetDecodedSamples());
+	ASSERT_NE(nullptr, provider->GetPeakIndex());
+	EXPECT_TRUE(provider->GetPeakIndex()->IsComplete());
+
+	uint16_t buff[512];
+	provider->GetAudio(buff, (1 << 22) - 256, 512);
+	for (size_t i = 0; i < 512; ++i)
+		ASSERT_EQ(static_cast<uint16_t>((1 << 22) - 256 + i), buff[i]);
+}
+
+TEST(lagi_audio, saved_audio_rebuilds_missing_peaks) {
+	auto path = agi::Path().Decode("?temp/saved_audio_peaks.pcm");
+	auto peaks_path = agi::Path().Decode("?temp/saved_audio_peaks.peaks");
+	{
+		TestAudioProvider<> source;
+		std::atomic<bool> cancelled{false};
+		ASSERT_TRUE(agi::SaveDecodedAudio(source, path, cancelled));
+	}
+	agi::fs::Remove(peaks_path);
+
+	{
+		auto provider = agi::CreateSavedAudioProvider(agi::make_unique<TestAudioProvider<>>(), path);
+		auto peaks = provider->GetPeakIndex();
+		ASSERT_NE(nullptr, peaks);
+		while (!peaks->IsComplete()) agi::util::sleep_for(0);
+	}
+	EXPECT_TRUE(agi::fs::FileExists(peaks_path));
+}
+
+TEST(lagi_audio, saved_audio_must_match_source) {
+	auto path = agi::Path().Decode("?temp/saved_audio_match.pcm");
+	{
+		TestAudioProvider<> source;
+		std::atomic<bool> cancelled{false};
+		ASSERT_TRUE(agi::SaveDecodedAudio(source, path, cancelled));
+	}
+
+	EXPECT_TRUE(agi::HasSavedAudio(TestAudioProvider<>(), path));
+	EXPECT_FALSE(agi::HasSavedAudio(TestAudioProvider<>(2), path));
+	EXPECT_FALSE(agi::HasSavedAudio(TestAudioProvider<uint8_t>(), path));
+	EXPECT_THROW(agi::CreateSavedAudioProvider(agi::make_unique<TestAudioProvider<>>(2), path), agi::AudioDataNotFound);
+
+	// Truncated
+	bfs::resize_file(path, agi::fs::Size(path) - 1);
+	EXPECT_FALSE(agi::HasSavedAudio(TestAudioProvider<>(), path));
+}
+
+TEST(lagi_audio, saved_audio_cancelled) {
+	auto path = agi::Path().Decode("?temp/saved_audio_cancelled.pcm");
+	agi::fs::Remove(path);
+
+	TestAudioProvider<> source;
+	std::atomic<bool> cancelled{true};
+	EXPECT_FALSE(agi::SaveDecodedAudio(source, path, cancelled));
+	EXPECT_FALSE(agi::fs::FileExists(path));
+}
+
 TEST(lagi_audio, convert_8bit) {
 	auto provider = agi::CreateConvertAudioProvider(agi::make_unique<TestAudioProvider<uint8_t>>());
 
@@ -253,6 +524,69 @@ TEST(lagi_audio, convert_32bit) {
 	EXPECT_EQ(SHRT_MAX, sample);
 }
 
+namespace {
+std::vector<agi::simd::level> supported_levels() {
+	std::vector<agi::simd::level> levels{agi::simd::level::none};
+	if (agi::simd::detect() >= agi::simd::level::sse2)
+		levels.push_back(agi::simd::level::sse2);
+	if (agi::simd::detect() >= agi::simd::level::avx2)
+		levels.push_back(agi::simd::level::avx2);
+	return levels;
+}
+}
+
+TEST(lagi_audio, sample_convert_rounds_towards_zero) {
+	float floats[] = {1.5f, -1.5f, -0.00002f, 0.5f, -0.5f, 1.f};
+	int16_t ints[] = {-1, -1, 0, 5, 5, 5};
+	for (auto level : supported_levels()) {
+		int16_t out[6];
+		agi::ConvertSamplesToInt16Mono(floats, out, 6, 4, true, 1, level);
+		EXPECT_EQ(SHRT_MAX, out[0]);
+		EXPECT_EQ(SHRT_MIN, out[1]);
+		EXPECT_EQ(0, out[2]);
+		EXPECT_EQ(16384, out[3]);
+		EXPECT_EQ(-16384, out[4]);
+		EXPECT_EQ(SHRT_MAX, out[5]);
+
+		agi::ConvertSamplesToInt16Mono(ints, out, 2, 2, false, 3, level);
+		EXPECT_EQ(0, out[0]);
+		EXPECT_EQ(5, out[1]);
+	}
+}
+
+TEST(lagi_audio, sample_convert_simd_matches_scalar) {
+	struct { int bytes; bool is_float; } formats[] = {{1, false}, {2, false}, {3, false}, {4, false}, {4, true}, {8, true}};
+
+	std::mt19937 rng(0);
+	std::uniform_real_distribution<double> dist(-1.5, 1.5);
+	for (auto const& format : formats) {
+		for (int channels = 1; channels <= 9; ++channels) {
+			// Odd so that every kernel has a scalar tail to do
+			const int64_t count = 1037;
+			std::vector<char> src(count * channels * format.bytes);
+			if (format.bytes == 4 && format.is_float) {
+				for (size_t i = 0; i < src.size() / 4; ++i)
+					reinterpret_cast<float *>(src.data())[i] = static_cast<float>(dist(rng));
+			}
+			else if (format.is_float) {
+				for (size_t i = 0; i < src.size() / 8; ++i)
+					reinterpret_cast<double *>(src.data())[i] = dist(rng);
+			}
+			else {
+				for (auto& b : src) b = static_cast<char>(rng());
+			}
+
+			std::vector<int16_t> expected(count), actual(count);
+			agi::ConvertSamplesToInt16Mono(src.data(), expected.data(), count, format.bytes, format.is_float, channels, agi::simd::level::none);
+			for (auto level : supported_levels()) {
+				std::fill(actual.begin(), actual.end(), 0);
+				agi::ConvertSamplesToInt16Mono(src.data(), actual.data(), count, format.bytes, format.is_float, channels, level);
+				ASSERT_EQ(expected, actual) << format.bytes << " bytes, " << channels << " channels, level " << (int)level;
+			}
+		}
+	}
+}
+
 TEST(lagi_audio, sample_doubling) {
 	struct AudioProvider : agi::AudioProvider {
 		AudioProvider() {
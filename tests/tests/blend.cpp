@@ -0,0 +1,100 @@
+// Copyright (c) 2014, Thomas Goyne <plorkyeran@aegisub.org>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include <libaegisub/blend.h>
+
+#include <main.h>
+
+#include <random>
+
+namespace {
+/// The per-pixel blend previously used by the libass subtitles provider
+void reference_blend(uint8_t *dst, ptrdiff_t dst_stride, const uint8_t *mask, ptrdiff_t mask_stride, int width, int height, uint32_t color) {
+	unsigned int opacity = 255 - (color & 0xFF);
+	unsigned int r = color >> 24;
+	unsigned int g = (color >> 16) & 0xFF;
+	unsigned int b = (color >> 8) & 0xFF;
+
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			uint8_t *px = dst + y * dst_stride + x * 4;
+			unsigned int k = ((unsigned)mask[y * mask_stride + x]) * opacity / 255;
+			unsigned int ck = 255 - k;
+			px[0] = (k * b + ck * px[0]) / 255;
+			px[1] = (k * g + ck * px[1]) / 255;
+			px[2] = (k * r + ck * px[2]) / 255;
+			px[3] = 0;
+		}
+	}
+}
+
+std::vector<agi::simd::level> supported_levels() {
+	std::vector<agi::simd::level> levels{agi::simd::level::none};
+	if (agi::simd::detect() >= agi::simd::level::sse2)
+		levels.push_back(agi::simd::level::sse2);
+	if (agi::simd::detect() >= agi::simd::level::avx2)
+		levels.push_back(agi::simd::level::avx2);
+	return levels;
+}
+
+void check_blend(int width, int height, uint32_t color, bool flipped, std::mt19937& rng) {
+	const int frame_width = width + 5, frame_height = height + 3;
+	const ptrdiff_t frame_stride = frame_width * 4, mask_stride = width + 7;
+	std::uniform_int_distribution<int> byte(0, 255);
+
+	std::vector<uint8_t> frame(frame_stride * frame_height), mask(mask_stride * height);
+	for (auto& px : frame) px = static_cast<uint8_t>(byte(rng));
+	for (auto& m : mask) m = static_cast<uint8_t>(byte(rng));
+	// Fully covered and uncovered pixels are the common case in real bitmaps
+	for (size_t i = 0; i < mask.size(); i += 3) mask[i] = i % 2 ? 255 : 0;
+
+	uint8_t *origin = &frame[frame_stride + 4];
+	ptrdiff_t stride = frame_stride;
+	if (flipped) {
+		origin += (height - 1) * frame_stride;
+		stride = -stride;
+	}
+
+	auto expected = frame;
+	reference_blend(expected.data() + (origin - frame.data()), stride, mask.data(), mask_stride, width, height, color);
+
+	for (auto level : supported_levels()) {
+		auto actual = frame;
+		agi::BlendMask(actual.data() + (origin - frame.data()), stride, mask.data(), mask_stride, width, height, color, level);
+		ASSERT_TRUE(expected == actual) << "level " << static_cast<int>(level) << ", " << width << "x" << height;
+	}
+}
+}
+
+TEST(lagi_blend, matches_reference_for_all_widths) {
+	std::mt19937 rng(1234);
+	for (int width = 1; width <= 40; ++width)
+		check_blend(width, 3, 0x40C0FF20, false, rng);
+}
+
+TEST(lagi_blend, matches_reference_for_all_colors) {
+	std::mt19937 rng(5678);
+	std::uniform_int_distribution<uint32_t> color;
+	for (int i = 0; i < 200; ++i)
+		check_blend(37, 5, color(rng), false, rng);
+	check_blend(37, 5, 0xFFFFFF00, false, rng);
+	check_blend(37, 5, 0x000000FF, false, rng);
+}
+
+TEST(lagi_blend, bottom_up_frames) {
+	std::mt19937 rng(42);
+	check_blend(67, 19, 0x12345600, true, rng);
+}
@@ -0,0 +1,68 @@
+// Copyright (c) 2014, Thomas Goyne <plorkyeran@aegisub.org>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+
+#include <libaegisub/codepoint_set.h>
+
+#include <main.h>
+
+using agi::CodepointSet;
+
+TEST(lagi_codepoint_set, empty) {
+	CodepointSet set;
+	EXPECT_TRUE(set.empty());
+	EXPECT_EQ(0u, set.size());
+	EXPECT_FALSE(set.contains('a'));
+	EXPECT_TRUE(set.codepoints().empty());
+}
+
+TEST(lagi_codepoint_set, insert) {
+	CodepointSet set;
+	set.insert('b');
+	set.insert('a');
+	set.insert('b');
+	set.insert(0x1F600);
+	set.insert(-1);
+	EXPECT_FALSE(set.empty());
+	EXPECT_EQ(3u, set.size());
+	EXPECT_TRUE(set.contains('a'));
+	EXPECT_FALSE(set.contains('c'));
+	EXPECT_FALSE(set.contains(0x110000));
+	EXPECT_EQ((std::vector<int>{'a', 'b', 0x1F600}), set.codepoints());
+}
+
+TEST(lagi_codepoint_set, union) {
+	CodepointSet a, b;
+	a.insert(63);
+	a.insert(64);
+	b.insert(64);
+	b.insert(0x3042);
+	a |= b;
+	EXPECT_EQ((std::vector<int>{63, 64, 0x3042}), a.codepoints());
+
+	b |= CodepointSet();
+	EXPECT_EQ((std::vector<int>{64, 0x3042}), b.codepoints());
+}
+
+TEST(lagi_codepoint_set, insert_text) {
+	CodepointSet set;
+	set.insert_text("b\\Na\\nb\\h\\q\xE3\x81\x82\xFF");
+	EXPECT_EQ((std::vector<int>{'\\', 'a', 'b', 'q', 0xA0, 0x3042, 0xFFFD}), set.codepoints());
+
+	CodepointSet trailing;
+	trailing.insert_text("a\\");
+	EXPECT_EQ((std::vector<int>{'\\', 'a'}), trailing.codepoints());
+}
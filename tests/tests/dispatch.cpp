@@ -0,0 +1,88 @@
+// Copyright (c) 2014, Thomas Goyne <plorkyeran@aegisub.org>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include <libaegisub/dispatch.h>
+
+#include <main.h>
+
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST(lagi_dispatch, parallel_for_calls_each_index_once) {
+	std::vector<std::atomic<int>> calls(1000);
+	for (auto& c : calls) c = 0;
+
+	agi::dispatch::ParallelFor(calls.size(), [&](size_t i) { ++calls[i]; });
+
+	for (auto const& c : calls)
+		EXPECT_EQ(1, c);
+}
+
+TEST(lagi_dispatch, parallel_for_empty) {
+	bool called = false;
+	agi::dispatch::ParallelFor(0, [&](size_t) { called = true; });
+	EXPECT_FALSE(called);
+}
+
+TEST(lagi_dispatch, parallel_for_rethrows) {
+	std::atomic<int> calls{0};
+	EXPECT_THROW(agi::dispatch::ParallelFor(100, [&](size_t i) {
+		++calls;
+		if (i == 50) throw std::runtime_error("fail");
+	}), std::runtime_error);
+	// Everything else still ran
+	EXPECT_EQ(100, calls);
+}
+
+TEST(lagi_dispatch, idle_thunks_run_after_queued_thunks) {
+	auto queue = agi::dispatch::Create();
+	std::mutex mutex;
+	std::vector<std::string> order;
+	auto record = [&](const char *name) {
+		std::lock_guard<std::mutex> lock(mutex);
+		order.push_back(name);
+	};
+
+	// Hold the queue so that everything below is queued before any of it runs
+	std::atomic<bool> release{false};
+	queue->Async([&] { while (!release) std::this_thread::yield(); });
+
+	queue->AsyncIdle([&] {
+		record("idle");
+		// Work queued by an idle thunk still waits for anything else
+		queue->AsyncIdle([&] { record("idle 2"); });
+		queue->Async([&] { record("async 3"); });
+	});
+	queue->Async([&] { record("async 1"); });
+	queue->Async([&] { record("async 2"); });
+
+	release = true;
+	queue->Sync([] { });
+	while (true) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (order.size() == 5) break;
+		}
+		std::this_thread::yield();
+	}
+
+	std::vector<std::string> expected{"async 1", "async 2", "idle", "async 3", "idle 2"};
+	EXPECT_EQ(expected, order);
+}
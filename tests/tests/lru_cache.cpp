@@ -0,0 +1,141 @@
+// Copyright (c) 2014, Thomas Goyne <plorkyeran@aegisub.org>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include <main.h>
+
+#include <libaegisub/lru_cache.h>
+
+#include <string>
+#include <vector>
+
+namespace {
+typedef agi::LRUCache<int, std::string> Cache;
+
+bool insert(Cache& cache, int key, std::string const& value) {
+	return cache.Insert(key, value.size(), [&](std::string& cached) {
+		cached = value;
+		return value.size();
+	});
+}
+}
+
+TEST(lagi_lru_cache, find_counts_hits_and_misses) {
+	Cache cache(100);
+	EXPECT_EQ(nullptr, cache.Find(1));
+	ASSERT_TRUE(insert(cache, 1, "one"));
+
+	auto value = cache.Find(1);
+	ASSERT_NE(nullptr, value);
+	EXPECT_EQ("one", *value);
+	EXPECT_EQ(nullptr, cache.Find(2));
+	EXPECT_NE(nullptr, cache.Find(1));
+
+	auto stats = cache.GetStats();
+	EXPECT_EQ(2u, stats.hits);
+	EXPECT_EQ(2u, stats.misses);
+	EXPECT_EQ(0u, stats.evictions);
+	EXPECT_EQ(1u, stats.entries);
+	EXPECT_EQ(3u, stats.size);
+	EXPECT_EQ(100u, stats.max_size);
+}
+
+TEST(lagi_lru_cache, contains_is_not_counted) {
+	Cache cache(100);
+	insert(cache, 1, "one");
+	EXPECT_TRUE(cache.Contains(1));
+	EXPECT_FALSE(cache.Contains(2));
+
+	auto stats = cache.GetStats();
+	EXPECT_EQ(0u, stats.hits);
+	EXPECT_EQ(0u, stats.misses);
+}
+
+TEST(lagi_lru_cache, evicts_least_recently_used) {
+	Cache cache(10);
+	insert(cache, 1, "aaaa");
+	insert(cache, 2, "bbbb");
+	cache.Find(1);
+	insert(cache, 3, "cccc");
+
+	EXPECT_TRUE(cache.Contains(1));
+	EXPECT_FALSE(cache.Contains(2));
+	EXPECT_TRUE(cache.Contains(3));
+
+	auto stats = cache.GetStats();
+	EXPECT_EQ(1u, stats.evictions);
+	EXPECT_EQ(2u, stats.entries);
+	EXPECT_EQ(8u, stats.size);
+}
+
+TEST(lagi_lru_cache, size_limit_is_never_exceeded) {
+	Cache cache(10);
+	for (int i = 0; i < 20; ++i) {
+		insert(cache, i, std::string(i % 7 + 1, 'x'));
+		EXPECT_GE(10u, cache.GetStats().size);
+	}
+	EXPECT_TRUE(cache.Contains(19));
+}
+
+TEST(lagi_lru_cache, too_big_is_not_cached) {
+	Cache cache(10);
+	insert(cache, 1, "aaaa");
+	EXPECT_FALSE(insert(cache, 2, std::string(11, 'b')));
+	EXPECT_TRUE(cache.Contains(1));
+	EXPECT_FALSE(cache.Contains(2));
+	EXPECT_EQ(0u, cache.GetStats().evictions);
+}
+
+TEST(lagi_lru_cache, evicted_value_is_reused) {
+	Cache cache(10);
+	insert(cache, 1, "aaaaaaaa");
+
+	std::string reused;
+	cache.Insert(2, 8, [&](std::string& cached) {
+		reused = cached;
+		cached = "bbbbbbbb";
+		return cached.size();
+	});
+	EXPECT_EQ("aaaaaaaa", reused);
+	EXPECT_EQ(1u, cache.GetStats().evictions);
+}
+
+TEST(lagi_lru_cache, larger_than_expected_entry_evicts_more) {
+	Cache cache(10);
+	insert(cache, 1, "aaa");
+	insert(cache, 2, "bbb");
+	cache.Insert(3, 3, [&](std::string& cached) {
+		cached = "ccccccc";
+		return cached.size();
+	});
+
+	EXPECT_FALSE(cache.Contains(1));
+	EXPECT_TRUE(cache.Contains(2));
+	EXPECT_TRUE(cache.Contains(3));
+	EXPECT_EQ(10u, cache.GetStats().size);
+}
+
+TEST(lagi_lru_cache, clear_keeps_counters) {
+	Cache cache(10);
+	insert(cache, 1, "aaa");
+	cache.Find(1);
+	cache.Clear();
+
+	EXPECT_FALSE(cache.Contains(1));
+	auto stats = cache.GetStats();
+	EXPECT_EQ(1u, stats.hits);
+	EXPECT_EQ(0u, stats.entries);
+	EXPECT_EQ(0u, stats.size);
+}
@@ -0,0 +1,164 @@
+// Copyright (c) 2014, Thomas Goyne <plorkyeran@aegisub.org>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include <libaegisub/search_text.h>
+#include <libaegisub/util.h>
+
+#include <main.h>
+
+#include <random>
+
+using agi::SearchText;
+
+#define EXPECT_RANGE(st, s, e, es, ee) \
+	do { \
+		size_t start = s, end = e; \
+		EXPECT_TRUE((st).ToSource(start, end)); \
+		EXPECT_EQ((size_t)es, start); \
+		EXPECT_EQ((size_t)ee, end); \
+	} while (false)
+
+#define EXPECT_NO_RANGE(st, s, e) \
+	do { \
+		size_t start = s, end = e; \
+		EXPECT_FALSE((st).ToSource(start, end)); \
+	} while (false)
+
+TEST(lagi_search_text, unchanged_text_is_not_copied) {
+	std::string str = "{\\b1}Hello";
+	SearchText st(str, false, false);
+	EXPECT_EQ(&str, &st.Text());
+	EXPECT_EQ(3u, st.FromSource(3));
+	EXPECT_RANGE(st, 2, 4, 2, 4);
+
+	std::string lower = "hello {unclosed";
+	EXPECT_EQ(&lower, &SearchText(lower, true, true).Text());
+}
+
+TEST(lagi_search_text, strip_tags) {
+	std::string str = "a{\\b1}b{\\i1}";
+	SearchText st(str, true, false);
+	EXPECT_EQ("ab", st.Text());
+
+	EXPECT_RANGE(st, 0, 1, 0, 1);
+	// Blocks inside the range are included, and ones before or after it aren't
+	EXPECT_RANGE(st, 0, 2, 0, 7);
+	EXPECT_RANGE(st, 1, 2, 6, 7);
+	EXPECT_RANGE(st, 2, 2, 12, 12);
+
+	EXPECT_EQ(0u, st.FromSource(0));
+	EXPECT_EQ(1u, st.FromSource(1));
+	EXPECT_EQ(1u, st.FromSource(3));
+	EXPECT_EQ(1u, st.FromSource(6));
+	EXPECT_EQ(2u, st.FromSource(7));
+	EXPECT_EQ(2u, st.FromSource(9));
+	EXPECT_EQ(2u, st.FromSource(12));
+}
+
+TEST(lagi_search_text, strip_tags_only_tags) {
+	std::string str = "{\\b1}{\\i1}";
+	SearchText st(str, true, true);
+	EXPECT_EQ("", st.Text());
+	EXPECT_EQ(0u, st.FromSource(3));
+	EXPECT_RANGE(st, 0, 0, 10, 10);
+}
+
+TEST(lagi_search_text, unclosed_block_is_text) {
+	std::string str = "a{b}{c";
+	SearchText st(str, true, false);
+	EXPECT_EQ("a{c", st.Text());
+	EXPECT_RANGE(st, 1, 3, 4, 6);
+}
+
+TEST(lagi_search_text, fold_ascii) {
+	std::string str = "HeLLo {\\B1}WORLD";
+	SearchText st(str, false, true);
+	EXPECT_EQ("hello {\\b1}world", st.Text());
+	EXPECT_RANGE(st, 2, 4, 2, 4);
+	EXPECT_EQ(5u, st.FromSource(5));
+
+	SearchText stripped(str, true, true);
+	EXPECT_EQ("hello world", stripped.Text());
+	EXPECT_RANGE(stripped, 6, 11, 11, 16);
+}
+
+TEST(lagi_search_text, fold_multibyte) {
+	// Capital A with diaeresis folds to the lowercase character of the same length
+	std::string str = "\xC3\x84" "B";
+	SearchText st(str, false, true);
+	EXPECT_EQ("\xC3\xA4" "b", st.Text());
+	EXPECT_RANGE(st, 0, 3, 0, 3);
+	EXPECT_RANGE(st, 2, 3, 2, 3);
+}
+
+TEST(lagi_search_text, fold_sharp_s) {
+	std::string str = "Stra\xC3\x9F" "e";
+	SearchText st(str, false, true);
+	ASSERT_EQ("strasse", st.Text());
+
+	EXPECT_RANGE(st, 4, 6, 4, 6);
+	EXPECT_RANGE(st, 3, 7, 3, 7);
+	EXPECT_RANGE(st, 6, 7, 6, 7);
+	// Only part of the folded character
+	EXPECT_NO_RANGE(st, 4, 5);
+	EXPECT_NO_RANGE(st, 5, 6);
+	EXPECT_NO_RANGE(st, 5, 7);
+
+	EXPECT_EQ(4u, st.FromSource(4));
+	EXPECT_EQ(6u, st.FromSource(5));
+	EXPECT_EQ(6u, st.FromSource(6));
+}
+
+TEST(lagi_search_text, fold_lengthens) {
+	// Capital sharp s is three bytes and folds to two
+	std::string str = "a\xE1\xBA\x9E" "b";
+	SearchText st(str, false, true);
+	ASSERT_EQ("assb", st.Text());
+	EXPECT_RANGE(st, 1, 3, 1, 4);
+	EXPECT_RANGE(st, 3, 4, 4, 5);
+	EXPECT_NO_RANGE(st, 2, 4);
+}
+
+TEST(lagi_search_text, invalid_utf8_is_kept) {
+	std::string str = "A\xFF" "B";
+	SearchText st(str, false, true);
+	EXPECT_EQ("a\xFF" "b", st.Text());
+	EXPECT_RANGE(st, 1, 3, 1, 3);
+}
+
+TEST(lagi_search_text, matches_tagless_find_helper) {
+	// Every range found in the stripped text should map to the same place the
+	// helper used by the old search code maps it to
+	std::mt19937 rng(0);
+	const char pieces[][6] = {"a", "b", "{\\b1}", "{", "}", "c{}"};
+	for (int i = 0; i < 200; ++i) {
+		std::string str;
+		for (int j = rng() % 10; j >= 0; --j)
+			str += pieces[rng() % 6];
+
+		SearchText st(str, true, false);
+		agi::util::tagless_find_helper helper;
+		ASSERT_EQ(helper.strip_tags(str, 0), st.Text());
+
+		for (size_t s = 0; s < st.Text().size(); ++s) {
+			for (size_t e = s + 1; e <= st.Text().size(); ++e) {
+				size_t hs = s, he = e;
+				helper.map_range(hs, he);
+				EXPECT_RANGE(st, s, e, hs, he);
+			}
+		}
+	}
+}
@@ -0,0 +1,164 @@
+// Copyright (c) 2014, Thomas Goyne <plorkyeran@aegisub.org>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include <libaegisub/slab_allocator.h>
+
+#include <main.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <set>
+#include <thread>
+
+namespace {
+struct Small : agi::SlabAllocated<Small> {
+	int value;
+	Small(int value) : value(value) { }
+};
+
+struct Derived : Small {
+	char extra[64];
+	Derived() : Small(0) { }
+};
+}
+
+TEST(lagi_slab, blocks_are_distinct_and_aligned) {
+	agi::SlabAllocator alloc(24);
+	std::set<void *> blocks;
+	for (int i = 0; i < 10000; ++i) {
+		void *block = alloc.Allocate();
+		ASSERT_EQ(0u, reinterpret_cast<uintptr_t>(block) % alignof(std::max_align_t));
+		memset(block, 0xFF, 24);
+		EXPECT_TRUE(blocks.insert(block).second);
+	}
+
+	auto it = blocks.begin();
+	for (size_t i = 0; i + 1 < blocks.size(); ++i, ++it)
+		EXPECT_LE(reinterpret_cast<char *>(*it) + 24, *std::next(it));
+
+	for (auto block : blocks)
+		alloc.Free(block);
+}
+
+TEST(lagi_slab, freed_blocks_are_reused) {
+	agi::SlabAllocator alloc(16);
+	void *a = alloc.Allocate();
+	void *b = alloc.Allocate();
+	alloc.Free(a);
+	EXPECT_EQ(a, alloc.Allocate());
+	alloc.Free(a);
+	alloc.Free(b);
+}
+
+TEST(lagi_slab, empty_slabs_are_released) {
+	agi::SlabAllocator alloc(64);
+	std::vector<void *> blocks;
+	for (int i = 0; i < 10000; ++i)
+		blocks.push_back(alloc.Allocate());
+	size_t full = alloc.SlabCount();
+	EXPECT_GT(full, 5u);
+	EXPECT_LT(full, 15u);
+
+	// Free in a random order so that slabs empty out at different times
+	std::shuffle(blocks.begin(), blocks.end(), std::mt19937(0));
+	for (auto block : blocks)
+		alloc.Free(block);
+
+	// One empty slab is kept as a spare
+	EXPECT_EQ(1u, alloc.SlabCount());
+
+	for (int i = 0; i < 10; ++i)
+		alloc.Free(alloc.Allocate());
+	EXPECT_EQ(1u, alloc.SlabCount());
+}
+
+TEST(lagi_slab, free_from_other_threads) {
+	agi::SlabAllocator alloc(32);
+	std::vector<void *> blocks;
+	for (int i = 0; i < 20000; ++i)
+		blocks.push_back(alloc.Allocate());
+
+	std::vector<std::thread> threads;
+	for (size_t t = 0; t < 4; ++t) {
+		threads.emplace_back([&, t] {
+			for (size_t i = t; i < blocks.size(); i += 4) {
+				alloc.Free(blocks[i]);
+				alloc.Free(alloc.Allocate());
+			}
+		});
+	}
+	for (auto& thread : threads) thread.join();
+
+	// Each thread which allocated may have left a spare in its own shard
+	EXPECT_GE(5u, alloc.SlabCount());
+}
+
+TEST(lagi_slab, allocate_from_several_threads) {
+	agi::SlabAllocator alloc(48);
+	std::vector<std::vector<void *>> blocks(4);
+
+	std::vector<std::thread> threads;
+	for (auto& thread_blocks : blocks) {
+		threads.emplace_back([&] {
+			for (int i = 0; i < 10000; ++i) {
+				void *block = alloc.Allocate();
+				memset(block, 0xFF, 48);
+				thread_blocks.push_back(block);
+			}
+		});
+	}
+	for (auto& thread : threads) thread.join();
+
+	std::set<void *> unique;
+	for (auto const& thread_blocks : blocks)
+		unique.insert(thread_blocks.begin(), thread_blocks.end());
+	EXPECT_EQ(40000u, unique.size());
+
+	// Free everything from threads other than the ones which allocated it
+	threads.clear();
+	for (size_t t = 0; t < blocks.size(); ++t) {
+		threads.emplace_back([&, t] {
+			for (auto block : blocks[(t + 1) % blocks.size()])
+				alloc.Free(block);
+		});
+	}
+	for (auto& thread : threads) thread.join();
+	EXPECT_GE(4u, alloc.SlabCount());
+}
+
+TEST(lagi_slab, slab_allocated_class) {
+	size_t before = Small::SlabCount();
+	std::vector<Small *> objects;
+	for (int i = 0; i < 5000; ++i)
+		objects.push_back(new Small(i));
+	EXPECT_LT(before, Small::SlabCount());
+
+	for (int i = 0; i < 5000; ++i)
+		EXPECT_EQ(i, objects[i]->value);
+	for (auto obj : objects)
+		delete obj;
+	EXPECT_GE(1u, Small::SlabCount());
+}
+
+TEST(lagi_slab, subclasses_use_the_heap) {
+	size_t before = Small::SlabCount();
+	auto obj = new Derived;
+	obj->extra[63] = 1;
+	EXPECT_EQ(before, Small::SlabCount());
+	delete obj;
+}
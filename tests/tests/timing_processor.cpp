@@ -0,0 +1,172 @@
+// Copyright (c) 2014, Thomas Goyne <plorkyeran@aegisub.org>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include <libaegisub/ass/timing_processor.h>
+#include <libaegisub/vfr.h>
+
+#include <main.h>
+
+#include <algorithm>
+#include <random>
+
+using agi::ass::TimingLine;
+using agi::ass::TimingSettings;
+
+namespace {
+bool collides(TimingLine const& a, TimingLine const& b) {
+	return a.start < b.start ? b.start < a.end : a.start < b.end;
+}
+
+/// The quadratic lead-in/lead-out previously done by the timing post-processor dialog
+void reference_lead(std::vector<TimingLine>& lines, int lead_in, int lead_out) {
+	if (lead_in) {
+		for (size_t i = 0; i < lines.size(); ++i) {
+			int start = lines[i].start - lead_in;
+			for (size_t j = 0; j < i; ++j) {
+				if (!collides(lines[i], lines[j]))
+					start = std::max<int>(start, lines[j].end);
+			}
+			lines[i].start = start;
+		}
+	}
+	if (lead_out) {
+		for (size_t i = 0; i < lines.size(); ++i) {
+			int end = lines[i].end + lead_out;
+			for (size_t j = i + 1; j < lines.size(); ++j) {
+				if (!collides(lines[i], lines[j]))
+					end = std::min<int>(end, lines[j].start);
+			}
+			lines[i].end = end;
+		}
+	}
+}
+
+std::vector<TimingLine> random_lines(std::mt19937& rng, size_t count, int spacing, int max_duration) {
+	std::vector<TimingLine> lines;
+	int time = 0;
+	for (size_t i = 0; i < count; ++i) {
+		// Reuse the previous start sometimes to get plenty of ties
+		if (rng() % 4)
+			time += rng() % spacing;
+		lines.push_back(TimingLine{time, time + static_cast<int>(rng() % max_duration)});
+	}
+	std::stable_sort(lines.begin(), lines.end(), [](TimingLine const& a, TimingLine const& b) {
+		return a.start < b.start;
+	});
+	return lines;
+}
+
+void expect_same(std::vector<TimingLine> const& expected, std::vector<TimingLine> const& actual) {
+	ASSERT_EQ(expected.size(), actual.size());
+	for (size_t i = 0; i < expected.size(); ++i) {
+		EXPECT_EQ(expected[i].start.GetMillisecond(), actual[i].start.GetMillisecond()) << "line " << i;
+		EXPECT_EQ(expected[i].end.GetMillisecond(), actual[i].end.GetMillisecond()) << "line " << i;
+	}
+}
+
+void check_against_reference(int lead_in, int lead_out, int spacing, int max_duration) {
+	std::mt19937 rng(lead_in * 31 + lead_out * 7 + spacing);
+	for (int round = 0; round < 20; ++round) {
+		auto lines = random_lines(rng, 300, spacing, max_duration);
+		auto expected = lines;
+		reference_lead(expected, lead_in, lead_out);
+
+		TimingSettings settings;
+		settings.lead_in = lead_in;
+		settings.lead_out = lead_out;
+		agi::ass::TimingPostProcess(lines, settings, agi::vfr::Framerate(), {});
+		expect_same(expected, lines);
+	}
+}
+}
+
+TEST(lagi_timing_processor, lead_in_matches_reference) {
+	check_against_reference(200, 0, 500, 3000);
+	check_against_reference(1234, 0, 50, 300);
+}
+
+TEST(lagi_timing_processor, lead_out_matches_reference) {
+	check_against_reference(0, 300, 500, 3000);
+	check_against_reference(0, 987, 50, 300);
+}
+
+TEST(lagi_timing_processor, lead_in_and_out_match_reference) {
+	check_against_reference(250, 400, 500, 3000);
+	check_against_reference(999, 999, 20, 100);
+	// Lots of zero-length and unrounded lines
+	check_against_reference(15, 25, 30, 12);
+}
+
+TEST(lagi_timing_processor, lead_in_does_not_create_overlaps) {
+	std::vector<TimingLine> lines{{1000, 2000}, {2100, 3000}, {2500, 2600}};
+	TimingSettings settings;
+	settings.lead_in = 500;
+	agi::ass::TimingPostProcess(lines, settings, agi::vfr::Framerate(), {});
+	EXPECT_EQ(500, lines[0].start);
+	EXPECT_EQ(2000, lines[1].start);
+	// Overlaps the second line, so only the first one limits it
+	EXPECT_EQ(2000, lines[2].start);
+}
+
+TEST(lagi_timing_processor, lead_in_clamps_to_zero) {
+	std::vector<TimingLine> lines{{100, 2000}};
+	TimingSettings settings;
+	settings.lead_in = 500;
+	agi::ass::TimingPostProcess(lines, settings, agi::vfr::Framerate(), {});
+	EXPECT_EQ(0, lines[0].start);
+}
+
+TEST(lagi_timing_processor, adjacent) {
+	std::vector<TimingLine> lines{{0, 1000}, {1100, 2000}, {1950, 3000}, {4000, 5000}};
+	TimingSettings settings;
+	settings.adjacent = true;
+	settings.adjacent_gap = 200;
+	settings.adjacent_overlap = 100;
+	settings.adjacent_bias = 0.5;
+	agi::ass::TimingPostProcess(lines, settings, agi::vfr::Framerate(), {});
+	EXPECT_EQ(1050, lines[0].end.GetMillisecond());
+	EXPECT_EQ(1050, lines[1].start.GetMillisecond());
+	EXPECT_EQ(1976, lines[1].end.GetMillisecond());
+	EXPECT_EQ(1976, lines[2].start.GetMillisecond());
+	EXPECT_EQ(3000, lines[2].end.GetMillisecond());
+	EXPECT_EQ(4000, lines[3].start.GetMillisecond());
+}
+
+TEST(lagi_timing_processor, snap_to_keyframes) {
+	agi::vfr::Framerate fps(10.);
+	std::vector<int> keyframes{0, 10, 20, 30};
+	// Start 50ms after keyframe 10, end 150ms before keyframe 30
+	std::vector<TimingLine> lines{{1050, 2850}, {1500, 2500}};
+	TimingSettings settings;
+	settings.snap = true;
+	settings.after_start = 100;
+	settings.before_end = 200;
+	agi::ass::TimingPostProcess(lines, settings, fps, keyframes);
+	EXPECT_EQ(fps.TimeAtFrame(10, agi::vfr::START), lines[0].start.GetMillisecond());
+	EXPECT_EQ(fps.TimeAtFrame(29, agi::vfr::END), lines[0].end.GetMillisecond());
+	// Too far from any keyframe
+	EXPECT_EQ(1500, lines[1].start);
+	EXPECT_EQ(2500, lines[1].end);
+}
+
+TEST(lagi_timing_processor, snapping_without_keyframes_does_nothing) {
+	std::vector<TimingLine> lines{{1050, 2850}};
+	TimingSettings settings;
+	settings.snap = true;
+	settings.after_start = 100;
+	agi::ass::TimingPostProcess(lines, settings, agi::vfr::Framerate(10.), {});
+	EXPECT_EQ(1050, lines[0].start);
+}
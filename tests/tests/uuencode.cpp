@@ -19,6 +19,8 @@
 #include <main.h>
 
 #include <boost/algorithm/string/replace.hpp>
+#include <boost/algorithm/string/split.hpp>
+#include <cstring>
 
 using namespace agi::ass;
 
@@ -55,3 +57,120 @@ TEST(lagi_uuencode, random_blobs_roundtrip) {
 		data.push_back(rand());
 	}
 }
+
+namespace {
+std::vector<agi::simd::level> supported_levels() {
+	std::vector<agi::simd::level> levels{agi::simd::level::none};
+	if (agi::simd::detect() >= agi::simd::level::sse2)
+		levels.push_back(agi::simd::level::sse2);
+	if (agi::simd::detect() >= agi::simd::level::avx2)
+		levels.push_back(agi::simd::level::avx2);
+	return levels;
+}
+
+/// Straightforward encoder to check the optimized ones against
+std::string reference_encode(std::vector<char> const& data, bool insert_linebreaks) {
+	std::string ret;
+	size_t written = 0;
+	for (size_t pos = 0; pos < data.size(); pos += 3) {
+		unsigned char src[3] = { 0, 0, 0 };
+		for (size_t i = 0; i < 3 && pos + i < data.size(); ++i)
+			src[i] = data[pos + i];
+		unsigned char dst[4] = {
+			static_cast<unsigned char>(src[0] >> 2),
+			static_cast<unsigned char>(((src[0] & 0x3) << 4) | (src[1] >> 4)),
+			static_cast<unsigned char>(((src[1] & 0xF) << 2) | (src[2] >> 6)),
+			static_cast<unsigned char>(src[2] & 0x3F)
+		};
+		for (size_t i = 0; i < std::min<size_t>(data.size() - pos + 1, 4); ++i) {
+			ret += static_cast<char>(dst[i] + 33);
+			if (insert_linebreaks && ++written == 80 && pos + 3 < data.size()) {
+				written = 0;
+				ret += "\r\n";
+			}
+		}
+	}
+	return ret;
+}
+
+std::vector<char> random_blob(size_t len) {
+	std::vector<char> data(len);
+	for (auto& c : data) c = static_cast<char>(rand());
+	return data;
+}
+}
+
+TEST(lagi_uuencode, simd_levels_match_reference) {
+	// Lengths around the line length and the block sizes of each kernel
+	for (size_t len = 0; len < 400; ++len) {
+		auto data = random_blob(len);
+		for (bool linebreaks : {true, false}) {
+			auto expected = reference_encode(data, linebreaks);
+			for (auto level : supported_levels()) {
+				auto encoded = UUEncode(data.data(), data.data() + data.size(), linebreaks, level);
+				ASSERT_EQ(expected, encoded) << len << " bytes, level " << (int)level;
+				ASSERT_EQ(data, UUDecode(encoded.data(), encoded.data() + encoded.size(), level)) << len << " bytes, level " << (int)level;
+			}
+		}
+	}
+}
+
+TEST(lagi_uuencode, lines_are_80_characters) {
+	auto data = random_blob(1000);
+	auto encoded = UUEncode(data.data(), data.data() + data.size());
+	std::vector<std::string> lines;
+	boost::split(lines, encoded, [](char c) { return c == '\n'; });
+	ASSERT_EQ(17u, lines.size());
+	for (size_t i = 0; i + 1 < lines.size(); ++i)
+		EXPECT_EQ("\r", lines[i].substr(80)) << i;
+	// 1000 bytes is 16 lines of 60 bytes plus 40 bytes in 54 characters
+	EXPECT_EQ(54u, lines.back().size());
+}
+
+TEST(lagi_uuencode, decode_skips_line_breaks_anywhere) {
+	auto data = random_blob(500);
+	auto encoded = UUEncode(data.data(), data.data() + data.size(), false);
+	const char skipped[] = {'\r', '\n', '\0'};
+
+	for (int i = 0; i < 50; ++i) {
+		std::string broken;
+		for (char c : encoded) {
+			while (rand() % 10 == 0)
+				broken += skipped[rand() % 3];
+			broken += c;
+		}
+		for (auto level : supported_levels())
+			ASSERT_EQ(data, UUDecode(broken.data(), broken.data() + broken.size(), level)) << "level " << (int)level;
+	}
+}
+
+TEST(lagi_uuencode, decode_garbage_matches_scalar) {
+	// Invalid characters aren't rejected, but should decode to the same
+	// thing with every implementation
+	std::string garbage;
+	for (int i = 0; i < 1000; ++i)
+		garbage += static_cast<char>(rand());
+	auto expected = UUDecode(garbage.data(), garbage.data() + garbage.size(), agi::simd::level::none);
+	for (auto level : supported_levels())
+		EXPECT_EQ(expected, UUDecode(garbage.data(), garbage.data() + garbage.size(), level)) << "level " << (int)level;
+}
+
+TEST(lagi_uuencode, streaming_matches_string) {
+	// Large enough to be split into several pieces
+	for (size_t len : {0, 1, 59, 60, 61, 61440, 61441, 200000}) {
+		auto data = random_blob(len);
+		for (bool linebreaks : {true, false}) {
+			std::string streamed;
+			size_t pieces = 0;
+			UUEncode(data.data(), data.data() + data.size(), [&](const char *str, size_t size) {
+				// Pieces after the first start with the line break which
+				// ended the previous piece
+				if (linebreaks && pieces++) {
+					EXPECT_EQ(0, strncmp(str, "\r\n", 2));
+				}
+				streamed.append(str, size);
+			}, linebreaks);
+			EXPECT_EQ(UUEncode(data.data(), data.data() + data.size(), linebreaks), streamed) << len;
+		}
+	}
+}
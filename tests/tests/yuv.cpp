@@ -0,0 +1,147 @@
+// Copyright (c) 2014, Thomas Goyne <plorkyeran@aegisub.org>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+
+#include <libaegisub/yuv.h>
+
+#include <main.h>
+
+#include <cstdlib>
+#include <random>
+
+namespace {
+std::vector<agi::simd::level> supported_levels() {
+	std::vector<agi::simd::level> levels{agi::simd::level::none};
+	if (agi::simd::detect() >= agi::simd::level::sse2)
+		levels.push_back(agi::simd::level::sse2);
+	if (agi::simd::detect() >= agi::simd::level::avx2)
+		levels.push_back(agi::simd::level::avx2);
+	return levels;
+}
+
+/// A random image with some padding at the end of each row
+struct yuv_image {
+	int width, height;
+	ptrdiff_t y_stride, uv_stride;
+	std::vector<uint8_t> y, u, v;
+
+	yuv_image(int width, int height, std::mt19937& rng)
+	: width(width)
+	, height(height)
+	, y_stride(width + 3)
+	, uv_stride((width + 1) / 2 + 5)
+	, y(y_stride * height)
+	, u(uv_stride * ((height + 1) / 2))
+	, v(u.size())
+	{
+		for (auto& b : y) b = static_cast<uint8_t>(rng());
+		for (auto& b : u) b = static_cast<uint8_t>(rng());
+		for (auto& b : v) b = static_cast<uint8_t>(rng());
+	}
+
+	std::vector<uint8_t> convert(agi::ycbcr_matrix matrix, agi::ycbcr_range range, agi::simd::level level) const {
+		std::vector<uint8_t> bgra(width * height * 4);
+		agi::YUV420ToBGRA(bgra.data(), width * 4, y.data(), y_stride, u.data(), v.data(), uv_stride,
+			width, height, matrix, range, level);
+		return bgra;
+	}
+};
+
+std::vector<uint8_t> convert_pixel(uint8_t y, uint8_t u, uint8_t v, agi::ycbcr_matrix matrix, agi::ycbcr_range range) {
+	std::vector<uint8_t> bgra(4);
+	agi::YUV420ToBGRA(bgra.data(), 4, &y, 1, &u, &v, 1, 1, 1, matrix, range);
+	return bgra;
+}
+
+const agi::ycbcr_matrix matrices[] = {
+	agi::ycbcr_matrix::bt601,
+	agi::ycbcr_matrix::bt709,
+	agi::ycbcr_matrix::fcc,
+	agi::ycbcr_matrix::smpte_240m,
+	agi::ycbcr_matrix::bt2020
+};
+}
+
+TEST(lagi_yuv, levels_match_for_all_sizes) {
+	std::mt19937 rng(1234);
+	for (int width = 1; width <= 40; ++width) {
+		for (int height = 1; height <= 4; ++height) {
+			yuv_image img(width, height, rng);
+			auto expected = img.convert(agi::ycbcr_matrix::bt709, agi::ycbcr_range::tv, agi::simd::level::none);
+			for (auto level : supported_levels())
+				ASSERT_TRUE(expected == img.convert(agi::ycbcr_matrix::bt709, agi::ycbcr_range::tv, level))
+					<< "level " << static_cast<int>(level) << ", " << width << "x" << height;
+		}
+	}
+}
+
+TEST(lagi_yuv, levels_match_for_all_matrices) {
+	std::mt19937 rng(5678);
+	yuv_image img(67, 9, rng);
+	for (auto matrix : matrices) {
+		for (auto range : {agi::ycbcr_range::tv, agi::ycbcr_range::pc}) {
+			auto expected = img.convert(matrix, range, agi::simd::level::none);
+			for (auto level : supported_levels())
+				ASSERT_TRUE(expected == img.convert(matrix, range, level))
+					<< "level " << static_cast<int>(level) << ", matrix " << static_cast<int>(matrix);
+		}
+	}
+}
+
+TEST(lagi_yuv, chroma_is_shared_by_two_by_two_pixels) {
+	std::mt19937 rng(42);
+	yuv_image img(5, 3, rng);
+	auto bgra = img.convert(agi::ycbcr_matrix::bt601, agi::ycbcr_range::pc, agi::simd::level::none);
+	for (int row = 0; row < img.height; ++row) {
+		for (int x = 0; x < img.width; ++x) {
+			size_t chroma = row / 2 * img.uv_stride + x / 2;
+			auto px = convert_pixel(img.y[row * img.y_stride + x], img.u[chroma], img.v[chroma],
+				agi::ycbcr_matrix::bt601, agi::ycbcr_range::pc);
+			EXPECT_TRUE(std::equal(px.begin(), px.end(), &bgra[(row * img.width + x) * 4])) << x << ", " << row;
+		}
+	}
+}
+
+TEST(lagi_yuv, black_and_white) {
+	typedef std::vector<uint8_t> px;
+	EXPECT_EQ((px{0, 0, 0, 255}), convert_pixel(16, 128, 128, agi::ycbcr_matrix::bt601, agi::ycbcr_range::tv));
+	EXPECT_EQ((px{255, 255, 255, 255}), convert_pixel(235, 128, 128, agi::ycbcr_matrix::bt601, agi::ycbcr_range::tv));
+	EXPECT_EQ((px{0, 0, 0, 255}), convert_pixel(0, 128, 128, agi::ycbcr_matrix::bt709, agi::ycbcr_range::pc));
+	EXPECT_EQ((px{255, 255, 255, 255}), convert_pixel(255, 128, 128, agi::ycbcr_matrix::bt709, agi::ycbcr_range::pc));
+	// Out of range values are clamped
+	EXPECT_EQ((px{0, 0, 0, 255}), convert_pixel(0, 128, 128, agi::ycbcr_matrix::bt601, agi::ycbcr_range::tv));
+	EXPECT_EQ((px{255, 255, 255, 255}), convert_pixel(255, 128, 128, agi::ycbcr_matrix::bt601, agi::ycbcr_range::tv));
+}
+
+TEST(lagi_yuv, matches_ycbcr_converter) {
+	std::mt19937 rng(0);
+	for (auto matrix : matrices) {
+		// The converter's BT.2020 Kg isn't 1 - Kr - Kb
+		if (matrix == agi::ycbcr_matrix::bt2020) continue;
+		for (auto range : {agi::ycbcr_range::tv, agi::ycbcr_range::pc}) {
+			agi::ycbcr_converter conv(matrix, range);
+			for (int i = 0; i < 1000; ++i) {
+				std::array<uint8_t, 3> ycbcr{{static_cast<uint8_t>(rng()), static_cast<uint8_t>(rng()), static_cast<uint8_t>(rng())}};
+				auto rgb = conv.ycbcr_to_rgb(ycbcr);
+				auto bgra = convert_pixel(ycbcr[0], ycbcr[1], ycbcr[2], matrix, range);
+				// Only rounding may differ
+				EXPECT_GE(1, std::abs(rgb[0] - bgra[2]));
+				EXPECT_GE(1, std::abs(rgb[1] - bgra[1]));
+				EXPECT_GE(1, std::abs(rgb[2] - bgra[0]));
+			}
+		}
+	}
+}